@@ -0,0 +1,491 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : analysiscache.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "analysiscache.h"
+#include "board.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char CACHE_MAGIC[8] = { 'C', 'P', 'A', 'N', 'C', 'A', 'C', 'H' };
+// 2 has Polyglot's keys
+static const uint32_t VERSION = 2;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t entrysize;
+	uint64_t buckets;
+	// Bumped by every open, entries remember the one they were stored in
+	uint32_t generation;
+	uint32_t reserved[9];
+};
+
+// One cache line
+struct CacheEntry {
+	// Odd while the entry is written
+	uint32_t sequence;
+	// Of everything from the key on
+	uint32_t check;
+	uint64_t key;
+	uint64_t nodes;
+	int16_t score;
+	uint8_t depth;
+	uint8_t generation;
+	uint8_t pvlength;
+	uint8_t reserved[3];
+	uint16_t pv[AnalysisEntry::MAX_PV];
+};
+
+static_assert(sizeof(CacheHeader) == 64, "CacheHeader isn't 64 bytes");
+static_assert(sizeof(CacheEntry) == 64, "CacheEntry isn't 64 bytes");
+
+// The part of an entry after the sequence number and checksum, copied a
+// word at a time with atomic loads and stores, so that a reader racing a
+// writer gets a torn copy rather than undefined behaviour, and the
+// sequence number tells it so
+static const int DATA_WORDS = (sizeof(CacheEntry) - 8) / 8;
+
+// Times a reader tries an entry that is being written before giving up
+static const int READ_TRIES = 4;
+
+// Plies of depth an entry loses against newer ones for every open it is old
+static const int AGE_WEIGHT = 2;
+
+// Bits of a packed move
+static const int MOVE_DEST_SHIFT = 6;
+static const int MOVE_PROMOTION_SHIFT = 12;
+static const int SQUARE_MASK = 63;
+
+static uint16_t packMove(const BoardMove & bm)
+{
+	int promotion = (bm.getPromotion() == Piece::NOTYPE) ? 0 : bm.getPromotion();
+	return (uint16_t)(bm.origin().hash() | bm.dest().hash() << MOVE_DEST_SHIFT |
+		promotion << MOVE_PROMOTION_SHIFT);
+}
+
+static BoardMove unpackMove(uint16_t move, const Board & board)
+{
+	BoardPosition origin(move & SQUARE_MASK);
+	BoardPosition dest((move >> MOVE_DEST_SHIFT) & SQUARE_MASK);
+	int promotion = move >> MOVE_PROMOTION_SHIFT;
+	return BoardMove(origin, dest, board.getPiece(origin),
+		promotion ? (Piece::Type)promotion : Piece::NOTYPE);
+}
+
+static uint64_t * dataWords(CacheEntry * entry)
+{
+	return (uint64_t *)&entry->key;
+}
+
+static const uint64_t * dataWords(const CacheEntry * entry)
+{
+	return (const uint64_t *)&entry->key;
+}
+
+static uint32_t checksum(const CacheEntry & entry)
+{
+	const uint64_t * words = dataWords(&entry);
+	uint64_t hash = 0;
+	for(int i = 0; i < DATA_WORDS; i++) {
+		hash = (hash ^ words[i]) * 0x9e3779b97f4a7c15ULL;
+		hash ^= hash >> 29;
+	}
+	// An entry of zeros is empty, and never looks like a valid one
+	return (uint32_t)(hash >> 32) | 1;
+}
+
+void AnalysisEntry::setPv(const vector<BoardMove> & moves)
+{
+	pvlength = min((int)moves.size(), (int)MAX_PV);
+	for(int i = 0; i < pvlength; i++) {
+		pv[i] = packMove(moves[i]);
+	}
+}
+
+vector<BoardMove> AnalysisEntry::getPv(const Board & board, Piece::Color turn) const
+{
+	vector<BoardMove> moves;
+	Board copy = board;
+	for(int i = 0; i < pvlength; i++) {
+		BoardMove move = unpackMove(pv[i], copy);
+		Piece * piece = copy.getPiece(move.origin());
+		unsigned long long legal[64];
+		copy.legalMoves(turn, legal);
+		if(!piece || !(legal[move.origin().hash()] & getMask(move.dest())) ||
+				move.needPromotion() != (move.getPromotion() != Piece::NOTYPE)) {
+			break;
+		}
+		moves.push_back(move);
+		copy.update(move);
+		turn = Piece::opposite(turn);
+	}
+	return moves;
+}
+
+BoardMove AnalysisEntry::getMove(const Board & board) const
+{
+	return pvlength ? unpackMove(pv[0], board) : BoardMove();
+}
+
+AnalysisCache::AnalysisCache() :
+	m_header(0),
+	m_entries(0),
+	m_buckets(0),
+	m_size(0),
+	m_generation(0)
+#ifndef WIN32
+	, m_fd(-1)
+#endif
+{
+}
+
+AnalysisCache::~AnalysisCache()
+{
+	close();
+}
+
+// The bytes of a new cache of megabytes, a power of two of buckets
+static size_t cacheSize(int megabytes, size_t & buckets)
+{
+	size_t bucket = AnalysisCache::BUCKET_ENTRIES * sizeof(CacheEntry);
+	buckets = 1;
+	while(buckets * 2 * bucket <= (size_t)max(megabytes, 1) << 20) {
+		buckets *= 2;
+	}
+	return sizeof(CacheHeader) + buckets * bucket;
+}
+
+static void fillHeader(CacheHeader & header, size_t buckets)
+{
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = VERSION;
+	header.entrysize = sizeof(CacheEntry);
+	header.buckets = buckets;
+}
+
+void AnalysisCache::repair()
+{
+	// Nobody else has the file open, so whatever is being written was
+	// left by a writer that died
+	size_t entries = m_buckets * BUCKET_ENTRIES;
+	for(size_t i = 0; i < entries; i++) {
+		CacheEntry & entry = m_entries[i];
+		if((entry.sequence & 1) || (entry.key && entry.check != checksum(entry))) {
+			memset(&entry, 0, sizeof(entry));
+		}
+	}
+}
+
+// The header has to match the size of the file
+static bool isValid(const CacheHeader * header, size_t size)
+{
+	return size >= sizeof(CacheHeader) && !memcmp(header->magic, CACHE_MAGIC, 8) &&
+		header->version == VERSION && header->entrysize == sizeof(CacheEntry) &&
+		header->buckets > 0 && (header->buckets & (header->buckets - 1)) == 0 &&
+		size == sizeof(CacheHeader) + header->buckets * AnalysisCache::BUCKET_ENTRIES * sizeof(CacheEntry);
+}
+
+#ifndef WIN32
+
+bool AnalysisCache::open(const string & filename, int megabytes)
+{
+	close();
+
+	// A new cache is made aside and linked into place, so that nobody
+	// ever sees it half made
+	if(access(filename.c_str(), F_OK) != 0) {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+		string temp = filename + suffix;
+		int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0) {
+			return false;
+		}
+		size_t buckets;
+		size_t size = cacheSize(megabytes, buckets);
+		CacheHeader header;
+		fillHeader(header, buckets);
+		bool written = ftruncate(fd, size) == 0 &&
+			pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+		::close(fd);
+		// Another process may have won the race, its file is as good
+		if(!written || (link(temp.c_str(), filename.c_str()) != 0 && errno != EEXIST)) {
+			unlink(temp.c_str());
+			return false;
+		}
+		unlink(temp.c_str());
+	}
+
+	m_fd = ::open(filename.c_str(), O_RDWR);
+	if(m_fd < 0) {
+		return false;
+	}
+
+	// Whoever opens the file first repairs it, the others wait for that
+	bool alone = flock(m_fd, LOCK_EX | LOCK_NB) == 0;
+	struct stat st;
+	if((!alone && flock(m_fd, LOCK_SH) != 0) || fstat(m_fd, &st) != 0 ||
+			st.st_size < (off_t)sizeof(CacheHeader)) {
+		close();
+		return false;
+	}
+	void * data = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if(data == MAP_FAILED) {
+		close();
+		return false;
+	}
+	m_header = (CacheHeader *)data;
+	m_size = st.st_size;
+	if(!isValid(m_header, m_size)) {
+		close();
+		return false;
+	}
+	m_entries = (CacheEntry *)(m_header + 1);
+	m_buckets = m_header->buckets;
+	// Lookups jump around the whole file
+	madvise(data, m_size, MADV_RANDOM);
+
+	if(alone) {
+		repair();
+		flock(m_fd, LOCK_SH);
+	}
+	m_generation = (uint8_t)(__atomic_add_fetch(&m_header->generation, 1, __ATOMIC_RELAXED));
+	return true;
+}
+
+void AnalysisCache::close()
+{
+	if(m_header) {
+		msync(m_header, m_size, MS_SYNC);
+		munmap(m_header, m_size);
+	}
+	if(m_fd >= 0) {
+		// Closing drops the lock
+		::close(m_fd);
+	}
+	m_fd = -1;
+	m_header = 0;
+	m_entries = 0;
+	m_buckets = 0;
+	m_size = 0;
+}
+
+void AnalysisCache::flush()
+{
+	if(m_header) {
+		msync(m_header, m_size, MS_ASYNC);
+	}
+}
+
+#else
+
+bool AnalysisCache::open(const string & filename, int megabytes)
+{
+	close();
+
+	FILE * file = fopen(filename.c_str(), "rb");
+	if(file) {
+		char chunk[65536];
+		size_t read;
+		while((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+			m_buffer.insert(m_buffer.end(), chunk, chunk + read);
+		}
+		fclose(file);
+		if(m_buffer.size() < sizeof(CacheHeader)) {
+			m_buffer.clear();
+			return false;
+		}
+	} else {
+		size_t buckets;
+		m_buffer.assign(cacheSize(megabytes, buckets), 0);
+		fillHeader(*(CacheHeader *)&m_buffer[0], buckets);
+	}
+
+	m_header = (CacheHeader *)&m_buffer[0];
+	m_size = m_buffer.size();
+	if(!isValid(m_header, m_size)) {
+		m_buffer.clear();
+		m_header = 0;
+		m_size = 0;
+		return false;
+	}
+	m_entries = (CacheEntry *)(m_header + 1);
+	m_buckets = m_header->buckets;
+	repair();
+	m_generation = (uint8_t)++m_header->generation;
+	m_filename = filename;
+	return true;
+}
+
+void AnalysisCache::close()
+{
+	flush();
+	m_buffer.clear();
+	m_header = 0;
+	m_entries = 0;
+	m_buckets = 0;
+	m_size = 0;
+}
+
+void AnalysisCache::flush()
+{
+	if(!m_header) {
+		return;
+	}
+	FILE * file = fopen(m_filename.c_str(), "wb");
+	if(file) {
+		fwrite(&m_buffer[0], 1, m_buffer.size(), file);
+		fclose(file);
+	}
+}
+
+#endif
+
+shared_ptr<AnalysisCache> AnalysisCache::load(const string & filename)
+{
+	static mutex s_mutex;
+	static map<string, weak_ptr<AnalysisCache> > s_caches;
+
+	lock_guard<mutex> lock(s_mutex);
+	shared_ptr<AnalysisCache> cache = s_caches[filename].lock();
+	if(!cache) {
+		cache.reset(new AnalysisCache);
+		if(!cache->open(filename)) {
+			return shared_ptr<AnalysisCache>();
+		}
+		s_caches[filename] = cache;
+	}
+	return cache;
+}
+
+bool AnalysisCache::probe(unsigned long long key, AnalysisEntry & entry) const
+{
+	if(!m_entries || !key) {
+		return false;
+	}
+	CacheEntry * bucket = m_entries + (key & (m_buckets - 1)) * BUCKET_ENTRIES;
+	for(int i = 0; i < BUCKET_ENTRIES; i++) {
+		CacheEntry & slot = bucket[i];
+		if(__atomic_load_n(&slot.key, __ATOMIC_RELAXED) != key) {
+			continue;
+		}
+
+		CacheEntry copy;
+		memset(&copy, 0, sizeof(copy));
+		bool read = false;
+		for(int tries = 0; tries < READ_TRIES && !read; tries++) {
+			uint32_t sequence = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+			if(sequence & 1) {
+				continue;
+			}
+			copy.check = __atomic_load_n(&slot.check, __ATOMIC_RELAXED);
+			for(int w = 0; w < DATA_WORDS; w++) {
+				dataWords(&copy)[w] = __atomic_load_n(dataWords(&slot) + w, __ATOMIC_RELAXED);
+			}
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			read = __atomic_load_n(&slot.sequence, __ATOMIC_RELAXED) == sequence;
+		}
+		if(!read || copy.key != key || copy.check != checksum(copy)) {
+			continue;
+		}
+
+		entry.depth = copy.depth;
+		entry.score = copy.score;
+		entry.nodes = (long long)copy.nodes;
+		entry.pvlength = min((int)copy.pvlength, (int)AnalysisEntry::MAX_PV);
+		memcpy(entry.pv, copy.pv, sizeof(entry.pv));
+		return true;
+	}
+	return false;
+}
+
+void AnalysisCache::store(unsigned long long key, const AnalysisEntry & entry)
+{
+	if(!m_entries || !key) {
+		return;
+	}
+
+	// The same position if it is there, else the emptiest slot, the
+	// shallowest for its age. Slots being written are passed over, one a
+	// writer that died left that way stays so until the file is repaired.
+	// The position being written by someone else is left to them, storing
+	// it in another slot would keep it twice.
+	CacheEntry * bucket = m_entries + (key & (m_buckets - 1)) * BUCKET_ENTRIES;
+	CacheEntry * target = 0;
+	uint32_t sequence = 0;
+	int worst = 0;
+	for(int i = 0; i < BUCKET_ENTRIES; i++) {
+		CacheEntry & slot = bucket[i];
+		uint32_t slotsequence = __atomic_load_n(&slot.sequence, __ATOMIC_RELAXED);
+		uint64_t slotkey = __atomic_load_n(&slot.key, __ATOMIC_RELAXED);
+		int depth = __atomic_load_n(&slot.depth, __ATOMIC_RELAXED);
+		if(slotkey == key) {
+			if((slotsequence & 1) || depth > entry.depth) {
+				return;
+			}
+			target = &slot;
+			sequence = slotsequence;
+			break;
+		}
+		if(slotsequence & 1) {
+			continue;
+		}
+		int age = (uint8_t)(m_generation - __atomic_load_n(&slot.generation, __ATOMIC_RELAXED));
+		int value = slotkey ? depth - AGE_WEIGHT * age : INT16_MIN;
+		if(!target || value < worst) {
+			target = &slot;
+			sequence = slotsequence;
+			worst = value;
+		}
+	}
+	if(!target) {
+		return;
+	}
+
+	CacheEntry data;
+	memset(&data, 0, sizeof(data));
+	data.key = key;
+	data.nodes = (uint64_t)max(entry.nodes, 0LL);
+	data.score = (int16_t)max(-(int)AnalysisEntry::MAX_SCORE, min(entry.score, (int)AnalysisEntry::MAX_SCORE));
+	data.depth = (uint8_t)min(max(entry.depth, 0), 255);
+	data.generation = m_generation;
+	data.pvlength = (uint8_t)min(max(entry.pvlength, 0), (int)AnalysisEntry::MAX_PV);
+	memcpy(data.pv, entry.pv, data.pvlength * sizeof(uint16_t));
+	data.check = checksum(data);
+
+	// A slot another writer took meanwhile is left to it, this result is
+	// dropped. The odd sequence must be seen before any of the new data.
+	if(!__atomic_compare_exchange_n(&target->sequence, &sequence, sequence + 1,
+			false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+		return;
+	}
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&target->check, data.check, __ATOMIC_RELAXED);
+	for(int w = 0; w < DATA_WORDS; w++) {
+		__atomic_store_n(dataWords(target) + w, dataWords(&data)[w], __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&target->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+// End of file analysiscache.cpp
@@ -0,0 +1,145 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : analysiscache.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include "boardmove.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Board;
+
+/**
+ * The result of a search kept in an AnalysisCache.
+ */
+struct AnalysisEntry {
+	/** Moves of the principal variation that are kept. */
+	static const int MAX_PV = 16;
+	/** Scores are kept up to this many centipawns either way, mates too. */
+	static const int MAX_SCORE = 32000;
+
+	AnalysisEntry() :
+		depth(0),
+		score(0),
+		nodes(0),
+		pvlength(0) {}
+
+	/** Keeps the first MAX_PV moves of pv. */
+	void setPv(const std::vector<BoardMove> & pv);
+
+	/**
+	 * Returns the moves of the principal variation played from board, as
+	 * far as they are legal there.
+	 */
+	std::vector<BoardMove> getPv(const Board & board, Piece::Color turn) const;
+
+	/** Returns the first move, its piece taken from board, invalid if there is none. */
+	BoardMove getMove(const Board & board) const;
+
+	int depth;
+	/** Centipawns from the point of view of the side to move */
+	int score;
+	long long nodes;
+	int pvlength;
+	/** Origin, destination and promotion type of every move */
+	uint16_t pv[MAX_PV];
+};
+
+/**
+ * Results of searches kept in a file by the Zobrist key of their
+ * position, so that searching a position again, in this run of the
+ * program or a later one, can start from what was found before.
+ *
+ * The file is mapped shared into every process that uses it and never
+ * grows. Entries are kept in buckets of four by their key, a new result
+ * replaces the same position if it is as deep, or else the entry of the
+ * bucket that is shallowest for its age. Every open starts a new age.
+ *
+ * Any number of threads and processes may look up and store at once.
+ * Each entry has a sequence number that is odd while it is written,
+ * readers that see it change try again, and a checksum. Writers pass
+ * over entries that are being written.
+ *
+ * A writer that crashes in the middle of an entry leaves its sequence
+ * number odd. Nothing tells that apart from a writer that is slow, so
+ * the entry is skipped, and its bucket has one entry less, until it is
+ * cleared by the next process that opens the file with nobody else
+ * using it.
+ *
+ * Where there is no mmap the file is read into memory instead, and
+ * written back when it is closed.
+ */
+class AnalysisCache {
+ public:
+	AnalysisCache();
+
+	/** Flushes and unmaps the file. */
+	~AnalysisCache();
+
+	/**
+	 * Opens a cache, creating it with the given size if it doesn't exist.
+	 * An existing file keeps its size. Returns false if it can't be
+	 * opened or isn't a cache.
+	 */
+	bool open(const std::string & filename, int megabytes = 64);
+
+	/** Writes out changes and closes the file. */
+	void close();
+
+	bool isOpen() const
+		{ return m_entries != 0; }
+
+	/**
+	 * Returns the cache of filename, opening it if no one has it open.
+	 * Null if it can't be opened.
+	 */
+	static std::shared_ptr<AnalysisCache> load(const std::string & filename);
+
+	/** Looks a position up, returns false if it isn't there. */
+	bool probe(unsigned long long key, AnalysisEntry & entry) const;
+
+	/** Keeps the result of a position, unless a deeper one is kept already. */
+	void store(unsigned long long key, const AnalysisEntry & entry);
+
+	/** Starts writing changes back to the disk, without waiting. */
+	void flush();
+
+	/** Returns the number of entries the file has room for. */
+	long long getCapacity() const
+		{ return (long long)m_buckets * BUCKET_ENTRIES; }
+
+	/** Entries in a bucket. */
+	static const int BUCKET_ENTRIES = 4;
+
+ private:
+	AnalysisCache(const AnalysisCache &);
+	AnalysisCache & operator=(const AnalysisCache &);
+
+	// Clears the entries crashed writers left
+	void repair();
+
+	struct CacheHeader * m_header;
+	struct CacheEntry * m_entries;
+	size_t m_buckets;
+	size_t m_size;
+	uint8_t m_generation;
+#ifndef WIN32
+	int m_fd;
+#else
+	std::string m_filename;
+	std::vector<char> m_buffer;
+#endif
+};
+
+#endif // ANALYSISCACHE_H
+
+// End of file analysiscache.h
@@ -0,0 +1,390 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : analyzer.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "analyzer.h"
+#include "analysiscache.h"
+#include "board.h"
+#include "chessgamestate.h"
+#include "chessplayer.h"
+#include "epd.h"
+#include "jobsystem.h"
+#include "matesolver.h"
+#include "notation.h"
+#include "options.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+using namespace std;
+
+// Positions read ahead for each thread when no window is set
+static const int WINDOW_PER_THREAD = 64;
+
+// Score of a mate as EPD writes it, less a point for every ply to the
+// mate. The player's own is larger, and a cache keeps scores from
+// MAX_SCORE on as mates.
+static const int MATE_SCORE = 32767;
+
+// Nodes and megabytes the mate solver gets to find the distance of a
+// mate the search only knows is there
+static const long long MATE_NODES = 1 << 20;
+static const int MATE_TABLE = 1;
+
+// Longest line read, longer ones are reported and skipped
+static const int MAX_LINE = 4096;
+
+// Reads a line into buffer, at most MAX_LINE characters. The rest of a
+// longer line is skipped and toolong set. Returns false at the end of
+// the input.
+static bool readLine(istream & in, vector<char> & buffer, string & line, bool & toolong)
+{
+	buffer.resize(MAX_LINE + 1);
+	in.getline(&buffer[0], buffer.size());
+	streamsize count = in.gcount();
+	toolong = false;
+	if(in.fail() && !in.eof() && !in.bad() && count == (streamsize)buffer.size() - 1) {
+		in.clear();
+		in.ignore(numeric_limits<streamsize>::max(), '\n');
+		toolong = true;
+		line.clear();
+		return true;
+	}
+	if(in.fail()) {
+		return false;
+	}
+	// The newline is counted but not stored
+	if(!in.eof()) {
+		count--;
+	}
+	line.assign(&buffer[0], count);
+	return true;
+}
+
+// Returns s as a JSON string, quotes included
+static string jsonString(const string & s)
+{
+	string out = "\"";
+	for(int i = 0; i < (int)s.size(); i++) {
+		unsigned char c = s[i];
+		if(c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if(c < 0x20) {
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x", c);
+			out += escape;
+		} else {
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+// Returns the four position fields of a FEN, without the move counters
+static string epdFields(const string & fen)
+{
+	size_t end = 0;
+	for(int i = 0; i < 4 && end != string::npos; i++) {
+		end = fen.find(' ', end + (i ? 1 : 0));
+	}
+	return fen.substr(0, end);
+}
+
+Analyzer::Analyzer() :
+	m_threads(0),
+	m_format(JSON),
+	m_window(0),
+	m_read(0),
+	m_next(0),
+	m_written(0),
+	m_eof(false),
+	m_out(0),
+	m_positions(0),
+	m_errors(0),
+	m_nodes(0)
+{
+	m_limits.movetime = 1000;
+}
+
+void Analyzer::run(istream & in, ostream & out)
+{
+	// The static tables have to be set up before any thread uses them
+	Board::init();
+	Board board;
+	Options::getInstance();
+
+	if(m_threads > 0) {
+		JobSystem::setThreadCount(m_threads);
+	}
+	JobSystem * jobs = JobSystem::getInstance();
+	int threads = jobs->getThreadCount();
+
+	m_slots.assign(m_window > 0 ? m_window : threads * WINDOW_PER_THREAD, Slot());
+	m_read = m_next = m_written = 0;
+	m_eof = false;
+	m_out = &out;
+	m_positions = m_errors = m_nodes = 0;
+
+	vector<JobHandle<void> > workers;
+	for(int i = 0; i < threads; i++) {
+		workers.push_back(jobs->submit(JobSystem::ANALYSIS, [this]() { worker(); }));
+	}
+
+	// Lines are read here while the workers search the ones before
+	long long number = 0;
+	vector<char> buffer;
+	string line;
+	bool toolong;
+	while(readLine(in, buffer, line, toolong)) {
+		number++;
+		if(!toolong && (line.find_first_not_of(" \t\r") == string::npos || line[0] == '#')) {
+			continue;
+		}
+
+		unique_lock<mutex> lock(m_mutex);
+		m_writable.wait(lock, [this]() { return m_read - m_written < (long long)m_slots.size(); });
+		Slot & slot = m_slots[m_read % m_slots.size()];
+		slot.number = number;
+		slot.line.swap(line);
+		slot.toolong = toolong;
+		slot.done = false;
+		m_read++;
+		m_readable.notify_one();
+	}
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_eof = true;
+		m_readable.notify_all();
+	}
+	for(int i = 0; i < threads; i++) {
+		workers[i].wait();
+	}
+	out.flush();
+	m_out = 0;
+	m_slots.clear();
+}
+
+void Analyzer::worker()
+{
+	unique_lock<mutex> lock(m_mutex);
+	for(;;) {
+		m_readable.wait(lock, [this]() { return m_next < m_read || m_eof; });
+		if(m_next == m_read) {
+			return;
+		}
+
+		// The line stays in its slot until its result is written
+		Slot & slot = m_slots[m_next % m_slots.size()];
+		m_next++;
+		lock.unlock();
+		string result = slot.toolong ? formatError(slot.number, "line too long", "") :
+			analyze(slot.number, slot.line);
+		lock.lock();
+
+		slot.result.swap(result);
+		slot.done = true;
+		writeResults();
+	}
+}
+
+void Analyzer::writeResults()
+{
+	bool written = false;
+	while(m_written < m_read) {
+		Slot & slot = m_slots[m_written % m_slots.size()];
+		if(!slot.done) {
+			break;
+		}
+		*m_out << slot.result;
+
+		// Long lines would otherwise keep their memory
+		string().swap(slot.line);
+		string().swap(slot.result);
+		slot.done = false;
+		m_written++;
+		written = true;
+	}
+	if(written) {
+		m_writable.notify_one();
+	}
+}
+
+string Analyzer::analyze(long long number, const string & line)
+{
+	EpdPosition pos;
+	ChessGameState state;
+	if(!parseEpd(line, pos) || !state.loadFEN(pos.fen)) {
+		return formatError(number, "not a position", line);
+	}
+
+	// A finished game has nothing to search
+	SearchInfo info;
+	string move;
+	long long nodes = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if(state.getStatus() == ChessGameState::CHECKMATE) {
+		info.score = -MATE_SCORE;
+	} else if(state.getStatus() != ChessGameState::STALEMATE) {
+		BrutalPlayer player;
+		player.setIsWhite(state.isWhiteTurn());
+		player.setLimits(m_limits);
+		if(m_cache) {
+			player.setAnalysisCache(m_cache);
+		}
+		player.setInfoCallback([&info](const SearchInfo & iteration) { info = iteration; });
+		player.think(state);
+		nodes = player.getNodes();
+		BoardMove best = player.getMove();
+		if(!info.mate && abs(info.score) >= AnalysisEntry::MAX_SCORE) {
+			info.mate = findMate(state, info, best);
+		}
+		if(state.isMoveLegal(best)) {
+			move = moveToCoordinate(best);
+		}
+
+		// Mates score the plies to them off MATE_SCORE, one whose
+		// distance wasn't found scores MATE_SCORE
+		if(info.mate > 0) {
+			info.score = MATE_SCORE - (2 * info.mate - 1);
+		} else if(info.mate < 0) {
+			info.score = -(MATE_SCORE + 2 * info.mate);
+		} else if(abs(info.score) >= AnalysisEntry::MAX_SCORE) {
+			info.score = (info.score > 0) ? MATE_SCORE : -MATE_SCORE;
+		}
+	}
+	long long time = chrono::duration_cast<chrono::milliseconds>(
+		chrono::steady_clock::now() - start).count();
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_positions++;
+		m_nodes += nodes;
+	}
+	if(m_format == EPD) {
+		return formatEpd(pos, state, info, move, nodes, time);
+	}
+	return formatJson(number, pos, state, info, move, nodes, time);
+}
+
+int Analyzer::findMate(const ChessGameState & state, const SearchInfo & info,
+	BoardMove & best) const
+{
+	// The search saw the mate within its depth, the solver looks no
+	// further. A side that is getting mated is mated after its best move.
+	// The search scores every mate alike, so the quickest is played.
+	SearchLimits limits;
+	limits.nodes = MATE_NODES;
+	MateSolver solver(MATE_TABLE);
+	solver.setLimits(limits);
+	int plies = max(info.depth, 1);
+	if(info.score > 0) {
+		MateResult result = solver.solve(state.getBoard(), state.getTurn(), (plies + 1) / 2);
+		if(result.status != MateResult::MATE || result.pv.empty()) {
+			return 0;
+		}
+		best = result.pv[0];
+		return result.moves;
+	}
+	if(!state.isMoveLegal(best)) {
+		return 0;
+	}
+	ChessGameState after = state;
+	after.update(best);
+	if(after.getStatus() == ChessGameState::CHECKMATE || after.getStatus() == ChessGameState::STALEMATE) {
+		return 0;
+	}
+	MateResult result = solver.solve(after.getBoard(), after.getTurn(), max(plies / 2, 1));
+	return (result.status == MateResult::MATE) ? -result.moves : 0;
+}
+
+string Analyzer::formatError(long long number, const string & message, const string & line)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_errors++;
+	if(m_format != JSON) {
+		return string();
+	}
+	string result = "{\"line\":" + to_string(number) + ",\"error\":" + jsonString(message);
+	if(!line.empty()) {
+		result += ",\"input\":" + jsonString(line);
+	}
+	return result + "}\n";
+}
+
+string Analyzer::formatJson(long long number, const EpdPosition & pos,
+	const ChessGameState & state, const SearchInfo & info, const string & move,
+	long long nodes, long long time) const
+{
+	stringstream out;
+	out << "{\"line\":" << number << ",\"fen\":" << jsonString(state.getFEN());
+	if(!pos.id.empty()) {
+		out << ",\"id\":" << jsonString(pos.id);
+	}
+	if(state.getStatus() == ChessGameState::CHECKMATE) {
+		out << ",\"status\":\"checkmate\"";
+	} else if(state.getStatus() == ChessGameState::STALEMATE) {
+		out << ",\"status\":\"stalemate\"";
+	} else {
+		out << ",\"depth\":" << info.depth << ",\"score\":" << info.score;
+		if(info.mate) {
+			out << ",\"mate\":" << info.mate;
+		}
+		out << ",\"nodes\":" << nodes << ",\"time\":" << time;
+		if(!move.empty()) {
+			BoardMove best = coordinateToMove(state.getBoard(), move);
+			out << ",\"bestmove\":" << jsonString(move)
+				<< ",\"san\":" << jsonString(moveToSAN(state, best));
+		}
+	}
+	out << "}\n";
+	return out.str();
+}
+
+string Analyzer::formatEpd(const EpdPosition & pos, const ChessGameState & state,
+	const SearchInfo & info, const string & move, long long nodes, long long time) const
+{
+	stringstream out;
+	out << epdFields(pos.fen);
+	out << " acd " << info.depth << "; acn " << nodes << "; acs " << time / 1000
+		<< "; ce " << info.score << ";";
+	if(!move.empty()) {
+		string san = moveToSAN(state, coordinateToMove(state.getBoard(), move));
+		out << " pm " << san << "; pv " << san << ";";
+	}
+
+	// What the record said already is kept
+	if(!pos.bm.empty()) {
+		out << " bm";
+		for(int i = 0; i < (int)pos.bm.size(); i++) {
+			out << " " << pos.bm[i];
+		}
+		out << ";";
+	}
+	if(!pos.am.empty()) {
+		out << " am";
+		for(int i = 0; i < (int)pos.am.size(); i++) {
+			out << " " << pos.am[i];
+		}
+		out << ";";
+	}
+	if(pos.dm) {
+		out << " dm " << pos.dm << ";";
+	}
+	if(!pos.id.empty()) {
+		out << " id \"" << pos.id << "\";";
+	}
+	out << "\n";
+	return out.str();
+}
+
+// End of file analyzer.cpp
@@ -0,0 +1,174 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : analyzer.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "searchinfo.h"
+
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class AnalysisCache;
+class BoardMove;
+class ChessGameState;
+struct EpdPosition;
+
+/**
+ * Searches a stream of positions with the BrutalPlayer, several at once,
+ * and writes a result for each in the order they came in.
+ *
+ * The input is read a line at a time, a FEN or an EPD record per line,
+ * while the positions before it are searched. At most a window of
+ * positions is read ahead of the last one written: a position is only
+ * read once there is room for it, and a result that finishes early
+ * waits in the window for the ones before it. So the memory used doesn't
+ * grow with the input, however long it is.
+ *
+ * Every position gets a player of its own. Given an AnalysisCache they
+ * share what they found through it, with each other and with later runs.
+ */
+class Analyzer {
+ public:
+	/** The ways of writing results. */
+	enum Format {
+		/** A JSON object per line */
+		JSON,
+		/** The EPD record with acd, acn, acs, ce, pm and pv operations */
+		EPD
+	};
+
+	Analyzer();
+
+	/** Sets how many positions are searched at once, every core by default. */
+	void setThreads(int threads)
+		{ m_threads = threads; }
+
+	/** Sets the search limits for every position, 1 second per move by default. */
+	void setLimits(const SearchLimits & limits)
+		{ m_limits = limits; }
+
+	void setFormat(Format format)
+		{ m_format = format; }
+
+	/**
+	 * Sets how many positions may be read ahead of the last one written,
+	 * 0 for 64 per thread.
+	 */
+	void setWindow(int positions)
+		{ m_window = positions; }
+
+	/** Sets the cache the players share, null for none. */
+	void setAnalysisCache(const std::shared_ptr<AnalysisCache> & cache)
+		{ m_cache = cache; }
+
+	/**
+	 * Searches every position of in and writes the results to out,
+	 * returns once all are written. Empty lines and lines starting with
+	 * '#' are skipped. A line that isn't a position, or is longer than
+	 * 4096 characters, is reported in its place in JSON, and left out of
+	 * EPD.
+	 *
+	 * A mate scores 32767 less the plies to it, and JSON gives the moves
+	 * to it as "mate", negative for the side getting mated. A mate whose
+	 * distance the mate solver couldn't find scores 32767.
+	 */
+	void run(std::istream & in, std::ostream & out);
+
+	/** Returns the positions searched by the last run. */
+	long long getPositions() const
+		{ return m_positions; }
+
+	/** Returns the lines of the last run that weren't positions. */
+	long long getErrors() const
+		{ return m_errors; }
+
+	/** Returns the nodes searched by the last run. */
+	long long getNodes() const
+		{ return m_nodes; }
+
+ private:
+	Analyzer(const Analyzer &);
+	Analyzer & operator=(const Analyzer &);
+
+	// A line read and, once it is searched, its result
+	struct Slot {
+		Slot() :
+			number(0),
+			toolong(false),
+			done(false) {}
+
+		long long number;
+		std::string line;
+		// The line was too long to be read, and is empty
+		bool toolong;
+		std::string result;
+		bool done;
+	};
+
+	void worker();
+
+	// Searches one line and returns what is written for it, empty for
+	// nothing
+	std::string analyze(long long number, const std::string & line);
+
+	// Returns the moves to the mate a search found, negative if the side
+	// to move is getting mated, 0 if the mate solver can't tell. The move
+	// best becomes the first of a quicker mate.
+	int findMate(const ChessGameState & state, const SearchInfo & info,
+		BoardMove & best) const;
+
+	// Counts an error and returns what is written for it, line is the
+	// input if it is worth showing
+	std::string formatError(long long number, const std::string & message,
+		const std::string & line);
+
+	std::string formatJson(long long number, const EpdPosition & pos,
+		const ChessGameState & state, const SearchInfo & info,
+		const std::string & move, long long nodes, long long time) const;
+	std::string formatEpd(const EpdPosition & pos, const ChessGameState & state,
+		const SearchInfo & info, const std::string & move, long long nodes,
+		long long time) const;
+
+	// Writes the finished results at the front of the window, the mutex
+	// has to be held
+	void writeResults();
+
+	int m_threads;
+	SearchLimits m_limits;
+	Format m_format;
+	int m_window;
+	std::shared_ptr<AnalysisCache> m_cache;
+
+	// Slot i % size holds line i, lines m_written up to m_read are in
+	// the window and m_next is the next to be searched
+	std::vector<Slot> m_slots;
+	long long m_read;
+	long long m_next;
+	long long m_written;
+	bool m_eof;
+	std::ostream * m_out;
+
+	long long m_positions;
+	long long m_errors;
+	long long m_nodes;
+
+	std::mutex m_mutex;
+	// Signalled when a line is read or the input ends
+	std::condition_variable m_readable;
+	// Signalled when results are written and the window has room
+	std::condition_variable m_writable;
+};
+
+#endif // ANALYZER_H
+
+// End of file analyzer.h
@@ -0,0 +1,165 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : analyzerunner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "analysiscache.h"
+#include "analyzer.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "searchinfo.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void printUsage()
+{
+	cerr << "Usage: chesspizza-analyze [options] [FILE]\n\n";
+	cerr << "Searches every position of FILE, or of the standard input, with the\n";
+	cerr << "Brutal Chess engine on all cores, and writes a result for each in the\n";
+	cerr << "order they came in. A line is a FEN or an EPD record. The input is\n";
+	cerr << "read as the search goes, so it may be of any length.\n\n";
+	cerr << "Results are JSON objects, one per line, with the line number, fen,\n";
+	cerr << "id, depth, score in centipawns for the side to move, mate in moves\n";
+	cerr << "when there is a forced mate, negative when the side to move is\n";
+	cerr << "getting mated, nodes, time in milliseconds, bestmove and san. A mate\n";
+	cerr << "scores 32767 less the plies to it. Lines that aren't positions, or\n";
+	cerr << "are longer than 4096 characters, give an error instead.\n\n";
+	cerr << "Options:\n";
+	cerr << " -o FILE  --output=FILE\t Write the results to FILE instead of the console.\n";
+	cerr << " --epd\t\t\t\t Write EPD records with acd, acn, acs, ce, pm and pv\n";
+	cerr << "      \t\t\t\t instead, lines that aren't positions are left out.\n";
+	cerr << " --movetime=MS\t\t\t Time per position, 1000 by default.\n";
+	cerr << " --nodes=N\t\t\t Nodes per position instead.\n";
+	cerr << " --depth=N\t\t\t Search depth in plies instead.\n";
+	cerr << " --cache=FILE\t\t\t Share results between the searches, and with later\n";
+	cerr << "             \t\t\t runs, through an analysis cache.\n";
+	cerr << " --cache-size=MB\t\t Size of a new cache, 64 by default.\n";
+	cerr << " --window=N\t\t\t Positions read ahead of the last one written, which\n";
+	cerr << "           \t\t\t bounds the memory used, 64 per thread by default.\n";
+	cerr << " -j N  --threads=N\t\t Positions searched at once, one per core by default.\n";
+	cerr << LogOptions::usage();
+	cerr << " -h  --help\t\t\t Print this help screen.\n";
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+
+	string input, output, cachefile;
+	LogOptions logoptions;
+	int threads = 0, window = 0, cachesize = 64;
+	bool epd = false;
+	SearchLimits limits;
+
+	for(int i = 0; i < (int)args.size(); i++) {
+		if(args[i] == "-h" || args[i] == "--help") {
+			printUsage();
+		} else if(args[i] == "-o" && i + 1 < (int)args.size()) {
+			output = args[++i];
+		} else if(args[i].substr(0, 9) == "--output=") {
+			output = args[i].substr(9);
+		} else if(args[i] == "--epd") {
+			epd = true;
+		} else if(args[i].substr(0, 11) == "--movetime=") {
+			limits.movetime = atoi(args[i].substr(11).c_str());
+		} else if(args[i].substr(0, 8) == "--nodes=") {
+			limits.nodes = atoll(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 8) == "--depth=") {
+			limits.depth = atoi(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 8) == "--cache=") {
+			cachefile = args[i].substr(8);
+		} else if(args[i].substr(0, 13) == "--cache-size=") {
+			cachesize = atoi(args[i].substr(13).c_str());
+		} else if(args[i].substr(0, 9) == "--window=") {
+			window = atoi(args[i].substr(9).c_str());
+		} else if(args[i] == "-j" && i + 1 < (int)args.size()) {
+			threads = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 10) == "--threads=") {
+			threads = atoi(args[i].substr(10).c_str());
+		} else if(logoptions.parse(args[i])) {
+			// --log or --log-level
+		} else if((args[i][0] == '-' && args[i] != "-") || !input.empty()) {
+			printUsage();
+		} else {
+			input = args[i];
+		}
+	}
+	if(window < 0 || cachesize <= 0) {
+		printUsage();
+	}
+
+	if(!logoptions.apply()) {
+		return 1;
+	}
+
+	ifstream infile;
+	if(!input.empty() && input != "-") {
+		infile.open(input.c_str());
+		if(!infile.is_open()) {
+			cerr << "Couldn't read " << input << endl;
+			return 1;
+		}
+	}
+	ofstream outfile;
+	if(!output.empty()) {
+		outfile.open(output.c_str());
+		if(!outfile.is_open()) {
+			cerr << "Couldn't create " << output << endl;
+			return 1;
+		}
+	}
+
+	Analyzer analyzer;
+	analyzer.setThreads(threads);
+	analyzer.setWindow(window);
+	analyzer.setFormat(epd ? Analyzer::EPD : Analyzer::JSON);
+	if(!limits.isEmpty()) {
+		analyzer.setLimits(limits);
+	}
+	if(!cachefile.empty()) {
+		shared_ptr<AnalysisCache> cache(new AnalysisCache);
+		if(!cache->open(cachefile, cachesize)) {
+			cerr << "Couldn't open the analysis cache " << cachefile << endl;
+			return 1;
+		}
+		analyzer.setAnalysisCache(cache);
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	analyzer.run(infile.is_open() ? (istream &)infile : cin, outfile.is_open() ? (ostream &)outfile : cout);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	int result = 0;
+	if(outfile.is_open()) {
+		outfile.close();
+		if(outfile.fail()) {
+			cerr << "Couldn't write " << output << endl;
+			result = 1;
+		}
+	}
+
+	char line[160];
+	snprintf(line, sizeof(line), "Searched %lld positions, %lld lines weren't positions, "
+		"%.1f positions/s, %.0f nodes/s, in %.1fs",
+		analyzer.getPositions(), analyzer.getErrors(), analyzer.getPositions() / max(seconds, 0.001),
+		analyzer.getNodes() / max(seconds, 0.001), seconds);
+	cerr << line << endl;
+
+	JobSystem::destroy();
+	Logger::destroy();
+	return result;
+}
+
+// End of file analyzerunner.cpp
@@ -7,6 +7,7 @@
  **************************************************************************/
 
 #include "config.h"
+#include "logger.h"
 #include "pieceset.h"
 #include "SDL_opengl.h"
 
@@ -144,7 +145,7 @@ bool BasicSet::unloadGL()
 
 void BasicSet::draw(const ChessGameState& cgs)
 {
-	Board b = cgs.getBoard();
+	const Board & b = cgs.getBoard();
 	
 	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 	
@@ -168,7 +169,7 @@ void BasicSet::draw(const ChessGameState& cgs)
 
 			double offx = 0.0, offy = 0.0;
 			if(m_movetimer[bp.x()][bp.y()].first.started()) {
-				cout << bp.x() << " " << bp.y() << endl;
+				LOG_DEBUG("pieces", "Moving " << bp.x() << " " << bp.y());
 				m_movetimer[bp.x()][bp.y()].first++;
 				m_movetimer[bp.x()][bp.y()].second++;
 				offx = m_movetimer[bp.x()][bp.y()].first.value();
@@ -0,0 +1,294 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : bench.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "bench.h"
+#include "board.h"
+#include "chessgamestate.h"
+#include "chessplayer.h"
+#include "notation.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Openings and the games that followed from them, as moves from the
+// starting position. Changing this list changes the bench signature.
+static const char * BENCH_POSITIONS[] = {
+	"e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7",
+	"e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7 a4c6 d7c6 "
+		"f3e5 f6e4 c2c4 d8d2 b1d2 e4d2 c1d2 c8e6 f2f4 e6c4 e5c4 e8g8",
+	"e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7 a4c6 d7c6 "
+		"f3e5 f6e4 c2c4 d8d2 b1d2 e4d2 c1d2 c8e6 f2f4 e6c4 e5c4 e8g8 "
+		"c4e5 f7f5 d1b3 f8f7 b3f7 g8h8 f7e7 h8g8 e7c7 b7b5 c7c6 g7g5 "
+		"c6a8 g8g7 f4g5 f5f4",
+	"e2e4 e7e5 g1f3 b8c6 f1c4 f8c5 c2c3 g8f6 d2d4",
+	"e2e4 e7e5 g1f3 b8c6 f1c4 f8c5 c2c3 g8f6 d2d4 c6d4 c3d4 f6e4 "
+		"d4c5 e4c5 f3e5 d7d5 c4e2 c8e6 c1e3 e8g8 e3c5 f7f5 c5f8",
+	"e2e4 e7e5 g1f3 b8c6 f1c4 f8c5 c2c3 g8f6 d2d4 c6d4 c3d4 f6e4 "
+		"d4c5 e4c5 f3e5 d7d5 c4e2 c8e6 c1e3 e8g8 e3c5 f7f5 c5f8 d8f8 "
+		"b1c3 c7c5 e1g1 d5d4 c3b5 e6a2 a1a2 d4d3 e2d3 g7g5 b5c3 b7b5 "
+		"c3b5 c5c4 d3c4",
+	"e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6",
+	"e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6 c1e3 f6e4 "
+		"c3e4 c8e6 d4e6 f7e6 f1d3 b8c6 e1g1 c6d4 e3d4 d6d5 d1h5 g7g6",
+	"e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6 c1e3 f6e4 "
+		"c3e4 c8e6 d4e6 f7e6 f1d3 b8c6 e1g1 c6d4 e3d4 d6d5 d1h5 g7g6 "
+		"h5g4 d5e4 d4h8 e4d3 c2d3 d8d3 g4a4 b7b5 a4a5 d3f1 a1f1 f8g7 "
+		"h8g7 e8f7 a5c3 e6e5",
+	"e2e4 c7c5 b1c3 b8c6 g2g3 g7g6 f1g2 f8g7",
+	"e2e4 c7c5 b1c3 b8c6 g2g3 g7g6 f1g2 f8g7 d2d4 c5d4 c3d5 e7e5 "
+		"c1d2 g8f6 d5f6 d8f6 g1e2 f6f2 e1f2 d7d5 e4d5 c8e6",
+	"e2e4 c7c5 b1c3 b8c6 g2g3 g7g6 f1g2 f8g7 d2d4 c5d4 c3d5 e7e5 "
+		"c1d2 g8f6 d5f6 d8f6 g1e2 f6f2 e1f2 d7d5 e4d5 c8e6 d5e6 f7e6 "
+		"f2g1 e8g8 a2a4 d4d3 c2d3 c6d4 e2c3 e5e4 c3e4 e6e5 b2b4 b7b5 "
+		"a4b5 d4b5",
+	"e2e4 e7e6 d2d4 d7d5 b1c3 f8b4 e4e5 c7c5",
+	"e2e4 e7e6 d2d4 d7d5 b1c3 f8b4 e4e5 c7c5 f1b5 c8d7 b5d7 b8d7 "
+		"d4c5 b4c3 b2c3 d7e5 c1e3 g8f6 g1e2 e8g8 e1g1 f6e4",
+	"e2e4 e7e6 d2d4 d7d5 b1c3 f8b4 e4e5 c7c5 f1b5 c8d7 b5d7 b8d7 "
+		"d4c5 b4c3 b2c3 d7e5 c1e3 g8f6 g1e2 e8g8 e1g1 f6e4 f2f4 e4c5 "
+		"e3c5 f7f5 f4e5 d5d4 c5f8 d8f8 c3d4 b7b5 c2c3 g7g5 g2g3 f5f4 "
+		"g3f4 g5f4",
+	"e2e4 c7c6 d2d4 d7d5 e4e5 c8f5",
+	"e2e4 c7c6 d2d4 d7d5 e4e5 c8f5 c1e3 f5c2 d1c2 g8f6 e5f6 e7f6 "
+		"f1d3 f8d6 h2h4 e8g8 d3h7 g8h8 h7f5 b8d7",
+	"e2e4 c7c6 d2d4 d7d5 e4e5 c8f5 c1e3 f5c2 d1c2 g8f6 e5f6 e7f6 "
+		"f1d3 f8d6 h2h4 e8g8 d3h7 g8h8 h7f5 b8d7 b1c3 h8g8 g1f3 d7e5 "
+		"d4e5 f6e5 h4h5 d5d4 f5h7 g8h8 f3d4 e5d4 e3d4 f7f5 h7g6 h8g8",
+	"e2e4 d7d5 e4d5 d8d5 b1c3 d5a5",
+	"e2e4 d7d5 e4d5 d8d5 b1c3 d5a5 c3e4 a5a2 a1a2 c8e6 f1b5 b8c6 "
+		"b5c6 b7c6 a2a3 g8f6 e4c5 f6e4 c5e4 f7f5",
+	"e2e4 d7d5 e4d5 d8d5 b1c3 d5a5 c3e4 a5a2 a1a2 c8e6 f1b5 b8c6 "
+		"b5c6 b7c6 a2a3 g8f6 e4c5 f6e4 c5e4 f7f5 d1h5 g7g6 h5f3 f5e4 "
+		"f3e4 f8g7 e4e6 g7b2 c1b2 e8f8 b2h8 c6c5 h8b2 c5c4 e6c4 e7e5",
+	"e2e4 d7d6 d2d4 g8f6 b1c3 g7g6",
+	"e2e4 d7d6 d2d4 g8f6 b1c3 g7g6 f1b5 c8d7 b5d7 b8d7 c1e3 f6e4 "
+		"c3e4 f8g7 g1f3 g7d4 f3d4 e7e5 d4f3 e8g8",
+	"e2e4 d7d6 d2d4 g8f6 b1c3 g7g6 f1b5 c8d7 b5d7 b8d7 c1e3 f6e4 "
+		"c3e4 f8g7 g1f3 g7d4 f3d4 e7e5 d4f3 e8g8 e1g1 c7c5 d1d6 f7f5 "
+		"d6d5 f8f7 e4d6 e5e4 d5f7 g8h8 f3d2 d7e5 f7b7 d8d6 b7a8 d6f8",
+	"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 f8e7",
+	"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 f8e7 c4d5 f6d5 g5e7 d8e7 "
+		"c3d5 e6d5 d1a4 c8d7 a4b3 e7e2 f1e2 b8c6 b3b7 c6d4",
+	"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 f8e7 c4d5 f6d5 g5e7 d8e7 "
+		"c3d5 e6d5 d1a4 c8d7 a4b3 e7e2 f1e2 b8c6 b3b7 c6d4 b7a8 e8e7 "
+		"a8h8 d4e2 g1e2 c7c5 h8g7 e7e8 g7h7 f7f5 f2f4 d5d4 e1f2 d4d3 "
+		"e2c3 d3d2",
+	"d2d4 d7d5 c2c4 c7c6 g1f3 g8f6 b1c3 d5c4",
+	"d2d4 d7d5 c2c4 c7c6 g1f3 g8f6 b1c3 d5c4 c1e3 d8d4 f3d4 c8e6 "
+		"d4e6 f7e6 f2f4 b8d7 a2a4 d7e5 f4e5 f6e4 c3e4 b7b5",
+	"d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6 g1f3 e8g8",
+	"d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6 g1f3 e8g8 c1e3 f6e4 "
+		"c3e4 g7d4 f3d4 c8e6 d4e6 f7e6 f1d3 f8f2 e1f2 b8c6 f2g1 c6d4",
+	"d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6 g1f3 e8g8 c1e3 f6e4 "
+		"c3e4 g7d4 f3d4 c8e6 d4e6 f7e6 f1d3 f8f2 e1f2 b8c6 f2g1 c6d4 "
+		"e3d4 c7c5 d4e3 d6d5 e4c5 d5c4 c5b7 c4d3 b7d8 a8d8 e3a7 d3d2 "
+		"a7c5 e6e5 c5e7 e5e4",
+	"d2d4 g8f6 c2c4 e7e6 b1c3 f8b4 d1c2",
+	"d2d4 g8f6 c2c4 e7e6 b1c3 f8b4 d1c2 b4c3 c2c3 d7d5 c4d5 f6d5 "
+		"c3a5 c8d7 c1d2 b8c6 a5a4 c6d4 a4d4 e8g8 e2e4",
+	"d2d4 g8f6 c2c4 e7e6 b1c3 f8b4 d1c2 b4c3 c2c3 d7d5 c4d5 f6d5 "
+		"c3a5 c8d7 c1d2 b8c6 a5a4 c6d4 a4d4 e8g8 e2e4 c7c5 d4c5 f7f5 "
+		"e4d5 e6d5 c5d5 d7e6 d5e6 f8f7 d2e3 b7b5 f1b5 g7g5 g1f3 f5f4 "
+		"e3c5",
+	"d2d4 f7f5 g2g3 g8f6 f1g2 e7e6",
+	"d2d4 f7f5 g2g3 g8f6 f1g2 e7e6 c1e3 f8d6 b1c3 d6g3 f2g3 d7d5 "
+		"g1f3 c8d7 e1g1 b8c6 b2b4 c6d4 f3d4 e8g8",
+	"d2d4 f7f5 g2g3 g8f6 f1g2 e7e6 c1e3 f8d6 b1c3 d6g3 f2g3 d7d5 "
+		"g1f3 c8d7 e1g1 b8c6 b2b4 c6d4 f3d4 e8g8 h2h4 c7c5 b4c5 f6e4 "
+		"c3e4 f5e4 f1f8 d8f8 c5c6 d7c6 d4e6 c6d7 e6f8 a8f8 d1d5 d7e6",
+	"c2c4 e7e5 b1c3 g8f6 g1f3 b8c6",
+	"c2c4 e7e5 b1c3 g8f6 g1f3 b8c6 d2d3 f8d6 c1e3 e8g8 a2a4 c6d4 "
+		"f3d4 e5d4 e3d4 d6h2 h1h2 d7d5 c4d5 f6d5",
+	"g1f3 d7d5 g2g3 g8f6 f1g2 e7e6 e1g1",
+	"g1f3 d7d5 g2g3 g8f6 f1g2 e7e6 e1g1 f8d6 d2d4 d6g3 f2g3 c8d7 "
+		"c1e3 b8c6 b1c3 c6d4 f3d4 e8g8 b2b4 c7c5 b4c5",
+	"g1f3 d7d5 g2g3 g8f6 f1g2 e7e6 e1g1 f8d6 d2d4 d6g3 f2g3 c8d7 "
+		"c1e3 b8c6 b1c3 c6d4 f3d4 e8g8 b2b4 c7c5 b4c5 f6e4 c3e4 d5e4 "
+		"g2e4 f7f5 e4b7 e6e5 b7a8 d8a8 d4b3 e5e4 d1d7 g7g5 e3g5 e4e3 "
+		"g5e3",
+	"c2c4 c7c5 g1f3 g8f6 b1c3 b8c6",
+	"c2c4 c7c5 g1f3 g8f6 b1c3 b8c6 d2d3 d7d5 c4d5 f6d5 c3d5 d8d5 "
+		"e2e4 d5e4 d3e4 c8e6 a2a4 f7f5 e4f5 e6f5",
+	"e2e4 e7e5 f2f4 e5f4 g1f3 g7g5",
+	"e2e4 e7e5 f2f4 e5f4 g1f3 g7g5 f1d3 f8d6 b1c3 b8c6 e1g1 g8f6 "
+		"f3g5 f6e4 g5e4 e8g8 e4d6 c7d6 f1f4 f7f5",
+	"e2e4 e7e5 f2f4 e5f4 g1f3 g7g5 f1d3 f8d6 b1c3 b8c6 e1g1 g8f6 "
+		"f3g5 f6e4 g5e4 e8g8 e4d6 c7d6 f1f4 f7f5 c3d5 c6d4 f4d4 b7b5 "
+		"d3b5 c8b7 d5e3 b7g2 e3g2 d6d5 d4d5 d7d6 d2d4 f5f4 c1d2 f4f3",
+	"e2e4 e7e5 g1f3 g8f6 f3e5 d7d6 e5f3 f6e4",
+	"e2e4 e7e5 g1f3 g8f6 f3e5 d7d6 e5f3 f6e4 f1b5 c8d7 b5d7 b8d7 "
+		"d1e2 f8e7 e2e4 e8g8 e4b7 d7e5 f3e5 d6e5 b1c3 d8d2",
+	0
+};
+
+BenchResult runBench(int depth, ostream & out)
+{
+	Board::init();
+
+	BenchResult result;
+	BrutalPlayer player;
+	SearchLimits limits;
+	limits.depth = depth;
+	player.setLimits(limits);
+
+	for(int i = 0; BENCH_POSITIONS[i]; i++) {
+		ChessGameState state;
+		stringstream ss(BENCH_POSITIONS[i]);
+		string move;
+		while(ss >> move) {
+			state.update(coordinateToMove(state.getBoard(), move));
+		}
+
+		player.setIsWhite(state.isWhiteTurn());
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		player.think(state);
+		result.time += chrono::duration_cast<chrono::milliseconds>(
+			chrono::steady_clock::now() - start).count();
+		result.nodes += player.getNodes();
+		result.positions++;
+
+		out << "Position " << result.positions << ": "
+			<< moveToCoordinate(player.getMove()) << ", "
+			<< player.getNodes() << " nodes" << endl;
+	}
+
+	out << "===========================" << endl;
+	out << "Depth           : " << depth << endl;
+	out << "Positions       : " << result.positions << endl;
+	out << "Total time (ms) : " << result.time << endl;
+	out << "Nodes searched  : " << result.nodes << endl;
+	out << "Nodes/second    : " << result.nps() << endl;
+	return result;
+}
+
+// Every position of the bench games, from the start to the searched one
+static vector<ChessGameState> benchStates()
+{
+	vector<ChessGameState> states;
+	for(int i = 0; BENCH_POSITIONS[i]; i++) {
+		ChessGameState state;
+		states.push_back(state);
+		stringstream ss(BENCH_POSITIONS[i]);
+		string move;
+		while(ss >> move) {
+			state.update(coordinateToMove(state.getBoard(), move));
+			states.push_back(state);
+		}
+	}
+	return states;
+}
+
+// Runs work, which handles count items, again and again for about half a
+// second and returns the items handled per second
+template<class Work>
+static long long itemsPerSecond(long long count, Work work)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	long long items = 0, time;
+	do {
+		work();
+		items += count;
+		time = chrono::duration_cast<chrono::microseconds>(
+			chrono::steady_clock::now() - start).count();
+	} while(time < 500000);
+	return items * 1000000 / time;
+}
+
+void runNotationBench(ostream & out)
+{
+	Board::init();
+
+	vector<ChessGameState> states = benchStates();
+	vector<string> fens;
+	vector<pair<int, BoardMove> > moves;
+	vector<string> sans;
+	for(int i = 0; i < (int)states.size(); i++) {
+		fens.push_back(states[i].getFEN());
+
+		const Board & board = states[i].getBoard();
+		for(int origin = 0; origin < Board::BOARDSIZE*Board::BOARDSIZE; origin++) {
+			unsigned long long legal = states[i].getLegalMoves(BoardPosition(origin));
+			for(int dest = 0; legal; dest++, legal >>= 1) {
+				if(!(legal & 1)) {
+					continue;
+				}
+				BoardMove move(BoardPosition(origin), BoardPosition(dest),
+					board.getPiece(BoardPosition(origin)));
+				if(move.needPromotion()) {
+					move.setPromotion(Piece::QUEEN);
+				}
+				moves.push_back(make_pair(i, move));
+				sans.push_back(moveToSAN(states[i], move));
+			}
+		}
+	}
+
+	// What is written has to read back the same
+	int errors = 0;
+	for(int i = 0; i < (int)fens.size(); i++) {
+		ChessGameState state;
+		if(!state.loadFEN(fens[i]) || state.getFEN() != fens[i]) {
+			out << "FEN doesn't read back: " << fens[i] << endl;
+			errors++;
+		}
+	}
+	for(int i = 0; i < (int)moves.size(); i++) {
+		const BoardMove & move = moves[i].second;
+		BoardMove read = sanToMove(states[moves[i].first], sans[i]);
+		if(read.origin() != move.origin() || read.dest() != move.dest() ||
+		   read.getPromotion() != move.getPromotion()) {
+			out << "SAN doesn't read back: " << sans[i] << " in "
+				<< fens[moves[i].first] << endl;
+			errors++;
+		}
+	}
+
+	// Summed up and printed so that none of the work is optimized away
+	long long checksum = 0;
+	Board board;
+	FenInfo info;
+	char buffer[FEN_BUFFER_SIZE];
+
+	long long fenread = itemsPerSecond(fens.size(), [&]() {
+		for(int i = 0; i < (int)fens.size(); i++) {
+			checksum += parseFEN(fens[i], board, info);
+		}
+	});
+	long long fenwrite = itemsPerSecond(states.size(), [&]() {
+		for(int i = 0; i < (int)states.size(); i++) {
+			info.turn = states[i].getTurn();
+			checksum += writeFEN(states[i].getBoard(), info, buffer);
+		}
+	});
+	long long sanwrite = itemsPerSecond(moves.size(), [&]() {
+		for(int i = 0; i < (int)moves.size(); i++) {
+			checksum += writeSAN(states[moves[i].first], moves[i].second, buffer);
+		}
+	});
+	long long sanread = itemsPerSecond(moves.size(), [&]() {
+		for(int i = 0; i < (int)moves.size(); i++) {
+			checksum += sanToMove(states[moves[i].first], sans[i]).dest().hash();
+		}
+	});
+
+	out << "===========================" << endl;
+	out << "Positions       : " << states.size() << endl;
+	out << "Moves           : " << moves.size() << endl;
+	out << "Errors          : " << errors << endl;
+	out << "FEN read/s      : " << fenread << endl;
+	out << "FEN write/s     : " << fenwrite << endl;
+	out << "SAN write/s     : " << sanwrite << endl;
+	out << "SAN read/s      : " << sanread << endl;
+	out << "Checksum        : " << checksum << endl;
+}
+
+// End of file bench.cpp
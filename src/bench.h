@@ -0,0 +1,52 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : bench.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <iostream>
+
+/** Depth, in plies, the bench searches to unless told otherwise. */
+const int BENCH_DEPTH = 3;
+
+/** Totals of a bench run. */
+struct BenchResult {
+	BenchResult() : positions(0), nodes(0), time(0) {}
+
+	/** Nodes searched per second. */
+	long long nps() const
+		{ return time ? nodes * 1000 / time : 0; }
+
+	int positions;
+	long long nodes;
+	// Milliseconds
+	long long time;
+};
+
+/**
+ * Searches a fixed set of positions with the BrutalPlayer to a fixed
+ * depth, one after the other on this thread. The total node count only
+ * changes when the search or the evaluation changes, so it serves as a
+ * signature of the engine, while nodes per second compare builds and
+ * machines. Per position counts and the totals are printed to out.
+ * @param depth - Depth in plies.
+ * @param out - Where the report goes.
+ */
+BenchResult runBench(int depth = BENCH_DEPTH, std::ostream & out = std::cout);
+
+/**
+ * Times the FEN and SAN codecs over the positions of the bench and every
+ * legal move in them, and checks that what is written reads back the
+ * same. Positions or moves per second are printed to out.
+ * @param out - Where the report goes.
+ */
+void runNotationBench(std::ostream & out = std::cout);
+
+#endif // BENCH_H
+
+// End of file bench.h
@@ -54,6 +54,20 @@ class Board {
 	void reset();
 
 	void setupPieces();
+
+	/**
+	 * Sets which castling moves are still allowed, when setting up a
+	 * position. Kings and rooks must be on their starting squares.
+	 */
+	void setCastling(bool whiteshort, bool whitelong, bool blackshort, bool blacklong);
+
+	/**
+	 * Marks the square a pawn just skipped over, so that it can be
+	 * captured en passant, when setting up a position.
+	 * @param bp - The skipped square, on the third or sixth rank.
+	 */
+	void setEnPassant(const BoardPosition & bp)
+		{ m_enpassant_flags |= getMask(bp); }
 	
 	/** Returns the piece at the BoardPosition 'bp'. */
 	Piece* getPiece(const BoardPosition & bp) const;
@@ -173,8 +187,36 @@ class Board {
 	bool isEnPassantSet(const BoardPosition & bp) const
 		{ return (0 != (getMask(bp) & m_enpassant_flags)); }
 
+	/**
+	 * Returns true if color may still castle to one side, that is its king
+	 * and that rook are on their starting squares and haven't moved.
+	 * @param c - The color to check.
+	 * @param kingside - True for O-O, false for O-O-O.
+	 */
+	bool canCastle(Piece::Color c, bool kingside) const;
+
 	vector<BoardMove> possibleMoves(Piece::Color color, bool findOne=false) const;
 
+	/**
+	 * Finds the same moves as possibleMoves without building them, for
+	 * every square a bitboard of where its piece can legally go. Much
+	 * faster, only the king and pieces lined up with it are tried out on
+	 * a copy of the board. Returns the number of moves, a promotion
+	 * counted once.
+	 * @param c - The side to move.
+	 * @param legal - 64 bitboards to fill in, by BoardPosition::hash().
+	 */
+	int legalMoves(Piece::Color c, unsigned long long * legal) const;
+
+	/**
+	 * Returns the Zobrist key of the position with turn to move, the same
+	 * for equal positions and almost never for different ones. Castling
+	 * rights count, and an en passant square only when a pawn can take
+	 * on it. These are Polyglot's keys.
+	 * @param turn - The side to move.
+	 */
+	unsigned long long getKey(Piece::Color turn) const;
+
 	/** */
 	BoardPosition getKing(Piece::Color c) const
 		{ return m_king_pos[c]; }
@@ -208,6 +250,12 @@ class Board {
 	/** */
 	void addPiece(Piece * p, const BoardPosition & bp);
 
+	/**
+	 * Puts a piece of type t and color c onto the board, counting it like
+	 * addPiece above, when setting up a position.
+	 */
+	void addPiece(Piece::Color c, Piece::Type t, const BoardPosition & bp);
+
 	/** */
 	SerialBoard serialize() const;
 	
@@ -0,0 +1,182 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : bookbuilder.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "bookbuilder.h"
+#include "chessgamestate.h"
+#include "jobsystem.h"
+#include "notation.h"
+#include "openingbook.h"
+#include "pgn.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+// Records a job gathers before it merges those of the same move
+static const size_t MERGE_RECORDS = 1 << 20;
+
+// A move of a position, with the games it was played in and the points
+// its side made, two for a win
+struct BookRecord {
+	uint64_t key;
+	uint16_t move;
+	uint32_t games;
+	uint32_t score;
+};
+
+// Sorts records by position and move and adds up those that are the same
+static void mergeRecords(vector<BookRecord> & records)
+{
+	sort(records.begin(), records.end(), [](const BookRecord & a, const BookRecord & b) {
+		return a.key != b.key ? a.key < b.key : a.move < b.move;
+	});
+
+	size_t out = 0;
+	for(size_t i = 0; i < records.size(); i++) {
+		if(out > 0 && records[out - 1].key == records[i].key &&
+				records[out - 1].move == records[i].move) {
+			records[out - 1].games += records[i].games;
+			records[out - 1].score += records[i].score;
+		} else {
+			records[out++] = records[i];
+		}
+	}
+	records.resize(out);
+}
+
+// Reads the games of a part of the PGN into records
+static vector<BookRecord> readPart(string_view part, const BookFilter & filter, long long & games)
+{
+	vector<BookRecord> records;
+	PgnReader reader(part);
+	PgnGameView game;
+	ChessGameState state;
+	while(reader.next(game)) {
+		games++;
+
+		// Points of white, two for a win
+		string_view result = game.result.empty() ? game.getTag("Result") : game.result;
+		int points;
+		if(result == "1-0") {
+			points = 2;
+		} else if(result == "1/2-1/2") {
+			points = 1;
+		} else if(result == "0-1") {
+			points = 0;
+		} else {
+			continue;
+		}
+
+		string_view fen = game.getTag("FEN");
+		if(fen.empty()) {
+			state.reset();
+		} else if(!state.loadFEN(fen)) {
+			continue;
+		}
+
+		int plies = min((int)game.moves.size(), filter.plies);
+		for(int i = 0; i < plies; i++) {
+			BoardMove move = sanToMove(state, game.moves[i]);
+			if(!move.isValid()) {
+				break;
+			}
+			bool white = state.getTurn() == Piece::WHITE;
+			if(white ? filter.white : filter.black) {
+				BookRecord record;
+				record.key = state.getKey();
+				record.move = OpeningBook::encodeMove(move);
+				record.games = 1;
+				record.score = white ? points : 2 - points;
+				records.push_back(record);
+			}
+			state.update(move);
+		}
+
+		if(records.size() >= MERGE_RECORDS) {
+			mergeRecords(records);
+		}
+	}
+	mergeRecords(records);
+	return records;
+}
+
+// Appends a big endian number of bytes bytes
+static void writeNumber(vector<unsigned char> & out, unsigned long long value, int bytes)
+{
+	for(int i = bytes - 1; i >= 0; i--) {
+		out.push_back((unsigned char)(value >> (8 * i)));
+	}
+}
+
+long long BookBuilder::build(string_view pgn, const string & filename,
+	const BookFilter & filter, long long * games)
+{
+	// Every part is read and merged on its own, then they all are merged
+	JobSystem * jobs = JobSystem::getInstance();
+	vector<string_view> parts = PgnReader::split(pgn, jobs->getThreadCount() * 4);
+	vector<long long> counts(parts.size(), 0);
+	vector<JobHandle<vector<BookRecord> > > handles;
+	for(int i = 0; i < (int)parts.size(); i++) {
+		handles.push_back(jobs->submit(JobSystem::IO, [&parts, &counts, &filter, i]() {
+			return readPart(parts[i], filter, counts[i]);
+		}));
+	}
+
+	vector<BookRecord> records;
+	for(int i = 0; i < (int)handles.size(); i++) {
+		const vector<BookRecord> & part = handles[i].get();
+		records.insert(records.end(), part.begin(), part.end());
+	}
+	mergeRecords(records);
+	if(games) {
+		*games = 0;
+		for(int i = 0; i < (int)counts.size(); i++) {
+			*games += counts[i];
+		}
+	}
+
+	// Filtered a position at a time, weights are scaled down only where
+	// they don't fit into 16 bits
+	vector<BookRecord> kept;
+	vector<unsigned char> out;
+	for(size_t first = 0, last; first < records.size(); first = last) {
+		kept.clear();
+		unsigned int most = 0;
+		for(last = first; last < records.size() && records[last].key == records[first].key; last++) {
+			const BookRecord & record = records[last];
+			if(record.games >= (uint32_t)filter.mingames && record.score > 0 &&
+					record.score * 50ULL >= (unsigned long long)filter.minscore * record.games) {
+				kept.push_back(record);
+				most = max(most, record.score);
+			}
+		}
+
+		unsigned int divisor = most / 0xffff + 1;
+		stable_sort(kept.begin(), kept.end(),
+			[](const BookRecord & a, const BookRecord & b) { return a.score > b.score; });
+		for(int i = 0; i < (int)kept.size(); i++) {
+			writeNumber(out, kept[i].key, 8);
+			writeNumber(out, kept[i].move, 2);
+			writeNumber(out, max(kept[i].score / divisor, 1u), 2);
+			writeNumber(out, 0, 4);
+		}
+	}
+
+	FILE * file = fopen(filename.c_str(), "wb");
+	if(!file) {
+		return -1;
+	}
+	bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+	ok = (fclose(file) == 0) && ok;
+	return ok ? (long long)(out.size() / OpeningBook::ENTRY_SIZE) : -1;
+}
+
+// End of file bookbuilder.cpp
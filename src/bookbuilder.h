@@ -0,0 +1,61 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : bookbuilder.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef BOOKBUILDER_H
+#define BOOKBUILDER_H
+
+#include <string>
+#include <string_view>
+
+/**
+ * Which moves of the games make it into a book.
+ */
+struct BookFilter {
+	BookFilter() :
+		plies(30),
+		mingames(3),
+		minscore(0),
+		white(true),
+		black(true) {}
+
+	/** Moves into each game that are read. */
+	int plies;
+	/** Games a move must have been played in. */
+	int mingames;
+	/**
+	 * Score the side that played a move must have made with it, in
+	 * percent. Moves that never won nor drew are always left out.
+	 */
+	int minscore;
+	/** Whether the moves of white and black are added. */
+	bool white, black;
+};
+
+/**
+ * Makes an OpeningBook out of PGN games. Each move is weighted by the
+ * score its side made with it, two points for a win and one for a draw,
+ * like Polyglot does. Games without a result are skipped.
+ */
+class BookBuilder {
+ public:
+	/**
+	 * Reads every game of pgn on the JobSystem and writes the book to
+	 * filename.
+	 * @param pgn - The games, usually a whole MappedFile.
+	 * @param filename - The book to write, replaced if it exists.
+	 * @param filter - The moves to keep.
+	 * @param games - Set to the number of games read, if not null.
+	 * @return The number of entries written, -1 on errors.
+	 */
+	static long long build(std::string_view pgn, const std::string & filename,
+		const BookFilter & filter = BookFilter(), long long * games = 0);
+};
+
+#endif // BOOKBUILDER_H
+
+// End of file bookbuilder.h
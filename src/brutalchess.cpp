@@ -17,7 +17,6 @@
 
 #include "SDL.h"
 #include "SDL_opengl.h"
-#include "SDL_thread.h"
 
 #include "boardtheme.h"
 #include "chessgame.h"
@@ -25,6 +24,7 @@
 #include "config.h"
 #include "fontloader.h"
 #include "gamecore.h"
+#include "jobsystem.h"
 #include "pieceset.h"
 #include "options.h"
 #include "utils.h"
@@ -124,17 +124,6 @@ bool drawGLScene(GameCore * core)
 	return true;
 }
 
-/*
- * Needed for loading the GameCore due to limitations of SDL_Thread
- * @param gc - GameCore that needs to be loaded
- */
-int callLoad(void * gc)
-{
-	GameCore* core = (GameCore*)gc;
-	core->load();
-	return 0;
-}
-
 /*
  * Come on, its main.
  */
@@ -151,6 +140,10 @@ int main(int argc, char *argv[])
 
 	// Parse command line options before doing any screen initialization
 	parseCommandLine(argc, argv);
+	JobSystem::setThreadCount(opts->jobthreads);
+
+	// Engines load while the window is being set up
+	startEngines();
 	
 	// Screen Settings
 	const int WINDOW_WIDTH = opts->getResolutionWidth();
@@ -250,13 +243,10 @@ int main(int argc, char *argv[])
 	GameCore * core = GameCore::get_Instance();
 	core->init(game, boardTheme, pieceSet);
 
-	// Call the core's load function in a new thread
-	SDL_Thread *thread = SDL_CreateThread(callLoad, core);
-	core->setLoadThread(thread);
-	if(thread == NULL) {
-		cerr << "Unable to create load thread: " << SDL_GetError() << endl;
-		Quit( 1 );
-	}	
+	// Load the models and textures while the loading screen is drawn
+	core->setLoadJob(JobSystem::getInstance()->submit(JobSystem::IO, [core]() {
+		core->load();
+	}));
 	
 	bool quit = false;
 	int width = WINDOW_WIDTH, height = WINDOW_HEIGHT;
@@ -6,34 +6,298 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey
  **************************************************************************/
 
+#include "analysiscache.h"
 #include "board.h"
 #include "chessplayer.h"
+#include "evalparams.h"
+#include "matesolver.h"
+#include "notation.h"
+#include "openingbook.h"
 #include "options.h"
+#include "tablebase.h"
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <vector>
 #include <time.h>
-#include <climits>
 
 using namespace std;
 
-BrutalPlayer::BrutalPlayer()
+// Deepest iteration tried when only nodes or time limit the search
+static const int MAX_DEPTH = 64;
+
+// Score of a win found in the tablebases, less a point for every ply to
+// mate, above any material but below the king
+static const int TABLEBASE_WIN = 50000;
+
+// Longest mate the mate check looks for, and the megabytes of its table
+static const int MATE_CHECK_MOVES = 5;
+static const int MATE_CHECK_TABLE = 4;
+
+// Index of a square in the tables of evalparams.h, which are from white's
+// point of view
+static int squareIndex(const BoardPosition & bp, Piece::Color color)
+{
+	return (color == Piece::WHITE) ? bp.hash() : bp.hash() ^ 56;
+}
+
+// Adds count values to an FNV-1a hash
+static void hashValues(unsigned long long & hash, const int * values, int count)
+{
+	const unsigned char * bytes = (const unsigned char *)values;
+	for(int i = 0; i < count * (int)sizeof(int); i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+}
+
+// Hashes the parameters of evalparams.h, a build tuned differently scores
+// differently
+static unsigned long long hashEvalParams()
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	hashValues(hash, EVAL_MATERIAL, 5);
+	hashValues(hash, EVAL_PAWN_SQUARES, 64);
+	hashValues(hash, EVAL_KNIGHT_SQUARES, 64);
+	hashValues(hash, EVAL_BISHOP_SQUARES, 64);
+	hashValues(hash, EVAL_KING_SQUARES, 64);
+	hashValues(hash, EVAL_ENDGAME_KING_SQUARES, 64);
+	hashValues(hash, EVAL_ISOLATED_PAWN, 4);
+	hashValues(hash, &EVAL_QUEEN_DISTANCE, 1);
+	return hash;
+}
+
+BrutalPlayer::BrutalPlayer() :
+	m_evaluation(FULL),
+	m_nodes(0),
+	m_max_nodes(0),
+	m_timed(false),
+	m_stop(false),
+	m_mate_check(0)
 {
     m_ply = Options::getInstance()->brutalplayer2ply;
 	m_trustworthy = true;
 	srand(time(NULL));
+
+	if(!Options::getInstance()->bookfile.empty()) {
+		setBook(OpeningBook::load(Options::getInstance()->bookfile));
+	}
+	if(!Options::getInstance()->tablebases.empty()) {
+		setTablebases(Tablebases::load(Options::getInstance()->tablebases));
+	}
+	if(!Options::getInstance()->analysiscache.empty()) {
+		setAnalysisCache(AnalysisCache::load(Options::getInstance()->analysiscache));
+	}
+	if(Options::getInstance()->matecheck > 0) {
+		setMateCheck(Options::getInstance()->matecheck);
+	}
+}
+
+void BrutalPlayer::setMateCheck(long long nodes)
+{
+	m_mate_check = nodes;
+	if(!nodes) {
+		m_mate_solver.reset();
+	} else if(!m_mate_solver) {
+		m_mate_solver = make_shared<MateSolver>(MATE_CHECK_TABLE);
+	}
 }
 
 void BrutalPlayer::think(const ChessGameState & cgs)
 {
-	BoardMove move;
+	m_is_thinking = true;
+	m_stop = false;
+	m_nodes = 0;
+	m_max_nodes = m_limits.nodes;
+
+	// Known theory is played at once, and differently every game
+	if(m_book && m_book->pickMove(cgs, m_move)) {
+		m_is_thinking = false;
+		return;
+	}
+
+	long long budget = getBudget();
+	m_timed = (budget > 0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if(m_timed) {
+		m_deadline = start + chrono::milliseconds(budget);
+	}
+
+	// A forced mate is played without searching any further
+	if(m_mate_solver && findMate(cgs, start)) {
+		m_is_thinking = false;
+		return;
+	}
+
+	// A fixed depth is searched directly, anything else deepens until
+	// the limit runs out
+	bool iterative = m_timed || m_max_nodes;
+	int maxdepth = m_ply;
+	if(m_limits.depth) {
+		maxdepth = m_limits.depth - 1;
+	} else if(iterative) {
+		maxdepth = MAX_DEPTH;
+	}
+	if((int)m_lines.size() <= maxdepth) {
+		m_lines.resize(maxdepth + 1);
+	}
+
+	BoardMove best;
+	bool gotbest = false;
+	int firstdepth = iterative ? 0 : maxdepth;
+
+	// A cached result as deep as asked for is the answer, a shallower one
+	// stands for the iterations it has done
+	AnalysisEntry cached;
+	unsigned long long key = cacheKey(cgs);
+	if(m_cache && m_cache->probe(key, cached) && cached.depth > 0 &&
+			cgs.isMoveLegal(cached.getMove(cgs.getBoard())) &&
+			(cached.depth > maxdepth || (iterative && cached.depth > firstdepth))) {
+		best = cached.getMove(cgs.getBoard());
+		gotbest = true;
+		firstdepth = cached.depth;
+		reportIteration(cached.depth, cached.score,
+			cached.getPv(cgs.getBoard(), cgs.getTurn()), start);
+	} else {
+		cached = AnalysisEntry();
+	}
+
+	int done = 0, donescore = 0;
+	vector<BoardMove> donepv;
     Board board = cgs.getBoard();
-	search(board, getColor(), m_ply, -INT_MAX, INT_MAX, move);
-	m_move = move;
+	for(int depth = firstdepth; depth <= maxdepth; depth++) {
+		vector<BoardMove> pv;
+		int score = search(board, getColor(), depth, -INT_MAX, INT_MAX, pv);
+
+		// An unfinished iteration is only better than nothing
+		if(m_stop && gotbest) {
+			break;
+		}
+		best = pv.empty() ? BoardMove() : pv[0];
+		gotbest = true;
+		if(m_stop) {
+			break;
+		}
+
+		done = depth + 1;
+		donescore = score;
+		donepv.swap(pv);
+		reportIteration(done, score, donepv, start);
+	}
+
+	if(m_cache && done > cached.depth) {
+		AnalysisEntry entry;
+		entry.depth = done;
+		entry.score = donescore;
+		entry.nodes = m_nodes;
+		entry.setPv(donepv);
+		m_cache->store(key, entry);
+	}
+	m_move = best;
+	m_is_thinking = false;
 }
 
-int BrutalPlayer::search(Board board, Piece::Color color, int depth, int alpha, int beta, BoardMove& move)
+void BrutalPlayer::reportIteration(int depth, int score, const vector<BoardMove> & pv,
+	chrono::steady_clock::time_point start)
 {
-	BoardMove testMove;
+	if(m_info_callback) {
+		SearchInfo info;
+		info.depth = depth;
+		info.score = score;
+		info.nodes = m_nodes;
+		info.time = (int)chrono::duration_cast<chrono::milliseconds>(
+			chrono::steady_clock::now() - start).count();
+		for(int i = 0; i < (int)pv.size(); i++) {
+			info.pv += (i ? " " : "") + moveToCoordinate(pv[i]);
+		}
+		m_info_callback(info);
+	}
+}
+
+unsigned long long BrutalPlayer::cacheKey(const ChessGameState & cgs) const
+{
+	// Scores only carry over between searches that score alike, by the
+	// same evaluation with the same parameters and tablebases
+	static const unsigned long long params = hashEvalParams();
+	unsigned long long salt = params ^ (m_evaluation + 1) * 0x9E3779B97F4A7C15ULL;
+	if(m_tablebases) {
+		salt ^= m_tablebases->getMaxPieces() * 0xC2B2AE3D27D4EB4FULL;
+	}
+	return cgs.getKey() ^ salt;
+}
+
+long long BrutalPlayer::getBudget() const
+{
+	long long budget = m_limits.movetime;
+	if(!budget && m_limits.hasClock()) {
+		long long left = isWhite() ? m_limits.wtime : m_limits.btime;
+		long long inc = isWhite() ? m_limits.winc : m_limits.binc;
+		int togo = m_limits.movestogo ? m_limits.movestogo : 30;
+		budget = left / togo + inc * 3 / 4;
+		if(budget > left / 2) {
+			budget = left / 2;
+		}
+		if(budget < 1) {
+			budget = 1;
+		}
+	}
+	return budget;
+}
+
+void BrutalPlayer::interruptThinking()
+{
+	m_stop = true;
+	if(m_mate_solver) {
+		m_mate_solver->stop();
+	}
+	m_is_thinking = false;
+}
+
+bool BrutalPlayer::findMate(const ChessGameState & cgs, chrono::steady_clock::time_point start)
+{
+	// The check may take a quarter of the time, the search needs the rest
+	SearchLimits limits;
+	limits.nodes = m_mate_check;
+	if(m_timed) {
+		long long budget = chrono::duration_cast<chrono::milliseconds>(m_deadline - start).count();
+		limits.movetime = (int)max(budget / 4, 1LL);
+	}
+	m_mate_solver->setLimits(limits);
+	MateResult mate = m_mate_solver->solve(cgs.getBoard(), getColor(), MATE_CHECK_MOVES);
+	if(mate.status != MateResult::MATE || mate.pv.empty()) {
+		return false;
+	}
+
+	m_move = mate.pv[0];
+	m_nodes = mate.nodes;
+	if(m_info_callback) {
+		SearchInfo info;
+		info.depth = 2 * mate.moves - 1;
+		info.mate = mate.moves;
+		info.nodes = mate.nodes;
+		info.time = (int)chrono::duration_cast<chrono::milliseconds>(
+			chrono::steady_clock::now() - start).count();
+		for(int i = 0; i < (int)mate.pv.size(); i++) {
+			info.pv += (i ? " " : "") + moveToCoordinate(mate.pv[i]);
+		}
+		m_info_callback(info);
+	}
+	return true;
+}
+
+bool BrutalPlayer::outOfTime()
+{
+	if(m_max_nodes && m_nodes >= m_max_nodes) {
+		return true;
+	}
+	// The clock is only read every so often, it isn't free
+	return m_timed && (m_nodes & 1023) == 0 &&
+		chrono::steady_clock::now() >= m_deadline;
+}
+
+int BrutalPlayer::search(Board board, Piece::Color color, int depth, int alpha, int beta, vector<BoardMove>& pv)
+{
+	vector<BoardMove> & line = m_lines[depth];
 	Board testBoard = board;
 	int moveScore, bestScore = -INT_MAX;
 	vector<BoardMove> moves = board.possibleMoves(color);
@@ -46,22 +310,43 @@ int BrutalPlayer::search(Board board, Piece::Color color, int depth, int alpha,
 		}
 
 		if(!gotmove) {
-			move = moves[i];
+			pv.assign(1, moves[i]);
 			gotmove = true;
 		}
 
+		if(m_stop) {
+			return 0;
+		}
+		m_nodes++;
+		if(outOfTime()) {
+			m_stop = true;
+			return 0;
+		}
+
 		testBoard = board;
 		testBoard.update(moves[i]);
-	
-        if(depth == 0) {
+		line.clear();
+
+		// Endings in the tablebases are known exactly, the quickest mate
+		// scores best
+		TablebaseResult result;
+		if(m_tablebases && testBoard.m_total_pieces[Piece::WHITE] + testBoard.m_total_pieces[Piece::BLACK] <=
+				m_tablebases->getMaxPieces() &&
+				m_tablebases->probe(testBoard, Piece::opposite(color), result)) {
+			moveScore = -result.wdl * (TABLEBASE_WIN - result.dtm);
+		} else if(depth == 0) {
 			moveScore = evaluateBoard(testBoard, color);
 		} else {
-			moveScore = -search(testBoard, Piece::opposite(color), depth-1, -beta, -alpha, testMove);
+			moveScore = -search(testBoard, Piece::opposite(color), depth-1, -beta, -alpha, line);
+		}
+		if(m_stop) {
+			return 0;
 		}
 
         if(moveScore > bestScore) {
 			bestScore = moveScore;
-			move = moves[i];
+			pv.assign(1, moves[i]);
+			pv.insert(pv.end(), line.begin(), line.end());
         }
         if(bestScore > alpha) {
 			alpha = bestScore;
@@ -82,7 +367,9 @@ int BrutalPlayer::evaluateBoard(const Board & board, Piece::Color turn)
     int balance = 0;
     int endgamecount = 0;
             
-    int queenval = 900, rookval = 500, bishopval = 325, knightval = 310, pawnval = 100, kingval = 100000;
+    int queenval = EVAL_MATERIAL[Piece::QUEEN], rookval = EVAL_MATERIAL[Piece::ROOK],
+        bishopval = EVAL_MATERIAL[Piece::BISHOP], knightval = EVAL_MATERIAL[Piece::KNIGHT],
+        pawnval = EVAL_MATERIAL[Piece::PAWN], kingval = 100000;
     
     for(int i=0; i < 64; i++) {
         BoardPosition bp = BoardPosition(i);
@@ -127,6 +414,11 @@ int BrutalPlayer::evaluateBoard(const Board & board, Piece::Color turn)
         }
     }
 
+    // The material only evaluation leaves out all positional bonuses
+    if (m_evaluation == MATERIAL) {
+        return balance;
+    }
+
     // Determine end game or not.  THIS IS A TWEAKABLE VALUE.
     bool endgame = false;
     if (endgamecount < 3500) {
@@ -172,7 +464,7 @@ int BrutalPlayer::queenBonus(const BoardPosition & bp, const Board & board, Piec
 		dist = BoardMove(bp, board.getKing(Piece::WHITE), p);
 	}
 
-	bonus = -2*abs(dist.fileDiff()+dist.rankDiff());
+	bonus = -EVAL_QUEEN_DISTANCE*abs(dist.fileDiff()+dist.rankDiff());
 
     return (turn == p->color()) ? bonus : -bonus;
 }
@@ -193,7 +485,7 @@ int BrutalPlayer::rookBonus(const BoardPosition & bp, const Board & board, Piece
 
 int BrutalPlayer::bishopBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
     Piece::Color color = board.getPiece(bp)->color();
-    int bonus = m_bishop[bp.hash()];
+    int bonus = EVAL_BISHOP_SQUARES[squareIndex(bp, color)];
 
     return (turn == color) ? bonus: -bonus;
 }
@@ -201,7 +493,7 @@ int BrutalPlayer::bishopBonus(const BoardPosition & bp, const Board & board, Pie
 
 int BrutalPlayer::knightBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
     Piece::Color color = board.getPiece(bp)->color();
-    int bonus = m_knight[bp.hash()];
+    int bonus = EVAL_KNIGHT_SQUARES[squareIndex(bp, color)];
 
 	bool drivenBonus = false;
 
@@ -213,19 +505,11 @@ int BrutalPlayer::knightBonus(const BoardPosition & bp, const Board & board, Pie
 
 int BrutalPlayer::pawnBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
     Piece::Color color = board.getPiece(bp)->color();
-    int bonus = (color == Piece::WHITE) ? m_wpawn[bp.hash()] : m_bpawn[bp.hash()];
+    int bonus = EVAL_PAWN_SQUARES[squareIndex(bp, color)];
 
+	// The penalty grows towards the center files
 	if(isIsolatedPawn(bp, board)) {
-        char file = bp.filec();
-        if(file == 'a' || file == 'h') {
-            bonus -= 12;
-        } else if (file == 'b' || file == 'g') {
-            bonus -= 14;
-        } else if (file == 'c' || file == 'f') {
-            bonus -= 16;
-        } else if (file == 'd' || file == 'e') {
-            bonus -= 20;
-        }
+        bonus -= EVAL_ISOLATED_PAWN[min(bp.file0(), 7 - bp.file0())];
     }
 	/*
     if(isDoubledPawn(bp, board)) {
@@ -245,9 +529,9 @@ int BrutalPlayer::kingBonus(const BoardPosition & bp, const Board & board, Piece
     }
     
     if(endgame) {
-        bonus = m_end_king[bp.hash()];
+        bonus = EVAL_ENDGAME_KING_SQUARES[squareIndex(bp, color)];
     } else {
-        bonus = (color == Piece::WHITE) ? m_wking[bp.hash()] : m_bking[bp.hash()];
+        bonus = EVAL_KING_SQUARES[squareIndex(bp, color)];
     }
     
     return (turn == color) ? bonus : -bonus;
@@ -287,76 +571,5 @@ bool BrutalPlayer::isDoubledPawn(const BoardPosition & bp, const Board & board)
 	return false;
 }
 
-// Positional Bonuses
-int BrutalPlayer::m_bishop[64] = {
-    -5,-5,-5,-5,-5,-5,-5,-5,
-    -5,10,5,10,10,5,10,-5,
-    -5,5,3,12,12,3,5,-5,
-    -5,3,12,3,3,12,3,-5,
-    -5,3,12,3,3,12,3,-5,
-    -5,5,3,12,12,3,5,-5,
-    -5,10,5,10,10,5,10,-5,
-    -5,-5,-5,-5,-5,-5,-5,-5 };
-
-int BrutalPlayer::m_knight[64] = {
-    -10,-5,-5,-5,-5,-5,-5,-10,
-    -5,0,0,3,3,0,0,-5,
-    -5,0,5,5,5,5,0,-5,
-    -5,0,5,10,10,5,0,-5,
-    -5,0,5,10,10,5,0,-5,
-    -5,0,5,5,5,5,0,-5,
-    -5,0,0,3,3,0,0,-5,
-    -10,-5,-5,-5,-5,-5,-5,-10 };
-
-int BrutalPlayer::m_wpawn[64] = {
-    0,0,0,0,0,0,0,0,
-    0,0,0,-5,-5,0,0,0,
-    1,2,3,4,4,3,2,1,
-    2,4,6,8,8,6,4,2,
-    3,6,9,12,12,9,6,3,
-    4,8,12,16,16,12,8,4,
-    5,10,15,20,20,15,10,5,
-    0,0,0,0,0,0,0,0 };
-
-int BrutalPlayer::m_bpawn[64] = {
-    0,0,0,0,0,0,0,0,
-    5,10,15,20,20,15,10,5,
-    4,8,12,16,16,12,8,4,
-    3,6,9,12,12,9,6,3,
-    2,4,6,8,8,6,4,2,
-    1,2,3,4,4,3,2,1,
-    0,0,0,-5,-5,0,0,0,
-    0,0,0,0,0,0,0,0 };
-
-int BrutalPlayer::m_wking[64] = {
-    2,10,4,0,0,7,10,2,
-    -3,-3,-5,-5,-5,-5,-3,-3,
-    -5,-5,-8,-8,-8,-8,-5,-5,
-    -8,-8,-13,-13,-13,-13,-8,-8,
-    -13,-13,-21,-21,-21,-21,-13,-13,
-    -21,-21,-34,-34,-34,-34,-21,-21,
-    -34,-34,-55,-55,-55,-55,-34,-34,
-    -55,-55,-89,-89,-89,-89,-55,-55};
-
-int BrutalPlayer::m_bking[64] = {
-    -55,-55,-89,-89,-89,-89,-55,-55,
-    -34,-34,-55,-55,-55,-55,-34,-34,
-    -21,-21,-34,-34,-34,-34,-21,-21,
-    -13,-13,-21,-21,-21,-21,-13,-13,
-    -8,-8,-13,-13,-13,-13,-8,-8,
-    -5,-5,-8,-8,-8,-8,-5,-5,
-    -3,-3,-5,-5,-5,-5,-3,-3,
-    2,10,4,0,0,7,10,2};
-
-int BrutalPlayer::m_end_king[64] = {
-    -5,-3,-1,0,0,-1,-3,-5,
-    -3,5,5,5,5,5,5,-3,
-    -1,5,10,10,10,10,5,-1,
-    0,5,10,15,15,10,5,0,
-    0,5,10,15,15,10,5,0,
-    -1,5,10,10,10,10,5,-1,
-    -3,5,5,5,5,5,5,-3,
-    -5,-3,-1,0,0,-1,-3,-5};
-
 // end of file brutalplayer.cpp
 
@@ -0,0 +1,214 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : chessclock.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "chessclock.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+static const long long NANOS_PER_SECOND = 1000000000LL;
+static const long long NANOS_PER_MILLI = 1000000LL;
+
+// Reads seconds, fractions allowed, into nanoseconds
+static bool parseSeconds(const string & text, long long & nanos)
+{
+	if(text.empty()) {
+		return false;
+	}
+	char * end;
+	double seconds = strtod(text.c_str(), &end);
+	if(*end != '\0' || seconds < 0) {
+		return false;
+	}
+	nanos = (long long)(seconds * NANOS_PER_SECOND + 0.5);
+	return true;
+}
+
+bool TimeControl::parse(const string & text, TimeControl & tc)
+{
+	TimeControl result;
+	string rest = text;
+
+	string::size_type slash = rest.find('/');
+	if(slash != string::npos) {
+		result.moves = atoi(rest.substr(0, slash).c_str());
+		if(result.moves <= 0) {
+			return false;
+		}
+		rest = rest.substr(slash + 1);
+	}
+
+	string::size_type delay = rest.find_first_of("db");
+	if(delay != string::npos) {
+		result.delaytype = (rest[delay] == 'b') ? BRONSTEIN : SIMPLE;
+		if(!parseSeconds(rest.substr(delay + 1), result.delay)) {
+			return false;
+		}
+		rest = rest.substr(0, delay);
+	}
+
+	string::size_type plus = rest.find('+');
+	if(plus != string::npos) {
+		if(!parseSeconds(rest.substr(plus + 1), result.increment)) {
+			return false;
+		}
+		rest = rest.substr(0, plus);
+	}
+
+	if(!parseSeconds(rest, result.base) || result.base == 0) {
+		return false;
+	}
+	tc = result;
+	return true;
+}
+
+ChessClock::ChessClock() :
+	m_running(false),
+	m_turn(Piece::WHITE)
+{
+	reset();
+}
+
+void ChessClock::setTimeControl(const TimeControl & tc)
+{
+	m_sides[Piece::WHITE].control = tc;
+	m_sides[Piece::BLACK].control = tc;
+	reset();
+}
+
+void ChessClock::setTimeControl(Piece::Color side, const TimeControl & tc)
+{
+	m_sides[side].control = tc;
+	reset();
+}
+
+bool ChessClock::isEnabled() const
+{
+	return m_sides[Piece::WHITE].control.isEnabled() ||
+		m_sides[Piece::BLACK].control.isEnabled();
+}
+
+void ChessClock::reset()
+{
+	for(int i = 0; i <= Piece::LAST_COLOR; i++) {
+		m_sides[i].remaining = m_sides[i].control.base;
+		m_sides[i].moves = 0;
+	}
+	m_running = false;
+	m_turn = Piece::WHITE;
+}
+
+void ChessClock::start(Piece::Color side, Clock::time_point now)
+{
+	stop(now);
+	m_turn = side;
+	m_since = now;
+	m_running = true;
+}
+
+void ChessClock::stop(Clock::time_point now)
+{
+	if(!m_running) {
+		return;
+	}
+	m_sides[m_turn].remaining -= charged(elapsed(now));
+	m_running = false;
+}
+
+bool ChessClock::press(Clock::time_point now)
+{
+	if(!m_running) {
+		return false;
+	}
+
+	Side & side = m_sides[m_turn];
+	const TimeControl & tc = side.control;
+	long long used = elapsed(now);
+	side.remaining -= charged(used);
+	m_running = false;
+
+	if(tc.isEnabled()) {
+		if(side.remaining <= 0) {
+			return false;
+		}
+		if(tc.delaytype == TimeControl::BRONSTEIN) {
+			side.remaining += (used < tc.delay) ? used : tc.delay;
+		}
+		side.remaining += tc.increment;
+	}
+
+	side.moves++;
+	if(tc.moves && side.moves % tc.moves == 0) {
+		side.remaining += tc.base;
+	}
+
+	start(Piece::opposite(m_turn), now);
+	return true;
+}
+
+long long ChessClock::getRemaining(Piece::Color side, Clock::time_point now) const
+{
+	long long remaining = m_sides[side].remaining;
+	if(m_running && side == m_turn) {
+		remaining -= charged(elapsed(now));
+	}
+	return remaining;
+}
+
+bool ChessClock::isFlagged(Piece::Color side, Clock::time_point now) const
+{
+	return m_sides[side].control.isEnabled() && getRemaining(side, now) <= 0;
+}
+
+int ChessClock::getMovesToGo(Piece::Color side) const
+{
+	const Side & s = m_sides[side];
+	if(!s.control.moves) {
+		return 0;
+	}
+	return s.control.moves - s.moves % s.control.moves;
+}
+
+void ChessClock::fillLimits(SearchLimits & limits, Clock::time_point now) const
+{
+	if(!isEnabled()) {
+		return;
+	}
+
+	// The limits can't say "out of time", so a flagged side gets 1ms
+	long long wtime = getRemaining(Piece::WHITE, now) / NANOS_PER_MILLI;
+	long long btime = getRemaining(Piece::BLACK, now) / NANOS_PER_MILLI;
+	limits.wtime = (int)(wtime > 0 ? wtime : 1);
+	limits.btime = (int)(btime > 0 ? btime : 1);
+
+	const TimeControl & white = m_sides[Piece::WHITE].control;
+	const TimeControl & black = m_sides[Piece::BLACK].control;
+	limits.winc = (int)((white.increment + white.delay) / NANOS_PER_MILLI);
+	limits.binc = (int)((black.increment + black.delay) / NANOS_PER_MILLI);
+	limits.movestogo = getMovesToGo(m_turn);
+}
+
+long long ChessClock::elapsed(Clock::time_point now) const
+{
+	if(!m_running || now < m_since) {
+		return 0;
+	}
+	return chrono::duration_cast<chrono::nanoseconds>(now - m_since).count();
+}
+
+long long ChessClock::charged(long long used) const
+{
+	const TimeControl & tc = m_sides[m_turn].control;
+	if(tc.delaytype == TimeControl::SIMPLE) {
+		return (used > tc.delay) ? used - tc.delay : 0;
+	}
+	return used;
+}
+
+// End of file chessclock.cpp
@@ -0,0 +1,164 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : chessclock.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef CHESSCLOCK_H
+#define CHESSCLOCK_H
+
+#include "piece.h"
+#include "searchinfo.h"
+
+#include <chrono>
+#include <string>
+
+/**
+ * How much time a side gets. All times are in nanoseconds.
+ */
+struct TimeControl {
+	/** What happens with the delay of every move. */
+	enum DelayType {
+		/** The clock waits for the delay before it starts running */
+		SIMPLE,
+		/** Time used is given back after the move, up to the delay */
+		BRONSTEIN
+	};
+
+	TimeControl() :
+		base(0),
+		increment(0),
+		delay(0),
+		delaytype(SIMPLE),
+		moves(0) {}
+
+	/** Returns false for no time control, the clock doesn't run. */
+	bool isEnabled() const
+		{ return base > 0; }
+
+	/**
+	 * Reads a time control written as [MOVES/]SECONDS[+INCREMENT] with an
+	 * optional dDELAY for a simple delay or bDELAY for a Bronstein delay,
+	 * all in seconds: "300+2", "40/5400+30", "180d3". Returns false if
+	 * text is not a time control.
+	 */
+	static bool parse(const std::string & text, TimeControl & tc);
+
+	/** Time at the start, and added again every MOVES moves. */
+	long long base;
+	/** Fischer increment, added after every move */
+	long long increment;
+	long long delay;
+	DelayType delaytype;
+	/** Moves per control, 0 if base is for the whole game */
+	int moves;
+};
+
+/**
+ * A chess clock, one time control and one running time per side. Only
+ * the side to move runs, pressing the clock ends its move and starts
+ * the other side. Time is read from a monotonic clock with nanosecond
+ * resolution, so it keeps running true whether or not there is a
+ * display to update it.
+ *
+ * Every method that depends on the time takes the current time, which
+ * defaults to now, so that a caller reading both sides sees the same
+ * moment. Like ChessGame, a clock belongs to the thread making the
+ * moves.
+ */
+class ChessClock {
+ public:
+	typedef std::chrono::steady_clock Clock;
+
+	ChessClock();
+
+	/** Gives both sides the same time control and resets the clock. */
+	void setTimeControl(const TimeControl & tc);
+
+	/** Gives one side its own time control and resets the clock. */
+	void setTimeControl(Piece::Color side, const TimeControl & tc);
+
+	const TimeControl & getTimeControl(Piece::Color side) const
+		{ return m_sides[side].control; }
+
+	/** Returns true if either side has a time control. */
+	bool isEnabled() const;
+
+	/** Stops the clock and sets both sides back to their base time. */
+	void reset();
+
+	/**
+	 * Starts running side's time. If the other side was running, its
+	 * time so far is charged without ending its move.
+	 */
+	void start(Piece::Color side, Clock::time_point now = Clock::now());
+
+	/** Stops the clock, charging the time used so far. */
+	void stop(Clock::time_point now = Clock::now());
+
+	bool isRunning() const
+		{ return m_running; }
+
+	/** Returns the side whose time runs or ran last. */
+	Piece::Color getRunningSide() const
+		{ return m_turn; }
+
+	/**
+	 * Ends the move of the running side: charges its time, applies the
+	 * increment, the delay and the next time control, and starts the
+	 * other side. If the running side had run out of time the clock
+	 * stops instead and false is returned.
+	 */
+	bool press(Clock::time_point now = Clock::now());
+
+	/**
+	 * Returns the time side has left, in nanoseconds. Zero or less once
+	 * it has run out.
+	 */
+	long long getRemaining(Piece::Color side, Clock::time_point now = Clock::now()) const;
+
+	/** Returns true if side has a time control and has run out of time. */
+	bool isFlagged(Piece::Color side, Clock::time_point now = Clock::now()) const;
+
+	/** Returns the moves side has finished. */
+	int getMoves(Piece::Color side) const
+		{ return m_sides[side].moves; }
+
+	/**
+	 * Returns how many moves side has left until time is added, 0 when
+	 * its base is for the rest of the game.
+	 */
+	int getMovesToGo(Piece::Color side) const;
+
+	/**
+	 * Fills the clock fields of limits, in milliseconds, for a player
+	 * thinking about the move of the running side. The delay is passed
+	 * on as increment, a player can count on it the same way.
+	 */
+	void fillLimits(SearchLimits & limits, Clock::time_point now = Clock::now()) const;
+
+ private:
+	struct Side {
+		TimeControl control;
+		// Time left when the side last stopped running
+		long long remaining;
+		int moves;
+	};
+
+	// Time the running side has used on this move
+	long long elapsed(Clock::time_point now) const;
+
+	// Time the running side is charged for elapsed, after the delay
+	long long charged(long long used) const;
+
+	Side m_sides[Piece::LAST_COLOR + 1];
+	bool m_running;
+	Piece::Color m_turn;
+	Clock::time_point m_since;
+};
+
+#endif // CHESSCLOCK_H
+
+// End of file chessclock.h
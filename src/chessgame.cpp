@@ -8,9 +8,8 @@
 
 #include "chessgame.h"
 #include "piece.h"
-#include "menu.h"
-#include "SDL.h"
 
+#include <algorithm>
 #include <iostream>
 using namespace std;
 
@@ -28,20 +27,27 @@ void ChessGame::startGame()
 	m_player1->startGame();
 	m_player2->startGame();
 	m_is_game_in_progress = true;
+
+	if(m_clock.isEnabled()) {
+		m_clock.start(getTurn());
+	}
 }
 
 void ChessGame::newGame()
 {
 	// reset the state of the game
-	m_state.reset();
+	publish(ChessGameStatePtr(new ChessGameState));
 
 	// indicate that the game hasn't yet bgun
 	m_is_game_in_progress = false;
 	m_player1->newGame();
 	m_player2->newGame();
 
-	m_history_stack = stack<ChessGameState>();
-	m_redo_stack = stack<ChessGameState>();
+	m_moves.clear();
+	m_snapshots.assign(1, m_state);
+	m_keys.assign(1, m_state->getKey());
+	m_ply = 0;
+	m_clock.reset();
 }
 
 void ChessGame::loadGame()
@@ -59,30 +65,101 @@ bool ChessGame::tryMove(const BoardMove & bm)
 	
 	// Check that the move is legal
 	if(!getCurrentPlayer()->isTrustworthy())
-		if(!m_state.m_board.isMoveLegal(bm))
+		if(!m_state->isMoveLegal(bm))
 			return false;
 
-//	cout << m_state.getTurnNumber() << ". " << bm.origin() << " " << bm.dest() << " " << bm.getPiece()->type() << endl;
+//	cout << m_state->getTurnNumber() << ". " << bm.origin() << " " << bm.dest() << " " << bm.getPiece()->type() << endl;
+
+	// Since the move is an okay one, update a copy of the state
+	ChessGameState * state = new ChessGameState(*m_state);
+	state->update(bm);
+	publish(ChessGameStatePtr(state));
 
-	// Since the move is an okay one, update the board
-	m_state.update(bm);
+	// A new move replaces the moves that were taken back
+	m_moves.resize(m_ply);
+	m_keys.resize(m_ply + 1);
+	m_snapshots.resize(m_ply / SNAPSHOT_INTERVAL + 1);
+	m_moves.push_back(bm);
+	m_keys.push_back(m_state->getKey());
+	m_ply++;
+	if(m_ply % SNAPSHOT_INTERVAL == 0) {
+		ChessGameState * snapshot = new ChessGameState(*m_state);
+		snapshot->clearRepetitions();
+		m_snapshots.push_back(ChessGameStatePtr(snapshot));
+	}
 
-	// Update the stacks
-	m_history_stack.push(m_state);
-	m_redo_stack = stack<ChessGameState>();
+	// The move ends the turn on the clock, a flag that fell before it
+	// is left for the caller to find
+	if(m_clock.isRunning()) {
+		m_clock.press();
+	}
 	
 	return true;
 }
 
 void ChessGame::undoMove()
 {
-	if(!m_history_stack.empty()) {
-		m_state = m_history_stack.top();
-		m_redo_stack.push(m_history_stack.top());
-		m_history_stack.pop();
+	if(m_ply > 0) {
+		goToPly(m_ply - 1);
 	}
 	m_player1->undoMove();
 	m_player2->undoMove();
 }
 
+bool ChessGame::redoMove()
+{
+	if(m_ply >= (int)m_moves.size()) {
+		return false;
+	}
+	goToPly(m_ply + 1);
+	return true;
+}
+
+void ChessGame::goToPly(int ply)
+{
+	if(ply < 0 || ply > (int)m_moves.size()) {
+		return;
+	}
+
+	// Every snapshot up to the last move is still there. Replay from the
+	// current state when going forward, else from the closest snapshot.
+	int snapshot = ply / SNAPSHOT_INTERVAL;
+	if(ply == 0) {
+		publish(m_snapshots[0]);
+	} else {
+		int from = snapshot * SNAPSHOT_INTERVAL;
+		ChessGameState * state;
+		if(m_ply > from && m_ply < ply) {
+			from = m_ply;
+			state = new ChessGameState(*m_state);
+		} else {
+			state = new ChessGameState(*m_snapshots[snapshot]);
+			restoreRepetitions(*state, from);
+		}
+		for(int i = from; i < ply; i++) {
+			state->update(m_moves[i]);
+		}
+		publish(ChessGameStatePtr(state));
+	}
+	m_ply = ply;
+
+	// Whoever is to move now has the clock, without ending a turn
+	if(m_clock.isRunning()) {
+		m_clock.start(getTurn());
+	}
+}
+
+void ChessGame::restoreRepetitions(ChessGameState & state, int ply) const
+{
+	// The start keeps its own, it has no positions before it
+	if(ply == 0) {
+		return;
+	}
+
+	// A pawn move clears both the halfmove clock and the positions, so
+	// they are the ones since the clock was last zero
+	int first = max(0, ply - state.getHalfmoveClock());
+	state.setRepetitions(&m_keys[first], &m_keys[ply] + 1);
+}
+
 // End of file chessgame.cpp
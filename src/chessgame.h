@@ -11,9 +11,13 @@
 
 #include "board.h"
 #include "boardmove.h"
+#include "chessclock.h"
 #include "chessplayer.h"
 #include "chessgamestate.h"
 
+#include <memory>
+#include <vector>
+
 /**
  * This class represents a Chess Game
  */
@@ -23,12 +27,20 @@ class ChessGame {
 	/** Default constructor. Initializes both players to zero. */ 
 	ChessGame() :
 		m_player1(0),
-		m_player2(0) {}
+		m_player2(0),
+		m_state(new ChessGameState),
+		m_snapshots(1, m_state),
+		m_keys(1, m_state->getKey()),
+		m_ply(0) {}
  
 	/** Constructor that initializes both ChessPlayers. */
 	ChessGame(ChessPlayer * p1, ChessPlayer * p2) :
 		m_player1(p1),
-		m_player2(p2) 
+		m_player2(p2),
+		m_state(new ChessGameState),
+		m_snapshots(1, m_state),
+		m_keys(1, m_state->getKey()),
+		m_ply(0)
 	{
 		m_player1->setIsWhite(true);
 		m_player2->setIsWhite(false);
@@ -64,38 +76,104 @@ class ChessGame {
 			
 	/** Retrieves the player whose turn it is. */
 	ChessPlayer * getCurrentPlayer() const
-		{ return (m_state.isWhiteTurn()) ? m_player1 : m_player2; }
+		{ return (m_state->isWhiteTurn()) ? m_player1 : m_player2; }
 
 	/** Retrieves the player who is inactive */
 	ChessPlayer * getInactivePlayer() const
-		{ return (m_state.isWhiteTurn()) ? m_player2 : m_player1; }
+		{ return (m_state->isWhiteTurn()) ? m_player2 : m_player1; }
 	
 	/** Attempts to apply bm, return true if applied */
 	bool tryMove(const BoardMove & bm);
 	
-	/** Returns the current state of the chess game */
-	ChessGameState getState() const 
-		{ return m_state; }
+	/**
+	 * Returns the current state of the chess game. Only for the thread
+	 * that makes the moves, the state is replaced by the next move.
+	 */
+	const ChessGameState & getState() const 
+		{ return *m_state; }
+
+	/**
+	 * Returns the current state for any thread. The state never changes,
+	 * moves publish a new one, so it can be read without locking for as
+	 * long as the pointer is held.
+	 */
+	ChessGameStatePtr getSnapshot() const
+		{ return std::atomic_load(&m_state); }
 
 	/** Accessor function for getting the board */
-	inline Board getBoard() const 
-		{ return m_state.getBoard(); }
+	inline const Board & getBoard() const 
+		{ return m_state->getBoard(); }
 
 	/** Accessor function for getting the turn */
 	inline Piece::Color getTurn() const
-		{ return m_state.getTurn(); }
+		{ return m_state->getTurn(); }
 
-	/** Undo the last move by popping it off the history stack */
+	/** Takes back the last move, it can be played again with redoMove. */
 	void undoMove();
 
+	/**
+	 * Plays the last move taken back again. Returns false if there is
+	 * none. Unlike undoMove the players aren't told, the caller has to
+	 * bring them up to date.
+	 */
+	bool redoMove();
+
+	/**
+	 * Goes to the position after the given number of plies of the game,
+	 * keeping the later moves for redoMove.
+	 */
+	void goToPly(int ply);
+
+	/** Returns the number of plies played to reach the current position. */
+	int getPly() const
+		{ return m_ply; }
+
+	/** Returns the state the game started from, before the first move. */
+	ChessGameStatePtr getStartState() const
+		{ return m_snapshots[0]; }
+
+	/** Returns every move of the game, including those taken back. */
+	const std::vector<BoardMove> & getMoves() const
+		{ return m_moves; }
+
+	/**
+	 * Returns the clock of the game. It is started by startGame if a
+	 * time control was set, and pressed by every move.
+	 */
+	ChessClock & getClock()
+		{ return m_clock; }
+
+	const ChessClock & getClock() const
+		{ return m_clock; }
+
+	/** Number of plies between the states kept for jumping around. */
+	static const int SNAPSHOT_INTERVAL = 32;
 						
  private:
 	ChessPlayer * m_player1;
 	ChessPlayer * m_player2;
-	ChessGameState m_state;
 
-	stack<ChessGameState> m_history_stack;
-	stack<ChessGameState> m_redo_stack;
+	// Replaces the current state, readers holding the old one keep it
+	void publish(const ChessGameStatePtr & state)
+		{ std::atomic_store(&m_state, state); }
+
+	// Gives the state of a snapshot back the positions before it that
+	// repetitions are looked for among
+	void restoreRepetitions(ChessGameState & state, int ply) const;
+
+	ChessGameStatePtr m_state;
+
+	// The history is the moves from the start of the game, with the state
+	// every SNAPSHOT_INTERVAL plies to replay them from. Moves past m_ply
+	// have been taken back. The snapshots after the start leave out the
+	// positions kept for finding repetitions, m_keys has the key of the
+	// position after every ply instead.
+	std::vector<BoardMove> m_moves;
+	std::vector<ChessGameStatePtr> m_snapshots;
+	std::vector<unsigned long long> m_keys;
+	int m_ply;
+
+	ChessClock m_clock;
  
  	bool m_is_game_in_progress;
 };
@@ -7,10 +7,11 @@
  **************************************************************************/
 
 #include "chessgamestate.h"
+#include "notation.h"
 
-using namespace std;
+#include <algorithm>
 
-inline bool compareBoards(SerialBoard, SerialBoard);
+using namespace std;
 
 void ChessGameState::reset()
 {
@@ -20,7 +21,7 @@ void ChessGameState::reset()
 	m_turn_number = 1;
 	m_white_turn = true;
 	m_last_move = BoardMove();
-	m_threefold_count.clear();
+	m_repetitions.clear();
 	m_board.reset();
 
 	for(int rank = 1; rank <=8; rank++) {
@@ -30,7 +31,6 @@ void ChessGameState::reset()
 			BoardPosition bp(file, rank);
 			
 			if(rank >= 3 && rank <= 6) {
-				m_pieces[bp.hash()] = NULL;
 				break;
 			} else if(rank == 2 || rank == 7) {
 				type = Piece::PAWN;
@@ -46,38 +46,72 @@ void ChessGameState::reset()
 				type = Piece::KING;
 			}
 
-			Piece* piece = new Piece(color, type);
-			m_pieces[bp.hash()] = piece;
-			m_board.addPiece(piece, bp);
+			m_board.addPiece(color, type, bp);
 		}
 	}
+
+	updateStatus();
 }
 
-bool ChessGameState::isDraw()
+bool ChessGameState::loadFEN(string_view fen)
 {
-    return  m_board.isStaleMate(this->getTurn()) ||
-            m_board.isMaterialDraw() ||
-            m_50_moves > 99 ||
-            m_threefold;
+	// The board is set up by parseFEN, only the rest is reset here
+	m_threefold = false;
+	m_last_move = BoardMove();
+	m_repetitions.clear();
+
+	FenInfo info;
+	if(!parseFEN(fen, m_board, info)) {
+		reset();
+		return false;
+	}
+	m_white_turn = (info.turn == Piece::WHITE);
+	m_50_moves = info.halfmoves;
+	m_turn_number = info.fullmoves;
+
+	m_check = m_board.isCheck(getTurn());
+	if(m_turn_number > 1 || !m_white_turn) {
+		m_repetitions.push_back(getKey());
+	}
+	updateStatus();
+	return true;
+}
+
+string ChessGameState::getFEN() const
+{
+	FenInfo info;
+	info.turn = getTurn();
+	info.halfmoves = m_50_moves;
+	info.fullmoves = m_turn_number;
+
+	char fen[FEN_BUFFER_SIZE];
+	return string(fen, writeFEN(m_board, info, fen));
+}
+
+void ChessGameState::updateStatus()
+{
+	if(m_board.legalMoves(getTurn(), m_legal) == 0) {
+		m_status = m_check ? CHECKMATE : STALEMATE;
+	} else if(m_board.isMaterialDraw()) {
+		m_status = INSUFFICIENT_MATERIAL;
+	} else if(m_50_moves > 99) {
+		m_status = FIFTY_MOVES;
+	} else if(m_threefold) {
+		m_status = REPETITION;
+	} else {
+		m_status = m_check ? CHECK : NORMAL;
+	}
 }
 
-// Change this function to return enum about the state of the board
-// i.e. check, checkmate, move out of check,stalemate draw, 50 move draw, 
-// normal, etc... used by chessgame to push user events 
-// onto the stack to handle the various animations and endgame scenarios.
 void ChessGameState::update(const BoardMove& bm)
 {
-	SerialBoard sb;
-	
-	if(m_turn_number > 1 && m_last_move.needPromotion()) {
+	if(m_last_move.isValid() && m_last_move.needPromotion()) {
 		return;
 	}
 
 	// Handle the start of a game
 	if(m_turn_number == 1 && m_white_turn) {
-		sb = m_board.serialize();
-		sb.white_turn = 1;
-		m_threefold_count.push_back(make_pair(sb, 1));
+		m_repetitions.push_back(getKey());
 	}
 
 	if(m_board.getPiece(bm.origin())->type() != Piece::PAWN ||
@@ -85,67 +119,27 @@ void ChessGameState::update(const BoardMove& bm)
 		m_50_moves++;
 	} else {
 		m_50_moves = 0;
-		m_threefold_count.clear();
+		m_repetitions.clear();
 	}
 
 	m_board.update(bm);
 	m_last_move = bm;
 	m_white_turn = !m_white_turn;
 
-	Piece::Color color = bm.getPiece()->color();
-	Piece::Type type = bm.getPiece()->type();
-
-	if(type == Piece::PAWN && bm.fileDiff() == bm.rankDiff() && !m_pieces[bm.dest().hash()]) {
-		// EnPassant capture
-		if(color == Piece::WHITE) {
-			m_pieces[bm.dest().S().hash()] = NULL;
-		} else {
-			m_pieces[bm.dest().N().hash()] = NULL;
-		}
-	} else if(type == Piece::KING && bm.signedFileDiff() == -2) {
-		// Castling to the left
-		BoardPosition corner = (color == Piece::WHITE) ?
-			BoardPosition('a',1) : BoardPosition('a',8);
-		m_pieces[bm.origin().W().hash()] = m_pieces[corner.hash()];
-		m_pieces[corner.hash()] = NULL;
-	} else if(type == Piece::KING && bm.signedFileDiff() == 2) {
-		// Castling to the right
-		BoardPosition corner = (color == Piece::WHITE) ?
-			BoardPosition('h',1) : BoardPosition('h',8);
-		m_pieces[bm.origin().E().hash()] = m_pieces[corner.hash()];
-		m_pieces[corner.hash()] = NULL;
-	}
-	
-	m_pieces[bm.dest().hash()] = m_pieces[bm.origin().hash()];
-	m_pieces[bm.dest().hash()]->promotePawn(bm.getPromotion());
-	m_pieces[bm.origin().hash()] = NULL;
-	
 	m_check = m_board.isCheck(getTurn());
 
 	// Update the threefold repetiiton counter
-	int i = 0;
-	sb = m_board.serialize();
-	sb.white_turn = m_white_turn ? 1 : 0;
-
-	for(; i < (int)m_threefold_count.size(); i++) {
-		if(compareBoards(sb, m_threefold_count[i].first)) {
-			m_threefold_count[i].second++;
-			if(m_threefold_count[i].second >= 3) {
-				m_threefold = true;
-			}
-			break;
-		}
-	}
-
-	if(i == m_threefold_count.size()) {
-		m_threefold_count.push_back(make_pair(sb, 1));
+	unsigned long long key = getKey();
+	m_repetitions.push_back(key);
+	if(count(m_repetitions.begin(), m_repetitions.end(), key) >= 3) {
+		m_threefold = true;
 	}
 
-	cout << m_turn_number << ". " << bm.origin() << " " << bm.dest() << endl;
-
 	if(m_white_turn) {
 		m_turn_number++;
 	}
+
+	updateStatus();
 }
 
 bool ChessGameState::isPositionSelectable(const BoardPosition& bp) const
@@ -159,18 +153,4 @@ bool ChessGameState::isPositionSelectable(const BoardPosition& bp) const
 	return true;
 }
 
-inline bool compareBoards(SerialBoard x, SerialBoard y) {
-	for(int i=0; i < Piece::LAST_TYPE; i++) {
-		if(x.pieces[i] != y.pieces[i]) {
-			return false;
-		}
-	}
-
-	if((x.color[0] != y.color[0]) || (x.color[1] != y.color[1])) {
-		return false;
-	}
-
-	return x.all_flags == y.all_flags;
-}
-
 // end of file chessgamestate.cpp
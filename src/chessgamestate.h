@@ -10,7 +10,10 @@
 #define CHESSGAMESTATE_H
 
 #include <map>
+#include <memory>
 #include <stack>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "board.h"
@@ -21,6 +24,17 @@ class ChessGameState {
 
   public:
 
+	/** Where the game stands, worked out once per move. */
+	enum Status {
+		NORMAL,
+		CHECK,
+		CHECKMATE,
+		STALEMATE,
+		FIFTY_MOVES,
+		REPETITION,
+		INSUFFICIENT_MATERIAL
+	};
+
 	/** Default constructor for ChessGameState */
 	ChessGameState()
 		{ reset(); }
@@ -28,6 +42,17 @@ class ChessGameState {
 	/** Reset to the beginning ChessGameState */
 	void reset();
 
+	/**
+	 * Sets up the position given in Forsyth-Edwards Notation. The move
+	 * counters may be left out, as they are in EPD. Returns false, with
+	 * the state reset, if the FEN can't be read.
+	 * @param fen - e.g. "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1"
+	 */
+	bool loadFEN(std::string_view fen);
+
+	/** Returns the position in Forsyth-Edwards Notation. */
+	std::string getFEN() const;
+
 	/** 
 	 * Update ChessGameState to reflect current state of the game
 	 * @param - bm - The legal BoardMove for updating the game.
@@ -39,7 +64,35 @@ class ChessGameState {
 		{ return m_check; }
 
 	/** Returns true if the game is a draw*/
-	bool isDraw();
+	bool isDraw() const
+		{ return m_status >= STALEMATE; }
+
+	/** Returns how the game stands after the last move. */
+	Status getStatus() const
+		{ return m_status; }
+
+	/** Returns true if the game is over, won or drawn. */
+	bool isGameOver() const
+		{ return m_status >= CHECKMATE; }
+
+	/**
+	 * Returns a bitboard of the squares the piece at bp can legally move
+	 * to. Empty for an empty square or a piece of the side not to move.
+	 */
+	unsigned long long getLegalMoves(const BoardPosition & bp) const
+		{ return bp.isValid() ? m_legal[bp.hash()] : 0; }
+
+	/**
+	 * Returns the legal moves of every square as getLegalMoves would,
+	 * indexed by BoardPosition::hash().
+	 */
+	const unsigned long long * getLegalMap() const
+		{ return m_legal; }
+
+	/** Returns true if the move is legal for the side to move. */
+	bool isMoveLegal(const BoardMove & bm) const
+		{ return bm.origin().isValid() && bm.dest().isValid() &&
+			(m_legal[bm.origin().hash()] & getMask(bm.dest())) != 0; }
 
 	/** Returns true if it is white's turn, false otherwise */
 	bool isWhiteTurn() const
@@ -57,7 +110,7 @@ class ChessGameState {
 		{ return m_white_turn ? Piece::WHITE : Piece::BLACK; }
 
 	/** Returns the current game board */
-	Board getBoard() const 
+	const Board & getBoard() const 
 		{ return m_board; }
 
 	/** Returns the last move made */
@@ -67,19 +120,48 @@ class ChessGameState {
 	/** Returns the number of turns played so far */
 	int getTurnNumber() const
 		{ return m_turn_number; }
+
+	/** Returns the Zobrist key of the position, see Board::getKey. */
+	unsigned long long getKey() const
+		{ return m_board.getKey(getTurn()); }
+
+	/** Returns the plies played since the last capture or pawn move */
+	int getHalfmoveClock() const
+		{ return m_50_moves; }
 	
     friend class ChessGame;
 
   private:
 
-    std::vector<std::pair<SerialBoard, int> > m_threefold_count;
-	Piece* m_pieces[Board::BOARDSIZE*Board::BOARDSIZE];
+	// Fills in the legal moves and the status of the current position
+	void updateStatus();
+
+	// Drops the positions kept to find repetitions, for states that are
+	// only kept to replay moves from
+	void clearRepetitions()
+		{ std::vector<unsigned long long>().swap(m_repetitions); }
+
+	// Sets the keys of the positions since the last pawn move, the
+	// current one last, as ChessGame keeps them
+	void setRepetitions(const unsigned long long * first, const unsigned long long * last)
+		{ m_repetitions.assign(first, last); }
+
+	// Keys of the positions since the last pawn move, to find repetitions
+	std::vector<unsigned long long> m_repetitions;
 	Board m_board;
 	BoardMove m_last_move;
 	bool m_white_turn, m_check, m_threefold;
 	int m_turn_number, m_50_moves;
+	unsigned long long m_legal[Board::BOARDSIZE*Board::BOARDSIZE];
+	Status m_status;
 };
 
+/**
+ * A state shared between threads. States published by ChessGame are
+ * never changed again, a move creates a new one.
+ */
+typedef std::shared_ptr<const ChessGameState> ChessGameStatePtr;
+
 #endif
 
 // end of file chessgamestate.h
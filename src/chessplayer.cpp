@@ -8,9 +8,131 @@
 
 #include "chessplayer.h"
 
+#include <chrono>
 #include <string>
 
-ChessPlayer * PlayerFactory(const std::string & playertype)
+using namespace std;
+
+MoveRequest::MoveRequest(ChessPlayer * player, const MoveCallback & callback, bool background) :
+	m_player(player),
+	m_callback(callback),
+	m_background(background),
+	m_done(false),
+	m_cancelled(false),
+	m_finished(false)
+{
+}
+
+bool MoveRequest::isDone() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_done;
+}
+
+bool MoveRequest::isCancelled() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_cancelled;
+}
+
+void MoveRequest::cancel()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if(m_done || m_cancelled) {
+			return;
+		}
+		m_cancelled = true;
+		if(!m_background) {
+			m_finished = true;
+		}
+	}
+	m_cond.notify_all();
+
+	if(m_background) {
+		m_player->interruptThinking();
+	}
+}
+
+void MoveRequest::wait() const
+{
+	// A worker must not sleep on a job it could be running
+	if(JobSystem::isWorkerThread()) {
+		JobSystem * jobs = JobSystem::getInstance();
+		while(true) {
+			{
+				lock_guard<mutex> lock(m_mutex);
+				if(m_finished) {
+					return;
+				}
+			}
+			if(!jobs->runPending()) {
+				unique_lock<mutex> lock(m_mutex);
+				m_cond.wait_for(lock, chrono::milliseconds(1));
+			}
+		}
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+	while(!m_finished) {
+		m_cond.wait(lock);
+	}
+}
+
+BoardMove MoveRequest::getMove() const
+{
+	wait();
+	lock_guard<mutex> lock(m_mutex);
+	return m_move;
+}
+
+void MoveRequest::complete(const BoardMove & move)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_finished = true;
+		if(m_done || m_cancelled) {
+			m_cond.notify_all();
+			return;
+		}
+		m_move = move;
+		m_done = true;
+	}
+	m_cond.notify_all();
+
+	if(m_callback) {
+		m_callback(m_player, move);
+	}
+}
+
+void MoveRequest::abandon()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_finished = true;
+	}
+	m_cond.notify_all();
+}
+
+MoveRequestPtr ChessPlayer::requestMove(const ChessGameStatePtr & state,
+	const SearchLimits & limits, const MoveCallback & callback)
+{
+	MoveRequestPtr request(new MoveRequest(this, callback, true));
+	JobSystem::Priority priority = isHuman() ? JobSystem::INTERACTIVE : JobSystem::SEARCH;
+	ChessPlayer * player = this;
+	JobSystem::getInstance()->schedule(priority, [player, state, limits, request]() {
+		if(request->isCancelled()) {
+			request->abandon();
+			return;
+		}
+		player->setLimits(limits);
+		player->think(*state);
+		request->complete(player->getMove());
+	});
+	return request;
+}
+
+ChessPlayer * PlayerFactory(const string & playertype)
 {
     if (playertype == "Brutal") {
         return new BrutalPlayer();
@@ -18,6 +140,9 @@ ChessPlayer * PlayerFactory(const std::string & playertype)
     else if (playertype == "Human") {
         return new HumanPlayer();
     }
+    else if (playertype == "Mcts") {
+        return new MctsPlayer();
+    }
     else if (playertype == "Random") {
         return new RandomPlayer();
     }
@@ -28,6 +153,9 @@ ChessPlayer * PlayerFactory(const std::string & playertype)
     else if (playertype == "Faile") {
         return new FailePlayer();
     }
+    else if (playertype == "Uci") {
+        return new UciPlayer();
+    }
 #endif // #ifndef WIN32
     else {
         return 0;
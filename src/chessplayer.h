@@ -11,9 +11,88 @@
 
 #include "boardmove.h"
 #include "chessgamestate.h"
-
+#include "jobsystem.h"
+#include "searchinfo.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 
+class ChessPlayer;
+class OpeningBook;
+
+/**
+ * Called with the player and its move when a move request is answered.
+ * It runs on whichever thread found the move, a worker or the thread
+ * that sent a human's move, so it should only hand the move on.
+ */
+typedef std::function<void(ChessPlayer *, const BoardMove &)> MoveCallback;
+
+/**
+ * A move asked of a ChessPlayer with requestMove. The player answers it
+ * at some later time, unless it is cancelled first.
+ */
+class MoveRequest {
+ public:
+	/**
+	 * @param player - The player asked for the move.
+	 * @param callback - Called with the move, unless cancelled.
+	 * @param background - True if a job is thinking about the move, so
+	 * that cancelling has to wait for the job.
+	 */
+	MoveRequest(ChessPlayer * player, const MoveCallback & callback, bool background);
+
+	/** Returns true once the move is known. */
+	bool isDone() const;
+
+	bool isCancelled() const;
+
+	/**
+	 * Withdraws the request, the callback won't be called. A player that
+	 * is thinking about it is interrupted.
+	 */
+	void cancel();
+
+	/** Waits until the move is known, or the player has stopped after a cancel. */
+	void wait() const;
+
+	/** Waits for the move, invalid if the request was cancelled. */
+	BoardMove getMove() const;
+
+	/**
+	 * Answers the request, called by the player. Does nothing if the
+	 * request was cancelled or already answered.
+	 */
+	void complete(const BoardMove & move);
+
+	/**
+	 * Marks the player as done with the request without a move, called
+	 * after a cancel.
+	 */
+	void abandon();
+
+ private:
+	MoveRequest(const MoveRequest &);
+	MoveRequest & operator=(const MoveRequest &);
+
+	ChessPlayer * m_player;
+	MoveCallback m_callback;
+	bool m_background;
+
+	mutable std::mutex m_mutex;
+	mutable std::condition_variable m_cond;
+	BoardMove m_move;
+	bool m_done;
+	bool m_cancelled;
+	// True once the player won't touch the request again
+	bool m_finished;
+};
+
+typedef std::shared_ptr<MoveRequest> MoveRequestPtr;
+
 class ChessPlayer {
  public:
 	 
@@ -25,9 +104,17 @@ class ChessPlayer {
 
 	virtual void startGame() {}
 
-	virtual void loadGame(const ChessGameState& cgs) {}
+	virtual void loadGame(const ChessGameState &) {}
 
-	virtual void opponentMove(const BoardMove & move, const ChessGameState & cgs) {}
+	virtual void opponentMove(const BoardMove &, const ChessGameState &) {}
+
+	/**
+	 * Tells the player its own move has been played, called on the thread
+	 * playing the moves right after it.
+	 * @param move - The move that was played.
+	 * @param cgs - The state after the move.
+	 */
+	virtual void moveMade(const BoardMove &, const ChessGameState &) {}
 
 	virtual bool isThinking() const
 		{ return m_is_thinking; }
@@ -37,6 +124,17 @@ class ChessPlayer {
 
 	virtual void think(const ChessGameState & cgs) = 0;
 
+	/**
+	 * Asks for a move without blocking. By default think() runs in a job,
+	 * with the limits set first, and the callback gets the move from the
+	 * worker. The returned request can be waited on or cancelled.
+	 * @param state - The position to move in, held until the move is made.
+	 * @param limits - The limits to think within.
+	 * @param callback - Gets the move, unless the request is cancelled.
+	 */
+	virtual MoveRequestPtr requestMove(const ChessGameStatePtr & state,
+		const SearchLimits & limits, const MoveCallback & callback);
+
 	virtual BoardMove getMove()
 		{ return m_move; }
 	
@@ -46,7 +144,7 @@ class ChessPlayer {
 	virtual bool needMove()
 		{ return false; }
 
-	virtual void sendMove(const BoardMove & bm) {}
+	virtual void sendMove(const BoardMove &) {}
 		
 	virtual void undoMove() {}
 
@@ -62,13 +160,32 @@ class ChessPlayer {
 	Piece::Color getColor() const
 		{ return (m_is_white ? Piece::WHITE : Piece::BLACK); }
 
+	/** Sets the limits (depth, nodes, clock) for the following moves. */
+	void setLimits(const SearchLimits & limits)
+		{ m_limits = limits; }
+
+	const SearchLimits & getLimits() const
+		{ return m_limits; }
+
+	/**
+	 * Sets the opening book the player plays from while it knows the
+	 * position, null for none.
+	 */
+	void setBook(const std::shared_ptr<const OpeningBook> & book)
+		{ m_book = book; }
+
+	const std::shared_ptr<const OpeningBook> & getBook() const
+		{ return m_book; }
+
  protected:
 
 	bool m_is_white;
-	bool m_is_thinking;
+	std::atomic<bool> m_is_thinking;
 	bool m_is_human;	
 	bool m_trustworthy;
 	BoardMove m_move;
+	SearchLimits m_limits;
+	std::shared_ptr<const OpeningBook> m_book;
 };
 
 ChessPlayer * PlayerFactory(const std::string & playertype);
@@ -8,17 +8,30 @@
 
 #ifdef INCHESSPLAYER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 using std::vector;
 
+class AnalysisCache;
+class EngineProcess;
+class MateSolver;
+class Tablebases;
+
 class HumanPlayer : public ChessPlayer {
  public:
 	HumanPlayer();
 
 	/**
 	 * Kills time while the Human user thinks about what move he/she
-	 * wants to make.
+	 * wants to make, or until interruptThinking is called.
 	 */
 	void think(const ChessGameState & cgs);
 	
@@ -29,22 +42,101 @@ class HumanPlayer : public ChessPlayer {
 	bool needMove() { return true; }
 	
 	/**
-	 * Sets the specified move as this players move to make.
+	 * Waits for the move sent with sendMove, without taking up a worker
+	 * while the Human user thinks.
+	 */
+	MoveRequestPtr requestMove(const ChessGameStatePtr & state,
+		const SearchLimits & limits, const MoveCallback & callback);
+
+	/**
+	 * Sets the specified move as this players move to make, and answers
+	 * the pending move request with it.
 	 */
 	void sendMove(const BoardMove & m);
+
+ private:
+	std::mutex m_request_mutex;
+	MoveRequestPtr m_request;
 };
 
 class BrutalPlayer : public ChessPlayer {
  public:
+	/** The evaluation functions to choose from, for comparing them. */
+	enum Evaluation { FULL, MATERIAL };
+
 	BrutalPlayer();
+
+	/**
+	 * Searches to the ply depth, or to the depth in the limits. With a
+	 * node, time or clock limit the search deepens iteratively until the
+	 * limit runs out and plays the move of the last finished iteration.
+	 */
 	void think(const ChessGameState & cgs);
 
+	/** Stops the search, the best move found so far is played. */
+	void interruptThinking();
+
 	int getPly() { return m_ply; }
 	void setPly(int ply) { m_ply = ply; }
 
+	Evaluation getEvaluation() const { return m_evaluation; }
+	void setEvaluation(Evaluation eval) { m_evaluation = eval; }
+
+	/** Returns the number of positions searched for the last move. */
+	long long getNodes() const { return m_nodes; }
+
+	/**
+	 * Sets a function that is called after every finished iteration with
+	 * its depth, score, nodes and best move. It runs on the thinking
+	 * thread.
+	 */
+	void setInfoCallback(const std::function<void(const SearchInfo &)> & cb)
+		{ m_info_callback = cb; }
+
+	/**
+	 * Sets the endgame tablebases looked up during the search once few
+	 * enough pieces are left, null for none.
+	 */
+	void setTablebases(const std::shared_ptr<const Tablebases> & tablebases)
+		{ m_tablebases = tablebases; }
+
+	/**
+	 * Looks for a forced mate with a MateSolver before every search, for
+	 * at most nodes positions, and plays it at once if there is one. 0,
+	 * the default, turns it off.
+	 */
+	void setMateCheck(long long nodes);
+
+	/**
+	 * Sets the cache of earlier searches, null for none. A position found
+	 * there deep enough is played at once, a shallower result is where
+	 * iterative deepening carries on from. Finished searches are stored
+	 * with their principal variation. Results are kept apart by the
+	 * evaluation, its parameters and the tablebases they were scored with.
+	 */
+	void setAnalysisCache(const std::shared_ptr<AnalysisCache> & cache)
+		{ m_cache = cache; }
+
  protected:
+	// Plays a forced mate found by the MateSolver, returns false if there
+	// is none
+	bool findMate(const ChessGameState & cgs, std::chrono::steady_clock::time_point start);
+
+	// Milliseconds the move may take by the move time or the clock, 0 for
+	// no time limit
+	long long getBudget() const;
+
+	// Tells the info callback about a finished iteration
+	void reportIteration(int depth, int score, const std::vector<BoardMove> & pv,
+		std::chrono::steady_clock::time_point start);
+
+	// The key of cgs in the analysis cache
+	unsigned long long cacheKey(const ChessGameState & cgs) const;
+
 	int evaluateBoard(const Board & board, Piece::Color color);
-	int search(Board board, Piece::Color color, int depth, int alpha, int beta, BoardMove& move);
+	// Returns the score of board for color, pv gets the best line found
+	int search(Board board, Piece::Color color, int depth, int alpha, int beta, std::vector<BoardMove>& pv);
+	bool outOfTime();
 	int pawnBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
 	int knightBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
 	int bishopBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
@@ -56,23 +148,159 @@ class BrutalPlayer : public ChessPlayer {
 
 	bool isIsolatedPawn(const BoardPosition & bp, const Board & board);
 	bool isDoubledPawn(const BoardPosition & bp, const Board & board);
-   
-	// Used to calculate positional bonuses
-	static int m_bishop[64];
-	static int m_knight[64];
-	static int m_wpawn[64];
-	static int m_bpawn[64];
-	static int m_wking[64];
-	static int m_bking[64];
-	static int m_end_king[64];
 
 	int m_ply;
+	Evaluation m_evaluation;
+
+	// Search limits for the current move
+	long long m_nodes;
+	long long m_max_nodes;
+	std::chrono::steady_clock::time_point m_deadline;
+	bool m_timed;
+	std::atomic<bool> m_stop;
+
+	std::function<void(const SearchInfo &)> m_info_callback;
+
+	std::shared_ptr<const Tablebases> m_tablebases;
+
+	long long m_mate_check;
+	std::shared_ptr<MateSolver> m_mate_solver;
+
+	std::shared_ptr<AnalysisCache> m_cache;
+
+	// The best line below each depth of the search, kept between moves so
+	// that their memory is reused
+	std::vector<std::vector<BoardMove> > m_lines;
+};
+
+/**
+ * MctsPlayer plays by Monte-Carlo tree search (PUCT) instead of alpha-beta.
+ * Every playout walks down the tree along the move that balances how well
+ * it did so far against how little it has been tried, adds the position
+ * it reaches and scores it, either with the evaluation of the BrutalPlayer
+ * or with a few random moves followed by a capture search. The move tried
+ * most at the root is played.
+ *
+ * Several threads may share the tree, each move on their way down counts
+ * as a loss until the playout is backed up so that they spread over
+ * different lines. Nodes come from a fixed arena, and the part of the
+ * tree below the next position is kept for the next move.
+ *
+ * Strength grows with the number of playouts, so a small budget makes an
+ * opponent that plays plausible but beatable moves.
+ */
+class MctsPlayer : public BrutalPlayer {
+ public:
+	/** How the positions added to the tree are scored. */
+	enum Playout { STATIC, ROLLOUT };
+
+	/**
+	 * @param megabytes - Size of the node arena, twice that once the tree
+	 *                    is kept between moves.
+	 */
+	MctsPlayer(int megabytes = 32);
+
+	/** Forgets the tree of the last game. */
+	void newGame();
+
+	/**
+	 * Runs playouts until the node limit, which counts playouts, or the
+	 * time runs out. Without either the playouts are set by the ply.
+	 */
+	void think(const ChessGameState & cgs);
+
+	Playout getPlayout() const { return m_playout; }
+	void setPlayout(Playout playout) { m_playout = playout; }
+
+	/**
+	 * Sets the threads searching the tree, the thinking thread and helpers
+	 * run as jobs. 0, the default, uses one per worker of the JobSystem.
+	 */
+	void setThreads(int threads) { m_threads = threads; }
+
+	/** Sets how much untried moves are favoured, 1.5 by default. */
+	void setExploration(double exploration) { m_exploration = exploration; }
+
+	/**
+	 * Sets the playouts for a move without a node or time limit. 0, the
+	 * default, gives 1000 at ply 2 and four times as many for every
+	 * further ply.
+	 */
+	void setPlayouts(long long playouts) { m_default_playouts = playouts; }
+
+ private:
+	MctsPlayer(const MctsPlayer &);
+	MctsPlayer & operator=(const MctsPlayer &);
+
+	struct Node {
+		/** Playouts through the node, and those still on their way down */
+		std::atomic<int> visits;
+		std::atomic<int> virtual_loss;
+		/** Sum of the results for the side that made the move, fixed point */
+		std::atomic<long long> value;
+		float prior;
+		/** Children are kept together in the arena */
+		int first_child;
+		unsigned short child_count;
+		/** From, to and promotion of the move leading here */
+		unsigned short move;
+		std::atomic<unsigned char> state;
+	};
+
+	// Keeps the subtree of the position if it is within two plies of the
+	// last root, returns false otherwise
+	bool reuseTree(const Board & board, Piece::Color turn);
+	void resetTree();
+
+	void runPlayouts(long long limit, bool main, std::chrono::steady_clock::time_point start);
+	void playout(std::vector<int> & path, unsigned long long & seed);
+	int select(int index) const;
+	// Adds the children of a node, returns false if the arena is full
+	bool expand(Node & node, const Board & board, Piece::Color turn);
+
+	// Results are for the side that moved into the position, from 0 for
+	// a loss to 1 for a win
+	double evaluate(const Board & board, Piece::Color turn, unsigned long long & seed);
+	int quiesce(const Board & board, Piece::Color turn, int alpha, int beta, int depth);
+	// The result of a score for color, relative to the root
+	double toResult(int score, Piece::Color color) const;
+
+	int bestChild(int index) const;
+	void report(std::chrono::steady_clock::time_point start);
+
+	std::unique_ptr<Node[]> m_tree;
+	std::unique_ptr<Node[]> m_spare;
+	int m_capacity;
+	std::atomic<int> m_used;
+	bool m_has_tree;
+	Board m_root_board;
+	Piece::Color m_root_turn;
+	// Evaluation of the root the tree was started from
+	int m_baseline;
+
+	Playout m_playout;
+	int m_threads;
+	double m_exploration;
+	long long m_default_playouts;
+
+	// Progress of the current move, shared by the threads
+	std::atomic<long long> m_playouts;
+	std::atomic<int> m_seldepth;
+	std::atomic<bool> m_done;
+	std::chrono::steady_clock::time_point m_last_report;
 };
 
 class RandomPlayer : public ChessPlayer {
  public:
-	RandomPlayer();
+	/**
+	 * @param delay - Milliseconds to wait before moving, so that games
+	 *                on screen can be followed.
+	 */
+	RandomPlayer(int delay = 150);
 	void think(const ChessGameState & cgs);
+
+ private:
+	int m_delay;
 };
 
 class TestPlayer : public ChessPlayer {
@@ -89,19 +317,20 @@ class TestPlayer : public ChessPlayer {
  */
 class XboardPlayer : public ChessPlayer {
  public:
+	/** Plays with GnuChess. */
 	XboardPlayer();
 
 	~XboardPlayer();
 
 	/**
 	 * Create a new game of chess using an XboardPlayer. This function 
-	 * starts the gnuchess process.
+	 * starts the engine process.
 	 */
 	void newGame();
 
 	/**
 	 * Load a saved game ofchess into the XboardPlayer. This function
-	 * starts the gnuchess process using the saved game.
+	 * starts the engine process using the saved game.
 	 */
 	void loadGame(const ChessGameState& cgs);
 
@@ -111,72 +340,223 @@ class XboardPlayer : public ChessPlayer {
 	void startGame();
 
 	/**
-	 * Gets a move from the XboardPlayer
+	 * Gets a move from the XboardPlayer, waiting for the engine until it
+	 * moves or interruptThinking() is called.
 	 */
 	void think(const ChessGameState & cgs);
 
+	/**
+	 * Returns at once, the thread reading the engine answers the request
+	 * when the engine moves. An engine that isn't running yet is started
+	 * in a job first.
+	 */
+	MoveRequestPtr requestMove(const ChessGameStatePtr & state,
+		const SearchLimits & limits, const MoveCallback & callback);
+
 	/**
 	 * Sends the opponents move to the XboardPlayer
 	 */
 	void opponentMove(const BoardMove & move, const ChessGameState & cgs);
 
+	/** Stops think() waiting, it then has no move. */
+	void interruptThinking();
+
 	void undoMove();
-	
+
+ protected:
+	/**
+	 * Sets up a player for an engine that differs from GnuChess in how it
+	 * talks.
+	 * @param command - The engine command line.
+	 * @param moveprefix - What starts a line with the engine's move.
+	 * @param category - The log category, a string literal.
+	 * @param sendpromotion - Whether a promotion is sent with the piece.
+	 */
+	XboardPlayer(const std::string & command, const std::string & moveprefix,
+		const char * category, bool sendpromotion);
+
  private:
-	// Starts GnuChess
+	// Leases the engine from the EnginePool
 	void runChessEngine();
-	
-	int m_to[2];
-	int m_from[2];
+
+	// Reads the engine's output, hands its moves to the pending request
+	// or keeps them for the next one
+	void readerLoop();
+
+	// Makes a move of the engine's answer, in coordinate notation
+	BoardMove parseMove(const std::string & reply, const ChessGameState & cgs) const;
+
+	std::string m_command;
+	std::string m_moveprefix;
+	const char * m_category;
+	bool m_sendpromotion;
+
+	EngineProcess * m_engine;
 	bool m_initialized;
+	std::thread m_reader;
+	std::atomic<bool> m_reader_stop;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	// A move the engine made before it was asked for
+	std::string m_reply;
+	bool m_got_move;
+	bool m_engine_dead;
+	// The request the engine's next move answers, and its position
+	MoveRequestPtr m_request;
+	ChessGameStatePtr m_request_state;
 };
 
 /**
- * FailePlayer is a ChessPlayer that can be used to interface with
- * the Faile chess engine. Very similar to XboardPlayer
+ * FailePlayer is an XboardPlayer for the Faile chess engine, which
+ * announces its moves differently.
  */
-class FailePlayer : public ChessPlayer {
+class FailePlayer : public XboardPlayer {
  public:
 	FailePlayer();
+};
 
-	~FailePlayer();
-
+/**
+ * UciPlayer is a ChessPlayer that drives any chess engine speaking the
+ * UCI protocol. The engine process is leased from the EnginePool and
+ * stays alive across games, every move request carries the full move
+ * list and the clock, and the engine's 'info' output is parsed as it
+ * arrives so that it can be shown while the engine is thinking.
+ */
+class UciPlayer : public ChessPlayer {
+ public:
 	/**
-	 * Create a new game of chess using an FailePlayer. This function 
-	 * starts the gnuchess process.
+	 * Creates a player for the given engine command line. The engine is
+	 * not started until it is needed. An empty command uses the engine
+	 * set in the Options.
 	 */
+	UciPlayer(const std::string & command = "");
+
+	~UciPlayer();
+
+	/** Starts the engine if needed and tells it a new game begins. */
 	void newGame();
 
-	/**
-	 * Load a saved game ofchess into the FailePlayer. This function
-	 * starts the gnuchess process using the saved game.
-	 */
+	/** Sets the position the game goes on from, sent as a FEN. */
 	void loadGame(const ChessGameState& cgs);
 
 	/**
-	 * Notify the FailePlayer that the game is starting
+	 * Sends the position and a 'go', then waits for the 'bestmove'. A
+	 * position the moves so far don't lead to is sent as a FEN.
 	 */
-	void startGame();
+	void think(const ChessGameState & cgs);
 
 	/**
-	 * Gets a move from the FailePlayer
+	 * Sends the position and a 'go' like think(), but returns at once.
+	 * The thread reading the engine answers the request when the
+	 * 'bestmove' comes, so no worker waits for the engine. The move is
+	 * only recorded, and pondering started, once moveMade() reports it
+	 * played. An engine that isn't running yet is started in a job first.
 	 */
-	void think(const ChessGameState & cgs);
+	MoveRequestPtr requestMove(const ChessGameStatePtr & state,
+		const SearchLimits & limits, const MoveCallback & callback);
+
+	/** Records the opponents move, answering a ponder with 'ponderhit'. */
+	void opponentMove(const BoardMove & move, const ChessGameState & cgs);
 
 	/**
-	 * Sends the opponents move to the FailePlayer
+	 * Records a move answered through requestMove() and starts pondering
+	 * on the reply the engine expects.
 	 */
-	void opponentMove(const BoardMove & move, const ChessGameState & cgs);
+	void moveMade(const BoardMove & move, const ChessGameState & cgs);
+
+	/** Sends 'stop', the engine then answers with its best move so far. */
+	void interruptThinking();
 
 	void undoMove();
-	
+
+	/** Lets the engine think on the opponent's time. Off by default. */
+	void setPonder(bool ponder)
+		{ m_ponder = ponder; }
+
+	/** Sets a UCI option, sent right after the 'uci' handshake. */
+	void setOption(const std::string & name, const std::string & value);
+
+	/** Returns the name the engine reported with 'id name'. */
+	std::string getEngineName() const;
+
+	/** Returns the most recent 'info' report of the engine. */
+	SearchInfo getLastInfo() const;
+
+	/**
+	 * Sets a function that is called for every 'info' report. It runs on
+	 * the thread reading the engine output, so it should return quickly.
+	 */
+	void setInfoCallback(const std::function<void(const SearchInfo &)> & cb);
+
  private:
-	// Starts Faile
-	void runChessEngine();
-	
-	int m_to[2];
-	int m_from[2];
-	bool m_initialized;
+	// Starts the engine and performs the 'uci' handshake
+	bool runChessEngine();
+	void shutdownEngine();
+
+	// Reads and dispatches the engine's output until told to stop
+	void readerLoop();
+	void parseInfo(const std::string & line);
+
+	bool waitForReady();
+	bool waitForBestMove(std::string & best, std::string & ponder);
+
+	// Returns true if the moves played from the start add up to the
+	// plies of cgs
+	bool reachesPosition(const ChessGameState & cgs) const;
+
+	// Gets the engine searching cgs, a ponder that hit just goes on
+	void startThinking(const ChessGameState & cgs);
+
+	// Takes the engine's answer as the move in cgs and starts pondering
+	// on the reply it expects
+	void playBestMove(const ChessGameState & cgs, const std::string & best,
+		const std::string & ponder);
+
+	// Completes a request with the engine's answer in cgs, leaving the
+	// answer for moveMade()
+	void answerRequest(const MoveRequestPtr & request,
+		const ChessGameState & cgs, const std::string & best,
+		const std::string & ponder);
+	void forgetAnswer();
+
+	void sendPosition(const std::string & extra);
+	std::string goCommand(bool ponder) const;
+	void startPondering(const std::string & ponder);
+	void stopPondering();
+
+	std::string m_command;
+	EngineProcess * m_engine;
+	std::thread m_reader;
+	std::atomic<bool> m_reader_stop;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_got_uciok, m_got_readyok, m_got_bestmove, m_engine_dead;
+	std::string m_bestmove, m_bestponder;
+	std::string m_name;
+	SearchInfo m_info;
+	std::function<void(const SearchInfo &)> m_info_callback;
+	// The request the next 'bestmove' answers, and its position
+	MoveRequestPtr m_request;
+	ChessGameStatePtr m_request_state;
+	// Set once a request was answered, until moveMade() or the next call
+	// from the game thread
+	bool m_answered;
+	std::string m_answer_ponder;
+
+	std::vector<std::pair<std::string, std::string> > m_options;
+	// The FEN the game started from, empty for the initial position, and
+	// the moves played since
+	std::string m_start;
+	int m_start_ply;
+	std::vector<std::string> m_moves;
+
+	bool m_ponder;
+	bool m_pondering;
+	bool m_ponderhit;
+	std::string m_pondermove;
+	int m_default_movetime;
 };
 
 #endif // #ifndef WIN32
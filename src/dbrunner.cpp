@@ -0,0 +1,453 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : dbrunner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "bookbuilder.h"
+#include "chessgamestate.h"
+#include "gamedb.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "mappedfile.h"
+#include "notation.h"
+#include "openingbook.h"
+#include "pgn.h"
+#include "positionindex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// PGN text is encoded this many bytes per job, a window of jobs at a time
+static const size_t PART_SIZE = 4 << 20;
+
+static void printUsage()
+{
+	cerr << "Usage: chesspizza-db [options] COMMAND FILE...\n\n";
+	cerr << "Builds and reads binary game databases, a compact form of PGN that\n";
+	cerr << "replays without parsing and finds any game at once.\n\n";
+	cerr << "Commands:\n";
+	cerr << " import PGN DB\t\t\t Add the games of PGN to DB, creating it if needed.\n";
+	cerr << " export DB PGN\t\t\t Append the games of DB to PGN.\n";
+	cerr << " info DB\t\t\t Print the size of DB.\n";
+	cerr << " replay DB\t\t\t Decode every game of DB and report how fast.\n";
+	cerr << " index DB INDEX\t\t Index the positions of DB by key into INDEX.\n";
+	cerr << " find INDEX [FEN]\t\t Look up a position, the initial one by default,\n";
+	cerr << "                 \t\t its moves and the games that reached it.\n";
+	cerr << " book PGN BOOK\t\t\t Build an opening book out of the games of PGN.\n";
+	cerr << " probe BOOK [FEN]\t\t Print the book moves of a position.\n\n";
+	cerr << "Options:\n";
+	cerr << " -j N  --threads=N\t\t Threads used, one per core by default.\n";
+	cerr << " --plies=N\t\t\t Index the first N moves of each game only,\n";
+	cerr << "          \t\t\t 30 when building books.\n";
+	cerr << " --min-games=N\t\t\t Leave out book moves played in fewer games, 3 by default.\n";
+	cerr << " --min-score=P\t\t\t Leave out book moves that scored under P percent.\n";
+	cerr << " --only-white  --only-black\t Add the moves of one side to the book only.\n";
+	cerr << " -h  --help\t\t\t Print this help screen.\n";
+	exit(1);
+}
+
+// The games of a part of a PGN file, ready to be written
+struct EncodedPart {
+	EncodedPart() : skipped(0) {}
+
+	vector<EncodedGame> games;
+	// Games with a move that isn't legal
+	long long skipped;
+};
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static int importGames(const string & pgnfile, const string & dbfile)
+{
+	MappedFile file;
+	if(!file.open(pgnfile)) {
+		cerr << "Couldn't read " << pgnfile << endl;
+		return 1;
+	}
+	GameDatabaseWriter writer;
+	if(!writer.open(dbfile)) {
+		cerr << "Couldn't open " << dbfile << endl;
+		return 1;
+	}
+	long long before = writer.getGameCount();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// Encoded on all cores, a window of parts at a time so that a file of
+	// any size fits in memory, then written in the order of the PGN
+	JobSystem * jobs = JobSystem::getInstance();
+	vector<string_view> parts = PgnReader::split(file.getText(),
+		(int)(file.getSize() / PART_SIZE) + 1);
+	int window = jobs->getThreadCount() * 2;
+	long long skipped = 0;
+	for(int first = 0; first < (int)parts.size(); first += window) {
+		int last = min(first + window, (int)parts.size());
+		vector<JobHandle<EncodedPart> > handles;
+		for(int i = first; i < last; i++) {
+			handles.push_back(jobs->submit(JobSystem::IO, [&parts, i]() {
+				EncodedPart part;
+				PgnReader reader(parts[i]);
+				PgnGameView game;
+				EncodedGame encoded;
+				while(reader.next(game)) {
+					if(encoded.encode(game)) {
+						part.games.push_back(encoded);
+					} else {
+						part.skipped++;
+					}
+				}
+				return part;
+			}));
+		}
+
+		for(int i = 0; i < (int)handles.size(); i++) {
+			const EncodedPart & part = handles[i].get();
+			for(int j = 0; j < (int)part.games.size(); j++) {
+				writer.add(part.games[j]);
+			}
+			skipped += part.skipped;
+		}
+	}
+
+	if(!writer.close()) {
+		cerr << "Couldn't write " << dbfile << endl;
+		return 1;
+	}
+	double seconds = secondsSince(start);
+	long long games = writer.getGameCount() - before;
+	cout << "Imported " << games << " games in " << seconds << "s, " <<
+		(long long)(games / seconds) << " games/s" << endl;
+	if(skipped) {
+		cout << "Skipped " << skipped << " games with moves that aren't legal" << endl;
+	}
+	return 0;
+}
+
+static int exportGames(const string & dbfile, const string & pgnfile)
+{
+	GameDatabase db;
+	if(!db.open(dbfile)) {
+		cerr << "Couldn't read " << dbfile << endl;
+		return 1;
+	}
+	PgnWriter writer;
+	if(!writer.open(pgnfile)) {
+		cerr << "Couldn't open " << pgnfile << endl;
+		return 1;
+	}
+	writer.setFlushEachGame(false);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	GameHeader header;
+	vector<BoardMove> moves;
+	ChessGameState state;
+	PgnGame game;
+	for(long long n = 0; n < db.getGameCount(); n++) {
+		db.getHeader(n, header);
+		if(!db.readMoves(n, moves)) {
+			cerr << "Game " << n + 1 << " of " << dbfile << " is damaged" << endl;
+			return 1;
+		}
+
+		game = PgnGame();
+		header.addTags(game);
+		if(header.tags[GameHeader::FEN].empty()) {
+			state.reset();
+		} else {
+			state.loadFEN(header.tags[GameHeader::FEN]);
+		}
+		for(int i = 0; i < (int)moves.size(); i++) {
+			game.moves.push_back(moveToSAN(state, moves[i]));
+			state.update(moves[i]);
+		}
+		game.result = GameHeader::resultName(header.result);
+		writer.write(game);
+	}
+	writer.close();
+
+	double seconds = secondsSince(start);
+	cout << "Exported " << db.getGameCount() << " games in " << seconds << "s" << endl;
+	return 0;
+}
+
+static int printInfo(const string & dbfile)
+{
+	GameDatabase db;
+	if(!db.open(dbfile)) {
+		cerr << "Couldn't read " << dbfile << endl;
+		return 1;
+	}
+
+	long long plies = 0;
+	for(long long n = 0; n < db.getGameCount(); n++) {
+		plies += db.getPlies(n);
+	}
+	long long games = db.getGameCount();
+	cout << "Games:  " << games << "\n";
+	cout << "Blocks: " << (games + GameDatabase::BLOCK_GAMES - 1) / GameDatabase::BLOCK_GAMES << "\n";
+	cout << "Moves:  " << plies << "\n";
+	cout << "Size:   " << db.getSize() << " bytes";
+	if(games) {
+		cout << ", " << db.getSize() / games << " per game";
+	}
+	if(plies) {
+		cout << ", " << db.getSize() * 8.0 / plies << " bits per move";
+	}
+	cout << endl;
+	return 0;
+}
+
+static int replayGames(const string & dbfile)
+{
+	GameDatabase db;
+	if(!db.open(dbfile)) {
+		cerr << "Couldn't read " << dbfile << endl;
+		return 1;
+	}
+
+	// A block per job, each game of it decoded to its last position
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	JobSystem * jobs = JobSystem::getInstance();
+	vector<JobHandle<long long> > handles;
+	for(long long first = 0; first < db.getGameCount(); first += GameDatabase::BLOCK_GAMES) {
+		handles.push_back(jobs->submit(JobSystem::IO, [&db, first]() {
+			long long last = min(first + GameDatabase::BLOCK_GAMES, db.getGameCount());
+			vector<BoardMove> moves;
+			long long plies = 0;
+			for(long long n = first; n < last; n++) {
+				if(!db.readMoves(n, moves)) {
+					return -1LL;
+				}
+				plies += moves.size();
+			}
+			return plies;
+		}));
+	}
+
+	long long plies = 0;
+	bool damaged = false;
+	for(int i = 0; i < (int)handles.size(); i++) {
+		if(handles[i].get() < 0) {
+			damaged = true;
+		} else {
+			plies += handles[i].get();
+		}
+	}
+	double seconds = secondsSince(start);
+	if(damaged) {
+		cerr << dbfile << " is damaged" << endl;
+		return 1;
+	}
+
+	long long games = db.getGameCount();
+	cout << "Replayed " << games << " games, " << plies << " moves in " <<
+		seconds << "s\n";
+	cout << (long long)(games * 60 / seconds) << " games/min, " <<
+		(long long)(plies / seconds) << " moves/s" << endl;
+	return 0;
+}
+
+static int indexPositions(const string & dbfile, const string & indexfile, int plies)
+{
+	GameDatabase db;
+	if(!db.open(dbfile)) {
+		cerr << "Couldn't read " << dbfile << endl;
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if(!PositionIndex::build(db, indexfile, plies)) {
+		cerr << "Couldn't index " << dbfile << " into " << indexfile << endl;
+		return 1;
+	}
+	double seconds = secondsSince(start);
+
+	PositionIndex index;
+	if(!index.open(indexfile)) {
+		cerr << "Couldn't read " << indexfile << endl;
+		return 1;
+	}
+	cout << "Indexed " << index.getPositionCount() << " positions of " <<
+		index.getGameCount() << " games in " << seconds << "s" << endl;
+	return 0;
+}
+
+static void printStats(const PositionStats & stats)
+{
+	cout << stats.games << " games, +" << stats.whitewins << " =" << stats.draws <<
+		" -" << stats.blackwins;
+}
+
+static int findPosition(const string & indexfile, const string & fen)
+{
+	PositionIndex index;
+	if(!index.open(indexfile)) {
+		cerr << "Couldn't read " << indexfile << endl;
+		return 1;
+	}
+	ChessGameState state;
+	if(!fen.empty() && !state.loadFEN(fen)) {
+		cerr << "Couldn't read the position " << fen << endl;
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	PositionStats stats;
+	index.find(state, stats);
+	double lookup = secondsSince(start);
+	start = chrono::steady_clock::now();
+	vector<MoveStats> moves;
+	index.explore(state, moves);
+	double explore = secondsSince(start);
+
+	cout << state.getFEN() << "\n";
+	printStats(stats);
+	cout << "\n\n";
+	for(int i = 0; i < (int)moves.size(); i++) {
+		cout << moveToSAN(state, moves[i].move) << "\t";
+		printStats(moves[i].stats);
+		cout << "\n";
+	}
+
+	vector<PositionGame> games;
+	index.findGames(state.getKey(), games, 10);
+	if(!games.empty()) {
+		cout << "\nGames:";
+		for(int i = 0; i < (int)games.size(); i++) {
+			cout << " " << games[i].game + 1 << "@" << games[i].ply;
+		}
+		if(games.size() < (size_t)stats.games) {
+			cout << " ...";
+		}
+		cout << "\n";
+	}
+	cout << "\nLooked up in " << lookup * 1e6 << "us, explored " << moves.size() <<
+		" moves in " << explore * 1e6 << "us" << endl;
+	return 0;
+}
+
+static int buildBook(const string & pgnfile, const string & bookfile, const BookFilter & filter)
+{
+	MappedFile file;
+	if(!file.open(pgnfile)) {
+		cerr << "Couldn't read " << pgnfile << endl;
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	long long games = 0;
+	long long entries = BookBuilder::build(file.getText(), bookfile, filter, &games);
+	if(entries < 0) {
+		cerr << "Couldn't write " << bookfile << endl;
+		return 1;
+	}
+	double seconds = secondsSince(start);
+	cout << "Built " << entries << " entries out of " << games << " games in " <<
+		seconds << "s" << endl;
+	return 0;
+}
+
+static int probeBook(const string & bookfile, const string & fen)
+{
+	OpeningBook book;
+	if(!book.open(bookfile)) {
+		cerr << "Couldn't read " << bookfile << endl;
+		return 1;
+	}
+	ChessGameState state;
+	if(!fen.empty() && !state.loadFEN(fen)) {
+		cerr << "Couldn't read the position " << fen << endl;
+		return 1;
+	}
+
+	vector<BookMove> moves;
+	int total = book.findMoves(state, moves);
+	cout << state.getFEN() << "\n";
+	if(moves.empty()) {
+		cout << "Not in the book" << endl;
+		return 0;
+	}
+	cout << "\n";
+	for(int i = 0; i < (int)moves.size(); i++) {
+		cout << moveToSAN(state, moves[i].move) << "\t" << moves[i].weight << "\t" <<
+			moves[i].weight * 100.0 / total << "%\n";
+	}
+	cout << flush;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+
+	vector<string> commands;
+	int threads = 0, plies = 0;
+	BookFilter filter;
+
+	for(int i = 0; i < (int)args.size(); i++) {
+		if(args[i] == "-h" || args[i] == "--help") {
+			printUsage();
+		} else if(args[i] == "-j" && i + 1 < (int)args.size()) {
+			threads = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 10) == "--threads=") {
+			threads = atoi(args[i].substr(10).c_str());
+		} else if(args[i].substr(0, 8) == "--plies=") {
+			plies = atoi(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 12) == "--min-games=") {
+			filter.mingames = atoi(args[i].substr(12).c_str());
+		} else if(args[i].substr(0, 12) == "--min-score=") {
+			filter.minscore = atoi(args[i].substr(12).c_str());
+		} else if(args[i] == "--only-white") {
+			filter.black = false;
+		} else if(args[i] == "--only-black") {
+			filter.white = false;
+		} else if(args[i][0] == '-') {
+			printUsage();
+		} else {
+			commands.push_back(args[i]);
+		}
+	}
+	if(plies > 0) {
+		filter.plies = plies;
+	}
+	JobSystem::setThreadCount(threads);
+	Board::init();
+
+	int result;
+	if(commands.size() == 3 && commands[0] == "import") {
+		result = importGames(commands[1], commands[2]);
+	} else if(commands.size() == 3 && commands[0] == "export") {
+		result = exportGames(commands[1], commands[2]);
+	} else if(commands.size() == 2 && commands[0] == "info") {
+		result = printInfo(commands[1]);
+	} else if(commands.size() == 2 && commands[0] == "replay") {
+		result = replayGames(commands[1]);
+	} else if(commands.size() == 3 && commands[0] == "index") {
+		result = indexPositions(commands[1], commands[2], plies);
+	} else if((commands.size() == 2 || commands.size() == 3) && commands[0] == "find") {
+		result = findPosition(commands[1], commands.size() == 3 ? commands[2] : "");
+	} else if(commands.size() == 3 && commands[0] == "book") {
+		result = buildBook(commands[1], commands[2], filter);
+	} else if((commands.size() == 2 || commands.size() == 3) && commands[0] == "probe") {
+		result = probeBook(commands[1], commands.size() == 3 ? commands[2] : "");
+	} else {
+		printUsage();
+	}
+
+	JobSystem::destroy();
+	Logger::destroy();
+	return result;
+}
+
+// End of file dbrunner.cpp
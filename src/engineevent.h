@@ -0,0 +1,51 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : engineevent.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef ENGINEEVENT_H
+#define ENGINEEVENT_H
+
+#include "boardmove.h"
+#include "mpscqueue.h"
+#include "searchinfo.h"
+
+class ChessPlayer;
+
+/**
+ * Something that happened on a worker thread and that the game loop has
+ * to know about. Events travel through an EngineEventQueue, which the
+ * game loop drains once per frame or tick.
+ */
+struct EngineEvent {
+	enum Type {
+		NONE,
+		/** A player found its move */
+		MOVE,
+		/** A thinking player reported progress, may be dropped */
+		ANALYSIS,
+		/** Assets finished loading */
+		LOADED
+	};
+
+	EngineEvent() :
+		type(NONE),
+		player(0),
+		game(0) {}
+
+	Type type;
+	ChessPlayer * player;
+	/** Number of the game the event belongs to */
+	int game;
+	BoardMove move;
+	SearchInfo info;
+};
+
+typedef MpscQueue<EngineEvent> EngineEventQueue;
+
+#endif // ENGINEEVENT_H
+
+// End of file engineevent.h
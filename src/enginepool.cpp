@@ -0,0 +1,442 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : enginepool.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+#ifndef WIN32
+
+#include "enginepool.h"
+#include "engineprocess.h"
+#include "logger.h"
+
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+// How long an engine gets to start up and to answer a ping
+static const int HANDSHAKE_TIMEOUT = 10000;
+static const int PING_TIMEOUT = 5000;
+
+atomic<EnginePool*> EnginePool::m_instance(0);
+mutex EnginePool::m_instance_mutex;
+
+EnginePool * EnginePool::getInstance()
+{
+	EnginePool * instance = m_instance.load(memory_order_acquire);
+	if(instance) {
+		return instance;
+	}
+
+	lock_guard<mutex> lock(m_instance_mutex);
+	instance = m_instance.load(memory_order_relaxed);
+	if(!instance) {
+		instance = new EnginePool();
+		m_instance.store(instance, memory_order_release);
+	}
+	return instance;
+}
+
+void EnginePool::destroy()
+{
+	lock_guard<mutex> lock(m_instance_mutex);
+	delete m_instance.load(memory_order_relaxed);
+	m_instance.store(0, memory_order_release);
+}
+
+EnginePool::EnginePool() :
+	m_stop(false),
+	m_wanted(false),
+	m_check_interval(5000)
+{
+	m_thread = thread(&EnginePool::maintenanceLoop, this);
+}
+
+EnginePool::~EnginePool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+	m_thread.join();
+
+	map<string, deque<Engine*> >::iterator it;
+	for(it = m_idle.begin(); it != m_idle.end(); ++it) {
+		for(int i = 0; i < (int)it->second.size(); i++) {
+			discard(it->second[i]);
+		}
+	}
+	for(int i = 0; i < (int)m_returned.size(); i++) {
+		discard(m_returned[i]);
+	}
+
+	// Leased engines are still in use by their players, they exit on
+	// their own once our end of the pipes is closed at exit.
+}
+
+void EnginePool::prespawn(const string & command, Protocol protocol, int count,
+	int niceness)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		Target & target = m_targets[command];
+		target.protocol = protocol;
+		target.count = count;
+		target.niceness = niceness;
+		m_wanted = true;
+	}
+	m_cond.notify_all();
+}
+
+EngineProcess * EnginePool::lease(const string & command, Protocol protocol,
+	int niceness)
+{
+	while(true) {
+		Engine * engine = 0;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			deque<Engine*> & idle = m_idle[command];
+			if(idle.empty()) {
+				break;
+			}
+			engine = idle.front();
+			idle.pop_front();
+		}
+
+		// An engine that died while idle is simply replaced
+		if(engine->process->isRunning()) {
+			lock_guard<mutex> lock(m_mutex);
+			m_leased[engine->process] = engine;
+			m_wanted = true;
+			m_cond.notify_all();
+			return engine->process;
+		}
+		discard(engine);
+	}
+
+	Engine * engine = spawn(command, protocol, niceness);
+	if(!engine) {
+		return 0;
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	m_leased[engine->process] = engine;
+	// Let the maintenance thread start a replacement if one is wanted
+	m_wanted = true;
+	m_cond.notify_all();
+	return engine->process;
+}
+
+void EnginePool::release(EngineProcess * process)
+{
+	if(!process) {
+		return;
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	map<EngineProcess*, Engine*>::iterator it = m_leased.find(process);
+	if(it == m_leased.end()) {
+		return;
+	}
+	m_returned.push_back(it->second);
+	m_leased.erase(it);
+	m_cond.notify_all();
+}
+
+string EnginePool::getName(EngineProcess * process) const
+{
+	lock_guard<mutex> lock(m_mutex);
+	map<EngineProcess*, Engine*>::const_iterator it = m_leased.find(process);
+	if(it == m_leased.end()) {
+		return "";
+	}
+	return it->second->name;
+}
+
+int EnginePool::idleCount(const string & command) const
+{
+	lock_guard<mutex> lock(m_mutex);
+	map<string, deque<Engine*> >::const_iterator it = m_idle.find(command);
+	return (it == m_idle.end()) ? 0 : (int)it->second.size();
+}
+
+EnginePool::Engine * EnginePool::spawn(const string & command, Protocol protocol,
+	int niceness)
+{
+	Engine * engine = new Engine;
+	engine->process = new EngineProcess(command, niceness);
+	engine->command = command;
+	engine->protocol = protocol;
+	engine->ping = false;
+	engine->niceness = niceness;
+	engine->pings = 0;
+
+	if(!engine->process->start() || !handshake(engine)) {
+		LOG_ERROR("engine", "Couldn't start " << command);
+		discard(engine);
+		return 0;
+	}
+	return engine;
+}
+
+bool EnginePool::handshake(Engine * engine)
+{
+	EngineProcess * process = engine->process;
+	string line;
+
+	if(engine->protocol == UCI) {
+		process->writeLine("uci");
+		chrono::steady_clock::time_point end =
+			chrono::steady_clock::now() + chrono::milliseconds(HANDSHAKE_TIMEOUT);
+		while(true) {
+			int left = (int)chrono::duration_cast<chrono::milliseconds>(
+				end - chrono::steady_clock::now()).count();
+			if(left <= 0 || !process->readLine(line, left)) {
+				return false;
+			}
+			if(line.substr(0, 8) == "id name ") {
+				engine->name = line.substr(8);
+			} else if(line.substr(0, 5) == "uciok") {
+				break;
+			}
+		}
+		return isHealthy(engine);
+	}
+
+	// Protocol version 2 engines list their features, version 1 engines
+	// stay silent and are only checked for being alive.
+	process->writeLine("xboard");
+	process->writeLine("protover 2");
+	int timeout = 2000;
+	while(process->readLine(line, timeout)) {
+		if(line.substr(0, 8) != "feature ") {
+			continue;
+		}
+		if(line.find("ping=1") != string::npos) {
+			engine->ping = true;
+		}
+		string::size_type pos = line.find("myname=\"");
+		if(pos != string::npos) {
+			string::size_type end = line.find('"', pos + 8);
+			engine->name = line.substr(pos + 8, end - pos - 8);
+		}
+		if(line.find("done=0") != string::npos) {
+			timeout = HANDSHAKE_TIMEOUT;
+		} else if(line.find("done=1") != string::npos) {
+			break;
+		}
+	}
+	return isHealthy(engine);
+}
+
+bool EnginePool::reset(Engine * engine)
+{
+	EngineProcess * process = engine->process;
+	if(!process->isRunning()) {
+		return false;
+	}
+
+	if(engine->protocol == UCI) {
+		// The previous player may have left a search running
+		process->writeLine("stop");
+		process->writeLine("ucinewgame");
+	} else {
+		process->writeLine("new");
+	}
+	return isHealthy(engine);
+}
+
+bool EnginePool::isHealthy(Engine * engine)
+{
+	EngineProcess * process = engine->process;
+	if(!process->isRunning()) {
+		return false;
+	}
+
+	if(engine->protocol == UCI) {
+		process->writeLine("isready");
+		return waitFor(engine, "readyok", PING_TIMEOUT);
+	}
+
+	if(engine->ping) {
+		stringstream ss;
+		ss << ++engine->pings;
+		process->writeLine("ping " + ss.str());
+		return waitFor(engine, "pong " + ss.str(), PING_TIMEOUT);
+	}
+
+	// Without ping all we can do is throw away stale output
+	string line;
+	while(process->readLine(line, 50)) {
+	}
+	return !process->atEof() && process->isRunning();
+}
+
+bool EnginePool::waitFor(Engine * engine, const string & prefix, int timeout)
+{
+	// Skips over whatever the engine still had to say, like the
+	// 'bestmove' of a search that was stopped
+	chrono::steady_clock::time_point end =
+		chrono::steady_clock::now() + chrono::milliseconds(timeout);
+	string line;
+	while(true) {
+		int left = (int)chrono::duration_cast<chrono::milliseconds>(
+			end - chrono::steady_clock::now()).count();
+		if(left <= 0 || !engine->process->readLine(line, left)) {
+			return false;
+		}
+		if(line.substr(0, prefix.size()) == prefix) {
+			return true;
+		}
+	}
+}
+
+void EnginePool::discard(Engine * engine)
+{
+	if(engine->process->isRunning()) {
+		engine->process->writeLine("quit");
+	}
+	engine->process->terminate();
+	delete engine->process;
+	delete engine;
+}
+
+bool EnginePool::isSurplus(const string & command) const
+{
+	// Replacements were started while the engine was leased, don't let
+	// the pool grow past what was asked for
+	lock_guard<mutex> lock(m_mutex);
+	map<string, Target>::const_iterator target = m_targets.find(command);
+	if(target == m_targets.end()) {
+		return false;
+	}
+	map<string, deque<Engine*> >::const_iterator idle = m_idle.find(command);
+	int count = (idle == m_idle.end()) ? 0 : (int)idle->second.size();
+	return count + target->second.starting >= target->second.count;
+}
+
+void EnginePool::maintenanceLoop()
+{
+	chrono::steady_clock::time_point nextcheck =
+		chrono::steady_clock::now() + chrono::milliseconds(m_check_interval);
+
+	while(true) {
+		vector<Engine*> returned;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_cond.wait_until(lock, nextcheck, [this] {
+				return m_stop || m_wanted || !m_returned.empty();
+			});
+			if(m_stop) {
+				return;
+			}
+			m_wanted = false;
+			returned.assign(m_returned.begin(), m_returned.end());
+			m_returned.clear();
+		}
+
+		// Reset the engines players gave back, outside the lock since it
+		// means waiting on the engines
+		for(int i = 0; i < (int)returned.size(); i++) {
+			if(reset(returned[i]) && !isSurplus(returned[i]->command)) {
+				lock_guard<mutex> lock(m_mutex);
+				m_idle[returned[i]->command].push_back(returned[i]);
+			} else {
+				discard(returned[i]);
+			}
+		}
+
+		if(chrono::steady_clock::now() >= nextcheck) {
+			checkIdle();
+			nextcheck = chrono::steady_clock::now() +
+				chrono::milliseconds(m_check_interval);
+		}
+		topUp();
+	}
+}
+
+void EnginePool::checkIdle()
+{
+	map<string, int> counts;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		map<string, deque<Engine*> >::iterator it;
+		for(it = m_idle.begin(); it != m_idle.end(); ++it) {
+			counts[it->first] = (int)it->second.size();
+		}
+	}
+
+	// Only the engine being pinged is taken out, the others can still be
+	// leased meanwhile. It goes back behind them, so each is checked once.
+	map<string, int>::iterator it;
+	for(it = counts.begin(); it != counts.end(); ++it) {
+		for(int i = 0; i < it->second; i++) {
+			Engine * engine = 0;
+			{
+				lock_guard<mutex> lock(m_mutex);
+				deque<Engine*> & idle = m_idle[it->first];
+				if(idle.empty()) {
+					break;
+				}
+				engine = idle.front();
+				idle.pop_front();
+			}
+
+			if(isHealthy(engine)) {
+				lock_guard<mutex> lock(m_mutex);
+				m_idle[it->first].push_back(engine);
+			} else {
+				LOG_WARNING("engine", "Replacing unresponsive engine " << it->first);
+				discard(engine);
+			}
+		}
+	}
+}
+
+void EnginePool::topUp()
+{
+	// The engines still starting are counted under the lock, so that no
+	// two top ups start engines for the same gap
+	vector<pair<string, Target> > missing;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		map<string, Target>::iterator it;
+		for(it = m_targets.begin(); it != m_targets.end(); ++it) {
+			Target & target = it->second;
+			int count = target.count - (int)m_idle[it->first].size() - target.starting;
+			for(int i = 0; i < count; i++) {
+				missing.push_back(make_pair(it->first, target));
+			}
+			if(count > 0) {
+				target.starting += count;
+			}
+		}
+	}
+
+	// Engines are started side by side, most of the startup time is
+	// spent waiting for them to allocate their tables
+	vector<thread> starters;
+	for(int i = 0; i < (int)missing.size(); i++) {
+		string command = missing[i].first;
+		Target target = missing[i].second;
+		starters.push_back(thread([this, command, target] {
+			Engine * engine = spawn(command, target.protocol, target.niceness);
+			lock_guard<mutex> lock(m_mutex);
+			m_targets[command].starting--;
+			if(engine) {
+				m_idle[command].push_back(engine);
+			}
+		}));
+	}
+	for(int i = 0; i < (int)starters.size(); i++) {
+		starters[i].join();
+	}
+}
+
+#endif
+
+// End of file enginepool.cpp
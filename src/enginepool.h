@@ -0,0 +1,137 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : enginepool.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#ifndef WIN32
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class EngineProcess;
+
+/**
+ * Keeps external engine processes alive between games and players.
+ * Starting an engine and letting it allocate its hash tables is by far
+ * the slowest part of a short game, so players lease an engine that has
+ * already been started, and hand it back when they are deleted. Returned
+ * engines are reset ('new' or 'ucinewgame') and idle engines are health
+ * checked on a background thread, dead ones are replaced.
+ *
+ * Engines are pooled by their command line.
+ */
+class EnginePool {
+ public:
+	/** The protocol spoken by an engine, decides how it is reset. */
+	enum Protocol { UCI, XBOARD };
+
+	/** Gets the instance of the EnginePool, Singleton pattern. */
+	static EnginePool * getInstance();
+
+	/** Quits all engines and deletes the pool, if it was ever created. */
+	static void destroy();
+
+	/**
+	 * Has engines started so that at least count of them sit idle for the
+	 * command. Returns at once, the engines are started on the pool's
+	 * thread. The pool keeps topping up to that number when engines die
+	 * or are leased.
+	 * @param command - The engine command line.
+	 * @param protocol - The protocol the engine speaks.
+	 * @param count - How many idle engines to keep around.
+	 * @param niceness - Scheduling priority adjustment for the engine.
+	 */
+	void prespawn(const std::string & command, Protocol protocol, int count,
+		int niceness = 0);
+
+	/**
+	 * Hands out an engine which has finished its handshake and is in its
+	 * initial state. An idle engine is used if there is one, otherwise a
+	 * new one is started. Returns 0 if the engine could not be started.
+	 */
+	EngineProcess * lease(const std::string & command, Protocol protocol,
+		int niceness = 0);
+
+	/**
+	 * Gives a leased engine back. The caller must not be reading from it
+	 * anymore. The engine is reset in the background and reused.
+	 */
+	void release(EngineProcess * engine);
+
+	/** Returns the name the engine reported during its handshake. */
+	std::string getName(EngineProcess * engine) const;
+
+	/** Returns the number of idle engines for the command. */
+	int idleCount(const std::string & command) const;
+
+	/** Sets how often idle engines are checked, in milliseconds. */
+	void setCheckInterval(int interval)
+		{ m_check_interval = interval; }
+
+ private:
+	struct Engine {
+		EngineProcess * process;
+		std::string command;
+		Protocol protocol;
+		std::string name;
+		bool ping;
+		int niceness;
+		int pings;
+	};
+
+	struct Target {
+		Protocol protocol;
+		int count;
+		int niceness;
+		// Engines being started for the target right now
+		int starting;
+	};
+
+	static std::atomic<EnginePool*> m_instance;
+	static std::mutex m_instance_mutex;
+
+	EnginePool();
+	~EnginePool();
+
+	Engine * spawn(const std::string & command, Protocol protocol, int niceness);
+	bool handshake(Engine * engine);
+	bool reset(Engine * engine);
+	bool isHealthy(Engine * engine);
+	bool waitFor(Engine * engine, const std::string & prefix, int timeout);
+	void discard(Engine * engine);
+	bool isSurplus(const std::string & command) const;
+
+	void maintenanceLoop();
+	void checkIdle();
+	void topUp();
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::thread m_thread;
+	bool m_stop;
+	// Set when the idle engines may have to be topped up
+	bool m_wanted;
+	int m_check_interval;
+
+	std::map<std::string, std::deque<Engine*> > m_idle;
+	std::map<std::string, Target> m_targets;
+	std::map<EngineProcess*, Engine*> m_leased;
+	std::deque<Engine*> m_returned;
+};
+
+#endif // #ifndef WIN32
+
+#endif // ENGINEPOOL_H
+
+// End of file enginepool.h
@@ -0,0 +1,257 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : engineprocess.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+#ifndef WIN32
+
+#include "engineprocess.h"
+
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+EngineProcess::EngineProcess(const string & command, int niceness) :
+	m_command(command),
+	m_pid(-1),
+	m_niceness(niceness),
+	m_to(-1),
+	m_from(-1),
+	m_eof(false)
+{
+}
+
+EngineProcess::~EngineProcess()
+{
+	terminate();
+}
+
+bool EngineProcess::start()
+{
+	if(m_pid > 0) {
+		return true;
+	}
+
+	// Split the command line into the arguments for execvp
+	vector<string> args;
+	stringstream ss(m_command);
+	string arg;
+	while(ss >> arg) {
+		args.push_back(arg);
+	}
+	if(args.empty()) {
+		return false;
+	}
+
+	// Only async-signal-safe calls are allowed in the child of a threaded
+	// process, so everything it needs is set up here
+	vector<char*> argv;
+	for(int i = 0; i < (int)args.size(); i++) {
+		argv.push_back(const_cast<char*>(args[i].c_str()));
+	}
+	argv.push_back(NULL);
+	string error = "Couldn't run " + m_command + "\n";
+
+	int to[2], from[2];
+	if(pipe(to) < 0) {
+		return false;
+	}
+	if(pipe(from) < 0) {
+		close(to[0]);
+		close(to[1]);
+		return false;
+	}
+
+	m_pid = fork();
+	if(m_pid < 0) {
+		close(to[0]);
+		close(to[1]);
+		close(from[0]);
+		close(from[1]);
+		return false;
+	}
+
+	if(m_pid == 0) {
+		// Child Process
+		if(m_niceness) {
+			nice(m_niceness);
+		}
+		dup2(to[0], 0);
+		dup2(from[1], 1);
+		close(to[0]);
+		close(to[1]);
+		close(from[0]);
+		close(from[1]);
+
+		execvp(argv[0], &argv[0]);
+		ssize_t written = write(2, error.c_str(), error.size());
+		(void)written;
+		_exit(127);
+	}
+
+	close(to[0]);
+	close(from[1]);
+	m_to = to[1];
+	m_from = from[0];
+	fcntl(m_to, F_SETFD, FD_CLOEXEC);
+	fcntl(m_from, F_SETFD, FD_CLOEXEC);
+	m_buffer.clear();
+	m_eof = false;
+	return true;
+}
+
+bool EngineProcess::isRunning()
+{
+	if(m_pid <= 0) {
+		return false;
+	}
+	int status;
+	if(waitpid(m_pid, &status, WNOHANG) == m_pid) {
+		m_pid = -1;
+		return false;
+	}
+	return true;
+}
+
+bool EngineProcess::writeLine(const string & line)
+{
+	if(m_to < 0) {
+		return false;
+	}
+
+	// A dead engine must not take us down with it when we write to it.
+	// SIGPIPE is blocked for this thread only, one raised by the write is
+	// taken off again before the old mask comes back.
+	sigset_t pipeset, oldset;
+	sigemptyset(&pipeset);
+	sigaddset(&pipeset, SIGPIPE);
+	sigset_t pending;
+	sigpending(&pending);
+	bool waspending = sigismember(&pending, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipeset, &oldset);
+
+	string data = line + '\n';
+	const char * p = data.c_str();
+	size_t left = data.size();
+	bool ok = true;
+	while(left > 0) {
+		ssize_t n = write(m_to, p, left);
+		if(n < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			ok = false;
+			break;
+		}
+		p += n;
+		left -= n;
+	}
+
+	if(!ok && errno == EPIPE && !waspending) {
+		timespec zero = { 0, 0 };
+		while(sigtimedwait(&pipeset, 0, &zero) < 0 && errno == EINTR) {
+		}
+		errno = EPIPE;
+	}
+	pthread_sigmask(SIG_SETMASK, &oldset, 0);
+	return ok;
+}
+
+bool EngineProcess::readLine(string & line, int timeout)
+{
+	while(true) {
+		// Hand out a complete line if we already have one buffered
+		string::size_type nl = m_buffer.find('\n');
+		if(nl != string::npos) {
+			line = m_buffer.substr(0, nl);
+			m_buffer.erase(0, nl + 1);
+			if(!line.empty() && line[line.size()-1] == '\r') {
+				line.erase(line.size()-1);
+			}
+			return true;
+		}
+
+		if(m_from < 0 || m_eof) {
+			return false;
+		}
+
+		if(timeout >= 0) {
+			pollfd pfd;
+			pfd.fd = m_from;
+			pfd.events = POLLIN;
+			int ready = poll(&pfd, 1, timeout);
+			if(ready < 0 && errno == EINTR) {
+				continue;
+			}
+			if(ready <= 0) {
+				return false;
+			}
+		}
+
+		char chunk[4096];
+		ssize_t n = read(m_from, chunk, sizeof(chunk));
+		if(n < 0 && errno == EINTR) {
+			continue;
+		}
+		if(n <= 0) {
+			m_eof = true;
+			return false;
+		}
+		m_buffer.append(chunk, n);
+	}
+}
+
+void EngineProcess::terminate()
+{
+	// Closing stdin makes most engines exit, give them a moment to do so
+	if(m_to >= 0) {
+		close(m_to);
+		m_to = -1;
+	}
+
+	if(m_pid > 0) {
+		int status;
+		int i = 0;
+		for(; i < 20; i++) {
+			if(waitpid(m_pid, &status, WNOHANG) == m_pid) {
+				break;
+			}
+			usleep(10000);
+		}
+		if(i == 20) {
+			kill(m_pid, SIGKILL);
+			waitpid(m_pid, &status, 0);
+		}
+		m_pid = -1;
+	}
+
+	closePipes();
+}
+
+void EngineProcess::closePipes()
+{
+	if(m_to >= 0) {
+		close(m_to);
+		m_to = -1;
+	}
+	if(m_from >= 0) {
+		close(m_from);
+		m_from = -1;
+	}
+}
+
+#endif
+
+// End of file engineprocess.cpp
@@ -0,0 +1,94 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : engineprocess.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef ENGINEPROCESS_H
+#define ENGINEPROCESS_H
+
+#ifndef WIN32
+
+#include <string>
+#include <sys/types.h>
+
+/**
+ * An external chess engine running as a child process. The engine's
+ * standard input and output are connected to pipes so that commands can
+ * be written and replies read one line at a time.
+ */
+class EngineProcess {
+ public:
+	/**
+	 * Creates an engine that will be started with the given command line.
+	 * The command is split on whitespace and looked up in the PATH.
+	 * @param command - The engine binary followed by its arguments.
+	 * @param niceness - Added to the engine's nice value so it does not
+	 *                   starve the user interface.
+	 */
+	EngineProcess(const std::string & command, int niceness = 0);
+
+	/** Kills the engine if it is still running. */
+	~EngineProcess();
+
+	/** Forks and executes the engine. Returns false if that failed. */
+	bool start();
+
+	/** Returns true if the engine process is still alive. */
+	bool isRunning();
+
+	/**
+	 * Sends one line to the engine, the newline is appended.
+	 * Returns false if the engine is gone.
+	 */
+	bool writeLine(const std::string & line);
+
+	/**
+	 * Reads one line of engine output without the trailing newline.
+	 * @param line - Receives the line that was read.
+	 * @param timeout - Milliseconds to wait, a negative value blocks.
+	 * @return false on timeout or when the engine closed its output.
+	 */
+	bool readLine(std::string & line, int timeout = -1);
+
+	/** Returns true once the engine has closed its output. */
+	bool atEof() const
+		{ return m_eof; }
+
+	/**
+	 * Stops the engine. It gets a short grace period to exit on its
+	 * own (after a 'quit' for instance) before it is killed. Nobody may
+	 * be blocked in readLine() when this is called.
+	 */
+	void terminate();
+
+	/** Returns the command line the engine was started with. */
+	const std::string & command() const
+		{ return m_command; }
+
+	pid_t pid() const
+		{ return m_pid; }
+
+ private:
+	// Not copyable, the pipes belong to exactly one object
+	EngineProcess(const EngineProcess &);
+	EngineProcess & operator=(const EngineProcess &);
+
+	void closePipes();
+
+	std::string m_command;
+	std::string m_buffer;
+	pid_t m_pid;
+	int m_niceness;
+	int m_to;
+	int m_from;
+	bool m_eof;
+};
+
+#endif // #ifndef WIN32
+
+#endif // ENGINEPROCESS_H
+
+// End of file engineprocess.h
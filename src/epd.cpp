@@ -0,0 +1,360 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : epd.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "epd.h"
+#include "board.h"
+#include "chessgamestate.h"
+#include "chessplayer.h"
+#include "jobsystem.h"
+#include "matesolver.h"
+#include "notation.h"
+#include "options.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+bool parseEpd(const string & line, EpdPosition & pos)
+{
+	pos = EpdPosition();
+
+	// The position is the first four fields of a FEN
+	stringstream ss(line);
+	string field;
+	for(int i = 0; i < 4; i++) {
+		if(!(ss >> field)) {
+			return false;
+		}
+		pos.fen += (i ? " " : "") + field;
+	}
+
+	// Some files give the move counters of a full FEN as well
+	string rest;
+	getline(ss, rest);
+	stringstream counters(rest);
+	int halfmove, fullmove;
+	if(counters >> halfmove >> fullmove) {
+		stringstream ws;
+		ws << ' ' << halfmove << ' ' << fullmove;
+		pos.fen += ws.str();
+		getline(counters, rest);
+	}
+
+	// Then operations, each an opcode with operands and a ';'. Quoted
+	// operands may hold spaces and semicolons.
+	vector<string> tokens;
+	string token;
+	bool quoted = false;
+	for(int i = 0; i <= (int)rest.size(); i++) {
+		char c = (i < (int)rest.size()) ? rest[i] : ';';
+		if(c == '"') {
+			quoted = !quoted;
+		} else if(quoted) {
+			token += c;
+		} else if(c == ' ' || c == '\t' || c == '\r' || c == ';') {
+			if(!token.empty()) {
+				tokens.push_back(token);
+				token.clear();
+			}
+			if(c == ';' && !tokens.empty()) {
+				vector<string> operands(tokens.begin() + 1, tokens.end());
+				if(tokens[0] == "bm") {
+					pos.bm = operands;
+				} else if(tokens[0] == "am") {
+					pos.am = operands;
+				} else if(tokens[0] == "dm" && !operands.empty()) {
+					pos.dm = atoi(operands[0].c_str());
+				} else if(tokens[0] == "id" && !operands.empty()) {
+					pos.id = operands[0];
+				}
+				tokens.clear();
+			}
+		} else {
+			token += c;
+		}
+	}
+	return !quoted;
+}
+
+EpdRunner::EpdRunner() :
+	m_threads(0),
+	m_mate_moves(0),
+	m_next(0)
+{
+	m_limits.movetime = 1000;
+}
+
+bool EpdRunner::load(const string & filename)
+{
+	ifstream file(filename.c_str());
+	if(!file.is_open()) {
+		return false;
+	}
+
+	vector<EpdPosition> positions;
+	string line;
+	while(getline(file, line)) {
+		if(line.find_first_not_of(" \t\r") == string::npos || line[0] == '#') {
+			continue;
+		}
+		EpdPosition pos;
+		if(!parseEpd(line, pos)) {
+			return false;
+		}
+		if(pos.id.empty()) {
+			stringstream id;
+			id << "#" << positions.size() + 1;
+			pos.id = id.str();
+		}
+		positions.push_back(pos);
+	}
+	m_positions = positions;
+	return true;
+}
+
+void EpdRunner::run(ostream & out)
+{
+	// The static tables have to be set up before any thread uses them
+	Board::init();
+	Board board;
+	Options::getInstance();
+
+	m_results.assign(m_positions.size(), EpdResult());
+	m_next = 0;
+
+	int threads = m_threads;
+	if(threads <= 0) {
+		threads = thread::hardware_concurrency();
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+	if(threads > (int)m_positions.size()) {
+		threads = (int)m_positions.size();
+	}
+
+	out << "Solving " << m_positions.size() << " positions on "
+		<< threads << " threads" << endl;
+
+	JobSystem::setThreadCount(threads);
+	JobSystem * jobs = JobSystem::getInstance();
+	vector<JobHandle<void> > workers;
+	for(int i = 0; i < threads; i++) {
+		workers.push_back(jobs->submit(JobSystem::ANALYSIS, [this, &out]() { worker(out); }));
+	}
+	for(int i = 0; i < threads; i++) {
+		workers[i].wait();
+	}
+
+	printSummary(out);
+}
+
+int EpdRunner::getSolved() const
+{
+	int solved = 0;
+	for(int i = 0; i < (int)m_results.size(); i++) {
+		if(m_results[i].solved) {
+			solved++;
+		}
+	}
+	return solved;
+}
+
+void EpdRunner::worker(ostream & out)
+{
+	int index;
+	while((index = m_next++) < (int)m_positions.size()) {
+		solve(index, out);
+	}
+}
+
+void EpdRunner::solve(int index, ostream & out)
+{
+	const EpdPosition & pos = m_positions[index];
+	EpdResult result;
+
+	ChessGameState state;
+	if(!state.loadFEN(pos.fen)) {
+		lock_guard<mutex> lock(m_mutex);
+		out << pos.id << ": bad position " << pos.fen << endl;
+		return;
+	}
+
+	// Compare moves in coordinate notation, SAN depends on the position
+	vector<string> bm, am;
+	bool bad = pos.bm.empty() && pos.am.empty() && !m_mate_moves;
+	for(int i = 0; i < (int)pos.bm.size(); i++) {
+		BoardMove move = sanToMove(state, pos.bm[i]);
+		bad = bad || !move.isValid();
+		bm.push_back(moveToCoordinate(move));
+	}
+	for(int i = 0; i < (int)pos.am.size(); i++) {
+		BoardMove move = sanToMove(state, pos.am[i]);
+		bad = bad || !move.isValid();
+		am.push_back(moveToCoordinate(move));
+	}
+	if(bad) {
+		lock_guard<mutex> lock(m_mutex);
+		out << pos.id << ": no legal bm or am move" << endl;
+		return;
+	}
+
+	if(m_mate_moves) {
+		solveMate(pos, state, am, result);
+	} else {
+		solvePlayer(state, bm, am, result);
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	m_results[index] = result;
+	out << pos.id << ":";
+	if(!result.move.empty()) {
+		out << " " << result.move;
+	}
+	if(result.solved) {
+		out << " solved in " << result.time << " ms, " << result.nodes << " nodes, ";
+		if(result.mate) {
+			out << "mate in " << result.mate << ": " << result.line << endl;
+		} else {
+			out << "depth " << result.depth << endl;
+		}
+	} else {
+		out << " not solved, expected";
+		for(int i = 0; i < (int)pos.bm.size(); i++) {
+			out << " " << pos.bm[i];
+		}
+		for(int i = 0; i < (int)pos.am.size(); i++) {
+			out << " not " << pos.am[i];
+		}
+		if(m_mate_moves) {
+			out << " mate in " << (pos.dm ? pos.dm : m_mate_moves);
+		}
+		out << endl;
+	}
+}
+
+void EpdRunner::solvePlayer(const ChessGameState & state, const vector<string> & bm,
+	const vector<string> & am, EpdResult & result)
+{
+	// Remembers where the current run of correct iterations started
+	bool correct = false;
+	SearchInfo found;
+	BrutalPlayer player;
+	player.setIsWhite(state.isWhiteTurn());
+	player.setLimits(m_limits);
+	player.setInfoCallback([&](const SearchInfo & info) {
+		string move = info.pv.substr(0, info.pv.find(' '));
+		bool right = (bm.empty() || find(bm.begin(), bm.end(), move) != bm.end()) &&
+			find(am.begin(), am.end(), move) == am.end();
+		if(right && !correct) {
+			found = info;
+		}
+		correct = right;
+	});
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	player.think(state);
+	long long elapsed = chrono::duration_cast<chrono::milliseconds>(
+		chrono::steady_clock::now() - start).count();
+
+	string played = moveToCoordinate(player.getMove());
+	result.move = moveToSAN(state, player.getMove());
+	result.solved = (bm.empty() || find(bm.begin(), bm.end(), played) != bm.end()) &&
+		find(am.begin(), am.end(), played) == am.end();
+	if(result.solved) {
+		if(correct) {
+			result.time = found.time;
+			result.nodes = found.nodes;
+			result.depth = found.depth;
+		} else {
+			// Only an interrupted first iteration came up with it
+			result.time = elapsed;
+			result.nodes = player.getNodes();
+		}
+	}
+}
+
+void EpdRunner::solveMate(const EpdPosition & pos, const ChessGameState & state,
+	const vector<string> & am, EpdResult & result)
+{
+	// The mate has to start with a best move, if there are any
+	vector<BoardMove> first;
+	for(int i = 0; i < (int)pos.bm.size(); i++) {
+		first.push_back(sanToMove(state, pos.bm[i]));
+	}
+
+	MateSolver solver;
+	solver.setLimits(m_limits);
+	MateResult mate = solver.solve(state.getBoard(), state.getTurn(),
+		pos.dm ? pos.dm : m_mate_moves, first);
+	result.time = mate.time;
+	result.nodes = mate.nodes;
+	if(mate.status != MateResult::MATE || mate.pv.empty()) {
+		return;
+	}
+
+	string played = moveToCoordinate(mate.pv[0]);
+	result.move = moveToSAN(state, mate.pv[0]);
+	result.solved = find(am.begin(), am.end(), played) == am.end();
+	result.mate = mate.moves;
+
+	ChessGameState line = state;
+	for(int i = 0; i < (int)mate.pv.size(); i++) {
+		result.line += (i ? " " : "") + moveToSAN(line, mate.pv[i]);
+		line.update(mate.pv[i]);
+	}
+}
+
+void EpdRunner::printSummary(ostream & out) const
+{
+	vector<long long> times, nodes;
+	for(int i = 0; i < (int)m_results.size(); i++) {
+		if(m_results[i].solved) {
+			times.push_back(m_results[i].time);
+			nodes.push_back(m_results[i].nodes);
+		}
+	}
+	sort(times.begin(), times.end());
+	sort(nodes.begin(), nodes.end());
+
+	int total = (int)m_positions.size();
+	int solved = (int)times.size();
+	out << "===========================" << endl;
+	out << "Solved " << solved << "/" << total << " ("
+		<< fixed << setprecision(1) << (total ? 100.0 * solved / total : 0.0)
+		<< "%)" << endl;
+	if(!solved) {
+		return;
+	}
+
+	// How many were found within each time, counted up
+	static const long long BUCKETS[] = { 10, 100, 1000, 10000, 60000 };
+	out << "Solved within:" << endl;
+	for(int i = 0; i < (int)(sizeof(BUCKETS) / sizeof(BUCKETS[0])); i++) {
+		int count = (int)(upper_bound(times.begin(), times.end(), BUCKETS[i]) - times.begin());
+		out << "  " << setw(6) << BUCKETS[i] << " ms : " << setw(5) << count << endl;
+	}
+
+	long long time_sum = 0, node_sum = 0;
+	for(int i = 0; i < solved; i++) {
+		time_sum += times[i];
+		node_sum += nodes[i];
+	}
+	out << "Time to solution (ms)  : median " << times[solved / 2]
+		<< ", mean " << time_sum / solved << endl;
+	out << "Nodes to solution      : median " << nodes[solved / 2]
+		<< ", mean " << node_sum / solved << endl;
+}
+
+// End of file epd.cpp
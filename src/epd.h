@@ -0,0 +1,142 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : epd.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef EPD_H
+#define EPD_H
+
+#include "searchinfo.h"
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ChessGameState;
+
+/**
+ * One test position of an EPD suite. The best and avoid moves are kept
+ * in standard algebraic notation, as they appear in the file.
+ */
+struct EpdPosition {
+	EpdPosition() :
+		dm(0) {}
+
+	std::string fen;
+	std::vector<std::string> bm;
+	std::vector<std::string> am;
+	/** Moves to the direct mate, 0 if not given */
+	int dm;
+	std::string id;
+};
+
+/**
+ * Parses one EPD record: the first four FEN fields followed by
+ * operations like 'bm Qd1+; dm 3; id "WAC.001";'. Returns false if the
+ * line isn't a record.
+ */
+bool parseEpd(const std::string & line, EpdPosition & pos);
+
+/** How the player did on one position of the suite. */
+struct EpdResult {
+	EpdResult() :
+		solved(false),
+		time(0),
+		nodes(0),
+		depth(0),
+		mate(0) {}
+
+	bool solved;
+	/** The move played, in standard algebraic notation */
+	std::string move;
+	/** Milliseconds and nodes after which the move stayed correct */
+	long long time;
+	long long nodes;
+	int depth;
+	/** Moves to the mate found by the mate solver, and its line */
+	int mate;
+	std::string line;
+};
+
+/**
+ * Runs an EPD test suite with the BrutalPlayer, several positions at
+ * once. A position counts as solved when the move played is one of the
+ * best moves and none of the moves to avoid. Its solution time is the
+ * time of the iteration from which on every iteration found a correct
+ * move, so an engine that stumbles on the answer and drops it again
+ * only gets credit for finding it for good.
+ *
+ * Mate problems may be solved with the MateSolver instead. A position
+ * then counts as solved when a mate is proven within its dm moves,
+ * starting with one of the best moves if it has any.
+ */
+class EpdRunner {
+ public:
+	EpdRunner();
+
+	/** Sets how many positions are solved at once, every core by default. */
+	void setThreads(int threads)
+		{ m_threads = threads; }
+
+	/** Sets the search limits for every position, 1 second per move by default. */
+	void setLimits(const SearchLimits & limits)
+		{ m_limits = limits; }
+
+	/**
+	 * Solves with the MateSolver, looking for mates of up to moves moves
+	 * where a position gives no dm. 0, the default, uses the BrutalPlayer.
+	 */
+	void setMateSearch(int moves)
+		{ m_mate_moves = moves; }
+
+	/**
+	 * Reads the positions of a suite, one per line. Empty lines and lines
+	 * starting with '#' are skipped. Returns false if the file can't be
+	 * read or a record is broken.
+	 */
+	bool load(const std::string & filename);
+
+	void setPositions(const std::vector<EpdPosition> & positions)
+		{ m_positions = positions; }
+
+	/**
+	 * Solves every position and returns when all are done. A line is
+	 * printed to out for every position as it finishes, and a summary at
+	 * the end.
+	 */
+	void run(std::ostream & out = std::cout);
+
+	/** Returns the results, in the order of the positions. */
+	const std::vector<EpdResult> & getResults() const
+		{ return m_results; }
+
+	/** Returns the number of positions solved. */
+	int getSolved() const;
+
+ private:
+	void worker(std::ostream & out);
+	void solve(int index, std::ostream & out);
+	void solvePlayer(const ChessGameState & state, const std::vector<std::string> & bm,
+		const std::vector<std::string> & am, EpdResult & result);
+	void solveMate(const EpdPosition & pos, const ChessGameState & state,
+		const std::vector<std::string> & am, EpdResult & result);
+	void printSummary(std::ostream & out) const;
+
+	int m_threads;
+	SearchLimits m_limits;
+	int m_mate_moves;
+	std::vector<EpdPosition> m_positions;
+	std::vector<EpdResult> m_results;
+
+	std::atomic<int> m_next;
+	std::mutex m_mutex;
+};
+
+#endif // EPD_H
+
+// End of file epd.h
@@ -0,0 +1,103 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : epdrunner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "epd.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "searchinfo.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void printUsage()
+{
+	cerr << "Usage: chesspizza-epd [options] FILE\n\n";
+	cerr << "Solves the positions of an EPD test suite with the Brutal Chess\n";
+	cerr << "engine, on all cores, and reports how many it found and how fast.\n";
+	cerr << "A position is solved when the engine plays one of its bm moves and\n";
+	cerr << "none of its am moves.\n\n";
+	cerr << " -j N  --threads=N\t\t Positions solved at once, one per core by default.\n";
+	cerr << " --movetime=MS\t\t\t Time per position, 1000 by default.\n";
+	cerr << " --nodes=N\t\t\t Nodes per position instead.\n";
+	cerr << " --depth=N\t\t\t Search depth in plies instead.\n";
+	cerr << " --mate[=N]\t\t\t Prove mates with the mate solver instead, of the dm\n";
+	cerr << "           \t\t\t moves of each position or else N, 5 by default.\n";
+	cerr << LogOptions::usage();
+	cerr << " -h  --help\t\t\t Print this help screen.\n";
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+
+	string filename;
+	LogOptions logoptions;
+	int threads = 0, mate = 0;
+	SearchLimits limits;
+
+	for(int i = 0; i < (int)args.size(); i++) {
+		if(args[i] == "-h" || args[i] == "--help") {
+			printUsage();
+		} else if(args[i] == "-j" && i + 1 < (int)args.size()) {
+			threads = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 10) == "--threads=") {
+			threads = atoi(args[i].substr(10).c_str());
+		} else if(args[i] == "--mate") {
+			mate = 5;
+		} else if(args[i].substr(0, 7) == "--mate=") {
+			mate = atoi(args[i].substr(7).c_str());
+			if(mate <= 0) {
+				printUsage();
+			}
+		} else if(args[i].substr(0, 11) == "--movetime=") {
+			limits.movetime = atoi(args[i].substr(11).c_str());
+		} else if(args[i].substr(0, 8) == "--nodes=") {
+			limits.nodes = atoll(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 8) == "--depth=") {
+			limits.depth = atoi(args[i].substr(8).c_str());
+		} else if(logoptions.parse(args[i])) {
+			// --log or --log-level
+		} else if(args[i][0] == '-' || !filename.empty()) {
+			printUsage();
+		} else {
+			filename = args[i];
+		}
+	}
+
+	if(filename.empty()) {
+		printUsage();
+	}
+
+	if(!logoptions.apply()) {
+		return 1;
+	}
+
+	EpdRunner runner;
+	runner.setThreads(threads);
+	runner.setMateSearch(mate);
+	if(!limits.isEmpty()) {
+		runner.setLimits(limits);
+	}
+	if(!runner.load(filename)) {
+		cerr << "Couldn't read positions from " << filename << endl;
+		return 1;
+	}
+
+	runner.run();
+
+	JobSystem::destroy();
+	Logger::destroy();
+	return 0;
+}
+
+// End of file epdrunner.cpp
@@ -0,0 +1,79 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : evalparams.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+// The parameters of the BrutalPlayer evaluation, written by chesspizza-tune.
+// Hand-tuned values.
+
+#ifndef EVALPARAMS_H
+#define EVALPARAMS_H
+
+// Centipawns of each piece by Piece::Type, the king isn't tuned
+static const int EVAL_MATERIAL[5] = {
+	100, 500, 310, 325, 900 };
+
+// Square bonuses from white's point of view, a1 first, mirrored for black
+static const int EVAL_PAWN_SQUARES[64] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, -5, -5, 0, 0, 0,
+	1, 2, 3, 4, 4, 3, 2, 1,
+	2, 4, 6, 8, 8, 6, 4, 2,
+	3, 6, 9, 12, 12, 9, 6, 3,
+	4, 8, 12, 16, 16, 12, 8, 4,
+	5, 10, 15, 20, 20, 15, 10, 5,
+	0, 0, 0, 0, 0, 0, 0, 0 };
+
+static const int EVAL_KNIGHT_SQUARES[64] = {
+	-10, -5, -5, -5, -5, -5, -5, -10,
+	-5, 0, 0, 3, 3, 0, 0, -5,
+	-5, 0, 5, 5, 5, 5, 0, -5,
+	-5, 0, 5, 10, 10, 5, 0, -5,
+	-5, 0, 5, 10, 10, 5, 0, -5,
+	-5, 0, 5, 5, 5, 5, 0, -5,
+	-5, 0, 0, 3, 3, 0, 0, -5,
+	-10, -5, -5, -5, -5, -5, -5, -10 };
+
+static const int EVAL_BISHOP_SQUARES[64] = {
+	-5, -5, -5, -5, -5, -5, -5, -5,
+	-5, 10, 5, 10, 10, 5, 10, -5,
+	-5, 5, 3, 12, 12, 3, 5, -5,
+	-5, 3, 12, 3, 3, 12, 3, -5,
+	-5, 3, 12, 3, 3, 12, 3, -5,
+	-5, 5, 3, 12, 12, 3, 5, -5,
+	-5, 10, 5, 10, 10, 5, 10, -5,
+	-5, -5, -5, -5, -5, -5, -5, -5 };
+
+static const int EVAL_KING_SQUARES[64] = {
+	2, 10, 4, 0, 0, 7, 10, 2,
+	-3, -3, -5, -5, -5, -5, -3, -3,
+	-5, -5, -8, -8, -8, -8, -5, -5,
+	-8, -8, -13, -13, -13, -13, -8, -8,
+	-13, -13, -21, -21, -21, -21, -13, -13,
+	-21, -21, -34, -34, -34, -34, -21, -21,
+	-34, -34, -55, -55, -55, -55, -34, -34,
+	-55, -55, -89, -89, -89, -89, -55, -55 };
+
+static const int EVAL_ENDGAME_KING_SQUARES[64] = {
+	-5, -3, -1, 0, 0, -1, -3, -5,
+	-3, 5, 5, 5, 5, 5, 5, -3,
+	-1, 5, 10, 10, 10, 10, 5, -1,
+	0, 5, 10, 15, 15, 10, 5, 0,
+	0, 5, 10, 15, 15, 10, 5, 0,
+	-1, 5, 10, 10, 10, 10, 5, -1,
+	-3, 5, 5, 5, 5, 5, 5, -3,
+	-5, -3, -1, 0, 0, -1, -3, -5 };
+
+// Penalty of an isolated pawn on the a and h, b and g, c and f, d and e files
+static const int EVAL_ISOLATED_PAWN[4] = {
+	12, 14, 16, 20 };
+
+// Endgame penalty for every square between a queen and the enemy king
+static const int EVAL_QUEEN_DISTANCE = 2;
+
+#endif // EVALPARAMS_H
+
+// End of file evalparams.h
@@ -0,0 +1,614 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : evaltuner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "evaltuner.h"
+
+#include "chessgamestate.h"
+#include "chessplayer.h"
+#include "evalparams.h"
+#include "gamedb.h"
+#include "jobsystem.h"
+#include "notation.h"
+#include "packedposition.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+
+using namespace std;
+
+// Where each parameter of evalparams.h is kept
+enum {
+	MATERIAL = 0,
+	PAWN_SQUARES = MATERIAL + 5,
+	KNIGHT_SQUARES = PAWN_SQUARES + 64,
+	BISHOP_SQUARES = KNIGHT_SQUARES + 64,
+	KING_SQUARES = BISHOP_SQUARES + 64,
+	ENDGAME_KING_SQUARES = KING_SQUARES + 64,
+	ISOLATED_PAWN = ENDGAME_KING_SQUARES + 64,
+	QUEEN_DISTANCE = ISOLATED_PAWN + 4,
+	PARAMS = QUEEN_DISTANCE + 1
+};
+
+// Longest capture sequence followed to a quiet position
+static const int QUIESCE_DEPTH = 8;
+
+// Positions evaluated further from equal than this are decided already,
+// or mates, and tell nothing about the parameters
+static const int MAX_EVAL = 2000;
+
+// Material below which the BrutalPlayer evaluation is in the endgame
+static const int ENDGAME_MATERIAL = 3500;
+
+// Parts the positions are split into for the JobSystem, per worker
+static const int JOBS_PER_THREAD = 4;
+
+static const double ADAM_BETA1 = 0.9;
+static const double ADAM_BETA2 = 0.999;
+static const double ADAM_EPSILON = 1e-8;
+
+/**
+ * Gives the tuner the evaluation of the BrutalPlayer.
+ */
+class TuningPlayer : public BrutalPlayer {
+ public:
+	int evaluate(const Board & board, Piece::Color turn)
+		{ return evaluateBoard(board, turn); }
+};
+
+// The parameters the program was built with, penalties as positive numbers
+static vector<double> builtinParams()
+{
+	vector<double> params(PARAMS);
+	for(int i = 0; i < 5; i++) {
+		params[MATERIAL + i] = EVAL_MATERIAL[i];
+	}
+	for(int i = 0; i < 64; i++) {
+		params[PAWN_SQUARES + i] = EVAL_PAWN_SQUARES[i];
+		params[KNIGHT_SQUARES + i] = EVAL_KNIGHT_SQUARES[i];
+		params[BISHOP_SQUARES + i] = EVAL_BISHOP_SQUARES[i];
+		params[KING_SQUARES + i] = EVAL_KING_SQUARES[i];
+		params[ENDGAME_KING_SQUARES + i] = EVAL_ENDGAME_KING_SQUARES[i];
+	}
+	for(int i = 0; i < 4; i++) {
+		params[ISOLATED_PAWN + i] = EVAL_ISOLATED_PAWN[i];
+	}
+	params[QUEEN_DISTANCE] = EVAL_QUEEN_DISTANCE;
+	return params;
+}
+
+static const vector<double> & getBuiltinParams()
+{
+	static const vector<double> params = builtinParams();
+	return params;
+}
+
+// Captures only, from the point of view of turn, with the position the
+// score comes from left in leaf
+static int quiesce(TuningPlayer & player, const Board & board, Piece::Color turn,
+	int alpha, int beta, int depth, Board & leaf, Piece::Color & leafturn)
+{
+	int best = player.evaluate(board, turn);
+	leaf = board;
+	leafturn = turn;
+	if(best >= beta || !depth) {
+		return best;
+	}
+	alpha = max(alpha, best);
+
+	// Biggest victims first, for the cutoffs
+	unsigned long long legal[64];
+	board.legalMoves(turn, legal);
+	vector<pair<int, BoardMove> > captures;
+	for(int i = 0; i < 64; i++) {
+		for(unsigned long long bits = legal[i]; bits; bits &= bits - 1) {
+			BoardPosition to(__builtin_ctzll(bits));
+			if(!board.isOccupied(to)) {
+				continue;
+			}
+			BoardMove bm(BoardPosition(i), to, board.getPiece(BoardPosition(i)));
+			if(bm.needPromotion()) {
+				bm.setPromotion(Piece::QUEEN);
+			}
+			captures.push_back(make_pair(-(int)board.getPiece(to)->type(), bm));
+		}
+	}
+	stable_sort(captures.begin(), captures.end(),
+		[](const pair<int, BoardMove> & a, const pair<int, BoardMove> & b) { return a.first < b.first; });
+
+	Board childleaf;
+	Piece::Color childturn;
+	for(int i = 0; i < (int)captures.size(); i++) {
+		Board after = board;
+		after.update(captures[i].second);
+		int score = -quiesce(player, after, Piece::opposite(turn), -beta, -alpha,
+			depth - 1, childleaf, childturn);
+		if(score > best) {
+			best = score;
+			leaf = childleaf;
+			leafturn = childturn;
+		}
+		if(score >= beta) {
+			break;
+		}
+		alpha = max(alpha, score);
+	}
+	return best;
+}
+
+// Reads the result at the end of a line of text, -1 if there is none
+static int parseResult(string_view text)
+{
+	static const char * const RESULTS[] = {
+		"1/2-1/2", "1-0", "0-1", "[0.5]", "[1", "[0"
+	};
+	static const int POINTS[] = { 1, 2, 0, 1, 2, 0 };
+	string_view::size_type found = string_view::npos;
+	int result = -1;
+	for(int i = 0; i < 6; i++) {
+		string_view::size_type at = text.find(RESULTS[i]);
+		if(at < found) {
+			found = at;
+			result = POINTS[i];
+		}
+	}
+	return result;
+}
+
+EvalTuner::EvalTuner() :
+	m_params(getBuiltinParams()),
+	m_scale(log(10.0) / 400.0),
+	m_progress(0)
+{
+}
+
+bool EvalTuner::addPosition(TuningPlayer & player, const Board & board, Piece::Color turn,
+	int result, Part & part)
+{
+	if(board.isCheck(turn)) {
+		return false;
+	}
+	Board leaf;
+	Piece::Color leafturn;
+	quiesce(player, board, turn, -INT_MAX, INT_MAX, QUIESCE_DEPTH, leaf, leafturn);
+	int eval = player.evaluate(leaf, Piece::WHITE);
+	if(abs(eval) > MAX_EVAL) {
+		return false;
+	}
+
+	// Pawns of each side on every file, and the material, for the terms
+	// that depend on other pieces
+	int pawns[2][8] = { { 0 } };
+	int material = 0;
+	for(int i = 0; i < 64; i++) {
+		BoardPosition bp(i);
+		if(!leaf.isOccupied(bp)) {
+			continue;
+		}
+		const Piece * p = leaf.getPiece(bp);
+		if(p->type() == Piece::PAWN) {
+			pawns[p->color()][bp.file0()]++;
+		}
+		if(p->type() != Piece::KING) {
+			material += EVAL_MATERIAL[p->type()];
+		}
+	}
+	bool endgame = material < ENDGAME_MATERIAL;
+
+	int counts[PARAMS] = { 0 };
+	for(int i = 0; i < 64; i++) {
+		BoardPosition bp(i);
+		if(!leaf.isOccupied(bp)) {
+			continue;
+		}
+		const Piece * p = leaf.getPiece(bp);
+		Piece::Color color = p->color();
+		int side = (color == Piece::WHITE) ? 1 : -1;
+		int square = (color == Piece::WHITE) ? i : i ^ 56;
+		int file = bp.file0();
+		switch(p->type()) {
+			case Piece::PAWN:
+				counts[PAWN_SQUARES + square] += side;
+				if((file == 0 || !pawns[color][file - 1]) && (file == 7 || !pawns[color][file + 1])) {
+					counts[ISOLATED_PAWN + min(file, 7 - file)] -= side;
+				}
+				break;
+			case Piece::KNIGHT:
+				counts[KNIGHT_SQUARES + square] += side;
+				break;
+			case Piece::BISHOP:
+				counts[BISHOP_SQUARES + square] += side;
+				break;
+			case Piece::QUEEN:
+				if(endgame) {
+					BoardPosition king = leaf.getKing(Piece::opposite(color));
+					counts[QUEEN_DISTANCE] -= side * (abs(king.file0() - file) + abs(king.rank0() - bp.rank0()));
+				}
+				break;
+			case Piece::KING:
+				counts[(endgame ? ENDGAME_KING_SQUARES : KING_SQUARES) + square] += side;
+				break;
+			default:
+				break;
+		}
+		if(p->type() != Piece::KING) {
+			counts[MATERIAL + p->type()] += side;
+		}
+	}
+
+	// What the tuned parameters don't explain stays as it is
+	const vector<double> & builtin = getBuiltinParams();
+	Position pos;
+	pos.fixed = eval;
+	pos.features = 0;
+	pos.result = (unsigned char)result;
+	for(int i = 0; i < PARAMS; i++) {
+		if(counts[i]) {
+			Feature feature;
+			feature.index = (unsigned short)i;
+			feature.count = (short)counts[i];
+			part.features.push_back(feature);
+			pos.fixed -= counts[i] * (int)builtin[i];
+			pos.features++;
+		}
+	}
+	part.positions.push_back(pos);
+	return true;
+}
+
+void EvalTuner::append(vector<Part> & parts)
+{
+	for(int i = 0; i < (int)parts.size(); i++) {
+		m_positions.insert(m_positions.end(), parts[i].positions.begin(), parts[i].positions.end());
+		m_features.insert(m_features.end(), parts[i].features.begin(), parts[i].features.end());
+		parts[i] = Part();
+	}
+
+	// Blocks are found again from the last one that was complete
+	size_t block = m_blocks.empty() ? 0 : m_blocks.size() - 1;
+	size_t offset = m_blocks.empty() ? 0 : m_blocks.back();
+	m_blocks.resize(block);
+	for(size_t i = block * BLOCK_POSITIONS; i < m_positions.size(); i++) {
+		if(i % BLOCK_POSITIONS == 0) {
+			m_blocks.push_back(offset);
+		}
+		offset += m_positions[i].features;
+	}
+}
+
+long long EvalTuner::addText(string_view text)
+{
+	// Split at line ends, each part is read on its own
+	JobSystem * jobs = JobSystem::getInstance();
+	int count = jobs->getThreadCount() * JOBS_PER_THREAD;
+	vector<string_view> texts;
+	size_t start = 0;
+	for(int i = 1; i <= count && start < text.size(); i++) {
+		size_t end = (i == count) ? text.size() : max(start, text.size() * i / count);
+		end = text.find('\n', end);
+		end = (end == string_view::npos) ? text.size() : end + 1;
+		texts.push_back(text.substr(start, end - start));
+		start = end;
+	}
+
+	vector<Part> parts(texts.size());
+	vector<JobHandle<void> > handles;
+	for(int i = 0; i < (int)texts.size(); i++) {
+		handles.push_back(jobs->submit(JobSystem::ANALYSIS, [&texts, &parts, i]() {
+			TuningPlayer player;
+			string_view part = texts[i];
+			while(!part.empty()) {
+				size_t end = part.find('\n');
+				string_view line = part.substr(0, end);
+				part = (end == string_view::npos) ? string_view() : part.substr(end + 1);
+
+				// The FEN is the first four fields, and the counters if
+				// there are any
+				size_t fieldend = 0;
+				int fields = 0;
+				while(fields < 6) {
+					size_t begin = line.find_first_not_of(" \t\r", fieldend);
+					if(begin == string_view::npos) {
+						break;
+					}
+					size_t next = min(line.find_first_of(" \t\r", begin), line.size());
+					if(fields >= 4 && line.find_first_not_of("0123456789", begin) < next) {
+						break;
+					}
+					fieldend = next;
+					fields++;
+				}
+				if(fields < 4) {
+					continue;
+				}
+				int result = parseResult(line.substr(fieldend));
+				Board board;
+				FenInfo info;
+				if(result < 0 || !parseFEN(line.substr(0, fieldend), board, info)) {
+					continue;
+				}
+				addPosition(player, board, info.turn, result, parts[i]);
+			}
+		}));
+	}
+	for(int i = 0; i < (int)handles.size(); i++) {
+		handles[i].wait();
+	}
+
+	long long before = getPositionCount();
+	append(parts);
+	return getPositionCount() - before;
+}
+
+long long EvalTuner::addGames(const GameDatabase & db, const TuningFilter & filter)
+{
+	JobSystem * jobs = JobSystem::getInstance();
+	long long games = db.getGameCount();
+	int count = (int)min<long long>(jobs->getThreadCount() * JOBS_PER_THREAD, max(games, 1LL));
+	vector<Part> parts(count);
+	vector<JobHandle<void> > handles;
+	for(int i = 0; i < count; i++) {
+		long long first = games * i / count, last = games * (i + 1) / count;
+		handles.push_back(jobs->submit(JobSystem::ANALYSIS, [&db, &parts, &filter, i, first, last]() {
+			TuningPlayer player;
+			ChessGameState state;
+			vector<BoardMove> moves;
+			for(long long n = first; n < last; n++) {
+				GameHeader::Result outcome = db.getResult(n);
+				if(outcome == GameHeader::UNKNOWN || !db.readMoves(n, moves)) {
+					continue;
+				}
+				int result = (outcome == GameHeader::WHITE_WINS) ? 2 :
+					(outcome == GameHeader::DRAW) ? 1 : 0;
+
+				string_view fen = db.getTag(n, GameHeader::FEN);
+				if(fen.empty()) {
+					state.reset();
+				} else if(!state.loadFEN(fen)) {
+					continue;
+				}
+				Board board = state.getBoard();
+				Piece::Color turn = state.getTurn();
+				for(int ply = 0; ply < (int)moves.size(); ply++) {
+					if(ply >= filter.skip && (ply - filter.skip) % max(filter.sample, 1) == 0) {
+						addPosition(player, board, turn, result, parts[i]);
+					}
+					const BoardMove & move = moves[ply];
+					board.update(BoardMove(move.origin(), move.dest(), board.getPiece(move.origin()),
+						move.getPromotion()));
+					turn = Piece::opposite(turn);
+				}
+			}
+		}));
+	}
+	for(int i = 0; i < (int)handles.size(); i++) {
+		handles[i].wait();
+	}
+
+	long long before = getPositionCount();
+	append(parts);
+	return getPositionCount() - before;
+}
+
+long long EvalTuner::addPacked(const PackedPositionFile & file, const TuningFilter & filter)
+{
+	// Chunks are handed out in turn, as many parts as for games
+	JobSystem * jobs = JobSystem::getInstance();
+	int chunks = file.getChunkCount();
+	int count = min(jobs->getThreadCount() * JOBS_PER_THREAD, max(chunks, 1));
+	vector<Part> parts(count);
+	vector<JobHandle<void> > handles;
+	for(int i = 0; i < count; i++) {
+		handles.push_back(jobs->submit(JobSystem::ANALYSIS, [&file, &parts, &filter, i, count, chunks]() {
+			TuningPlayer player;
+			vector<PackedPosition> positions;
+			int sample = max(filter.sample, 1);
+			for(int n = i; n < chunks; n += count) {
+				if(!file.readChunk(n, positions)) {
+					continue;
+				}
+				for(int j = 0; j < (int)positions.size(); j += sample) {
+					Board board;
+					FenInfo info;
+					positions[j].unpack(board, info);
+					addPosition(player, board, info.turn, positions[j].result, parts[i]);
+				}
+			}
+		}));
+	}
+	for(int i = 0; i < (int)handles.size(); i++) {
+		handles[i].wait();
+	}
+
+	long long before = getPositionCount();
+	append(parts);
+	return getPositionCount() - before;
+}
+
+size_t EvalTuner::getMemoryUsage() const
+{
+	return m_positions.size() * sizeof(Position) + m_features.size() * sizeof(Feature) +
+		m_blocks.size() * sizeof(size_t);
+}
+
+double EvalTuner::blockError(size_t first, size_t last, vector<double> * gradient) const
+{
+	const Feature * feature = m_features.data() + m_blocks[first / BLOCK_POSITIONS];
+	const double * params = m_params.data();
+	double error = 0.0;
+	for(size_t i = first; i < last; i++) {
+		const Position & pos = m_positions[i];
+		double eval = pos.fixed;
+		for(int k = 0; k < pos.features; k++) {
+			eval += feature[k].count * params[feature[k].index];
+		}
+		double chance = 1.0 / (1.0 + exp(-m_scale * eval));
+		double diff = pos.result * 0.5 - chance;
+		error += diff * diff;
+
+		if(gradient) {
+			double slope = -2.0 * diff * chance * (1.0 - chance) * m_scale;
+			double * g = gradient->data();
+			for(int k = 0; k < pos.features; k++) {
+				g[feature[k].index] += slope * feature[k].count;
+			}
+		}
+		feature += pos.features;
+	}
+	return error;
+}
+
+double EvalTuner::computeError(vector<double> * gradient) const
+{
+	if(m_positions.empty()) {
+		return 0.0;
+	}
+
+	// Whole blocks for every job, each with a gradient of its own
+	JobSystem * jobs = JobSystem::getInstance();
+	size_t blocks = m_blocks.size();
+	size_t count = min<size_t>(jobs->getThreadCount() * JOBS_PER_THREAD, blocks);
+	vector<double> errors(count);
+	vector<vector<double> > gradients(gradient ? count : 0);
+	vector<JobHandle<void> > handles;
+	for(size_t i = 0; i < count; i++) {
+		size_t first = blocks * i / count * BLOCK_POSITIONS;
+		size_t last = min(blocks * (i + 1) / count * BLOCK_POSITIONS, m_positions.size());
+		handles.push_back(jobs->submit(JobSystem::ANALYSIS, [this, &errors, &gradients, i, first, last]() {
+			vector<double> * local = 0;
+			if(!gradients.empty()) {
+				gradients[i].assign(PARAMS, 0.0);
+				local = &gradients[i];
+			}
+			errors[i] = blockError(first, last, local);
+		}));
+	}
+
+	double error = 0.0;
+	for(size_t i = 0; i < count; i++) {
+		handles[i].wait();
+		error += errors[i];
+		if(gradient) {
+			gradient->resize(PARAMS);
+			double * sum = gradient->data();
+			const double * part = gradients[i].data();
+			for(int k = 0; k < PARAMS; k++) {
+				sum[k] += part[k];
+			}
+		}
+	}
+	return error / m_positions.size();
+}
+
+double EvalTuner::fitScale()
+{
+	// The error is smooth in the scale, a golden section search finds it
+	static const double GOLDEN = 0.6180339887;
+	double low = 0.1, high = 3.0;
+	double a = high - GOLDEN * (high - low), b = low + GOLDEN * (high - low);
+	m_scale = a * log(10.0) / 400.0;
+	double errora = computeError();
+	m_scale = b * log(10.0) / 400.0;
+	double errorb = computeError();
+	while(high - low > 0.001) {
+		if(errora < errorb) {
+			high = b;
+			b = a;
+			errorb = errora;
+			a = high - GOLDEN * (high - low);
+			m_scale = a * log(10.0) / 400.0;
+			errora = computeError();
+		} else {
+			low = a;
+			a = b;
+			errora = errorb;
+			b = low + GOLDEN * (high - low);
+			m_scale = b * log(10.0) / 400.0;
+			errorb = computeError();
+		}
+	}
+	double k = (low + high) / 2;
+	m_scale = k * log(10.0) / 400.0;
+	return k;
+}
+
+double EvalTuner::tune(int iterations, double rate)
+{
+	vector<double> gradient(PARAMS), moment(PARAMS, 0.0), velocity(PARAMS, 0.0);
+	double error = computeError();
+	for(int t = 1; t <= iterations; t++) {
+		gradient.assign(PARAMS, 0.0);
+		error = computeError(&gradient);
+
+		double correct1 = 1.0 - pow(ADAM_BETA1, t);
+		double correct2 = 1.0 - pow(ADAM_BETA2, t);
+		double * params = m_params.data();
+		for(int i = 0; i < PARAMS; i++) {
+			double g = gradient[i] / m_positions.size();
+			moment[i] = ADAM_BETA1 * moment[i] + (1.0 - ADAM_BETA1) * g;
+			velocity[i] = ADAM_BETA2 * velocity[i] + (1.0 - ADAM_BETA2) * g * g;
+			params[i] -= rate * (moment[i] / correct1) / (sqrt(velocity[i] / correct2) + ADAM_EPSILON);
+		}
+		if(m_progress) {
+			m_progress(t, error);
+		}
+	}
+	return computeError();
+}
+
+// Writes count parameters, eight to a line
+static void writeTable(ostream & out, const vector<double> & params, int first, int count)
+{
+	for(int i = 0; i < count; i++) {
+		out << ((i % 8) ? " " : "\t") << lround(params[first + i]) <<
+			((i + 1 < count) ? "," : " };") << (((i + 1) % 8 && i + 1 < count) ? "" : "\n");
+	}
+}
+
+bool EvalTuner::write(const string & filename) const
+{
+	ofstream out(filename.c_str());
+	if(!out) {
+		return false;
+	}
+	out << "/***************************************************************************\n";
+	out << " * Brutal Chess\n";
+	out << " * http://brutalchess.sf.net\n";
+	out << " *\n";
+	out << " * File : evalparams.h\n";
+	out << " * Authors : Mike Cook, Joe Flint, Neil Pankey\n";
+	out << " **************************************************************************/\n\n";
+	out << "// The parameters of the BrutalPlayer evaluation, written by chesspizza-tune.\n";
+	out << "// Tuned on " << m_positions.size() << " positions, error " << computeError() << ".\n\n";
+	out << "#ifndef EVALPARAMS_H\n#define EVALPARAMS_H\n\n";
+
+	out << "// Centipawns of each piece by Piece::Type, the king isn't tuned\n";
+	out << "static const int EVAL_MATERIAL[5] = {\n";
+	writeTable(out, m_params, MATERIAL, 5);
+	out << "\n// Square bonuses from white's point of view, a1 first, mirrored for black\n";
+	static const char * const TABLES[5] = {
+		"EVAL_PAWN_SQUARES", "EVAL_KNIGHT_SQUARES", "EVAL_BISHOP_SQUARES",
+		"EVAL_KING_SQUARES", "EVAL_ENDGAME_KING_SQUARES"
+	};
+	for(int i = 0; i < 5; i++) {
+		out << (i ? "\n" : "") << "static const int " << TABLES[i] << "[64] = {\n";
+		writeTable(out, m_params, PAWN_SQUARES + 64 * i, 64);
+	}
+	out << "\n// Penalty of an isolated pawn on the a and h, b and g, c and f, d and e files\n";
+	out << "static const int EVAL_ISOLATED_PAWN[4] = {\n";
+	writeTable(out, m_params, ISOLATED_PAWN, 4);
+	out << "\n// Endgame penalty for every square between a queen and the enemy king\n";
+	out << "static const int EVAL_QUEEN_DISTANCE = " << lround(m_params[QUEEN_DISTANCE]) << ";\n\n";
+	out << "#endif // EVALPARAMS_H\n\n";
+	out << "// End of file evalparams.h\n";
+	return out.good();
+}
+
+// End of file evaltuner.cpp
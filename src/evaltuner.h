@@ -0,0 +1,161 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : evaltuner.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef EVALTUNER_H
+#define EVALTUNER_H
+
+#include "board.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class GameDatabase;
+class PackedPositionFile;
+class TuningPlayer;
+
+/**
+ * Which positions of a GameDatabase are read.
+ */
+struct TuningFilter {
+	TuningFilter() :
+		skip(8),
+		sample(1) {}
+
+	/** Plies at the start of each game that are left out, as book moves. */
+	int skip;
+	/** Only every sample-th position after those is read. */
+	int sample;
+};
+
+/**
+ * Tunes the parameters of the BrutalPlayer evaluation, those of
+ * evalparams.h, to positions labelled with the result of their game, the
+ * way the Texel engine did. The error is the mean squared difference of
+ * the results and the evaluations mapped to a winning chance, and it is
+ * minimised with Adam.
+ *
+ * Each position is first replaced by the end of its capture sequence, so
+ * that only quiet positions are scored. The evaluation is linear in the
+ * parameters there, so a position is kept as the parameters it uses with
+ * their counts, white's minus black's, and the rest of its evaluation as
+ * one number. A pass over millions of them takes a few seconds on the
+ * JobSystem. Whether the endgame tables apply is decided once, with the
+ * material values the program was built with.
+ *
+ * Needs Board::init() to have been called.
+ */
+class EvalTuner {
+ public:
+	EvalTuner();
+
+	/**
+	 * Reads positions, one per line as a FEN or EPD followed by the result
+	 * from white's point of view, "1-0", "0-1" or "1/2-1/2" as in EPD c9
+	 * operations, or "[1.0]", "[0.5]" or "[0.0]". Lines without a result
+	 * are skipped.
+	 * @return The number of positions added.
+	 */
+	long long addText(std::string_view text);
+
+	/**
+	 * Reads the positions of every finished game of a database.
+	 * @return The number of positions added.
+	 */
+	long long addGames(const GameDatabase & db, const TuningFilter & filter = TuningFilter());
+
+	/**
+	 * Reads the positions of a file of PackedPositions, every sample-th
+	 * of the filter.
+	 * @return The number of positions added.
+	 */
+	long long addPacked(const PackedPositionFile & file, const TuningFilter & filter = TuningFilter());
+
+	long long getPositionCount() const
+		{ return (long long)m_positions.size(); }
+
+	/** Returns the bytes the positions take. */
+	size_t getMemoryUsage() const;
+
+	/**
+	 * Finds the scale of the winning chance that fits the evaluation as
+	 * it is best, and keeps it for the tuning.
+	 */
+	double fitScale();
+
+	/**
+	 * Runs iterations steps of Adam.
+	 * @param rate - The step in centipawns, roughly.
+	 * @return The error after the last step.
+	 */
+	double tune(int iterations, double rate);
+
+	/**
+	 * Returns the error of the current parameters, and adds its gradient
+	 * to gradient if that isn't null.
+	 */
+	double computeError(std::vector<double> * gradient = 0) const;
+
+	/**
+	 * Writes the parameters, rounded, in the layout of evalparams.h.
+	 * Returns false if the file can't be written.
+	 */
+	bool write(const std::string & filename) const;
+
+	/** Called after every iteration of tune with its number and error. */
+	void setProgress(void (*progress)(int iteration, double error))
+		{ m_progress = progress; }
+
+ private:
+	EvalTuner(const EvalTuner &);
+	EvalTuner & operator=(const EvalTuner &);
+
+	struct Feature {
+		unsigned short index;
+		short count;
+	};
+
+	/** 8 bytes, the features are kept apart */
+	struct Position {
+		/** Evaluation of what isn't tuned, from white's point of view */
+		int fixed;
+		unsigned char features;
+		/** Half points white scored, 0 to 2 */
+		unsigned char result;
+	};
+
+	/**
+	 * Positions are added and scored in blocks, which remember where
+	 * their features start.
+	 */
+	static const int BLOCK_POSITIONS = 4096;
+
+	struct Part {
+		std::vector<Position> positions;
+		std::vector<Feature> features;
+	};
+
+	// Adds the quiet position reached from board, false if there is none
+	static bool addPosition(TuningPlayer & player, const Board & board, Piece::Color turn,
+		int result, Part & part);
+	void append(std::vector<Part> & parts);
+
+	double blockError(size_t first, size_t last, std::vector<double> * gradient) const;
+
+	std::vector<Position> m_positions;
+	std::vector<Feature> m_features;
+	std::vector<size_t> m_blocks;
+
+	std::vector<double> m_params;
+	double m_scale;
+	void (*m_progress)(int iteration, double error);
+};
+
+#endif // EVALTUNER_H
+
+// End of file evaltuner.h
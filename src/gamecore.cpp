@@ -12,21 +12,17 @@
 #include "config.h"
 #include "fontloader.h"
 #include "gamecore.h"
+#include "logger.h"
 #include "menu.h"
 #include "menuitem.h"
 #include "objfile.h"
 #include "options.h"
 #include "SDL.h"
 #include "SDL_opengl.h"
-#include "SDL_thread.h"
 #include "texture.h"
 
 #include <cmath>
-#include <iostream>
-
-using std::cout;
-using std::cerr;
-using std::endl;
+#include <cstdio>
 
 // Menu string constants
 static const string AI_DIFFICULTY_EASY = "Easy";
@@ -35,10 +31,29 @@ static const string AI_DIFFICULTY_HARD = "Hard";
 
 static const string PLAYER_BRUTAL = "Brutal";
 static const string PLAYER_HUMAN = "Human";
+static const string PLAYER_MCTS = "Mcts";
 static const string PLAYER_RANDOM = "Random";
+static const string PLAYER_UCI = "Uci";
 
 GameCore * GameCore::m_instance = 0;
 
+// Sets the function a thinking player reports its progress to, for the
+// players that report any
+static void setInfoCallback(ChessPlayer * player,
+	const function<void(const SearchInfo &)> & report)
+{
+	BrutalPlayer * brutal = dynamic_cast<BrutalPlayer*>(player);
+	if (brutal) {
+		brutal->setInfoCallback(report);
+	}
+#ifndef WIN32
+	UciPlayer * uci = dynamic_cast<UciPlayer*>(player);
+	if (uci) {
+		uci->setInfoCallback(report);
+	}
+#endif
+}
+
 GameCore * GameCore::get_Instance()
 {
 	if (m_instance == 0)
@@ -73,17 +88,21 @@ bool GameCore::load()
 	m_rotatey = 0.0;
 	m_isWaitingForPromotion = false;
 	m_rotate = false;
-	m_loaded = true;
 	m_suggestedwhiteplayer = m_options->getPlayer1String();
 	m_suggestedblackplayer = m_options->getPlayer2String();
+
+	// The game loop picks up from here once it sees this
+	EngineEvent loaded;
+	loaded.type = EngineEvent::LOADED;
+	postEvent(loaded);
 	return true;
 }
 
 bool GameCore::loadGL()
 {
-	if(m_loadthread) {
-		SDL_WaitThread(m_loadthread, NULL);
-		m_loadthread = 0;
+	if(m_loadjob.isValid()) {
+		m_loadjob.wait();
+		m_loadjob = JobHandle<void>();
 	}
 
 	m_set->loadGL();
@@ -98,8 +117,8 @@ bool GameCore::loadGL()
 	m_blankcur = SDL_CreateCursor((Uint8*)blank, (Uint8*)blank, 8, 8, 0, 0);
 	m_glloaded = true;
 
-	if(!m_thinkthread) {
-		spawnThinkThread();
+	if(!m_thinkrequest) {
+		startThinking();
 	}
 
 	return true;
@@ -121,6 +140,18 @@ void GameCore::unloadGL()
 
 void GameCore::draw()
 {
+	processEvents();
+
+	// A player whose time runs out loses, whatever it is doing
+	ChessClock & clock = m_game.getClock();
+	if(clock.isRunning() && clock.isFlagged(clock.getRunningSide())) {
+		stopThinking();
+		clock.stop();
+		m_endgametimer = Timer(Timer::LINEAR);
+		m_endgametimer.setDuration(1.0);
+		m_endgametimer.start();
+	}
+
 	if(m_loaded) {
 		if(!m_glloaded) {
 			loadGL();
@@ -174,6 +205,14 @@ void GameCore::draw()
 			m_set->drawPiece(&p, 0.9, false);
 			glScalef(1/7.0, 1/7.0, 1/7.0);
 			glEnable(GL_DEPTH_TEST);
+
+			// Show what the engine is currently thinking about
+			if (m_engineinfo.depth) {
+				drawEngineInfo(m_engineinfo);
+			}
+			if (clock.isEnabled()) {
+				drawClock();
+			}
 		}
 
 		if (m_menu.isActive()) {
@@ -189,14 +228,29 @@ void GameCore::draw()
             buildMenu();
             m_menu.pushOptionsSet("Game Over");
             string condition;
-            if (m_game.getBoard().isCheckMate(Piece::BLACK)) {
-                condition = "Checkmate - White Wins";
-            }
-            else if (m_game.getBoard().isCheckMate(Piece::WHITE)) {
-                condition = "Checkmate - Black Wins";
-            }
-            else {
-                condition = "Stalemate";
+            Piece::Color turn = m_game.getTurn();
+            if (clock.isFlagged(turn)) {
+                condition = (turn == Piece::WHITE) ?
+                    "Time - Black Wins" : "Time - White Wins";
+            } else {
+                switch (m_game.getState().getStatus()) {
+                    case ChessGameState::CHECKMATE:
+                        condition = m_game.getState().isWhiteTurn() ?
+                            "Checkmate - Black Wins" : "Checkmate - White Wins";
+                        break;
+                    case ChessGameState::FIFTY_MOVES:
+                        condition = "Draw - Fifty Move Rule";
+                        break;
+                    case ChessGameState::REPETITION:
+                        condition = "Draw - Repetition";
+                        break;
+                    case ChessGameState::INSUFFICIENT_MATERIAL:
+                        condition = "Draw - Insufficient Material";
+                        break;
+                    default:
+                        condition = "Stalemate";
+                        break;
+                }
             }
             m_menu.setHeader(condition);
             m_menu.activate();
@@ -295,7 +349,7 @@ bool GameCore::handleEvent(SDL_Event& e)
 					// We've already clicked once, so save this new click position and
 					// make the move from m_firstclick to the new position
 					BoardMove bm(m_firstclick, m_mousepos, m_game.getBoard().getPiece(m_firstclick));
-					if (bm.needPromotion()) {
+					if (bm.needPromotion() && m_game.getState().isMoveLegal(bm)) {
 						m_secondclick = m_mousepos;
 						if (m_game.getCurrentPlayer()->isHuman()) {
 							m_set->drawPromotionSelector(true);
@@ -351,29 +405,7 @@ bool GameCore::handleEvent(SDL_Event& e)
 			}
 	}
 	else if (e.type == SDL_USEREVENT) {
-		if(e.user.code == 0) {
-			// Received notification that the player is done thinking
-			ChessPlayer *player = (ChessPlayer*)e.user.data1;
-			//m_set->animateMove(player->getMove());
-			if(m_game.tryMove(player->getMove())) {
-				m_game.getCurrentPlayer()->opponentMove(player->getMove(), m_game.getState());
-				SDL_SetCursor(m_defaultcur);
-				m_set->deselectPosition();
-				m_firstclick.invalidate();
-			}
-			SDL_WaitThread(m_thinkthread, NULL);
-			m_thinkthread = NULL;
-
-			// Only temporary, really want to do this after animation is done
-	    	if (!(m_game.getBoard().containsCheckMate() || m_game.getState().isDraw())) {
-				spawnThinkThread();
-			} else {
-                m_endgametimer = Timer(Timer::LINEAR);
-                m_endgametimer.setDuration(1.0);
-                m_endgametimer.start();
-			}
-		}
-		else if (e.user.code == Menu::eQUIT) {
+		if (e.user.code == Menu::eQUIT) {
 			SDL_Event quitevent;
 			quitevent.type = SDL_QUIT;
 			SDL_PushEvent(&quitevent);
@@ -406,7 +438,8 @@ bool GameCore::handleEvent(SDL_Event& e)
 		}
 		else if (e.user.code == Menu::eBLACKPLAYERCHANGED) {
 			m_suggestedblackplayer = m_blackplayerchoices->getCurrentChoice();
-			m_blackbrutalplychoices->setCollapsed(PLAYER_BRUTAL != m_suggestedblackplayer);
+			m_blackbrutalplychoices->setCollapsed(PLAYER_BRUTAL != m_suggestedblackplayer &&
+				PLAYER_MCTS != m_suggestedblackplayer);
 		}
 		else if (e.user.code == Menu::eWBRUTALPLYCHANGED) {
 			// Set the AI ply depth based on the ai difficulty string
@@ -427,9 +460,12 @@ bool GameCore::handleEvent(SDL_Event& e)
 		}
 		else if (e.user.code == Menu::eWHITEPLAYERCHANGED) {
 			m_suggestedwhiteplayer = m_whiteplayerchoices->getCurrentChoice();
-			m_whitebrutalplychoices->setCollapsed(PLAYER_BRUTAL != m_suggestedwhiteplayer);
+			m_whitebrutalplychoices->setCollapsed(PLAYER_BRUTAL != m_suggestedwhiteplayer &&
+				PLAYER_MCTS != m_suggestedwhiteplayer);
 		}
 		else if (e.user.code == Menu::eSTARTNEWGAME) {
+			// The old players are deleted, they must be done thinking
+			stopThinking();
 			ChessPlayer * whiteplayer = PlayerFactory(m_suggestedwhiteplayer);
 			BrutalPlayer* brutalplayer = dynamic_cast<BrutalPlayer*>(whiteplayer);
 			if (brutalplayer) {
@@ -445,10 +481,8 @@ bool GameCore::handleEvent(SDL_Event& e)
 			m_game.setPlayer1(whiteplayer);
 			m_game.setPlayer2(blackplayer);
 			m_game.newGame();
-			if (m_thinkthread) {
-				SDL_KillThread(m_thinkthread);
-			}
-			spawnThinkThread();
+			startClock();
+			startThinking();
 			SDL_Event backEvent;
 			backEvent.type = SDL_USEREVENT;
 			backEvent.user.code = Menu::eBACK;
@@ -473,7 +507,7 @@ bool GameCore::preload()
 	} else if(m_loadpawn.load(MODELS_DIR + string("pawn.obj"))) {
 		// add debugging
 	} else {
-		cerr << "Failed to load pawn." << endl;
+		LOG_ERROR("gamecore", "Failed to load pawn.");
 		return false;
 	}
 			
@@ -485,7 +519,7 @@ bool GameCore::preload()
 	} else if(FontLoader::loadFont("sans", FONTS_DIR + string("ZEROES__.TTF"), 32)) {
 		// add debugging
 	} else {
-		cerr << "Failed to load fonts." << endl;
+		LOG_ERROR("gamecore", "Failed to load fonts.");
 		return false;
 	}
 
@@ -494,7 +528,7 @@ bool GameCore::preload()
 	} else if(m_logotexture.load(ART_DIR + string("brutalchesslogo.png"))) {
 		// add debugging
 	} else {
-		cerr << "Failed to load logo" << endl;
+		LOG_ERROR("gamecore", "Failed to load logo");
 		return false;
 	}
 
@@ -549,6 +583,88 @@ void GameCore::drawLoadingScreen()
 	m_loadpawn.draw();
 }
 
+void GameCore::drawEngineInfo(const SearchInfo & info)
+{
+	if (info.depth == 0 && info.pv.empty()) {
+		return;
+	}
+
+	char score[32];
+	if (info.mate) {
+		snprintf(score, sizeof(score), "#%d", info.mate);
+	} else {
+		snprintf(score, sizeof(score), "%+.2f", info.score / 100.0);
+	}
+	string pv = info.pv.substr(0, 40);
+
+	glLoadIdentity();
+	double height = static_cast<double>(m_options->getResolutionHeight());
+	double width = static_cast<double>(m_options->getResolutionWidth());
+	double aspectRatioDiff = (height/width)  - 0.75;
+	glTranslated(-38.0 + 50.0*aspectRatioDiff, -27.0, -106);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glColor4f(1.0, 1.0, 1.0, 0.8);
+	glScaled(1/14.0, 1/14.0, 1/14.0);
+	FontLoader::print(0, 0, "depth %d  %s  %s", info.depth, score, pv.c_str());
+	glScaled(14, 14, 14);
+	glDisable(GL_BLEND);
+	glEnable(GL_LIGHTING);
+	glEnable(GL_DEPTH_TEST);
+}
+
+// Formats a clock reading as minutes, seconds and tenths
+static string formatClockTime(long long nanos)
+{
+	if (nanos < 0) {
+		nanos = 0;
+	}
+	long long tenths = nanos / 100000000LL;
+	char text[32];
+	snprintf(text, sizeof(text), "%lld:%02lld.%lld", tenths / 600, (tenths / 10) % 60, tenths % 10);
+	return text;
+}
+
+void GameCore::drawClock()
+{
+	ChessClock::Clock::time_point now = ChessClock::Clock::now();
+	const ChessClock & clock = m_game.getClock();
+	string white = formatClockTime(clock.getRemaining(Piece::WHITE, now));
+	string black = formatClockTime(clock.getRemaining(Piece::BLACK, now));
+	bool whiteturn = clock.isRunning() && clock.getRunningSide() == Piece::WHITE;
+	bool blackturn = clock.isRunning() && clock.getRunningSide() == Piece::BLACK;
+
+	glLoadIdentity();
+	double height = static_cast<double>(m_options->getResolutionHeight());
+	double width = static_cast<double>(m_options->getResolutionWidth());
+	double aspectRatioDiff = (height/width)  - 0.75;
+	glTranslated(-38.0 + 50.0*aspectRatioDiff, 25.0, -106);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glColor4f(1.0, 1.0, 1.0, 0.8);
+	glScaled(1/14.0, 1/14.0, 1/14.0);
+	FontLoader::print(0, 0, "%sWhite %s   %sBlack %s", whiteturn ? "> " : "",
+		white.c_str(), blackturn ? "> " : "", black.c_str());
+	glScaled(14, 14, 14);
+	glDisable(GL_BLEND);
+	glEnable(GL_LIGHTING);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void GameCore::startClock()
+{
+	TimeControl tc;
+	if (TimeControl::parse(m_options->timecontrol, tc)) {
+		ChessClock & clock = m_game.getClock();
+		clock.setTimeControl(tc);
+		clock.start(m_game.getTurn());
+	}
+}
+
 void GameCore::projectShadows()
 {
 	glPushAttrib(GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
@@ -728,7 +844,11 @@ void GameCore::buildMenu()
 	m_whiteplayerchoices = new ChoicesItem("White Player");
 	m_whiteplayerchoices->addChoice(PLAYER_BRUTAL, Menu::eWHITEPLAYERCHANGED);
 	m_whiteplayerchoices->addChoice(PLAYER_HUMAN, Menu::eWHITEPLAYERCHANGED);
+	m_whiteplayerchoices->addChoice(PLAYER_MCTS, Menu::eWHITEPLAYERCHANGED);
 	m_whiteplayerchoices->addChoice(PLAYER_RANDOM, Menu::eWHITEPLAYERCHANGED);
+#ifndef WIN32
+	m_whiteplayerchoices->addChoice(PLAYER_UCI, Menu::eWHITEPLAYERCHANGED);
+#endif
 	m_whiteplayerchoices->setChoice(PLAYER_HUMAN);
 	m_whitebrutalplychoices = new ChoicesItem("  Difficulty");
 	m_whitebrutalplychoices->addChoice(AI_DIFFICULTY_EASY, Menu::eWBRUTALPLYCHANGED);
@@ -738,7 +858,11 @@ void GameCore::buildMenu()
 	m_blackplayerchoices = new ChoicesItem("Black Player");
 	m_blackplayerchoices->addChoice(PLAYER_BRUTAL, Menu::eBLACKPLAYERCHANGED);
 	m_blackplayerchoices->addChoice(PLAYER_HUMAN, Menu::eBLACKPLAYERCHANGED);
+	m_blackplayerchoices->addChoice(PLAYER_MCTS, Menu::eBLACKPLAYERCHANGED);
 	m_blackplayerchoices->addChoice(PLAYER_RANDOM, Menu::eBLACKPLAYERCHANGED);
+#ifndef WIN32
+	m_blackplayerchoices->addChoice(PLAYER_UCI, Menu::eBLACKPLAYERCHANGED);
+#endif
 	m_blackplayerchoices->setChoice(PLAYER_BRUTAL);
 	m_blackbrutalplychoices = new ChoicesItem("  Difficulty");
 	m_blackbrutalplychoices->addChoice(AI_DIFFICULTY_EASY, Menu::eBBRUTALPLYCHANGED);
@@ -862,34 +986,129 @@ void GameCore::updateMouseBoardPos()
 	m_mousepos = BoardPosition((int)floor(x), -(int)ceil(z));
 }
 
-int callThink(void *pt)
+void GameCore::startThinking()
 {
-	ChessGame* game = (ChessGame*)pt;
-	// Give the player time to think
-	game->getCurrentPlayer()->think(game->getState());
-
-	// Finished thinking, let the main thread know
-	SDL_Event thinkevent;
-	thinkevent.type = SDL_USEREVENT;
-	thinkevent.user.code = 0;
-	thinkevent.user.data1 = game->getCurrentPlayer();
-	thinkevent.user.data2 = NULL;
-	SDL_PushEvent(&thinkevent);
-	return 0;
+	// The move is handed to the game loop as an event, tagged with the
+	// game it belongs to
+	int gamenum = m_thinkgame;
+	ChessPlayer * player = m_game.getCurrentPlayer();
+	m_engineinfo = SearchInfo();
+
+	// Progress reports are dropped when the game loop falls behind
+	function<void(const SearchInfo &)> report = [this, player, gamenum](const SearchInfo & info) {
+		EngineEvent event;
+		event.type = EngineEvent::ANALYSIS;
+		event.player = player;
+		event.game = gamenum;
+		event.info = info;
+		postEvent(event);
+	};
+	setInfoCallback(player, report);
+
+	// A running clock takes over from the fixed limits of the player
+	SearchLimits limits = player->getLimits();
+	m_game.getClock().fillLimits(limits);
+
+	m_thinkrequest = player->requestMove(m_game.getSnapshot(), limits,
+		[this, gamenum](ChessPlayer * player, const BoardMove & move) {
+			EngineEvent event;
+			event.type = EngineEvent::MOVE;
+			event.player = player;
+			event.game = gamenum;
+			event.move = move;
+			postEvent(event);
+		});
 }
 
-void GameCore::spawnThinkThread()
+void GameCore::stopThinking()
 {
-	m_thinkthread = SDL_CreateThread(callThink, &m_game);
-	if(m_thinkthread == NULL) {
-		cerr << "Unable to create think thread: " << SDL_GetError() << endl;
+	if(m_thinkrequest) {
+		m_thinkrequest->cancel();
+		m_thinkrequest->wait();
+		m_thinkrequest.reset();
+		setInfoCallback(m_game.getCurrentPlayer(), nullptr);
 	}
+	m_thinkgame++;
+}
 
-	/* 
-	if(!m_game.getCurrentPlayer()->isHuman()) {
-		SDL_WaitThread(m_thinkthread, NULL);
+void GameCore::postEvent(const EngineEvent & event)
+{
+	if(m_events.tryPush(event) || event.type == EngineEvent::ANALYSIS) {
+		return;
+	}
+
+	// The game loop is the only one draining the queue, it would wait
+	// for itself. A human's move is posted from there.
+	if(this_thread::get_id() == m_mainthread) {
+		m_overflow.push_back(event);
+	} else {
+		m_events.push(event);
+	}
+}
+
+void GameCore::processEvents()
+{
+	// Events queued while these are handled wait for the next frame
+	EngineEvent event;
+	for(int i = 0; i < EVENT_QUEUE_SIZE && m_events.tryPop(event); i++) {
+		dispatchEvent(event);
+	}
+
+	// Posted by the game loop itself after the ones in the queue
+	vector<EngineEvent> overflow;
+	overflow.swap(m_overflow);
+	for(int i = 0; i < (int)overflow.size(); i++) {
+		dispatchEvent(overflow[i]);
+	}
+}
+
+void GameCore::dispatchEvent(const EngineEvent & event)
+{
+	if(event.type == EngineEvent::LOADED) {
+		m_loaded = true;
+		startClock();
+	} else if(event.game != m_thinkgame) {
+		// Left over from a game that has been replaced
+		return;
+	} else if(event.type == EngineEvent::MOVE) {
+		handleMove(event);
+	} else if(event.type == EngineEvent::ANALYSIS) {
+		// Reports that were queued before the move was played are stale
+		if(m_thinkrequest && event.player == m_game.getCurrentPlayer()) {
+			m_engineinfo = event.info;
+		}
+	}
+}
+
+void GameCore::handleMove(const EngineEvent & event)
+{
+	if(!m_thinkrequest) {
+		return;
+	}
+	m_thinkrequest.reset();
+	m_engineinfo = SearchInfo();
+
+	// A pondering engine keeps reporting, its turn is over
+	setInfoCallback(event.player, nullptr);
+
+	//m_set->animateMove(event.move);
+	if(m_game.tryMove(event.move)) {
+		event.player->moveMade(event.move, m_game.getState());
+		m_game.getCurrentPlayer()->opponentMove(event.move, m_game.getState());
+		SDL_SetCursor(m_defaultcur);
+		m_set->deselectPosition();
+		m_firstclick.invalidate();
+	}
+
+	// Only temporary, really want to do this after animation is done
+	if (!m_game.getState().isGameOver()) {
+		startThinking();
+	} else {
+		m_game.getClock().stop();
+		m_endgametimer = Timer(Timer::LINEAR);
+		m_endgametimer.setDuration(1.0);
+		m_endgametimer.start();
 	}
-	*/
 }
 
 Piece::Type GameCore::getPromotionSelection(const BoardPosition & bp)
@@ -11,13 +11,17 @@
 
 #include "boardtheme.h"
 #include "chessgame.h"
+#include "engineevent.h"
+#include "jobsystem.h"
 #include "menu.h"
 #include "objfile.h"
 #include "pieceset.h"
 #include "SDL.h"
-#include "SDL_thread.h"
 #include "texture.h"
 
+#include <thread>
+#include <vector>
+
 class ChoicesItem;
 class Options;
 class ToggleItem;
@@ -61,12 +65,27 @@ class GameCore {
 	 */
 	void draw();
 
+	/**
+	 * Handles the events that worker threads queued for the game loop:
+	 * moves, engine analysis and the end of loading. Called once per
+	 * frame by draw().
+	 */
+	void processEvents();
+
+	/**
+	 * Queues an event for the game loop, from any thread. Analysis is
+	 * dropped when the queue is full, the game loop keeps what it posts
+	 * to itself aside then instead of waiting.
+	 */
+	void postEvent(const EngineEvent & event);
+
 	/**
 	 * Handle an event from SDL
 	 */
 	bool handleEvent(SDL_Event& e);
 
-	void setLoadThread(SDL_Thread * loadthread) { m_loadthread = loadthread; }
+	/** Sets the job loading the game, drawing waits for it to finish. */
+	void setLoadJob(const JobHandle<void> & loadjob) { m_loadjob = loadjob; }
 
 	/**
 	 * Set the resolution
@@ -104,13 +123,20 @@ class GameCore {
 		m_mousex(0),
 		m_mousey(0),
 		m_mousepos(),
-		m_thinkthread(0),
+		m_thinkgame(0),
+		m_events(EVENT_QUEUE_SIZE),
+		m_mainthread(std::this_thread::get_id()),
 		m_rotate(false),
 		m_rotatex(0),
 		m_rotatey(0) {}
 
 	bool preload();
 	void drawLoadingScreen();
+	void drawEngineInfo(const SearchInfo & info);
+	void drawClock();
+
+	// Starts the clock of a new game, if the options ask for one
+	void startClock();
 
 	void buildMenu();
 
@@ -119,10 +145,34 @@ class GameCore {
 	
 	void updateMouseBoardPos();
 
-	SDL_Thread * m_thinkthread;
-	SDL_Thread * m_loadthread;
+	MoveRequestPtr m_thinkrequest;
+	JobHandle<void> m_loadjob;
+
+	// Counts games, so that moves of a game that was left are ignored
+	int m_thinkgame;
+
+	// Asks the current player for its move
+	void startThinking();
+
+	// Interrupts the current player and waits for it
+	void stopThinking();
+
+	// Acts on one event in the game loop
+	void dispatchEvent(const EngineEvent & event);
+
+	void handleMove(const EngineEvent & event);
+
+	// Events a frame can fall behind by, analysis beyond that is dropped
+	static const int EVENT_QUEUE_SIZE = 256;
+	EngineEventQueue m_events;
+
+	// The thread of the game loop, and the events it posted to itself
+	// while the queue was full
+	std::thread::id m_mainthread;
+	std::vector<EngineEvent> m_overflow;
 
-	void spawnThinkThread();
+	// What the thinking player reported last
+	SearchInfo m_engineinfo;
 	
 	BoardTheme * m_theme; 
 	PieceSet * m_set;
@@ -0,0 +1,923 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : gamedb.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "gamedb.h"
+#include "notation.h"
+#include "pgn.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char FILE_MAGIC[8] = { 'C', 'P', 'G', 'A', 'M', 'E', 'D', 'B' };
+static const char BLOCK_MAGIC[4] = { 'G', 'B', 'L', 'K' };
+static const char TAIL_MAGIC[8] = { 'C', 'P', 'D', 'B', 'T', 'A', 'I', 'L' };
+static const uint32_t VERSION = 1;
+
+static const char * const TAG_NAMES[GameHeader::TAGS] = {
+	"Event", "Site", "Round", "White", "Black", "ECO", "FEN"
+};
+
+static const char * const START_FEN =
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// The order promotions take in the list of legal moves
+static const Piece::Type PROMOTIONS[4] = {
+	Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT
+};
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t blockgames;
+};
+
+// Starts the tail file holding the blocks that replace a short last block
+struct TailHeader {
+	char magic[8];
+	// Bytes of the database kept, the short block starts there
+	uint64_t keep;
+	// Set once all the blocks are on the disk
+	uint32_t complete;
+	uint32_t padding;
+};
+
+// The columns of a block, in the order they are stored
+enum Column {
+	MOVE_OFFSETS,
+	PLIES,
+	RESULTS,
+	DATES,
+	WHITE_ELOS,
+	BLACK_ELOS,
+	TAG_OFFSETS,
+	MOVE_DATA = TAG_OFFSETS + GameHeader::TAGS,
+	STRINGS,
+	COLUMNS
+};
+
+struct GameBlock {
+	char magic[4];
+	uint32_t games;
+	// Bytes in the block, this header included
+	uint64_t size;
+	// Where each column starts, from the start of the block
+	uint32_t columns[COLUMNS];
+};
+
+// Everything in a file is aligned to 8 bytes
+static size_t align(size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
+static const size_t BLOCK_HEADER_SIZE = align(sizeof(GameBlock));
+
+// Returns the bytes a column of games entries takes
+static size_t columnSize(int column, size_t games)
+{
+	switch(column) {
+		case MOVE_OFFSETS:
+			return (games + 1) * sizeof(uint32_t);
+		case PLIES:
+		case WHITE_ELOS:
+		case BLACK_ELOS:
+			return games * sizeof(uint16_t);
+		case RESULTS:
+			return games * sizeof(uint8_t);
+		case MOVE_DATA:
+		case STRINGS:
+			return 0;
+		default:
+			return games * sizeof(uint32_t);
+	}
+}
+
+// Returns the bits an index into a list of count moves takes
+static int indexBits(int count)
+{
+	int bits = 0;
+	while((1 << bits) < count) {
+		bits++;
+	}
+	return bits;
+}
+
+static int popCount(unsigned long long bits)
+{
+	int count = 0;
+	for(; bits; bits &= bits - 1) {
+		count++;
+	}
+	return count;
+}
+
+// Returns the lowest set bit of bits, which must not be 0
+static int lowestBit(unsigned long long bits)
+{
+	int bit = 0;
+	while(!((bits >> bit) & 1)) {
+		bit++;
+	}
+	return bit;
+}
+
+/**
+ * The list of legal moves a move is numbered in, built from the bitboards
+ * of Board::legalMoves without making a single BoardMove.
+ */
+struct MoveList {
+	MoveList(const Board & board, Piece::Color color) :
+		m_board(board),
+		m_count(0)
+	{
+		board.legalMoves(color, m_legal);
+
+		// A pawn on the rank before the last only has promotions
+		int rank0 = (color == Piece::WHITE) ? 6 : 1;
+		unsigned long long pawns = (unsigned long long)
+			board.getPieces(color, Piece::PAWN).getBoard();
+		for(int sq = 0; sq < 64; sq++) {
+			bool promotes = (sq / 8 == rank0) && ((pawns >> sq) & 1);
+			m_weights[sq] = popCount(m_legal[sq]) * (promotes ? 4 : 1);
+			m_count += m_weights[sq];
+		}
+	}
+
+	int getCount() const
+		{ return m_count; }
+
+	const unsigned long long * getLegal() const
+		{ return m_legal; }
+
+	/** Returns the number of bm in the list, -1 if it isn't legal. */
+	int indexOf(const BoardMove & bm) const
+	{
+		int origin = bm.origin().hash();
+		int dest = bm.dest().hash();
+		if(!bm.isValid() || !((m_legal[origin] >> dest) & 1)) {
+			return -1;
+		}
+
+		int index = 0;
+		for(int sq = 0; sq < origin; sq++) {
+			index += m_weights[sq];
+		}
+		unsigned long long before = m_legal[origin] & ((1ULL << dest) - 1);
+		if(m_weights[origin] == popCount(m_legal[origin])) {
+			return index + popCount(before);
+		}
+
+		for(int i = 0; i < 4; i++) {
+			if(bm.getPromotion() == PROMOTIONS[i]) {
+				return index + popCount(before) * 4 + i;
+			}
+		}
+		return -1;
+	}
+
+	/** Returns the move numbered index, which must be less than getCount(). */
+	BoardMove moveAt(int index) const
+	{
+		int origin = 0;
+		while(index >= m_weights[origin]) {
+			index -= m_weights[origin++];
+		}
+
+		int per = (m_weights[origin] == popCount(m_legal[origin])) ? 1 : 4;
+		unsigned long long dests = m_legal[origin];
+		for(int i = index / per; i > 0; i--) {
+			dests &= dests - 1;
+		}
+		BoardPosition from(origin), to(lowestBit(dests));
+		return BoardMove(from, to, m_board.getPiece(from),
+			per == 4 ? PROMOTIONS[index % 4] : Piece::NOTYPE);
+	}
+
+ private:
+	const Board & m_board;
+	unsigned long long m_legal[64];
+	int m_weights[64];
+	int m_count;
+};
+
+// Packs bits into bytes, lowest first
+struct BitWriter {
+	explicit BitWriter(vector<unsigned char> & out) :
+		m_out(out),
+		m_bits(0),
+		m_count(0) {}
+
+	void write(unsigned value, int bits)
+	{
+		m_bits |= value << m_count;
+		m_count += bits;
+		while(m_count >= 8) {
+			m_out.push_back((unsigned char)m_bits);
+			m_bits >>= 8;
+			m_count -= 8;
+		}
+	}
+
+	void flush()
+	{
+		if(m_count > 0) {
+			m_out.push_back((unsigned char)m_bits);
+		}
+		m_bits = 0;
+		m_count = 0;
+	}
+
+ private:
+	vector<unsigned char> & m_out;
+	unsigned m_bits;
+	int m_count;
+};
+
+struct BitReader {
+	BitReader(const unsigned char * data, const unsigned char * end) :
+		m_data(data),
+		m_end(end),
+		m_bits(0),
+		m_count(0) {}
+
+	/** Returns the next value, -1 if the data runs out. */
+	int read(int bits)
+	{
+		while(m_count < bits) {
+			if(m_data == m_end) {
+				return -1;
+			}
+			m_bits |= (unsigned)*m_data++ << m_count;
+			m_count += 8;
+		}
+		int value = (int)(m_bits & ((1u << bits) - 1));
+		m_bits >>= bits;
+		m_count -= bits;
+		return value;
+	}
+
+ private:
+	const unsigned char * m_data;
+	const unsigned char * m_end;
+	unsigned m_bits;
+	int m_count;
+};
+
+// Sets board to the starting position of a game, the initial one if fen
+// is empty
+static bool startPosition(string_view fen, Board & board, Piece::Color & turn)
+{
+	FenInfo info;
+	if(fen.empty()) {
+		// Read once, copying a board is cheaper than parsing it
+		static const Board start = []() {
+			Board board;
+			FenInfo info;
+			parseFEN(START_FEN, board, info);
+			return board;
+		}();
+		board = start;
+		turn = Piece::WHITE;
+		return true;
+	}
+	if(!parseFEN(fen, board, info)) {
+		return false;
+	}
+	turn = info.turn;
+	return true;
+}
+
+// Reads a number of at most digits digits, 0 if it is unknown
+static int parseDatePart(string_view text, size_t & pos, int digits)
+{
+	int value = 0;
+	for(int i = 0; i < digits && pos < text.size() && text[pos] != '.'; i++, pos++) {
+		if(text[pos] < '0' || text[pos] > '9') {
+			value = -1;
+		} else if(value >= 0) {
+			value = value * 10 + (text[pos] - '0');
+		}
+	}
+	if(pos < text.size() && text[pos] == '.') {
+		pos++;
+	}
+	return value > 0 ? value : 0;
+}
+
+// Writes a date as a PGN Date tag, the unknown parts as question marks
+static string formatDate(int date)
+{
+	char text[16];
+	int year = date / 10000, month = date / 100 % 100, day = date % 100;
+	snprintf(text, sizeof(text), "%04d.%02d.%02d", year, month, day);
+	string result(text);
+	if(!year) {
+		result.replace(0, 4, "????");
+	}
+	if(!month) {
+		result.replace(5, 2, "??");
+	}
+	if(!day) {
+		result.replace(8, 2, "??");
+	}
+	return result;
+}
+
+void GameHeader::setTags(const PgnGameView & game)
+{
+	for(int i = 0; i < TAGS; i++) {
+		tags[i] = PgnReader::unescape(game.getTag(TAG_NAMES[i]));
+	}
+
+	string_view text = game.getTag("Date");
+	size_t pos = 0;
+	int year = parseDatePart(text, pos, 4);
+	int month = parseDatePart(text, pos, 2);
+	int day = parseDatePart(text, pos, 2);
+	date = (year > 9999 ? 0 : year) * 10000 + (month > 12 ? 0 : month) * 100 +
+		(day > 31 ? 0 : day);
+
+	int * elos[2] = { &whiteelo, &blackelo };
+	const char * names[2] = { "WhiteElo", "BlackElo" };
+	for(int i = 0; i < 2; i++) {
+		string value(game.getTag(names[i]));
+		long elo = strtol(value.c_str(), 0, 10);
+		*elos[i] = (elo > 0 && elo <= 0xffff) ? (int)elo : 0;
+	}
+
+	result = parseResult(game.result.empty() ? game.getTag("Result") : game.result);
+}
+
+void GameHeader::addTags(PgnGame & game) const
+{
+	for(int i = EVENT; i <= BLACK; i++) {
+		if(i == ROUND) {
+			game.addTag("Date", formatDate(date));
+		}
+		game.addTag(TAG_NAMES[i], tags[i].empty() ? "?" : tags[i]);
+	}
+	game.addTag("Result", resultName(result));
+
+	if(whiteelo) {
+		game.addTag("WhiteElo", to_string(whiteelo));
+	}
+	if(blackelo) {
+		game.addTag("BlackElo", to_string(blackelo));
+	}
+	if(!tags[ECO].empty()) {
+		game.addTag("ECO", tags[ECO]);
+	}
+	if(!tags[FEN].empty()) {
+		game.setFEN(tags[FEN]);
+	}
+}
+
+GameHeader::Result GameHeader::parseResult(string_view text)
+{
+	for(int i = WHITE_WINS; i <= DRAW; i++) {
+		if(text == resultName((Result)i)) {
+			return (Result)i;
+		}
+	}
+	return UNKNOWN;
+}
+
+const char * GameHeader::resultName(Result result)
+{
+	switch(result) {
+		case WHITE_WINS:
+			return "1-0";
+		case BLACK_WINS:
+			return "0-1";
+		case DRAW:
+			return "1/2-1/2";
+		default:
+			return "*";
+	}
+}
+
+bool EncodedGame::encode(const PgnGameView & game)
+{
+	header = GameHeader();
+	header.setTags(game);
+	plies = 0;
+	moves.clear();
+
+	Board board;
+	Piece::Color turn;
+	if(!startPosition(header.tags[GameHeader::FEN], board, turn)) {
+		return false;
+	}
+
+	BitWriter writer(moves);
+	for(int i = 0; i < (int)game.moves.size(); i++) {
+		MoveList list(board, turn);
+		BoardMove bm = sanToMove(board, turn, list.getLegal(), game.moves[i]);
+		int index = list.indexOf(bm);
+		if(index < 0 || plies == 0xffff) {
+			return false;
+		}
+		writer.write(index, indexBits(list.getCount()));
+		board.update(bm);
+		turn = Piece::opposite(turn);
+		plies++;
+	}
+	writer.flush();
+	return true;
+}
+
+bool EncodedGame::encode(const GameHeader & header, const vector<BoardMove> & moves)
+{
+	this->header = header;
+	plies = 0;
+	this->moves.clear();
+
+	Board board;
+	Piece::Color turn;
+	if(!startPosition(header.tags[GameHeader::FEN], board, turn)) {
+		return false;
+	}
+
+	BitWriter writer(this->moves);
+	for(int i = 0; i < (int)moves.size(); i++) {
+		MoveList list(board, turn);
+		int index = list.indexOf(moves[i]);
+		if(index < 0 || plies == 0xffff) {
+			return false;
+		}
+		writer.write(index, indexBits(list.getCount()));
+		board.update(list.moveAt(index));
+		turn = Piece::opposite(turn);
+		plies++;
+	}
+	writer.flush();
+	return true;
+}
+
+bool GameDatabase::open(const string & filename)
+{
+	close();
+	if(!m_file.open(filename)) {
+		return false;
+	}
+
+	const char * data = m_file.getData();
+	size_t size = m_file.getSize();
+	const FileHeader * header = (const FileHeader *)data;
+	if(size < sizeof(FileHeader) || memcmp(header->magic, FILE_MAGIC, 8) ||
+			header->version != VERSION || header->blockgames != BLOCK_GAMES) {
+		close();
+		return false;
+	}
+
+	size_t pos = align(sizeof(FileHeader));
+	while(pos < size) {
+		const GameBlock * block = (const GameBlock *)(data + pos);
+		bool valid = size - pos >= BLOCK_HEADER_SIZE &&
+			!memcmp(block->magic, BLOCK_MAGIC, 4) &&
+			block->games > 0 && block->games <= BLOCK_GAMES &&
+			block->size <= size - pos && block->size % 8 == 0 &&
+			data[pos + block->size - 1] == '\0';
+		// Only the last block may be short
+		valid = valid && (m_blocks.empty() ||
+			m_blocks.back()->games == BLOCK_GAMES);
+		for(int i = 0; valid && i < COLUMNS; i++) {
+			valid = block->columns[i] >= BLOCK_HEADER_SIZE &&
+				block->columns[i] + columnSize(i, block->games) <= block->size;
+		}
+		if(!valid) {
+			close();
+			return false;
+		}
+
+		m_blocks.push_back(block);
+		m_games += block->games;
+		pos += block->size;
+	}
+	return true;
+}
+
+void GameDatabase::close()
+{
+	m_file.close();
+	m_blocks.clear();
+	m_games = 0;
+}
+
+const GameBlock * GameDatabase::findBlock(long long n, int & index) const
+{
+	index = (int)(n % BLOCK_GAMES);
+	return m_blocks[n / BLOCK_GAMES];
+}
+
+// Returns column of block as an array of T
+template<class T>
+static const T * column(const GameBlock * block, int column)
+{
+	return (const T *)((const char *)block + block->columns[column]);
+}
+
+GameHeader::Result GameDatabase::getResult(long long n) const
+{
+	int index;
+	const GameBlock * block = findBlock(n, index);
+	return (GameHeader::Result)column<uint8_t>(block, RESULTS)[index];
+}
+
+int GameDatabase::getPlies(long long n) const
+{
+	int index;
+	const GameBlock * block = findBlock(n, index);
+	return column<uint16_t>(block, PLIES)[index];
+}
+
+int GameDatabase::getDate(long long n) const
+{
+	int index;
+	const GameBlock * block = findBlock(n, index);
+	return column<uint32_t>(block, DATES)[index];
+}
+
+int GameDatabase::getWhiteElo(long long n) const
+{
+	int index;
+	const GameBlock * block = findBlock(n, index);
+	return column<uint16_t>(block, WHITE_ELOS)[index];
+}
+
+int GameDatabase::getBlackElo(long long n) const
+{
+	int index;
+	const GameBlock * block = findBlock(n, index);
+	return column<uint16_t>(block, BLACK_ELOS)[index];
+}
+
+string_view GameDatabase::getTag(long long n, GameHeader::Tag tag) const
+{
+	int index;
+	const GameBlock * block = findBlock(n, index);
+	uint32_t offset = column<uint32_t>(block, TAG_OFFSETS + tag)[index];
+	if(offset >= block->size - block->columns[STRINGS]) {
+		return string_view();
+	}
+	return string_view(column<char>(block, STRINGS) + offset);
+}
+
+void GameDatabase::getHeader(long long n, GameHeader & header) const
+{
+	for(int i = 0; i < GameHeader::TAGS; i++) {
+		header.tags[i] = getTag(n, (GameHeader::Tag)i);
+	}
+	header.date = getDate(n);
+	header.whiteelo = getWhiteElo(n);
+	header.blackelo = getBlackElo(n);
+	header.result = getResult(n);
+}
+
+bool GameDatabase::readMoves(long long n, vector<BoardMove> & moves, Board * board) const
+{
+	moves.clear();
+	return decode(n, -1, &moves, 0, board);
+}
+
+bool GameDatabase::readKeys(long long n, vector<unsigned long long> & keys, int plies) const
+{
+	keys.clear();
+	return decode(n, plies, 0, &keys, 0);
+}
+
+bool GameDatabase::decode(long long n, int plies, vector<BoardMove> * moves,
+	vector<unsigned long long> * keys, Board * board) const
+{
+	int index;
+	const GameBlock * block = findBlock(n, index);
+	const uint32_t * offsets = column<uint32_t>(block, MOVE_OFFSETS);
+	size_t available = block->size - block->columns[MOVE_DATA];
+	if(offsets[index] > offsets[index + 1] || offsets[index + 1] > available) {
+		return false;
+	}
+	const unsigned char * data = column<unsigned char>(block, MOVE_DATA);
+	BitReader reader(data + offsets[index], data + offsets[index + 1]);
+
+	Board local;
+	Board & position = board ? *board : local;
+	Piece::Color turn;
+	if(!startPosition(getTag(n, GameHeader::FEN), position, turn)) {
+		return false;
+	}
+	if(keys) {
+		keys->push_back(position.getKey(turn));
+	}
+
+	int stored = column<uint16_t>(block, PLIES)[index];
+	if(plies < 0 || plies > stored) {
+		plies = stored;
+	}
+	for(int i = 0; i < plies; i++) {
+		MoveList list(position, turn);
+		int number = reader.read(indexBits(list.getCount()));
+		if(number < 0 || number >= list.getCount()) {
+			return false;
+		}
+		BoardMove bm = list.moveAt(number);
+		position.update(bm);
+		turn = Piece::opposite(turn);
+		if(moves) {
+			moves->push_back(bm);
+		}
+		if(keys) {
+			keys->push_back(position.getKey(turn));
+		}
+	}
+	return true;
+}
+
+// Returns the name of the tail file of a database
+static string tailName(const string & filename)
+{
+	return filename + ".tail";
+}
+
+// Writes out what is buffered for file and waits for the disk
+static bool syncFile(FILE * file)
+{
+	if(fflush(file)) {
+		return false;
+	}
+#ifndef WIN32
+	return fsync(fileno(file)) == 0;
+#else
+	return true;
+#endif
+}
+
+// Puts the blocks of a complete tail file in place of the short last
+// block of the database. Cutting the database and appending can be done
+// over and over, so a crash meanwhile is finished by the next call. An
+// incomplete tail never touched the database and is thrown away.
+static bool finishTail(const string & filename)
+{
+	string tailname = tailName(filename);
+	FILE * tail = fopen(tailname.c_str(), "rb");
+	if(!tail) {
+		return true;
+	}
+
+	TailHeader header;
+	bool ok = true;
+	if(fread(&header, sizeof(header), 1, tail) == 1 &&
+			!memcmp(header.magic, TAIL_MAGIC, sizeof(header.magic)) &&
+			header.complete) {
+		// The kept part is never cut off, a tail that says so is damaged
+		error_code error;
+		uintmax_t size = filesystem::file_size(filename, error);
+		if(!error && header.keep > size) {
+			error = make_error_code(errc::invalid_argument);
+		}
+		if(!error) {
+			filesystem::resize_file(filename, header.keep, error);
+		}
+		FILE * file = error ? 0 : fopen(filename.c_str(), "ab");
+		ok = file != 0;
+
+		char buffer[65536];
+		size_t n;
+		while(ok && (n = fread(buffer, 1, sizeof(buffer), tail)) > 0) {
+			ok = fwrite(buffer, 1, n, file) == n;
+		}
+		ok = ok && !ferror(tail);
+		if(file) {
+			ok = syncFile(file) && ok;
+			ok = !fclose(file) && ok;
+		}
+	}
+	fclose(tail);
+
+	if(ok) {
+		remove(tailname.c_str());
+	}
+	return ok;
+}
+
+GameDatabaseWriter::~GameDatabaseWriter()
+{
+	close();
+}
+
+bool GameDatabaseWriter::open(const string & filename)
+{
+	close();
+	m_error = false;
+	m_games = 0;
+	if(!finishTail(filename)) {
+		return false;
+	}
+
+	error_code error;
+	uintmax_t size = filesystem::file_size(filename, error);
+	if(error || size == 0) {
+		m_file = fopen(filename.c_str(), "wb");
+		if(!m_file) {
+			return false;
+		}
+		FileHeader header;
+		memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+		header.version = VERSION;
+		header.blockgames = GameDatabase::BLOCK_GAMES;
+		fwrite(&header, sizeof(header), 1, m_file);
+		return !ferror(m_file);
+	}
+
+	// A short last block is taken back and written again with the new games
+	vector<EncodedGame> partial;
+	size_t keep = size;
+	{
+		GameDatabase db;
+		if(!db.open(filename)) {
+			return false;
+		}
+		m_games = db.getGameCount();
+		if(!db.m_blocks.empty() && db.m_blocks.back()->games < GameDatabase::BLOCK_GAMES) {
+			const GameBlock * block = db.m_blocks.back();
+			keep = (const char *)block - db.m_file.getData();
+			partial.resize(block->games);
+
+			const uint32_t * offsets = column<uint32_t>(block, MOVE_OFFSETS);
+			const unsigned char * data = column<unsigned char>(block, MOVE_DATA);
+			long long first = m_games - block->games;
+			for(int i = 0; i < (int)block->games; i++) {
+				db.getHeader(first + i, partial[i].header);
+				partial[i].plies = db.getPlies(first + i);
+				partial[i].moves.assign(data + offsets[i], data + offsets[i + 1]);
+			}
+			m_games = first;
+		}
+	}
+
+	if(keep == size) {
+		m_file = fopen(filename.c_str(), "ab");
+		return m_file != 0;
+	}
+
+	// The short block stays in the database until the blocks replacing it
+	// are on the disk
+	m_file = fopen(tailName(filename).c_str(), "wb");
+	if(!m_file) {
+		return false;
+	}
+	TailHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TAIL_MAGIC, sizeof(header.magic));
+	header.keep = keep;
+	fwrite(&header, sizeof(header), 1, m_file);
+	m_tail = true;
+	m_filename = filename;
+	for(int i = 0; i < (int)partial.size(); i++) {
+		add(partial[i]);
+	}
+	return !ferror(m_file);
+}
+
+bool GameDatabaseWriter::close()
+{
+	if(!m_file) {
+		return !m_error;
+	}
+	if(!m_plies.empty()) {
+		writeBlock();
+	}
+
+	// The tail is only marked complete once its blocks are on the disk
+	if(m_tail && !m_error) {
+		uint32_t complete = 1;
+		if(!syncFile(m_file) ||
+				fseek(m_file, offsetof(TailHeader, complete), SEEK_SET) ||
+				fwrite(&complete, sizeof(complete), 1, m_file) != 1 ||
+				!syncFile(m_file)) {
+			m_error = true;
+		}
+	}
+	if(fclose(m_file)) {
+		m_error = true;
+	}
+	m_file = 0;
+
+	if(m_tail && !m_error && !finishTail(m_filename)) {
+		m_error = true;
+	}
+	m_tail = false;
+	return !m_error;
+}
+
+void GameDatabaseWriter::add(const EncodedGame & game)
+{
+	if(m_plies.empty()) {
+		m_move_offsets.assign(1, 0);
+		m_strings.assign(1, '\0');
+		m_string_offsets.clear();
+	}
+
+	m_plies.push_back((uint16_t)game.plies);
+	m_results.push_back((uint8_t)game.header.result);
+	m_dates.push_back(game.header.date);
+	m_elos[0].push_back((uint16_t)game.header.whiteelo);
+	m_elos[1].push_back((uint16_t)game.header.blackelo);
+
+	// Names repeat a lot within a block, each is stored once
+	for(int i = 0; i < GameHeader::TAGS; i++) {
+		const string & tag = game.header.tags[i];
+		uint32_t offset = 0;
+		if(!tag.empty()) {
+			unordered_map<string, uint32_t>::iterator it = m_string_offsets.find(tag);
+			if(it != m_string_offsets.end()) {
+				offset = it->second;
+			} else {
+				offset = (uint32_t)m_strings.size();
+				m_strings.append(tag.c_str(), tag.size() + 1);
+				m_string_offsets[tag] = offset;
+			}
+		}
+		m_tags[i].push_back(offset);
+	}
+
+	m_moves.insert(m_moves.end(), game.moves.begin(), game.moves.end());
+	m_move_offsets.push_back((uint32_t)m_moves.size());
+	m_games++;
+
+	if(m_plies.size() == GameDatabase::BLOCK_GAMES) {
+		writeBlock();
+	}
+}
+
+bool GameDatabaseWriter::writeBlock()
+{
+	size_t games = m_plies.size();
+	const void * columns[COLUMNS];
+	size_t sizes[COLUMNS];
+	columns[MOVE_OFFSETS] = m_move_offsets.data();
+	columns[PLIES] = m_plies.data();
+	columns[RESULTS] = m_results.data();
+	columns[DATES] = m_dates.data();
+	columns[WHITE_ELOS] = m_elos[0].data();
+	columns[BLACK_ELOS] = m_elos[1].data();
+	for(int i = 0; i < GameHeader::TAGS; i++) {
+		columns[TAG_OFFSETS + i] = m_tags[i].data();
+	}
+	columns[MOVE_DATA] = m_moves.data();
+	columns[STRINGS] = m_strings.data();
+	for(int i = 0; i < COLUMNS; i++) {
+		sizes[i] = columnSize(i, games);
+	}
+	sizes[MOVE_DATA] = m_moves.size();
+	sizes[STRINGS] = m_strings.size();
+
+	GameBlock header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BLOCK_MAGIC, sizeof(header.magic));
+	header.games = (uint32_t)games;
+	size_t size = BLOCK_HEADER_SIZE;
+	for(int i = 0; i < COLUMNS; i++) {
+		header.columns[i] = (uint32_t)size;
+		size += align(sizes[i]);
+	}
+	header.size = size;
+
+	string block(size, '\0');
+	memcpy(&block[0], &header, sizeof(header));
+	for(int i = 0; i < COLUMNS; i++) {
+		memcpy(&block[header.columns[i]], columns[i], sizes[i]);
+	}
+	if(fwrite(block.data(), 1, block.size(), m_file) != block.size()) {
+		m_error = true;
+	}
+
+	m_move_offsets.clear();
+	m_plies.clear();
+	m_results.clear();
+	m_dates.clear();
+	m_elos[0].clear();
+	m_elos[1].clear();
+	for(int i = 0; i < GameHeader::TAGS; i++) {
+		m_tags[i].clear();
+	}
+	m_moves.clear();
+	m_strings.clear();
+	m_string_offsets.clear();
+	return !m_error;
+}
+
+// End of file gamedb.cpp
@@ -0,0 +1,260 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : gamedb.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef GAMEDB_H
+#define GAMEDB_H
+
+#include "board.h"
+#include "boardmove.h"
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct PgnGame;
+struct PgnGameView;
+
+/**
+ * The tags of a game that a GameDatabase keeps.
+ */
+struct GameHeader {
+	enum Result {
+		UNKNOWN,
+		WHITE_WINS,
+		BLACK_WINS,
+		DRAW
+	};
+
+	/** The text tags, in the order of the database columns. */
+	enum Tag {
+		EVENT,
+		SITE,
+		ROUND,
+		WHITE,
+		BLACK,
+		ECO,
+		/** Starting position, empty for the initial one */
+		FEN
+	};
+	static const int TAGS = FEN + 1;
+
+	GameHeader() :
+		date(0),
+		whiteelo(0),
+		blackelo(0),
+		result(UNKNOWN) {}
+
+	/** Takes the header from the tags of a PGN game. */
+	void setTags(const PgnGameView & game);
+
+	/** Adds the header to a PGN game, the seven tag roster first. */
+	void addTags(PgnGame & game) const;
+
+	/** Reads a PGN result, UNKNOWN if it isn't one. */
+	static Result parseResult(std::string_view text);
+
+	/** Returns the PGN result, "*" for UNKNOWN. */
+	static const char * resultName(Result result);
+
+	std::string tags[TAGS];
+	/** As yyyymmdd, the parts that aren't known are 0 */
+	int date;
+	/** Ratings, 0 if not known */
+	int whiteelo, blackelo;
+	Result result;
+};
+
+/**
+ * A game with its moves encoded the way a GameDatabase stores them, ready
+ * to be added. Encoding replays the game, so it is the part worth doing
+ * on many threads.
+ */
+struct EncodedGame {
+	EncodedGame() : plies(0) {}
+
+	/**
+	 * Encodes the main line of a PGN game. Returns false if the starting
+	 * position can't be read or a move isn't legal.
+	 */
+	bool encode(const PgnGameView & game);
+
+	/**
+	 * Encodes moves played from the starting position of header. Returns
+	 * false if one isn't legal.
+	 */
+	bool encode(const GameHeader & header, const std::vector<BoardMove> & moves);
+
+	GameHeader header;
+	int plies;
+	std::vector<unsigned char> moves;
+};
+
+/**
+ * A binary database of games, read through a MappedFile. Games take a
+ * fraction of their PGN size and replay without parsing.
+ *
+ * Each move is stored as its number in the list of legal moves, in as
+ * many bits as that list needs: none for a forced move, 5 bits for 20
+ * moves, never more than 8. The list is the order of Board::legalMoves,
+ * origin then destination square, promotions to queen, rook, bishop and
+ * knight.
+ *
+ * The file is a short header followed by blocks of BLOCK_GAMES games,
+ * only the last one may hold fewer. A block stores every header field
+ * as a column, so that scanning one field touches nothing else, then
+ * the moves and the strings of its games. Game N is in block
+ * N / BLOCK_GAMES, found in constant time.
+ *
+ * Numbers are stored little-endian, as they are in memory on the machines
+ * this runs on. Many threads may read one GameDatabase at once. Like the
+ * rest of the move generation, encoding and decoding need Board::init().
+ */
+class GameDatabase {
+ public:
+	GameDatabase() :
+		m_games(0) {}
+
+	/** Games in a block. */
+	static const int BLOCK_GAMES = 4096;
+
+	/** Opens a database, returns false if it can't be read. */
+	bool open(const std::string & filename);
+
+	void close();
+
+	bool isOpen() const
+		{ return m_file.isOpen(); }
+
+	long long getGameCount() const
+		{ return m_games; }
+
+	/** Returns the size of the file in bytes. */
+	size_t getSize() const
+		{ return m_file.getSize(); }
+
+	GameHeader::Result getResult(long long n) const;
+
+	int getPlies(long long n) const;
+
+	int getDate(long long n) const;
+
+	int getWhiteElo(long long n) const;
+
+	int getBlackElo(long long n) const;
+
+	/** Returns a text tag of game n, empty if it has none. */
+	std::string_view getTag(long long n, GameHeader::Tag tag) const;
+
+	/** Copies out the whole header of game n. */
+	void getHeader(long long n, GameHeader & header) const;
+
+	/**
+	 * Decodes the moves of game n. Returns false if they can't be, the
+	 * file is damaged then.
+	 * @param n - The game, from 0.
+	 * @param moves - Filled with the moves.
+	 * @param board - Left at the position after the last move, if not null.
+	 */
+	bool readMoves(long long n, std::vector<BoardMove> & moves, Board * board = 0) const;
+
+	/**
+	 * Decodes the keys of the positions of game n, see Board::getKey.
+	 * Returns false if the file is damaged.
+	 * @param n - The game, from 0.
+	 * @param keys - Filled with the keys, the starting position's first.
+	 * @param plies - Moves to decode, all of them if negative.
+	 */
+	bool readKeys(long long n, std::vector<unsigned long long> & keys, int plies = -1) const;
+
+ private:
+	friend class GameDatabaseWriter;
+
+	GameDatabase(const GameDatabase &);
+	GameDatabase & operator=(const GameDatabase &);
+
+	// Returns the block header of game n and sets index to its place there
+	const struct GameBlock * findBlock(long long n, int & index) const;
+
+	// Decodes up to plies moves of game n into whichever of moves, keys
+	// and board aren't null
+	bool decode(long long n, int plies, std::vector<BoardMove> * moves,
+		std::vector<unsigned long long> * keys, Board * board) const;
+
+	MappedFile m_file;
+	std::vector<const struct GameBlock *> m_blocks;
+	long long m_games;
+};
+
+/**
+ * Adds games to a GameDatabase file, creating it if needed. Games are
+ * gathered in memory and written a block at a time. To add to an
+ * existing file with a partly filled last block, that block is read back
+ * and written again with the new games. These blocks go to a tail file
+ * next to the database, which takes the place of the short block only
+ * once it is on the disk, when the writer is closed. A writer that died
+ * before is finished, or its tail thrown away, by the next open().
+ *
+ * A writer belongs to one thread. Don't read a file while it is written.
+ */
+class GameDatabaseWriter {
+ public:
+	GameDatabaseWriter() :
+		m_file(0),
+		m_tail(false),
+		m_games(0),
+		m_error(false) {}
+
+	/** Writes what is left and closes the file. */
+	~GameDatabaseWriter();
+
+	/** Opens a database for adding games, returns false if it can't. */
+	bool open(const std::string & filename);
+
+	/** Writes the last block and closes the file. Returns false on errors. */
+	bool close();
+
+	/** Adds a game, it is written once its block is full. */
+	void add(const EncodedGame & game);
+
+	/** Returns the number of games in the file, including those added. */
+	long long getGameCount() const
+		{ return m_games; }
+
+ private:
+	GameDatabaseWriter(const GameDatabaseWriter &);
+	GameDatabaseWriter & operator=(const GameDatabaseWriter &);
+
+	// Writes out the games gathered so far as a block
+	bool writeBlock();
+
+	FILE * m_file;
+	// Set while the blocks go to the tail file of m_filename
+	bool m_tail;
+	std::string m_filename;
+	long long m_games;
+	bool m_error;
+
+	// The block being gathered, column by column
+	std::vector<uint32_t> m_move_offsets;
+	std::vector<uint16_t> m_plies;
+	std::vector<uint8_t> m_results;
+	std::vector<uint32_t> m_dates;
+	std::vector<uint16_t> m_elos[2];
+	std::vector<uint32_t> m_tags[GameHeader::TAGS];
+	std::vector<unsigned char> m_moves;
+	std::string m_strings;
+	std::unordered_map<std::string, uint32_t> m_string_offsets;
+};
+
+#endif // GAMEDB_H
+
+// End of file gamedb.h
@@ -6,11 +6,11 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey
  **************************************************************************/
 
-#include <iostream>
 #include <string>
 
 #include "boardtheme.h"
 #include "config.h"
+#include "logger.h"
 #include "SDL_opengl.h"
 #include "texture.h"
 
@@ -227,7 +227,7 @@ bool GraniteTheme::load()
 	} else if(m_blacktexture.load(ART_DIR + string("marblehugeblack.png"))) {
 		// add debugging
 	} else {
-		cerr << "Failed to load marblehugeblack.png texture" << endl;
+		LOG_ERROR("theme", "Failed to load marblehugeblack.png texture");
 		return false;
 	}
 
@@ -236,7 +236,7 @@ bool GraniteTheme::load()
 	} else if(m_whitetexture.load(ART_DIR + string("marblehugewhite.png"))) {
 		// add debugging
 	} else {
-		cerr << "Failed to load marblehugewhite.png texture" << endl;
+		LOG_ERROR("theme", "Failed to load marblehugewhite.png texture");
 		return false;
 	}
 
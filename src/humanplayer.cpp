@@ -8,9 +8,10 @@
 
 #include "boardmove.h"
 #include "chessplayer.h"
-#include "SDL.h"
 
+#include <chrono>
 #include <iostream>
+#include <thread>
 
 using namespace std;
 
@@ -20,18 +21,38 @@ HumanPlayer::HumanPlayer()
 	m_trustworthy = false;
 }
 
-void HumanPlayer::think(const ChessGameState & cgs)
+void HumanPlayer::think(const ChessGameState &)
 {
 	m_move.invalidate();
-	while(!m_move.isValid())
+	m_is_thinking = true;
+	while(!m_move.isValid() && m_is_thinking)
 	{
-		SDL_Delay(50);
+		this_thread::sleep_for(chrono::milliseconds(50));
 	}
+	m_is_thinking = false;
+}
+
+MoveRequestPtr HumanPlayer::requestMove(const ChessGameStatePtr &,
+	const SearchLimits &, const MoveCallback & callback)
+{
+	MoveRequestPtr request(new MoveRequest(this, callback, false));
+	lock_guard<mutex> lock(m_request_mutex);
+	m_request = request;
+	return request;
 }
 
 void HumanPlayer::sendMove(const BoardMove & m)
 {
-	m_move = m;
+	MoveRequestPtr request;
+	{
+		lock_guard<mutex> lock(m_request_mutex);
+		request.swap(m_request);
+	}
+	if(request) {
+		request->complete(m);
+	} else {
+		m_move = m;
+	}
 }
 
 // End of file humanplayer.cpp
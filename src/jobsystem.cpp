@@ -0,0 +1,236 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : jobsystem.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "jobsystem.h"
+
+#include <chrono>
+
+using namespace std;
+
+JobSystem * JobSystem::m_instance = 0;
+mutex JobSystem::m_instance_mutex;
+int JobSystem::m_thread_count = 0;
+
+// Index of the worker running on this thread, -1 for other threads
+static thread_local int t_worker = -1;
+
+void JobStateBase::wait()
+{
+	if(m_ready) {
+		return;
+	}
+
+	// A worker that just blocked could starve the job it waits for
+	if(JobSystem::isWorkerThread()) {
+		JobSystem * jobs = JobSystem::getInstance();
+		while(!m_ready) {
+			if(!jobs->runPending()) {
+				unique_lock<mutex> lock(m_mutex);
+				m_cond.wait_for(lock, chrono::milliseconds(1));
+			}
+		}
+		return;
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+	while(!m_ready) {
+		m_cond.wait(lock);
+	}
+}
+
+void JobStateBase::addContinuation(const function<void()> & cont)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if(!m_ready) {
+			m_continuations.push_back(cont);
+			return;
+		}
+	}
+	cont();
+}
+
+void JobStateBase::finish()
+{
+	vector<function<void()> > continuations;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_ready = true;
+		continuations.swap(m_continuations);
+	}
+	m_cond.notify_all();
+
+	for(int i = 0; i < (int)continuations.size(); i++) {
+		continuations[i]();
+	}
+}
+
+JobSystem * JobSystem::getInstance()
+{
+	lock_guard<mutex> lock(m_instance_mutex);
+	if(!m_instance) {
+		int threads = m_thread_count;
+		if(threads <= 0) {
+			threads = thread::hardware_concurrency();
+		}
+		if(threads < 2) {
+			threads = 2;
+		}
+		m_instance = new JobSystem(threads);
+	}
+	return m_instance;
+}
+
+void JobSystem::destroy()
+{
+	// Jobs that are still running may look up the instance
+	JobSystem * instance;
+	{
+		lock_guard<mutex> lock(m_instance_mutex);
+		instance = m_instance;
+	}
+	delete instance;
+
+	lock_guard<mutex> lock(m_instance_mutex);
+	m_instance = 0;
+}
+
+void JobSystem::setThreadCount(int threads)
+{
+	lock_guard<mutex> lock(m_instance_mutex);
+	m_thread_count = threads;
+}
+
+bool JobSystem::isWorkerThread()
+{
+	return t_worker >= 0;
+}
+
+JobSystem::JobSystem(int threads) :
+	m_pending(0),
+	m_quit(false)
+{
+	for(int i = 0; i < threads * PRIORITIES; i++) {
+		m_local.push_back(unique_ptr<Queue>(new Queue));
+	}
+	for(int i = 0; i < threads; i++) {
+		m_workers.push_back(thread(&JobSystem::workerLoop, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		lock_guard<mutex> lock(m_sleep_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for(int i = 0; i < (int)m_workers.size(); i++) {
+		m_workers[i].join();
+	}
+}
+
+void JobSystem::schedule(Priority priority, const function<void()> & job)
+{
+	// Workers keep what they create, the others share a queue
+	Queue & queue = (t_worker >= 0) ?
+		localQueue(t_worker, priority) : m_global[priority];
+	{
+		lock_guard<mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+
+	{
+		lock_guard<mutex> lock(m_sleep_mutex);
+		m_pending++;
+	}
+	m_wake.notify_one();
+}
+
+bool JobSystem::runPending()
+{
+	function<void()> job;
+	if(!findJob(t_worker, job)) {
+		return false;
+	}
+	job();
+	return true;
+}
+
+void JobSystem::workerLoop(int index)
+{
+	t_worker = index;
+
+	function<void()> job;
+	while(true) {
+		if(findJob(index, job)) {
+			job();
+			job = function<void()>();
+			continue;
+		}
+
+		unique_lock<mutex> lock(m_sleep_mutex);
+		if(m_quit && m_pending <= 0) {
+			break;
+		}
+		while(!m_quit && m_pending <= 0) {
+			m_wake.wait(lock);
+		}
+	}
+}
+
+bool JobSystem::findJob(int worker, function<void()> & job)
+{
+	// Can be below zero for a moment, a job is counted after it's queued
+	if(m_pending <= 0) {
+		return false;
+	}
+
+	int workers = (int)m_workers.size();
+	for(int priority = 0; priority < PRIORITIES; priority++) {
+		if(worker >= 0 && popBack(localQueue(worker, priority), job)) {
+			return true;
+		}
+		if(popFront(m_global[priority], job)) {
+			return true;
+		}
+		for(int i = 1; i <= workers; i++) {
+			int victim = (worker + i) % workers;
+			if(victim != worker && popFront(localQueue(victim, priority), job)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool JobSystem::popBack(Queue & queue, function<void()> & job)
+{
+	lock_guard<mutex> lock(queue.mutex);
+	if(queue.jobs.empty()) {
+		return false;
+	}
+	job = queue.jobs.back();
+	queue.jobs.pop_back();
+	m_pending--;
+	return true;
+}
+
+bool JobSystem::popFront(Queue & queue, function<void()> & job)
+{
+	lock_guard<mutex> lock(queue.mutex);
+	if(queue.jobs.empty()) {
+		return false;
+	}
+	job = queue.jobs.front();
+	queue.jobs.pop_front();
+	m_pending--;
+	return true;
+}
+
+// End of file jobsystem.cpp
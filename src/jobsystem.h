@@ -0,0 +1,273 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : jobsystem.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * The part of a job's state that doesn't depend on its result: whether it
+ * is finished, and what to do once it is.
+ */
+class JobStateBase {
+ public:
+	JobStateBase() : m_ready(false) {}
+
+	bool isReady() const
+		{ return m_ready; }
+
+	/**
+	 * Waits for the job to finish. A worker thread runs other jobs while
+	 * it waits, so jobs may wait on each other.
+	 */
+	void wait();
+
+	/** Calls cont once the job is finished, right away if it already is. */
+	void addContinuation(const std::function<void()> & cont);
+
+ protected:
+	// Marks the job finished and calls the continuations
+	void finish();
+
+ private:
+	std::atomic<bool> m_ready;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::vector<std::function<void()> > m_continuations;
+};
+
+/** The state of a job with a result of type T. */
+template<class T>
+class JobState : public JobStateBase {
+ public:
+	template<class F>
+	void run(F & func)
+		{ m_value = func(); finish(); }
+
+	T m_value;
+};
+
+template<>
+class JobState<void> : public JobStateBase {
+ public:
+	template<class F>
+	void run(F & func)
+		{ func(); finish(); }
+};
+
+template<class T> class JobHandle;
+
+/**
+ * A pool of worker threads, started once, that runs every job of the
+ * program: searches, asset loading and analysis. Each worker keeps its
+ * own queues, one per priority. Jobs submitted by a worker go to its own
+ * queue and are taken newest first, and an idle worker steals the
+ * oldest job from the others. A worker always takes the most urgent job
+ * there is, whichever queue it is in.
+ *
+ * Jobs may block, a HumanPlayer waits for a move in one, so the pool
+ * keeps at least two workers.
+ */
+class JobSystem {
+ public:
+	/** How urgent a job is, most urgent first. */
+	enum Priority {
+		INTERACTIVE,
+		SEARCH,
+		ANALYSIS,
+		IO
+	};
+	static const int PRIORITIES = IO + 1;
+
+	/** Returns the job system, starting the workers on first use. */
+	static JobSystem * getInstance();
+
+	/**
+	 * Lets the queued jobs finish, then stops the workers. Jobs that
+	 * never finish keep this from returning.
+	 */
+	static void destroy();
+
+	/**
+	 * Sets how many workers are started, which caps the CPU the program
+	 * uses. 0, the default, means one per core. Only has an effect before
+	 * the first getInstance().
+	 */
+	static void setThreadCount(int threads);
+
+	/** Returns the number of workers. */
+	int getThreadCount() const
+		{ return (int)m_workers.size(); }
+
+	/** Returns true if called from one of the workers. */
+	static bool isWorkerThread();
+
+	/**
+	 * Runs func on a worker. The handle returned gives its result once
+	 * it is done.
+	 */
+	template<class F>
+	JobHandle<decltype(std::declval<F>()())> submit(Priority priority, F func);
+
+	/** Queues a job that has no handle. */
+	void schedule(Priority priority, const std::function<void()> & job);
+
+	/**
+	 * Runs one queued job on the calling thread. Returns false if there
+	 * was none.
+	 */
+	bool runPending();
+
+ private:
+	JobSystem(int threads);
+	~JobSystem();
+
+	JobSystem(const JobSystem &);
+	JobSystem & operator=(const JobSystem &);
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()> > jobs;
+	};
+
+	void workerLoop(int index);
+
+	// Takes the most urgent job for the worker, -1 for other threads
+	bool findJob(int worker, std::function<void()> & job);
+	bool popBack(Queue & queue, std::function<void()> & job);
+	bool popFront(Queue & queue, std::function<void()> & job);
+
+	Queue & localQueue(int worker, int priority)
+		{ return *m_local[worker * PRIORITIES + priority]; }
+
+	static JobSystem * m_instance;
+	static std::mutex m_instance_mutex;
+	static int m_thread_count;
+
+	std::vector<std::unique_ptr<Queue> > m_local;
+	Queue m_global[PRIORITIES];
+
+	std::atomic<int> m_pending;
+	std::atomic<bool> m_quit;
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_wake;
+	std::vector<std::thread> m_workers;
+};
+
+/**
+ * Refers to a submitted job. Handles are cheap to copy, and all copies
+ * refer to the same job.
+ */
+template<class T>
+class JobHandle {
+ public:
+	JobHandle() {}
+
+	explicit JobHandle(const std::shared_ptr<JobState<T> > & state) :
+		m_state(state) {}
+
+	/** Returns false for a handle that doesn't refer to a job. */
+	bool isValid() const
+		{ return m_state.get() != 0; }
+
+	bool isReady() const
+		{ return m_state && m_state->isReady(); }
+
+	void wait() const
+		{ if(m_state) m_state->wait(); }
+
+	/** Waits for the job and returns its result. */
+	const T & get() const
+		{ wait(); return m_state->m_value; }
+
+	/**
+	 * Submits func(result) as a new job once this one is done, and
+	 * returns the handle of the new job.
+	 */
+	template<class F>
+	JobHandle<decltype(std::declval<F>()(std::declval<const T &>()))>
+	then(JobSystem::Priority priority, F func) const
+	{
+		typedef decltype(func(std::declval<const T &>())) R;
+		std::shared_ptr<JobState<R> > next(new JobState<R>);
+		std::shared_ptr<JobState<T> > prev = m_state;
+		m_state->addContinuation([=]() {
+			JobSystem::getInstance()->schedule(priority, [=]() mutable {
+				auto call = [&]() { return func(prev->m_value); };
+				next->run(call);
+			});
+		});
+		return JobHandle<R>(next);
+	}
+
+ private:
+	std::shared_ptr<JobState<T> > m_state;
+};
+
+template<>
+class JobHandle<void> {
+ public:
+	JobHandle() {}
+
+	explicit JobHandle(const std::shared_ptr<JobState<void> > & state) :
+		m_state(state) {}
+
+	bool isValid() const
+		{ return m_state.get() != 0; }
+
+	bool isReady() const
+		{ return m_state && m_state->isReady(); }
+
+	void wait() const
+		{ if(m_state) m_state->wait(); }
+
+	void get() const
+		{ wait(); }
+
+	/** Submits func() as a new job once this one is done. */
+	template<class F>
+	JobHandle<decltype(std::declval<F>()())>
+	then(JobSystem::Priority priority, F func) const
+	{
+		typedef decltype(func()) R;
+		std::shared_ptr<JobState<R> > next(new JobState<R>);
+		m_state->addContinuation([=]() {
+			JobSystem::getInstance()->schedule(priority, [=]() mutable {
+				next->run(func);
+			});
+		});
+		return JobHandle<R>(next);
+	}
+
+ private:
+	std::shared_ptr<JobState<void> > m_state;
+};
+
+template<class F>
+JobHandle<decltype(std::declval<F>()())> JobSystem::submit(Priority priority, F func)
+{
+	typedef decltype(func()) R;
+	std::shared_ptr<JobState<R> > state(new JobState<R>);
+	schedule(priority, [=]() mutable {
+		state->run(func);
+	});
+	return JobHandle<R>(state);
+}
+
+#endif // JOBSYSTEM_H
+
+// End of file jobsystem.h
@@ -0,0 +1,403 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : logger.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+atomic<Logger*> Logger::m_instance(0);
+mutex Logger::m_instance_mutex;
+atomic<int> Logger::m_level(Logger::LEVEL_INFO);
+
+// Every logger gets a new number, rings of a destroyed one are not reused
+static atomic<int> s_generation(0);
+
+Logger * Logger::getInstance()
+{
+	Logger * instance = m_instance.load(memory_order_acquire);
+	if(instance) {
+		return instance;
+	}
+
+	lock_guard<mutex> lock(m_instance_mutex);
+	instance = m_instance.load(memory_order_relaxed);
+	if(!instance) {
+		instance = new Logger;
+		m_instance.store(instance, memory_order_release);
+	}
+	return instance;
+}
+
+void Logger::destroy()
+{
+	// Deleting it could pull the logger from under a thread in write()
+	lock_guard<mutex> lock(m_instance_mutex);
+	Logger * instance = m_instance.load(memory_order_relaxed);
+	if(instance) {
+		instance->stop();
+	}
+}
+
+void Logger::setLevel(Level level)
+{
+	m_level.store(level, memory_order_relaxed);
+}
+
+Logger::Level Logger::getLevel()
+{
+	return (Level)m_level.load(memory_order_relaxed);
+}
+
+const char * Logger::levelName(Level level)
+{
+	switch(level) {
+		case LEVEL_DEBUG:
+			return "debug";
+		case LEVEL_INFO:
+			return "info";
+		case LEVEL_WARNING:
+			return "warning";
+		case LEVEL_ERROR:
+			return "error";
+		default:
+			return "none";
+	}
+}
+
+bool Logger::parseLevel(const string & name, Level & level)
+{
+	for(int i = LEVEL_DEBUG; i <= LEVEL_NONE; i++) {
+		if(name == levelName((Level)i)) {
+			level = (Level)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+Logger::Logger() :
+	m_generation(++s_generation),
+	m_start(chrono::steady_clock::now()),
+	m_next_thread(0),
+	m_file(stderr),
+	m_ownfile(false),
+	m_flush_requests(0),
+	m_flushes(0),
+	m_quit(false),
+	m_stopped(false)
+{
+	m_writer = thread(&Logger::writerLoop, this);
+}
+
+Logger::~Logger()
+{
+	stop();
+	if(m_ownfile) {
+		fclose(m_file);
+	}
+}
+
+void Logger::stop()
+{
+	{
+		lock_guard<mutex> lock(m_wake_mutex);
+		if(m_quit) {
+			return;
+		}
+		m_stopped = true;
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	m_writer.join();
+	drain();
+}
+
+bool Logger::openFile(const string & filename)
+{
+	FILE * file = fopen(filename.c_str(), "w");
+	if(!file) {
+		return false;
+	}
+
+	// Whatever was logged before goes where it was meant to
+	flush();
+	lock_guard<mutex> lock(m_wake_mutex);
+	if(m_ownfile) {
+		fclose(m_file);
+	}
+	m_file = file;
+	m_ownfile = true;
+	return true;
+}
+
+Logger::Ring * Logger::threadRing()
+{
+	// Marks the ring closed when the thread ends, the writer then
+	// drains it and lets it go
+	struct ThreadRing {
+		ThreadRing() : generation(0) {}
+		~ThreadRing()
+			{ if(ring) ring->closed = true; }
+
+		int generation;
+		shared_ptr<Ring> ring;
+	};
+	static thread_local ThreadRing t_ring;
+
+	if(t_ring.generation != m_generation) {
+		if(t_ring.ring) {
+			t_ring.ring->closed = true;
+		}
+		lock_guard<mutex> lock(m_rings_mutex);
+		t_ring.ring.reset(new Ring(m_next_thread++));
+		t_ring.generation = m_generation;
+		m_rings.push_back(t_ring.ring);
+	}
+	return t_ring.ring.get();
+}
+
+void Logger::write(Level level, const char * category, const char * text, size_t length)
+{
+	Ring * ring = threadRing();
+
+	Record record;
+	record.time = chrono::duration_cast<chrono::microseconds>(
+		chrono::steady_clock::now() - m_start).count();
+	record.level = level;
+	record.category = category;
+	record.thread = ring->thread;
+	record.length = (int)min(length, (size_t)MAX_TEXT);
+	memcpy(record.text, text, record.length);
+
+	if(ring->records.tryPush(record)) {
+		// Without the writer nobody else takes it out
+		if(m_stopped) {
+			drain();
+		} else if(level >= LEVEL_WARNING) {
+			m_wake.notify_one();
+		}
+		return;
+	}
+
+	// Full, only what matters is worth waiting for
+	if(level < LEVEL_WARNING) {
+		ring->dropped++;
+		m_wake.notify_one();
+		return;
+	}
+	while(!ring->records.tryPush(record)) {
+		if(m_stopped) {
+			drain();
+		} else {
+			m_wake.notify_one();
+			this_thread::yield();
+		}
+	}
+	if(m_stopped) {
+		drain();
+	}
+}
+
+void Logger::flush()
+{
+	unique_lock<mutex> lock(m_wake_mutex);
+	long long request = ++m_flush_requests;
+	m_wake.notify_all();
+	while(m_flushes < request && !m_quit) {
+		m_flushed.wait(lock);
+	}
+}
+
+void Logger::writerLoop()
+{
+	vector<Record> batch;
+	string out;
+
+	unique_lock<mutex> lock(m_wake_mutex);
+	while(true) {
+		long long requests = m_flush_requests;
+		bool quit = m_quit;
+
+		lock.unlock();
+		while(writeBatch(batch, out)) {
+		}
+		lock.lock();
+
+		m_flushes = requests;
+		m_flushed.notify_all();
+		if(quit) {
+			break;
+		}
+		if(m_flush_requests == requests && !m_quit) {
+			m_wake.wait_for(lock, chrono::milliseconds(50));
+		}
+	}
+}
+
+void Logger::drain()
+{
+	vector<Record> batch;
+	string out;
+	while(writeBatch(batch, out)) {
+	}
+}
+
+bool Logger::writeBatch(vector<Record> & batch, string & out)
+{
+	batch.clear();
+	{
+		lock_guard<mutex> lock(m_rings_mutex);
+		for(int i = 0; i < (int)m_rings.size(); ) {
+			Ring & ring = *m_rings[i];
+			// Checked first, so nothing can be pushed after the drain
+			bool closed = ring.closed;
+
+			Record record;
+			record.time = 0;
+			while(ring.records.tryPop(record)) {
+				batch.push_back(record);
+			}
+
+			long long dropped = ring.dropped.exchange(0);
+			if(dropped > 0) {
+				// Reported after the last record that made it
+				record.level = LEVEL_WARNING;
+				record.category = "logger";
+				record.thread = ring.thread;
+				record.length = snprintf(record.text, MAX_TEXT,
+					"%lld messages dropped", dropped);
+				batch.push_back(record);
+			}
+
+			if(closed) {
+				m_rings.erase(m_rings.begin() + i);
+			} else {
+				i++;
+			}
+		}
+	}
+
+	if(batch.empty()) {
+		return false;
+	}
+
+	// Each ring is in order already, this only interleaves them
+	stable_sort(batch.begin(), batch.end(),
+		[](const Record & a, const Record & b) { return a.time < b.time; });
+
+	out.clear();
+	char prefix[64];
+	for(int i = 0; i < (int)batch.size(); i++) {
+		const Record & record = batch[i];
+		int length = snprintf(prefix, sizeof(prefix), "%4lld.%06lld %-7s %s[%d] ",
+			record.time / 1000000, record.time % 1000000,
+			levelName(record.level), record.category, record.thread);
+		out.append(prefix, min(length, (int)sizeof(prefix) - 1));
+		out.append(record.text, record.length);
+		out += '\n';
+	}
+
+	lock_guard<mutex> lock(m_wake_mutex);
+	fwrite(out.data(), 1, out.size(), m_file);
+	fflush(m_file);
+	return true;
+}
+
+bool LogOptions::parse(const string & arg)
+{
+	if(arg.substr(0, 6) == "--log=") {
+		m_file = arg.substr(6);
+		return true;
+	}
+	if(arg.substr(0, 12) == "--log-level=") {
+		Logger::Level level;
+		if(!Logger::parseLevel(arg.substr(12), level)) {
+			return false;
+		}
+		Logger::setLevel(level);
+		return true;
+	}
+	return false;
+}
+
+bool LogOptions::apply() const
+{
+	if(!m_file.empty() && !Logger::getInstance()->openFile(m_file)) {
+		cerr << "Couldn't open the log file " << m_file << endl;
+		return false;
+	}
+	return true;
+}
+
+const char * LogOptions::usage()
+{
+	return
+		" --log=FILE\t\t\t Write diagnostics to FILE instead of the console.\n"
+		" --log-level=LEVEL\t\t debug, info, warning, error or none, info by\n"
+		"                  \t\t default.\n";
+}
+
+LogLine & LogLine::operator<<(const char * text)
+{
+	append(text, strlen(text));
+	return *this;
+}
+
+LogLine & LogLine::operator<<(int value)
+{
+	return *this << (long long)value;
+}
+
+LogLine & LogLine::operator<<(unsigned int value)
+{
+	return *this << (unsigned long long)value;
+}
+
+LogLine & LogLine::operator<<(long value)
+{
+	return *this << (long long)value;
+}
+
+LogLine & LogLine::operator<<(unsigned long value)
+{
+	return *this << (unsigned long long)value;
+}
+
+LogLine & LogLine::operator<<(long long value)
+{
+	char buf[24];
+	append(buf, snprintf(buf, sizeof(buf), "%lld", value));
+	return *this;
+}
+
+LogLine & LogLine::operator<<(unsigned long long value)
+{
+	char buf[24];
+	append(buf, snprintf(buf, sizeof(buf), "%llu", value));
+	return *this;
+}
+
+LogLine & LogLine::operator<<(double value)
+{
+	char buf[32];
+	append(buf, snprintf(buf, sizeof(buf), "%g", value));
+	return *this;
+}
+
+void LogLine::append(const char * text, size_t length)
+{
+	length = min(length, (size_t)Logger::MAX_TEXT - m_length);
+	memcpy(m_text + m_length, text, length);
+	m_length += length;
+}
+
+// End of file logger.cpp
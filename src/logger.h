@@ -0,0 +1,268 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : logger.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "mpscqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Collects the diagnostic messages of the whole program and writes them
+ * from a thread of its own, so logging never waits on the console or a
+ * file. Each thread that logs gets its own ring of records, which the
+ * writer drains in batches, ordered by time.
+ *
+ * A record has a time, a level, a category naming the part of the
+ * program it comes from, and the number of the thread that logged it.
+ * When a thread logs faster than the writer keeps up, its debug and
+ * info records are dropped and counted, warnings and errors wait.
+ *
+ * Log through the LOG_ macros below rather than calling write().
+ */
+class Logger {
+ public:
+	enum Level {
+		LEVEL_DEBUG,
+		LEVEL_INFO,
+		LEVEL_WARNING,
+		LEVEL_ERROR,
+		LEVEL_NONE
+	};
+
+	/** Longest message kept, longer ones are cut. */
+	static const int MAX_TEXT = 232;
+
+	/** Returns the logger, starting the writer on first use. */
+	static Logger * getInstance();
+
+	/**
+	 * Writes out what is still queued and stops the writer. The logger
+	 * itself lives on until the process ends, since other threads may
+	 * still be logging. They write their messages themselves from then on.
+	 */
+	static void destroy();
+
+	/** Sets the least severe level that is logged, LEVEL_INFO by default. */
+	static void setLevel(Level level);
+
+	static Level getLevel();
+
+	/** Returns true if messages of the given level are logged. */
+	static bool isEnabled(Level level)
+		{ return level >= m_level.load(std::memory_order_relaxed); }
+
+	/** Returns the name of a level, as used in the output. */
+	static const char * levelName(Level level);
+
+	/** Reads a level from its name. Returns false for an unknown name. */
+	static bool parseLevel(const std::string & name, Level & level);
+
+	/**
+	 * Writes to a file instead of the standard error. Returns false if
+	 * the file couldn't be opened.
+	 */
+	bool openFile(const std::string & filename);
+
+	/**
+	 * Queues a message, called from any thread.
+	 * @param category - A string literal naming what the message is about.
+	 */
+	void write(Level level, const char * category, const char * text, size_t length);
+
+	/** Waits until everything logged so far is written. */
+	void flush();
+
+ private:
+	Logger();
+	~Logger();
+
+	Logger(const Logger &);
+	Logger & operator=(const Logger &);
+
+	struct Record {
+		long long time;
+		Level level;
+		const char * category;
+		int thread;
+		int length;
+		char text[MAX_TEXT];
+	};
+
+	// The records of one thread, only that thread pushes
+	struct Ring {
+		explicit Ring(int thread) :
+			records(RING_SIZE),
+			thread(thread),
+			dropped(0),
+			closed(false) {}
+
+		MpscQueue<Record> records;
+		int thread;
+		std::atomic<long long> dropped;
+		std::atomic<bool> closed;
+	};
+
+	static const int RING_SIZE = 256;
+
+	// Returns the ring of the calling thread, making one if needed
+	Ring * threadRing();
+
+	void writerLoop();
+
+	// Writes out what is queued and stops the writer thread
+	void stop();
+
+	// Takes the queued records and writes them, returns false if there were none
+	bool writeBatch(std::vector<Record> & batch, std::string & out);
+
+	// Writes batches until the rings are empty
+	void drain();
+
+	static std::atomic<Logger*> m_instance;
+	static std::mutex m_instance_mutex;
+	static std::atomic<int> m_level;
+
+	// Tells rings of an old logger from those of the current one
+	int m_generation;
+	std::chrono::steady_clock::time_point m_start;
+
+	std::mutex m_rings_mutex;
+	std::vector<std::shared_ptr<Ring> > m_rings;
+	int m_next_thread;
+
+	FILE * m_file;
+	bool m_ownfile;
+
+	std::mutex m_wake_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_flushed;
+	long long m_flush_requests;
+	long long m_flushes;
+	bool m_quit;
+	// Set once the writer is stopped, records are then written by the
+	// threads logging them
+	std::atomic<bool> m_stopped;
+	std::thread m_writer;
+};
+
+/**
+ * The --log=FILE and --log-level=LEVEL options shared by the command line
+ * tools.
+ */
+class LogOptions {
+ public:
+	/**
+	 * Takes arg if it is one of the options. Returns false if it isn't,
+	 * or names an unknown level, the tool then prints its usage.
+	 */
+	bool parse(const std::string & arg);
+
+	/**
+	 * Sends the log to the file given, if any. Prints an error and returns
+	 * false if the file couldn't be opened.
+	 */
+	bool apply() const;
+
+	/** Returns the lines describing the options for a usage screen. */
+	static const char * usage();
+
+ private:
+	std::string m_file;
+};
+
+/**
+ * Builds one message in place, without allocating, and hands it to the
+ * logger when it goes out of scope.
+ */
+class LogLine {
+ public:
+	LogLine(Logger::Level level, const char * category) :
+		m_level(level),
+		m_category(category),
+		m_length(0) {}
+
+	~LogLine()
+		{ Logger::getInstance()->write(m_level, m_category, m_text, m_length); }
+
+	LogLine & operator<<(const char * text);
+	LogLine & operator<<(const std::string & text)
+		{ append(text.data(), text.size()); return *this; }
+	LogLine & operator<<(char c)
+		{ append(&c, 1); return *this; }
+	LogLine & operator<<(int value);
+	LogLine & operator<<(unsigned int value);
+	LogLine & operator<<(long value);
+	LogLine & operator<<(unsigned long value);
+	LogLine & operator<<(long long value);
+	LogLine & operator<<(unsigned long long value);
+	LogLine & operator<<(double value);
+
+	/** Anything else that can be written to a stream. */
+	template<class T>
+	LogLine & operator<<(const T & value)
+	{
+		std::ostringstream oss;
+		oss << value;
+		return *this << oss.str();
+	}
+
+ private:
+	LogLine(const LogLine &);
+	LogLine & operator=(const LogLine &);
+
+	void append(const char * text, size_t length);
+
+	Logger::Level m_level;
+	const char * m_category;
+	size_t m_length;
+	char m_text[Logger::MAX_TEXT];
+};
+
+/**
+ * Logs message, which may be a chain of values joined with <<, if the
+ * level is enabled. Nothing in message is evaluated otherwise.
+ */
+#define LOG_AT(level, category, message) \
+	do { \
+		if(Logger::isEnabled(level)) { \
+			LogLine log_line_(level, category); \
+			log_line_ << message; \
+		} \
+	} while(0)
+
+// Debug messages cost nothing in release builds
+#ifdef NDEBUG
+#define LOG_DEBUG(category, message) \
+	do { \
+		if(false) { \
+			LogLine log_line_(Logger::LEVEL_DEBUG, category); \
+			log_line_ << message; \
+		} \
+	} while(0)
+#else
+#define LOG_DEBUG(category, message) LOG_AT(Logger::LEVEL_DEBUG, category, message)
+#endif
+
+#define LOG_INFO(category, message) LOG_AT(Logger::LEVEL_INFO, category, message)
+#define LOG_WARNING(category, message) LOG_AT(Logger::LEVEL_WARNING, category, message)
+#define LOG_ERROR(category, message) LOG_AT(Logger::LEVEL_ERROR, category, message)
+
+#endif // LOGGER_H
+
+// End of file logger.h
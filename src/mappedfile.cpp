@@ -0,0 +1,117 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : mappedfile.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "mappedfile.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() :
+	m_data(0),
+	m_size(0),
+	m_open(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifndef WIN32
+
+bool MappedFile::open(const string & filename)
+{
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	// An empty file can't be mapped, but it opens fine
+	if(st.st_size > 0) {
+		void * data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED) {
+			::close(fd);
+			return false;
+		}
+		// Files are mostly read front to back
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+		m_data = (const char *)data;
+		m_size = st.st_size;
+	}
+
+	// The mapping keeps the file, the descriptor isn't needed anymore
+	::close(fd);
+	m_open = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(m_data) {
+		munmap((void *)m_data, m_size);
+	}
+	m_data = 0;
+	m_size = 0;
+	m_open = false;
+}
+
+#else
+
+bool MappedFile::open(const string & filename)
+{
+	close();
+
+	FILE * file = fopen(filename.c_str(), "rb");
+	if(!file) {
+		return false;
+	}
+	char chunk[65536];
+	size_t read;
+	while((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		m_buffer.insert(m_buffer.end(), chunk, chunk + read);
+	}
+	bool error = ferror(file) != 0;
+	fclose(file);
+	if(error) {
+		m_buffer.clear();
+		return false;
+	}
+
+	m_data = m_buffer.empty() ? 0 : &m_buffer[0];
+	m_size = m_buffer.size();
+	m_open = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	m_buffer.clear();
+	m_data = 0;
+	m_size = 0;
+	m_open = false;
+}
+
+#endif
+
+// End of file mappedfile.cpp
@@ -0,0 +1,65 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : mappedfile.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A whole file mapped into memory for reading. Pages are read in by the
+ * system as they are touched, so a file of any size opens at once and is
+ * read at disk speed without copying it. Where there is no mmap the file
+ * is read into memory instead.
+ *
+ * The contents stay valid until the file is closed, views into them
+ * must not outlive it.
+ */
+class MappedFile {
+ public:
+	MappedFile();
+
+	/** Unmaps the file. */
+	~MappedFile();
+
+	/** Maps the file, closing the one open before. Returns false if it can't. */
+	bool open(const std::string & filename);
+
+	void close();
+
+	bool isOpen() const
+		{ return m_open; }
+
+	const char * getData() const
+		{ return m_data; }
+
+	size_t getSize() const
+		{ return m_size; }
+
+	/** Returns the whole file as text. */
+	std::string_view getText() const
+		{ return std::string_view(m_data, m_size); }
+
+ private:
+	MappedFile(const MappedFile &);
+	MappedFile & operator=(const MappedFile &);
+
+	const char * m_data;
+	size_t m_size;
+	bool m_open;
+#ifdef WIN32
+	std::vector<char> m_buffer;
+#endif
+};
+
+#endif // MAPPEDFILE_H
+
+// End of file mappedfile.h
@@ -0,0 +1,553 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : match.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "board.h"
+#include "chessgame.h"
+#include "chessgamestate.h"
+#include "enginepool.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "match.h"
+#include "notation.h"
+#include "options.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+// Played when no opening file is given, each one twice
+static const char * DEFAULT_OPENINGS[] = {
+	"e2e4 e7e5 g1f3 b8c6 f1b5",
+	"e2e4 e7e5 g1f3 b8c6 f1c4",
+	"e2e4 c7c5 g1f3 d7d6",
+	"e2e4 c7c5 b1c3 b8c6",
+	"e2e4 e7e6 d2d4 d7d5",
+	"e2e4 c7c6 d2d4 d7d5",
+	"e2e4 d7d5 e4d5 d8d5",
+	"e2e4 d7d6 d2d4 g8f6",
+	"d2d4 d7d5 c2c4 e7e6",
+	"d2d4 d7d5 c2c4 c7c6",
+	"d2d4 g8f6 c2c4 g7g6",
+	"d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",
+	"d2d4 f7f5 g2g3 g8f6",
+	"c2c4 e7e5 b1c3 g8f6",
+	"g1f3 d7d5 g2g3 g8f6",
+	"c2c4 c7c5 g1f3 g8f6",
+	0
+};
+
+static vector<string> splitMoves(const string & line)
+{
+	vector<string> moves;
+	string move;
+	stringstream ss(line);
+	while(ss >> move) {
+		moves.push_back(move);
+	}
+	return moves;
+}
+
+bool parsePlayerSpec(const string & str, PlayerSpec & spec)
+{
+	vector<string> fields;
+	string::size_type start = 0, end;
+	do {
+		end = str.find(':', start);
+		fields.push_back(str.substr(start, end - start));
+		start = end + 1;
+	} while(end != string::npos);
+
+	spec = PlayerSpec();
+	if(fields[0] == "brutal") {
+		spec.type = PlayerSpec::BRUTAL;
+		spec.name = "Brutal";
+	} else if(fields[0] == "mcts") {
+		spec.type = PlayerSpec::MCTS;
+		spec.name = "Mcts";
+	} else if(fields[0] == "random") {
+		spec.type = PlayerSpec::RANDOM;
+		spec.name = "Random";
+#ifndef WIN32
+	} else if(fields[0] == "uci") {
+		spec.type = PlayerSpec::UCI;
+#endif
+	} else {
+		return false;
+	}
+
+	bool searcher = (spec.type == PlayerSpec::BRUTAL || spec.type == PlayerSpec::MCTS);
+	bool named = false;
+	for(int i = 1; i < (int)fields.size(); i++) {
+		string::size_type eq = fields[i].find('=');
+		if(eq == string::npos) {
+			return false;
+		}
+		string key = fields[i].substr(0, eq);
+		string value = fields[i].substr(eq + 1);
+
+		if(key == "name") {
+			spec.name = value;
+			named = true;
+		} else if(key == "ply" && searcher) {
+			spec.ply = atoi(value.c_str());
+		} else if(key == "eval" && spec.type == PlayerSpec::BRUTAL) {
+			if(value == "full") {
+				spec.evaluation = BrutalPlayer::FULL;
+			} else if(value == "material") {
+				spec.evaluation = BrutalPlayer::MATERIAL;
+			} else {
+				return false;
+			}
+		} else if(key == "eval" && spec.type == PlayerSpec::MCTS) {
+			if(value == "static") {
+				spec.playout = MctsPlayer::STATIC;
+			} else if(value == "rollout") {
+				spec.playout = MctsPlayer::ROLLOUT;
+			} else {
+				return false;
+			}
+		} else if(key == "threads" && spec.type == PlayerSpec::MCTS) {
+			spec.threads = atoi(value.c_str());
+		} else if(key == "cpuct" && spec.type == PlayerSpec::MCTS) {
+			spec.exploration = atof(value.c_str());
+		} else if(key == "book" && searcher) {
+			spec.book = OpeningBook::load(value);
+			if(!spec.book) {
+				return false;
+			}
+		} else if(key == "tb" && spec.type == PlayerSpec::BRUTAL) {
+			spec.tablebases = Tablebases::load(value);
+			if(!spec.tablebases) {
+				return false;
+			}
+		} else if(key == "cache" && spec.type == PlayerSpec::BRUTAL) {
+			spec.cache = AnalysisCache::load(value);
+			if(!spec.cache) {
+				return false;
+			}
+		} else if(key == "mate" && searcher) {
+			spec.matecheck = atoll(value.c_str());
+		} else if(key == "cmd" && spec.type == PlayerSpec::UCI) {
+			spec.command = value;
+		} else if(key.substr(0, 7) == "option." && spec.type == PlayerSpec::UCI) {
+			spec.options.push_back(make_pair(key.substr(7), value));
+		} else if(key == "depth") {
+			spec.limits.depth = atoi(value.c_str());
+		} else if(key == "nodes") {
+			spec.limits.nodes = atoll(value.c_str());
+		} else if(key == "movetime") {
+			spec.limits.movetime = atoi(value.c_str());
+		} else {
+			return false;
+		}
+	}
+
+	if(spec.type == PlayerSpec::UCI) {
+		if(spec.command.empty()) {
+			return false;
+		}
+		if(!named) {
+			spec.name = spec.command;
+		}
+	} else if(!named && spec.type == PlayerSpec::BRUTAL) {
+		stringstream ss;
+		ss << "Brutal";
+		if(spec.limits.depth) {
+			ss << "-d" << spec.limits.depth;
+		} else if(spec.ply >= 0) {
+			ss << "-p" << spec.ply;
+		}
+		if(spec.evaluation == BrutalPlayer::MATERIAL) {
+			ss << "-material";
+		}
+		spec.name = ss.str();
+	} else if(!named && spec.type == PlayerSpec::MCTS) {
+		stringstream ss;
+		ss << "Mcts";
+		if(spec.limits.nodes) {
+			ss << "-n" << spec.limits.nodes;
+		} else if(spec.ply >= 0) {
+			ss << "-p" << spec.ply;
+		}
+		if(spec.playout == MctsPlayer::ROLLOUT) {
+			ss << "-rollout";
+		}
+		spec.name = ss.str();
+	}
+	return true;
+}
+
+ChessPlayer * createPlayer(const PlayerSpec & spec)
+{
+	if(spec.type == PlayerSpec::BRUTAL) {
+		BrutalPlayer * player = new BrutalPlayer();
+		if(spec.ply >= 0) {
+			player->setPly(spec.ply);
+		}
+		player->setEvaluation(spec.evaluation);
+		if(spec.book) {
+			player->setBook(spec.book);
+		}
+		if(spec.tablebases) {
+			player->setTablebases(spec.tablebases);
+		}
+		if(spec.cache) {
+			player->setAnalysisCache(spec.cache);
+		}
+		if(spec.matecheck) {
+			player->setMateCheck(spec.matecheck);
+		}
+		return player;
+	} else if(spec.type == PlayerSpec::MCTS) {
+		MctsPlayer * player = new MctsPlayer();
+		if(spec.ply >= 0) {
+			player->setPly(spec.ply);
+		}
+		player->setPlayout(spec.playout);
+		player->setThreads(spec.threads);
+		if(spec.exploration > 0) {
+			player->setExploration(spec.exploration);
+		}
+		if(spec.book) {
+			player->setBook(spec.book);
+		}
+		if(spec.matecheck) {
+			player->setMateCheck(spec.matecheck);
+		}
+		return player;
+	} else if(spec.type == PlayerSpec::RANDOM) {
+		return new RandomPlayer(0);
+	}
+#ifndef WIN32
+	else if(spec.type == PlayerSpec::UCI) {
+		UciPlayer * player = new UciPlayer(spec.command);
+		for(int i = 0; i < (int)spec.options.size(); i++) {
+			player->setOption(spec.options[i].first, spec.options[i].second);
+		}
+		return player;
+	}
+#endif
+	return 0;
+}
+
+Match::Match(const PlayerSpec & a, const PlayerSpec & b) :
+	m_a(a),
+	m_b(b),
+	m_games(1000),
+	m_threads(0),
+	m_max_plies(400),
+	m_sprt(false),
+	m_elo0(0),
+	m_elo1(0),
+	m_alpha(0.05),
+	m_beta(0.05),
+	m_next(0),
+	m_stop(false),
+	m_finished(0),
+	m_verdict(MatchStats::CONTINUE)
+{
+	for(int i = 0; DEFAULT_OPENINGS[i]; i++) {
+		m_openings.push_back(splitMoves(DEFAULT_OPENINGS[i]));
+	}
+}
+
+bool Match::loadOpenings(const string & filename)
+{
+	ifstream file(filename.c_str());
+	if(!file) {
+		return false;
+	}
+
+	vector<vector<string> > openings;
+	string line;
+	while(getline(file, line)) {
+		vector<string> moves = splitMoves(line);
+		if(moves.empty() || moves[0][0] == '#') {
+			continue;
+		}
+		openings.push_back(moves);
+	}
+	if(openings.empty()) {
+		return false;
+	}
+	m_openings = openings;
+	return true;
+}
+
+void Match::setSprt(double elo0, double elo1, double alpha, double beta)
+{
+	m_sprt = true;
+	m_elo0 = elo0;
+	m_elo1 = elo1;
+	m_alpha = alpha;
+	m_beta = beta;
+}
+
+MatchStats::Verdict Match::getVerdict() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_verdict;
+}
+
+void Match::run()
+{
+	// The static tables have to be set up before any thread uses them
+	Board::init();
+	Board board;
+
+	char date[16];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+	m_date = date;
+
+	int threads = m_threads;
+	if(threads <= 0) {
+		threads = thread::hardware_concurrency();
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+	if(threads > m_games) {
+		threads = m_games;
+	}
+
+	// Singletons are created here rather than racing in the workers
+	Options::getInstance();
+#ifndef WIN32
+	EnginePool * pool = EnginePool::getInstance();
+	if(m_a.type == PlayerSpec::UCI) {
+		int count = threads;
+		if(m_b.type == PlayerSpec::UCI && m_b.command == m_a.command) {
+			count *= 2;
+		}
+		pool->prespawn(m_a.command, EnginePool::UCI, count);
+	}
+	if(m_b.type == PlayerSpec::UCI && m_b.command != m_a.command) {
+		pool->prespawn(m_b.command, EnginePool::UCI, threads);
+	}
+#endif
+
+	cout << "Playing " << m_games << " games of " << m_a.name << " vs "
+		<< m_b.name << " on " << threads << " threads" << endl;
+
+	// Games run as jobs, with as many workers as games at once unless the
+	// job system was started before
+	JobSystem::setThreadCount(threads);
+	JobSystem * jobs = JobSystem::getInstance();
+	vector<JobHandle<void> > workers;
+	for(int i = 0; i < threads; i++) {
+		workers.push_back(jobs->submit(JobSystem::SEARCH, [this]() { worker(); }));
+	}
+	for(int i = 0; i < threads; i++) {
+		workers[i].wait();
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	printStats();
+}
+
+void Match::worker()
+{
+	while(!m_stop) {
+		int round = m_next++;
+		if(round >= m_games) {
+			break;
+		}
+
+		// Each opening is played with both colors back to back
+		bool a_white = (round % 2 == 0);
+		PgnGame pgn;
+		Result result = playGame(round, a_white, pgn);
+		finishGame(round, a_white, result, pgn);
+	}
+}
+
+Match::Result Match::playGame(int round, bool a_white, PgnGame & pgn)
+{
+	const PlayerSpec & white = a_white ? m_a : m_b;
+	const PlayerSpec & black = a_white ? m_b : m_a;
+	const vector<string> & opening = m_openings[(round / 2) % m_openings.size()];
+
+	stringstream roundstr;
+	roundstr << round + 1;
+	pgn.addTag("Event", "chesspizza-match");
+	pgn.addTag("Site", "?");
+	pgn.addTag("Date", m_date);
+	pgn.addTag("Round", roundstr.str());
+	pgn.addTag("White", white.name);
+	pgn.addTag("Black", black.name);
+
+	ChessGame game(createPlayer(white), createPlayer(black));
+	game.getClock().setTimeControl(m_timecontrol);
+	game.newGame();
+
+	// The opening is told to both players, like moves of an opponent
+	for(int i = 0; i < (int)opening.size(); i++) {
+		const Board & board = game.getBoard();
+		BoardMove move = coordinateToMove(board, opening[i]);
+		if(!game.getState().isMoveLegal(move) || move.needPromotion()) {
+			LOG_WARNING("match", "Illegal opening move " << opening[i]);
+			break;
+		}
+		game.tryMove(move);
+		game.getPlayer1()->opponentMove(move, game.getState());
+		game.getPlayer2()->opponentMove(move, game.getState());
+	}
+	game.startGame();
+
+	ChessClock & clock = game.getClock();
+	Result result = DRAW;
+	string termination = "normal";
+	int plies = game.getPly();
+
+	while(true) {
+		// Held until the move is made, tryMove publishes a new state
+		ChessGameStatePtr state = game.getSnapshot();
+		const Board & board = state->getBoard();
+		Piece::Color turn = state->getTurn();
+		bool whiteturn = state->isWhiteTurn();
+
+		if(state->getStatus() == ChessGameState::CHECKMATE) {
+			result = whiteturn ? BLACK_WINS : WHITE_WINS;
+			break;
+		}
+		if(state->isDraw()) {
+			result = DRAW;
+			break;
+		}
+		if(plies >= m_max_plies) {
+			result = DRAW;
+			termination = "adjudication";
+			break;
+		}
+
+		ChessPlayer * player = game.getCurrentPlayer();
+		const PlayerSpec & spec = whiteturn ? white : black;
+		SearchLimits limits = m_limits;
+		if(spec.limits.depth) {
+			limits.depth = spec.limits.depth;
+		}
+		if(spec.limits.nodes) {
+			limits.nodes = spec.limits.nodes;
+		}
+		if(spec.limits.movetime) {
+			limits.movetime = spec.limits.movetime;
+		}
+		clock.fillLimits(limits);
+		player->setLimits(limits);
+
+		player->think(*state);
+
+		if(clock.isFlagged(turn)) {
+			result = whiteturn ? BLACK_WINS : WHITE_WINS;
+			termination = "time forfeit";
+			break;
+		}
+
+		BoardMove move = player->getMove();
+		if(move.isValid() && board.getPiece(move.origin()) && move.needPromotion()) {
+			move.setPromotion(Piece::QUEEN);
+		}
+		if(!move.isValid() || !state->isMoveLegal(move)) {
+			result = whiteturn ? BLACK_WINS : WHITE_WINS;
+			termination = "rules infraction";
+			break;
+		}
+
+		ChessPlayer * opponent = game.getInactivePlayer();
+		game.tryMove(move);
+		opponent->opponentMove(move, game.getState());
+		plies++;
+	}
+
+	pgn.addMoves(game);
+	if(result == WHITE_WINS) {
+		pgn.result = "1-0";
+	} else if(result == BLACK_WINS) {
+		pgn.result = "0-1";
+	} else {
+		pgn.result = "1/2-1/2";
+	}
+	pgn.addTag("Result", pgn.result);
+	pgn.addTag("Termination", termination);
+	return result;
+}
+
+void Match::finishGame(int round, bool a_white, Result result, PgnGame & pgn)
+{
+	if(m_pgn.isOpen()) {
+		m_pgn.write(pgn);
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	if(result == DRAW) {
+		m_stats.addDraw();
+	} else if((result == WHITE_WINS) == a_white) {
+		m_stats.addWin();
+	} else {
+		m_stats.addLoss();
+	}
+	m_finished++;
+
+	cout << "Finished game " << round + 1 << " ("
+		<< (a_white ? m_a.name : m_b.name) << " vs "
+		<< (a_white ? m_b.name : m_a.name) << "): " << pgn.result << endl;
+
+	if(m_finished % 10 == 0) {
+		printStats();
+	}
+
+	if(m_sprt && m_verdict == MatchStats::CONTINUE) {
+		m_verdict = m_stats.sprt(m_elo0, m_elo1, m_alpha, m_beta);
+		if(m_verdict != MatchStats::CONTINUE) {
+			// Games already being played are finished and counted, but
+			// the verdict stands and no new ones start
+			m_stop = true;
+		}
+	}
+}
+
+void Match::printStats() const
+{
+	char line[128];
+	snprintf(line, sizeof(line), "Score of %s vs %s: %d - %d - %d  [%.3f] %d",
+		m_a.name.c_str(), m_b.name.c_str(), m_stats.wins(), m_stats.losses(),
+		m_stats.draws(), m_stats.score(), m_stats.games());
+	cout << line << endl;
+
+	snprintf(line, sizeof(line), "Elo difference: %.1f +/- %.1f, LOS: %.1f %%",
+		m_stats.elo(), m_stats.eloError(), m_stats.los() * 100.0);
+	cout << line << endl;
+
+	if(m_sprt) {
+		snprintf(line, sizeof(line), "SPRT: llr %.2f (%.2f, %.2f), elo0 %.1f, elo1 %.1f",
+			m_stats.llr(m_elo0, m_elo1),
+			MatchStats::lowerBound(m_alpha, m_beta),
+			MatchStats::upperBound(m_alpha, m_beta), m_elo0, m_elo1);
+		cout << line;
+		switch(m_verdict) {
+			case MatchStats::ACCEPT_H0:
+				cout << " - H0 accepted";
+				break;
+			case MatchStats::ACCEPT_H1:
+				cout << " - H1 accepted";
+				break;
+			default:
+				break;
+		}
+		cout << endl;
+	}
+}
+
+// End of file match.cpp
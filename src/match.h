@@ -0,0 +1,176 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : match.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "analysiscache.h"
+#include "chessclock.h"
+#include "chessplayer.h"
+#include "matchstats.h"
+#include "openingbook.h"
+#include "tablebase.h"
+#include "pgn.h"
+#include "searchinfo.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Describes one side of a match. Every game gets a fresh ChessPlayer
+ * made from it, so that games can be played at the same time.
+ */
+struct PlayerSpec {
+	enum Type { BRUTAL, MCTS, RANDOM, UCI };
+
+	PlayerSpec() :
+		type(BRUTAL),
+		ply(-1),
+		evaluation(BrutalPlayer::FULL),
+		matecheck(0),
+		playout(MctsPlayer::STATIC),
+		threads(1),
+		exploration(0) {}
+
+	Type type;
+	std::string name;
+
+	// BrutalPlayer settings, a ply of -1 keeps the default
+	int ply;
+	BrutalPlayer::Evaluation evaluation;
+	std::shared_ptr<const OpeningBook> book;
+	std::shared_ptr<const Tablebases> tablebases;
+	std::shared_ptr<AnalysisCache> cache;
+	long long matecheck;
+
+	// MctsPlayer settings, the ply, book and mate check above apply too,
+	// an exploration of 0 keeps the default
+	MctsPlayer::Playout playout;
+	int threads;
+	double exploration;
+
+	// UciPlayer settings
+	std::string command;
+	std::vector<std::pair<std::string, std::string> > options;
+
+	// Overrides the match limits for this player where set
+	SearchLimits limits;
+};
+
+/**
+ * Parses a player description of the form TYPE[:KEY=VALUE]..., e.g.
+ * "brutal:depth=3:eval=material" or "uci:cmd=stockfish:option.Hash=16".
+ * Returns false if the description doesn't make sense.
+ */
+bool parsePlayerSpec(const std::string & str, PlayerSpec & spec);
+
+/** Creates a new player from its description. */
+ChessPlayer * createPlayer(const PlayerSpec & spec);
+
+/**
+ * Plays games between two players on all cores, without any graphics,
+ * and keeps the score. Players alternate colors, and each opening is
+ * played once with each color. Games are adjudicated by ChessGameState:
+ * checkmate, stalemate, the fifty move rule, repetition, insufficient
+ * material, or a draw once the game grows too long. A player that makes
+ * an illegal move or runs out of time loses.
+ */
+class Match {
+ public:
+	Match(const PlayerSpec & a, const PlayerSpec & b);
+
+	/** Sets the number of games to play, 1000 by default. */
+	void setGames(int games)
+		{ m_games = games; }
+
+	/** Sets how many games are played at once, every core by default. */
+	void setThreads(int threads)
+		{ m_threads = threads; }
+
+	/** Sets depth, node and movetime limits for both players. */
+	void setLimits(const SearchLimits & limits)
+		{ m_limits = limits; }
+
+	/**
+	 * Gives each player a clock with the given time control. Without
+	 * one, the default, there is no clock.
+	 */
+	void setTimeControl(const TimeControl & tc)
+		{ m_timecontrol = tc; }
+
+	/** Sets the length, in plies, after which a game is called a draw. */
+	void setMaxPlies(int plies)
+		{ m_max_plies = plies; }
+
+	/** Sets the openings, each one a list of moves in coordinate notation. */
+	void setOpenings(const std::vector<std::vector<std::string> > & openings)
+		{ m_openings = openings; }
+
+	/**
+	 * Reads openings from a file, one per line, moves in coordinate
+	 * notation. Empty lines and lines starting with '#' are skipped.
+	 */
+	bool loadOpenings(const std::string & filename);
+
+	/** Writes every finished game to a PGN file. */
+	bool openPgn(const std::string & filename)
+		{ return m_pgn.open(filename); }
+
+	/**
+	 * Stops the match as soon as a sequential probability ratio test
+	 * decides between H0: A is elo0 stronger, and H1: A is elo1 stronger.
+	 */
+	void setSprt(double elo0, double elo1, double alpha, double beta);
+
+	/** Plays the match, returns when all games are finished. */
+	void run();
+
+	const MatchStats & getStats() const
+		{ return m_stats; }
+
+	/** Returns the SPRT verdict, CONTINUE if there was no test. */
+	MatchStats::Verdict getVerdict() const;
+
+ private:
+	// Result of a game from white's point of view
+	enum Result { WHITE_WINS, BLACK_WINS, DRAW };
+
+	void worker();
+	Result playGame(int round, bool a_white, PgnGame & pgn);
+	void finishGame(int round, bool a_white, Result result, PgnGame & pgn);
+	void printStats() const;
+
+	PlayerSpec m_a;
+	PlayerSpec m_b;
+	int m_games;
+	int m_threads;
+	SearchLimits m_limits;
+	TimeControl m_timecontrol;
+	int m_max_plies;
+	std::vector<std::vector<std::string> > m_openings;
+	std::string m_date;
+
+	bool m_sprt;
+	double m_elo0, m_elo1, m_alpha, m_beta;
+
+	std::atomic<int> m_next;
+	std::atomic<bool> m_stop;
+	mutable std::mutex m_mutex;
+	MatchStats m_stats;
+	int m_finished;
+	MatchStats::Verdict m_verdict;
+	PgnWriter m_pgn;
+};
+
+#endif // MATCH_H
+
+// End of file match.h
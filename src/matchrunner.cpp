@@ -0,0 +1,189 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : matchrunner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "bench.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "match.h"
+#include "searchinfo.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+#include "enginepool.h"
+#endif
+
+using namespace std;
+
+static void printUsage()
+{
+	cerr << "Usage: chesspizza-match [options] PLAYER_A PLAYER_B\n";
+	cerr << "       chesspizza-match bench [DEPTH]\n";
+	cerr << "       chesspizza-match bench notation\n\n";
+	cerr << "Plays PLAYER_A against PLAYER_B without graphics, on all cores, and\n";
+	cerr << "reports the Elo difference of A over B.\n\n";
+	cerr << "PLAYER is a type followed by settings, separated by colons:\n";
+	cerr << "  brutal[:ply=N][:eval=full|material][:book=FILE][:tb=DIR]\n";
+	cerr << "        [:mate=NODES][:cache=FILE]\n";
+	cerr << "  mcts[:ply=N][:eval=static|rollout][:threads=N][:cpuct=C]\n";
+	cerr << "        [:book=FILE][:mate=NODES], nodes=N counts playouts\n";
+	cerr << "  random\n";
+#ifndef WIN32
+	cerr << "  uci:cmd=COMMAND[:option.NAME=VALUE]...\n";
+#endif
+	cerr << "Every player also takes name=NAME, depth=N, nodes=N and movetime=MS.\n\n";
+	cerr << " -g N  --games=N\t\t Games to play, 1000 by default.\n";
+	cerr << " -j N  --threads=N\t\t Games played at once, one per core by default.\n";
+	cerr << " --tc=[MOVES/]SECONDS[+INC]\t Clock for each player, e.g. 10+0.1 or 40/60.\n";
+	cerr << "                 \t\t A dDELAY or bDELAY suffix adds a simple or\n";
+	cerr << "                 \t\t Bronstein delay, e.g. 60d1.\n";
+	cerr << " --depth=N\t\t\t Search depth in plies for both players.\n";
+	cerr << " --nodes=N\t\t\t Nodes per move for both players.\n";
+	cerr << " --movetime=MS\t\t\t Time per move for both players.\n";
+	cerr << " --max-plies=N\t\t\t Draw games longer than this, 400 by default.\n";
+	cerr << " --openings=FILE\t\t Openings, one per line in coordinate notation.\n";
+	cerr << " --pgn=FILE\t\t\t Append the games to a PGN file.\n";
+	cerr << " --sprt=ELO0,ELO1\t\t Stop once H0 (A is ELO0 stronger) or H1 (A is\n";
+	cerr << "                 \t\t ELO1 stronger) is accepted.\n";
+	cerr << " --alpha=A  --beta=B\t\t SPRT error probabilities, 0.05 by default.\n";
+	cerr << LogOptions::usage();
+	cerr << " -h  --help\t\t\t Print this help screen.\n\n";
+	cerr << "bench searches a fixed set of positions to DEPTH plies on one thread\n";
+	cerr << "and prints the node count signature and the nodes per second.\n";
+	cerr << "bench notation times reading and writing FEN and SAN.\n";
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+
+	if(args.size() == 2 && args[0] == "bench" && args[1] == "notation") {
+		runNotationBench();
+		return 0;
+	}
+	if(!args.empty() && args[0] == "bench") {
+		int depth = BENCH_DEPTH;
+		if(args.size() > 1) {
+			depth = atoi(args[1].c_str());
+		}
+		if(depth <= 0 || args.size() > 2) {
+			printUsage();
+		}
+		runBench(depth);
+		return 0;
+	}
+
+	vector<string> players;
+	string openings, pgn;
+	LogOptions logoptions;
+	int games = 1000, threads = 0, maxplies = 400;
+	TimeControl tc;
+	SearchLimits limits;
+	bool sprt = false;
+	double elo0 = 0, elo1 = 0, alpha = 0.05, beta = 0.05;
+
+	for(int i = 0; i < (int)args.size(); i++) {
+		if(args[i] == "-h" || args[i] == "--help") {
+			printUsage();
+		} else if(args[i] == "-g" && i + 1 < (int)args.size()) {
+			games = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 8) == "--games=") {
+			games = atoi(args[i].substr(8).c_str());
+		} else if(args[i] == "-j" && i + 1 < (int)args.size()) {
+			threads = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 10) == "--threads=") {
+			threads = atoi(args[i].substr(10).c_str());
+		} else if(args[i].substr(0, 5) == "--tc=") {
+			if(!TimeControl::parse(args[i].substr(5), tc)) {
+				printUsage();
+			}
+		} else if(args[i].substr(0, 8) == "--depth=") {
+			limits.depth = atoi(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 8) == "--nodes=") {
+			limits.nodes = atoll(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 11) == "--movetime=") {
+			limits.movetime = atoi(args[i].substr(11).c_str());
+		} else if(args[i].substr(0, 12) == "--max-plies=") {
+			maxplies = atoi(args[i].substr(12).c_str());
+		} else if(args[i].substr(0, 11) == "--openings=") {
+			openings = args[i].substr(11);
+		} else if(args[i].substr(0, 6) == "--pgn=") {
+			pgn = args[i].substr(6);
+		} else if(logoptions.parse(args[i])) {
+			// --log or --log-level
+		} else if(args[i].substr(0, 7) == "--sprt=") {
+			string bounds = args[i].substr(7);
+			string::size_type comma = bounds.find(',');
+			if(comma == string::npos) {
+				printUsage();
+			}
+			elo0 = atof(bounds.substr(0, comma).c_str());
+			elo1 = atof(bounds.substr(comma + 1).c_str());
+			sprt = true;
+		} else if(args[i].substr(0, 8) == "--alpha=") {
+			alpha = atof(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 7) == "--beta=") {
+			beta = atof(args[i].substr(7).c_str());
+		} else if(args[i][0] == '-') {
+			printUsage();
+		} else {
+			players.push_back(args[i]);
+		}
+	}
+
+	if(players.size() != 2 || games <= 0) {
+		printUsage();
+	}
+
+	PlayerSpec a, b;
+	if(!parsePlayerSpec(players[0], a)) {
+		cerr << "Bad player: " << players[0] << endl;
+		printUsage();
+	}
+	if(!parsePlayerSpec(players[1], b)) {
+		cerr << "Bad player: " << players[1] << endl;
+		printUsage();
+	}
+
+	if(!logoptions.apply()) {
+		return 1;
+	}
+
+	Match match(a, b);
+	match.setGames(games);
+	match.setThreads(threads);
+	match.setLimits(limits);
+	match.setTimeControl(tc);
+	match.setMaxPlies(maxplies);
+	if(sprt) {
+		match.setSprt(elo0, elo1, alpha, beta);
+	}
+	if(!openings.empty() && !match.loadOpenings(openings)) {
+		cerr << "Couldn't read openings from " << openings << endl;
+		return 1;
+	}
+	if(!pgn.empty() && !match.openPgn(pgn)) {
+		cerr << "Couldn't open " << pgn << endl;
+		return 1;
+	}
+
+	match.run();
+
+	JobSystem::destroy();
+#ifndef WIN32
+	EnginePool::destroy();
+#endif
+	Logger::destroy();
+	return 0;
+}
+
+// End of file matchrunner.cpp
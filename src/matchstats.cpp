@@ -0,0 +1,110 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : matchstats.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "matchstats.h"
+
+#include <cmath>
+
+using namespace std;
+
+// Expected score for an Elo difference, and the other way around
+static double eloToScore(double elo)
+{
+	return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+static double scoreToElo(double score)
+{
+	// Keep a perfect score from going to infinity
+	if(score < 1e-6) {
+		score = 1e-6;
+	} else if(score > 1.0 - 1e-6) {
+		score = 1.0 - 1e-6;
+	}
+	return -400.0 * log10(1.0 / score - 1.0);
+}
+
+double MatchStats::score() const
+{
+	if(!games()) {
+		return 0.5;
+	}
+	return (m_wins + 0.5 * m_draws) / games();
+}
+
+double MatchStats::variance() const
+{
+	if(!games()) {
+		return 0.0;
+	}
+	double s = score();
+	double n = games();
+	return (m_wins * (1.0 - s) * (1.0 - s) +
+		m_draws * (0.5 - s) * (0.5 - s) +
+		m_losses * s * s) / n;
+}
+
+double MatchStats::elo() const
+{
+	return scoreToElo(score());
+}
+
+double MatchStats::eloError() const
+{
+	if(games() < 2) {
+		return 0.0;
+	}
+	double stderror = sqrt(variance() / games());
+	double low = scoreToElo(score() - 1.959964 * stderror);
+	double high = scoreToElo(score() + 1.959964 * stderror);
+	return (high - low) / 2.0;
+}
+
+double MatchStats::los() const
+{
+	if(m_wins + m_losses == 0) {
+		return 0.5;
+	}
+	return 0.5 * (1.0 + erf((m_wins - m_losses) /
+		sqrt(2.0 * (m_wins + m_losses))));
+}
+
+double MatchStats::llr(double elo0, double elo1) const
+{
+	double var = variance();
+	if(games() < 2 || var <= 0.0) {
+		return 0.0;
+	}
+	double s0 = eloToScore(elo0);
+	double s1 = eloToScore(elo1);
+	return games() * (s1 - s0) * (2.0 * score() - s0 - s1) / (2.0 * var);
+}
+
+MatchStats::Verdict MatchStats::sprt(double elo0, double elo1, double alpha,
+	double beta) const
+{
+	double ratio = llr(elo0, elo1);
+	if(ratio >= upperBound(alpha, beta)) {
+		return ACCEPT_H1;
+	} else if(ratio <= lowerBound(alpha, beta)) {
+		return ACCEPT_H0;
+	}
+	return CONTINUE;
+}
+
+double MatchStats::lowerBound(double alpha, double beta)
+{
+	return log(beta / (1.0 - alpha));
+}
+
+double MatchStats::upperBound(double alpha, double beta)
+{
+	return log((1.0 - beta) / alpha);
+}
+
+// End of file matchstats.cpp
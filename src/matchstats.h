@@ -0,0 +1,75 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : matchstats.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef MATCHSTATS_H
+#define MATCHSTATS_H
+
+/**
+ * Keeps the score of a match between two players, A and B, and turns it
+ * into an Elo difference with error bars and a sequential probability
+ * ratio test (SPRT) verdict. All results are from A's point of view.
+ */
+class MatchStats {
+ public:
+	enum Verdict { CONTINUE, ACCEPT_H0, ACCEPT_H1 };
+
+	MatchStats() : m_wins(0), m_draws(0), m_losses(0) {}
+
+	void addWin() { m_wins++; }
+	void addDraw() { m_draws++; }
+	void addLoss() { m_losses++; }
+
+	int wins() const { return m_wins; }
+	int draws() const { return m_draws; }
+	int losses() const { return m_losses; }
+	int games() const { return m_wins + m_draws + m_losses; }
+
+	/** Returns A's score, between 0 and 1. */
+	double score() const;
+
+	/** Returns the Elo difference of A over B. */
+	double elo() const;
+
+	/**
+	 * Returns the half width of the 95% confidence interval of the Elo
+	 * difference, using the per game variance of the results.
+	 */
+	double eloError() const;
+
+	/** Returns the likelihood that A is stronger than B, between 0 and 1. */
+	double los() const;
+
+	/**
+	 * Returns the log likelihood ratio of H1 (A is elo1 stronger) against
+	 * H0 (A is elo0 stronger), using the normal approximation of the
+	 * trinomial results.
+	 */
+	double llr(double elo0, double elo1) const;
+
+	/**
+	 * Tells whether the SPRT has accepted either hypothesis yet.
+	 * @param alpha - Probability of accepting H1 when H0 is true.
+	 * @param beta - Probability of accepting H0 when H1 is true.
+	 */
+	Verdict sprt(double elo0, double elo1, double alpha, double beta) const;
+
+	/** The LLR bounds the SPRT stops at. */
+	static double lowerBound(double alpha, double beta);
+	static double upperBound(double alpha, double beta);
+
+ private:
+	double variance() const;
+
+	int m_wins;
+	int m_draws;
+	int m_losses;
+};
+
+#endif // MATCHSTATS_H
+
+// End of file matchstats.h
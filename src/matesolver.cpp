@@ -0,0 +1,407 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : matesolver.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "matesolver.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+// Proof or disproof number of a position that is settled the other way
+static const unsigned int INFINITE = 1u << 30;
+
+// Set on the keys while black is to mate, the side to move alone doesn't
+// tell the attacker from the defender
+static const unsigned long long BLACK_ATTACKER = 0x9c5e3c6b2f1a7d43ULL;
+
+// Adds up proof numbers, a sum of finite numbers staying finite
+static unsigned int addNumbers(unsigned int a, unsigned int b)
+{
+	if(a >= INFINITE || b >= INFINITE) {
+		return INFINITE;
+	}
+	return min(a + b, INFINITE - 1);
+}
+
+MateSolver::MateSolver(int megabytes) :
+	m_mask(0),
+	m_attacker(Piece::WHITE),
+	m_nodes(0),
+	m_stopped(false),
+	m_stop(false)
+{
+	unsigned long long buckets = (unsigned long long)max(megabytes, 1) * 1024 * 1024 / sizeof(Bucket);
+	unsigned long long size = 1;
+	while(size * 2 <= buckets) {
+		size *= 2;
+	}
+	m_table.resize(size);
+	m_mask = size - 1;
+	clear();
+}
+
+void MateSolver::clear()
+{
+	// Both numbers 0 marks an empty entry, no position has them
+	Bucket empty;
+	for(int i = 0; i < BUCKET_SIZE; i++) {
+		empty.entries[i].lock = 0;
+		empty.entries[i].pn = 0;
+		empty.entries[i].dn = 0;
+		empty.entries[i].work = 0;
+		empty.entries[i].depth = 0;
+	}
+	fill(m_table.begin(), m_table.end(), empty);
+}
+
+// Returns true if move is one of moves
+static bool isOneOf(const BoardMove & move, const vector<BoardMove> & moves)
+{
+	for(int i = 0; i < (int)moves.size(); i++) {
+		if(moves[i].origin() == move.origin() && moves[i].dest() == move.dest() &&
+				moves[i].getPromotion() == move.getPromotion()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+MateResult MateSolver::solve(const Board & board, Piece::Color turn, int moves)
+{
+	return solve(board, turn, moves, vector<BoardMove>());
+}
+
+MateResult MateSolver::solve(const Board & board, Piece::Color turn, int moves,
+	const vector<BoardMove> & first)
+{
+	MateResult result;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	m_attacker = turn;
+	m_nodes = 0;
+	m_stopped = false;
+	m_stop = false;
+	if(m_limits.movetime) {
+		m_deadline = start + chrono::milliseconds(m_limits.movetime);
+	}
+
+	// The first depth with a proof has the quickest mate
+	for(int depth = 1; depth <= moves && !m_stopped && !result.moves; depth++) {
+		if(first.empty()) {
+			if(prove(board, turn, true, depth)) {
+				result.moves = depth;
+			}
+			continue;
+		}
+		for(int i = 0; i < (int)first.size() && !m_stopped && !result.moves; i++) {
+			Board after = board;
+			after.update(first[i]);
+			if(prove(after, Piece::opposite(turn), false, depth - 1)) {
+				result.moves = depth;
+			}
+		}
+	}
+	if(result.moves) {
+		result.status = MateResult::MATE;
+	}
+	if(result.status == MateResult::MATE) {
+		// The line is worked out whatever the limits, it costs little next
+		// to the proof
+		SearchLimits limits = m_limits;
+		m_limits = SearchLimits();
+		m_stopped = false;
+		findLine(board, turn, result.moves, first, result.pv);
+		m_limits = limits;
+	} else if(!m_stopped) {
+		result.status = MateResult::NO_MATE;
+	}
+
+	result.nodes = m_nodes;
+	result.time = (int)chrono::duration_cast<chrono::milliseconds>(
+		chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+bool MateSolver::lookup(unsigned long long key, int depth, unsigned int & pn, unsigned int & dn) const
+{
+	const Entry * bucket = m_table[key & m_mask].entries;
+	unsigned int lock = (unsigned int)(key >> 32);
+	bool found = false;
+	for(int i = 0; i < BUCKET_SIZE; i++) {
+		const Entry & entry = bucket[i];
+		if(entry.lock != lock || (!entry.pn && !entry.dn)) {
+			continue;
+		}
+
+		// A mate in fewer moves is one in more too, and no mate in more
+		// moves means none in fewer
+		if((!entry.pn && entry.depth <= depth) || (!entry.dn && entry.depth >= depth)) {
+			pn = entry.pn;
+			dn = entry.dn;
+			return true;
+		}
+		if(entry.depth == depth) {
+			pn = entry.pn;
+			dn = entry.dn;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void MateSolver::store(unsigned long long key, int depth, unsigned int pn, unsigned int dn, unsigned int work)
+{
+	// The same position, else the one that took the least work
+	Entry * bucket = m_table[key & m_mask].entries;
+	unsigned int lock = (unsigned int)(key >> 32);
+	Entry * slot = bucket;
+	for(int i = 0; i < BUCKET_SIZE; i++) {
+		if(bucket[i].lock == lock && bucket[i].depth == depth) {
+			slot = &bucket[i];
+			break;
+		}
+		if(bucket[i].work < slot->work) {
+			slot = &bucket[i];
+		}
+	}
+	slot->lock = lock;
+	slot->depth = (short)depth;
+	slot->pn = pn;
+	slot->dn = dn;
+	slot->work = (unsigned short)min(work, (unsigned int)USHRT_MAX);
+}
+
+unsigned long long MateSolver::getKey(const Board & board, Piece::Color turn) const
+{
+	return board.getKey(turn) ^ ((m_attacker == Piece::BLACK) ? BLACK_ATTACKER : 0);
+}
+
+void MateSolver::evaluate(const Board & board, Piece::Color turn, bool attacker, int depth,
+	unsigned int & pn, unsigned int & dn) const
+{
+	// With the moves used up a defender that isn't in check can't be
+	// mated, whatever it has left
+	if(!attacker && depth == 0 && !board.isCheck(turn)) {
+		pn = INFINITE;
+		dn = 0;
+		return;
+	}
+
+	unsigned long long legal[Board::BOARDSIZE*Board::BOARDSIZE];
+	int count = board.legalMoves(turn, legal);
+	if(!count) {
+		// Only mating the defender counts, stalemate is no better than
+		// getting mated
+		bool mated = !attacker && board.isCheck(turn);
+		pn = mated ? 0 : INFINITE;
+		dn = mated ? INFINITE : 0;
+	} else if(!attacker && depth == 0) {
+		pn = INFINITE;
+		dn = 0;
+	} else if(attacker) {
+		// The attacker needs one good move, the defender has to answer
+		// every one
+		pn = 1;
+		dn = count;
+	} else {
+		pn = count;
+		dn = 1;
+	}
+}
+
+void MateSolver::expand(const Board & board, Piece::Color turn, bool attacker, int depth,
+	vector<Child> & children)
+{
+	static const Piece::Type PROMOTIONS[4] = {
+		Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT
+	};
+
+	children.clear();
+	unsigned long long legal[Board::BOARDSIZE*Board::BOARDSIZE];
+	board.legalMoves(turn, legal);
+	Piece::Color next = Piece::opposite(turn);
+	int nextdepth = attacker ? depth - 1 : depth;
+
+	for(int i = 0; i < Board::BOARDSIZE*Board::BOARDSIZE; i++) {
+		unsigned long long targets = legal[i];
+		for(int j = 0; targets; j++, targets >>= 1) {
+			if(!(targets & 1)) {
+				continue;
+			}
+			BoardMove bm(BoardPosition(i), BoardPosition(j), board.getPiece(BoardPosition(i)));
+			int promotions = bm.needPromotion() ? 4 : 1;
+			for(int k = 0; k < promotions; k++) {
+				if(promotions > 1) {
+					bm.setPromotion(PROMOTIONS[k]);
+				}
+				Board after = board;
+				after.update(bm);
+
+				// With one move left only a check can mate
+				if(attacker && depth == 1 && !after.isCheck(next)) {
+					continue;
+				}
+
+				Child child;
+				child.move = bm;
+				child.key = getKey(after, next);
+				unsigned int pn, dn;
+				if(!lookup(child.key, nextdepth, pn, dn)) {
+					evaluate(after, next, !attacker, nextdepth, pn, dn);
+					store(child.key, nextdepth, pn, dn, 0);
+				}
+				child.phi = attacker ? dn : pn;
+				child.delta = attacker ? pn : dn;
+				children.push_back(child);
+			}
+		}
+	}
+}
+
+void MateSolver::mid(const Board & board, Piece::Color turn, bool attacker, int depth,
+	unsigned long long key, unsigned int thphi, unsigned int thdelta,
+	unsigned int & phi, unsigned int & delta)
+{
+	if(outOfTime()) {
+		m_stopped = true;
+		return;
+	}
+	long long first = m_nodes;
+
+	vector<Child> children;
+	expand(board, turn, attacker, depth, children);
+	Piece::Color next = Piece::opposite(turn);
+	int nextdepth = attacker ? depth - 1 : depth;
+
+	while(true) {
+		// The side to move needs one move that works, its opponent has to
+		// answer all of them. With none the attacker has failed, unless
+		// the defender is mated.
+		int best = -1;
+		unsigned int second = INFINITE;
+		phi = INFINITE;
+		delta = 0;
+		for(int i = 0; i < (int)children.size(); i++) {
+			delta = addNumbers(delta, children[i].phi);
+			if(children[i].delta < phi) {
+				second = phi;
+				phi = children[i].delta;
+				best = i;
+			} else if(children[i].delta < second) {
+				second = children[i].delta;
+			}
+		}
+		if(children.empty() && !attacker && !board.isCheck(turn)) {
+			phi = 0;
+			delta = INFINITE;
+		}
+		if(phi >= thphi || delta >= thdelta || m_stopped) {
+			break;
+		}
+
+		// Go on with the most promising move until it stops being that,
+		// with some slack so the search doesn't keep switching between two
+		// of them
+		Child & child = children[best];
+		unsigned int childphi = thdelta - delta + child.phi;
+		unsigned int childdelta = min(thphi, second + second / 4 + 1);
+		Board after = board;
+		after.update(child.move);
+		mid(after, next, !attacker, nextdepth, child.key, childphi, childdelta,
+			child.phi, child.delta);
+	}
+
+	unsigned int work = (unsigned int)min(m_nodes - first, (long long)UINT_MAX);
+	store(key, depth, attacker ? phi : delta, attacker ? delta : phi, work);
+}
+
+bool MateSolver::prove(const Board & board, Piece::Color turn, bool attacker, int depth)
+{
+	unsigned long long key = getKey(board, turn);
+	unsigned int pn, dn;
+	if(!lookup(key, depth, pn, dn)) {
+		evaluate(board, turn, attacker, depth, pn, dn);
+	}
+	if(pn && dn) {
+		unsigned int phi = attacker ? pn : dn;
+		unsigned int delta = attacker ? dn : pn;
+		mid(board, turn, attacker, depth, key, INFINITE, INFINITE, phi, delta);
+		pn = attacker ? phi : delta;
+	}
+	return pn == 0;
+}
+
+void MateSolver::findLine(Board board, Piece::Color turn, int depth, const vector<BoardMove> & first,
+	vector<BoardMove> & pv)
+{
+	Piece::Color defender = Piece::opposite(turn);
+	vector<Child> children;
+	while(depth > 0 && !m_stopped) {
+		// Any move that keeps the mate in depth moves, those the table
+		// already knows to work first
+		expand(board, turn, true, depth, children);
+		stable_sort(children.begin(), children.end(),
+			[](const Child & a, const Child & b) { return a.delta < b.delta; });
+		int found = -1;
+		for(int i = 0; i < (int)children.size() && found < 0 && !m_stopped; i++) {
+			if(pv.empty() && !first.empty() && !isOneOf(children[i].move, first)) {
+				continue;
+			}
+			Board after = board;
+			after.update(children[i].move);
+			if(prove(after, defender, false, depth - 1)) {
+				found = i;
+			}
+		}
+		if(found < 0) {
+			return;
+		}
+		board.update(children[found].move);
+		pv.push_back(children[found].move);
+		depth--;
+
+		// The defence that puts the mate off longest, none left is mate
+		expand(board, defender, false, depth, children);
+		int longest = 0;
+		BoardMove defence;
+		for(int i = 0; i < (int)children.size() && !m_stopped; i++) {
+			Board after = board;
+			after.update(children[i].move);
+			int moves = 1;
+			while(moves < depth && !prove(after, turn, true, moves)) {
+				moves++;
+			}
+			if(moves > longest) {
+				longest = moves;
+				defence = children[i].move;
+			}
+		}
+		if(!longest || m_stopped) {
+			return;
+		}
+		board.update(defence);
+		pv.push_back(defence);
+		depth = longest;
+	}
+}
+
+bool MateSolver::outOfTime()
+{
+	m_nodes++;
+	if(m_stop) {
+		return true;
+	}
+	if(m_limits.nodes && m_nodes >= m_limits.nodes) {
+		return true;
+	}
+	// The clock is only read every so often, it isn't free
+	return m_limits.movetime && (m_nodes & 1023) == 0 &&
+		chrono::steady_clock::now() >= m_deadline;
+}
+
+// End of file matesolver.cpp
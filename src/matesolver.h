@@ -0,0 +1,167 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : matesolver.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef MATESOLVER_H
+#define MATESOLVER_H
+
+#include "board.h"
+#include "boardmove.h"
+#include "searchinfo.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+/**
+ * What a MateSolver found out about a position.
+ */
+struct MateResult {
+	enum Status {
+		/** The limits ran out first */
+		UNKNOWN,
+		/** The side to move mates in moves moves */
+		MATE,
+		/** There is no mate in as many moves as were asked for */
+		NO_MATE
+	};
+
+	MateResult() :
+		status(UNKNOWN),
+		moves(0),
+		nodes(0),
+		time(0) {}
+
+	Status status;
+	/** Moves to the quickest mate, when found */
+	int moves;
+	/**
+	 * The mating line, moves of both sides, with the defence that holds
+	 * out longest. Ends with the mate.
+	 */
+	std::vector<BoardMove> pv;
+	long long nodes;
+	/** Milliseconds taken */
+	int time;
+};
+
+/**
+ * Proves or disproves that the side to move can force mate within a
+ * number of moves, with depth-first proof-number search (df-pn). Instead
+ * of scoring positions it counts how many of them would still have to be
+ * proven or disproven, and always works on the one that is cheapest to
+ * settle, so forced mates are found many times faster than by alpha-beta.
+ *
+ * Proof and disproof numbers are kept in a transposition table of their
+ * own, together with the moves left, so that a table filled by one
+ * search helps the next. Repetitions and the fifty move rule are not
+ * taken into account, a mate through a repeated position is found all
+ * the same.
+ *
+ * Needs Board::init() to have been called. A MateSolver is used by one
+ * thread at a time, stop() may be called from any thread.
+ */
+class MateSolver {
+ public:
+	/** @param megabytes - Size of the transposition table. */
+	MateSolver(int megabytes = 16);
+
+	/**
+	 * Sets the nodes and movetime to give up after, for each solve. No
+	 * limit by default.
+	 */
+	void setLimits(const SearchLimits & limits)
+		{ m_limits = limits; }
+
+	/**
+	 * Looks for the quickest mate of the side to move in at most moves
+	 * moves, trying one move first, then two and so on.
+	 * @param turn - The side to move, the one that is to mate.
+	 */
+	MateResult solve(const Board & board, Piece::Color turn, int moves);
+
+	/**
+	 * Same as above for a mate that starts with one of the legal moves
+	 * first, to check the solution of a problem.
+	 */
+	MateResult solve(const Board & board, Piece::Color turn, int moves,
+		const std::vector<BoardMove> & first);
+
+	/** Makes a running solve give up, the result is UNKNOWN. */
+	void stop()
+		{ m_stop = true; }
+
+	/** Forgets every position of the transposition table. */
+	void clear();
+
+ private:
+	MateSolver(const MateSolver &);
+	MateSolver & operator=(const MateSolver &);
+
+	struct Entry {
+		/** The upper half of the key, the lower half picks the bucket */
+		unsigned int lock;
+		unsigned int pn, dn;
+		/** Nodes spent on the position, the cheapest are replaced first */
+		unsigned short work;
+		short depth;
+	};
+
+	static const int BUCKET_SIZE = 4;
+
+	/** The entries a position may be kept in, one cache line */
+	struct alignas(64) Bucket {
+		Entry entries[BUCKET_SIZE];
+	};
+
+	struct Child {
+		BoardMove move;
+		unsigned long long key;
+		/** Proof numbers from the point of view of the side to move there */
+		unsigned int phi, delta;
+	};
+
+	// Finds the numbers of a position with depth moves left for the
+	// attacker, returns false if it has none in the table
+	bool lookup(unsigned long long key, int depth, unsigned int & pn, unsigned int & dn) const;
+	void store(unsigned long long key, int depth, unsigned int pn, unsigned int dn, unsigned int work);
+
+	unsigned long long getKey(const Board & board, Piece::Color turn) const;
+
+	// Numbers of a position not searched yet, settled at once if the
+	// game is over there or the attacker has no moves left
+	void evaluate(const Board & board, Piece::Color turn, bool attacker, int depth,
+		unsigned int & pn, unsigned int & dn) const;
+	void expand(const Board & board, Piece::Color turn, bool attacker, int depth,
+		std::vector<Child> & children);
+
+	void mid(const Board & board, Piece::Color turn, bool attacker, int depth,
+		unsigned long long key, unsigned int thphi, unsigned int thdelta,
+		unsigned int & phi, unsigned int & delta);
+
+	// Searches until a position is proven or disproven, returns true for
+	// a mate
+	bool prove(const Board & board, Piece::Color turn, bool attacker, int depth);
+	void findLine(Board board, Piece::Color turn, int depth, const std::vector<BoardMove> & first,
+		std::vector<BoardMove> & pv);
+
+	bool outOfTime();
+
+	std::vector<Bucket> m_table;
+	unsigned long long m_mask;
+
+	Piece::Color m_attacker;
+	SearchLimits m_limits;
+	long long m_nodes;
+	std::chrono::steady_clock::time_point m_deadline;
+	bool m_stopped;
+	std::atomic<bool> m_stop;
+};
+
+#endif // MATESOLVER_H
+
+// End of file matesolver.h
@@ -0,0 +1,553 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : mctsplayer.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "board.h"
+#include "chessplayer.h"
+#include "jobsystem.h"
+#include "notation.h"
+#include "openingbook.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// States of a node, the thread that expands it owns it in between
+enum { UNEXPANDED, EXPANDING, EXPANDED };
+
+// Results are summed in fixed point so that threads can add them up
+static const double VALUE_SCALE = 65536.0;
+
+// Untried moves are taken to be this much worse than their parent
+static const double FPU_REDUCTION = 0.2;
+
+// Random moves of a rollout before the capture search takes over
+static const int ROLLOUT_PLIES = 4;
+static const int QUIESCE_DEPTH = 6;
+
+// Scores are taken relative to the root, so that being a rook up still
+// leaves room to tell a won position from a mate
+static const int MAX_SCORE = 2000;
+
+// A kept tree is dropped once the evaluation moved this far from the root
+// its results are relative to
+static const int REUSE_MARGIN = 100;
+
+static const int REPORT_INTERVAL_MS = 500;
+
+static const int PIECE_VALUES[Piece::NOTYPE + 1] = {
+	100, 500, 310, 325, 900, 0, 0
+};
+
+static const Piece::Type PROMOTIONS[4] = {
+	Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT
+};
+
+static unsigned short encodeMove(const BoardMove & bm)
+{
+	return bm.origin().hash() | bm.dest().hash() << 6 | bm.getPromotion() << 12;
+}
+
+static BoardMove decodeMove(unsigned short move, const Board & board)
+{
+	BoardPosition from(move & 63), to((move >> 6) & 63);
+	return BoardMove(from, to, board.getPiece(from), (Piece::Type)(move >> 12));
+}
+
+// Chance of winning for a score in centipawns
+static double toValue(int score)
+{
+	score = max(-MAX_SCORE, min(MAX_SCORE, score));
+	return 1.0 / (1.0 + pow(10.0, -score / 400.0));
+}
+
+static int toScore(double value)
+{
+	value = max(0.001, min(0.999, value));
+	return (int)(-400.0 * log10(1.0 / value - 1.0));
+}
+
+static unsigned long long nextRandom(unsigned long long & seed)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return seed;
+}
+
+// Every legal move, promotions to each piece
+static void generateMoves(const Board & board, Piece::Color turn, vector<BoardMove> & moves)
+{
+	unsigned long long legal[64];
+	moves.clear();
+	if(!board.legalMoves(turn, legal)) {
+		return;
+	}
+	for(int i = 0; i < 64; i++) {
+		for(unsigned long long bits = legal[i]; bits; bits &= bits - 1) {
+			BoardMove bm(BoardPosition(i), BoardPosition(__builtin_ctzll(bits)),
+				board.getPiece(BoardPosition(i)));
+			if(!bm.needPromotion()) {
+				moves.push_back(bm);
+				continue;
+			}
+			for(int k = 0; k < 4; k++) {
+				bm.setPromotion(PROMOTIONS[k]);
+				moves.push_back(bm);
+			}
+		}
+	}
+}
+
+MctsPlayer::MctsPlayer(int megabytes) :
+	m_capacity(max(megabytes, 1) * (1 << 20) / (int)sizeof(Node)),
+	m_used(0),
+	m_has_tree(false),
+	m_root_turn(Piece::WHITE),
+	m_baseline(0),
+	m_playout(STATIC),
+	m_threads(0),
+	m_exploration(1.5),
+	m_default_playouts(0),
+	m_playouts(0),
+	m_seldepth(0),
+	m_done(false)
+{
+}
+
+void MctsPlayer::newGame()
+{
+	m_has_tree = false;
+}
+
+void MctsPlayer::think(const ChessGameState & cgs)
+{
+	m_is_thinking = true;
+	m_stop = false;
+	m_nodes = 0;
+
+	if(m_book && m_book->pickMove(cgs, m_move)) {
+		m_is_thinking = false;
+		return;
+	}
+
+	long long budget = getBudget();
+	m_timed = (budget > 0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if(m_timed) {
+		m_deadline = start + chrono::milliseconds(budget);
+	}
+	if(m_mate_solver && findMate(cgs, start)) {
+		m_is_thinking = false;
+		return;
+	}
+
+	// A node limit counts playouts, a time limit runs until it is up, and
+	// otherwise the ply sets them
+	long long limit = m_limits.nodes;
+	if(!limit && m_timed) {
+		limit = LLONG_MAX;
+	} else if(!limit) {
+		limit = m_default_playouts ? m_default_playouts :
+			250LL << (2 * max(0, min(m_ply - 1, 20)));
+	}
+
+	if(!m_tree) {
+		m_tree.reset(new Node[m_capacity]);
+	}
+	if(!reuseTree(cgs.getBoard(), getColor())) {
+		m_root_board = cgs.getBoard();
+		m_root_turn = getColor();
+		m_baseline = evaluateBoard(m_root_board, m_root_turn);
+		resetTree();
+	}
+	m_has_tree = true;
+	m_playouts = 0;
+	m_seldepth = 0;
+	m_done = false;
+	m_last_report = start;
+
+	// Helpers give up at once if they start after the search is over, so
+	// that a busy JobSystem cannot hold up the move
+	int threads = m_threads ? m_threads : JobSystem::getInstance()->getThreadCount();
+	shared_ptr<vector<atomic<int> > > claims(new vector<atomic<int> >(max(threads - 1, 0)));
+	vector<JobHandle<void> > helpers;
+	for(int i = 0; i < (int)claims->size(); i++) {
+		(*claims)[i] = 0;
+		helpers.push_back(JobSystem::getInstance()->submit(JobSystem::SEARCH,
+			[this, claims, i, limit, start]() {
+				int expected = 0;
+				if((*claims)[i].compare_exchange_strong(expected, 1)) {
+					runPlayouts(limit, false, start);
+				}
+			}));
+	}
+	runPlayouts(limit, true, start);
+	for(int i = 0; i < (int)helpers.size(); i++) {
+		int expected = 0;
+		if(!(*claims)[i].compare_exchange_strong(expected, 2)) {
+			helpers[i].wait();
+		}
+	}
+
+	int best = bestChild(0);
+	if(best >= 0) {
+		m_move = decodeMove(m_tree[best].move, m_root_board);
+	} else {
+		// The arena was too small for even the root
+		vector<BoardMove> moves;
+		generateMoves(m_root_board, m_root_turn, moves);
+		if(!moves.empty()) {
+			m_move = moves[0];
+		}
+	}
+	m_nodes = min(m_playouts.load(), limit);
+	report(start);
+	m_is_thinking = false;
+}
+
+bool MctsPlayer::reuseTree(const Board & board, Piece::Color turn)
+{
+	if(!m_has_tree || abs(evaluateBoard(board, turn) - m_baseline) > REUSE_MARGIN) {
+		return false;
+	}
+
+	// The position is usually two plies down, after our move and the reply
+	unsigned long long key = board.getKey(turn);
+	int found = -1;
+	if(m_root_board.getKey(m_root_turn) == key && m_root_turn == turn) {
+		found = 0;
+	}
+	for(int i = 0; i < m_tree[0].child_count && found < 0; i++) {
+		const Node & child = m_tree[m_tree[0].first_child + i];
+		if(child.state != EXPANDED) {
+			continue;
+		}
+		Board after = m_root_board;
+		after.update(decodeMove(child.move, after));
+		for(int j = 0; j < child.child_count; j++) {
+			int index = child.first_child + j;
+			Board next = after;
+			next.update(decodeMove(m_tree[index].move, next));
+			if(next.getKey(turn) == key) {
+				found = index;
+				break;
+			}
+		}
+	}
+	if(found < 0) {
+		return false;
+	}
+
+	// Copy the subtree into the spare arena breadth first, children stay
+	// together
+	if(!m_spare) {
+		m_spare.reset(new Node[m_capacity]);
+	}
+	vector<pair<int, int> > queue(1, make_pair(found, 0));
+	int used = 1;
+	for(int q = 0; q < (int)queue.size(); q++) {
+		const Node & from = m_tree[queue[q].first];
+		Node & to = m_spare[queue[q].second];
+		to.visits = from.visits.load();
+		to.virtual_loss = 0;
+		to.value = from.value.load();
+		to.prior = from.prior;
+		to.move = from.move;
+		to.first_child = -1;
+		to.child_count = 0;
+		to.state = UNEXPANDED;
+		if(from.state != EXPANDED) {
+			continue;
+		}
+		to.state = EXPANDED;
+		if(!from.child_count) {
+			continue;
+		}
+		to.first_child = used;
+		to.child_count = from.child_count;
+		for(int i = 0; i < from.child_count; i++) {
+			queue.push_back(make_pair(from.first_child + i, used + i));
+		}
+		used += from.child_count;
+	}
+	swap(m_tree, m_spare);
+	m_used = used;
+	m_root_board = board;
+	m_root_turn = turn;
+	return true;
+}
+
+void MctsPlayer::resetTree()
+{
+	Node & root = m_tree[0];
+	root.visits = 0;
+	root.virtual_loss = 0;
+	root.value = 0;
+	root.prior = 1.0f;
+	root.move = 0;
+	root.first_child = -1;
+	root.child_count = 0;
+	root.state = UNEXPANDED;
+	m_used = 1;
+}
+
+void MctsPlayer::runPlayouts(long long limit, bool main, chrono::steady_clock::time_point start)
+{
+	vector<int> path;
+	unsigned long long seed = ((unsigned long long)chrono::steady_clock::now().time_since_epoch().count() ^
+		(unsigned long long)hash<thread::id>()(this_thread::get_id())) | 1;
+	for(long long count = 1; !m_stop && !m_done; count++) {
+		if(m_playouts.fetch_add(1) >= limit) {
+			break;
+		}
+		playout(path, seed);
+		if(m_timed && !(count & 15) && chrono::steady_clock::now() >= m_deadline) {
+			break;
+		}
+		if(main && m_info_callback && !(count & 63) && chrono::steady_clock::now() -
+				m_last_report >= chrono::milliseconds(REPORT_INTERVAL_MS)) {
+			report(start);
+		}
+	}
+	// Whichever thread finishes first ends the search for all
+	m_done = true;
+}
+
+void MctsPlayer::playout(vector<int> & path, unsigned long long & seed)
+{
+	Board board = m_root_board;
+	Piece::Color turn = m_root_turn;
+	int index = 0;
+	path.clear();
+	path.push_back(index);
+	while(m_tree[index].state.load(memory_order_acquire) == EXPANDED && m_tree[index].child_count) {
+		index = select(index);
+		m_tree[index].virtual_loss++;
+		board.update(decodeMove(m_tree[index].move, board));
+		turn = Piece::opposite(turn);
+		path.push_back(index);
+	}
+
+	// A leaf gets its children on its second visit, which saves most of
+	// the arena for lines worth looking at. The first thread to get there
+	// adds them, the others just score it
+	Node & leaf = m_tree[index];
+	unsigned char expected = UNEXPANDED;
+	bool terminal = (leaf.state.load(memory_order_acquire) == EXPANDED);
+	if(!terminal && (leaf.visits || !index) &&
+			leaf.state.compare_exchange_strong(expected, EXPANDING)) {
+		terminal = expand(leaf, board, turn) && !leaf.child_count;
+	}
+	double value;
+	if(terminal) {
+		value = board.isCheck(turn) ? 1.0 : toResult(0, Piece::opposite(turn));
+	} else if(board.isMaterialDraw()) {
+		value = toResult(0, Piece::opposite(turn));
+	} else {
+		value = evaluate(board, turn, seed);
+	}
+
+	for(int i = (int)path.size() - 1; i >= 0; i--) {
+		Node & node = m_tree[path[i]];
+		node.value += (long long)(value * VALUE_SCALE);
+		node.visits++;
+		if(i) {
+			node.virtual_loss--;
+		}
+		value = 1.0 - value;
+	}
+
+	int depth = (int)path.size() - 1;
+	int seldepth = m_seldepth;
+	while(depth > seldepth && !m_seldepth.compare_exchange_weak(seldepth, depth)) {
+	}
+}
+
+int MctsPlayer::select(int index) const
+{
+	const Node & node = m_tree[index];
+	double sqrtn = sqrt((double)max(node.visits + node.virtual_loss, 1));
+	int visits = node.visits;
+	double parent = visits ? 1.0 - node.value / VALUE_SCALE / visits : 0.5;
+	double fpu = max(parent - FPU_REDUCTION, 0.0);
+
+	// Moves on their way down count as losses, they have visits but no
+	// value yet
+	int best = node.first_child;
+	double bestscore = -1.0;
+	for(int i = 0; i < node.child_count; i++) {
+		const Node & child = m_tree[node.first_child + i];
+		int n = child.visits + child.virtual_loss;
+		double q = n ? child.value / VALUE_SCALE / n : fpu;
+		double score = q + m_exploration * child.prior * sqrtn / (1 + n);
+		if(score > bestscore) {
+			bestscore = score;
+			best = node.first_child + i;
+		}
+	}
+	return best;
+}
+
+bool MctsPlayer::expand(Node & node, const Board & board, Piece::Color turn)
+{
+	vector<BoardMove> moves;
+	generateMoves(board, turn, moves);
+	int count = (int)moves.size();
+
+	int first = m_used;
+	do {
+		if(first + count > m_capacity) {
+			node.state.store(UNEXPANDED, memory_order_release);
+			return false;
+		}
+	} while(!m_used.compare_exchange_weak(first, first + count));
+
+	// Captures of big pieces by small ones and promotions are tried first
+	vector<double> weights(count);
+	double total = 0.0;
+	for(int i = 0; i < count; i++) {
+		double gain = 0.0;
+		if(board.isOccupied(moves[i].dest())) {
+			gain += PIECE_VALUES[board.getPiece(moves[i].dest())->type()] -
+				PIECE_VALUES[moves[i].getPiece()->type()] / 10.0 + 100.0;
+		}
+		if(moves[i].getPromotion() != Piece::NOTYPE) {
+			gain += PIECE_VALUES[moves[i].getPromotion()] - 100.0;
+		}
+		weights[i] = exp(gain / 200.0);
+		total += weights[i];
+	}
+	for(int i = 0; i < count; i++) {
+		Node & child = m_tree[first + i];
+		child.visits = 0;
+		child.virtual_loss = 0;
+		child.value = 0;
+		child.prior = (float)(weights[i] / total);
+		child.move = encodeMove(moves[i]);
+		child.first_child = -1;
+		child.child_count = 0;
+		child.state = UNEXPANDED;
+	}
+	node.first_child = first;
+	node.child_count = (unsigned short)count;
+	node.state.store(EXPANDED, memory_order_release);
+	return true;
+}
+
+double MctsPlayer::evaluate(const Board & board, Piece::Color turn, unsigned long long & seed)
+{
+	Piece::Color mover = Piece::opposite(turn);
+	if(m_playout == STATIC) {
+		return toResult(evaluateBoard(board, mover), mover);
+	}
+
+	// A few random moves, then captures until the position is quiet
+	Board rollout = board;
+	Piece::Color side = turn;
+	vector<BoardMove> moves;
+	for(int ply = 0; ply < ROLLOUT_PLIES; ply++) {
+		generateMoves(rollout, side, moves);
+		if(moves.empty()) {
+			if(!rollout.isCheck(side)) {
+				return toResult(0, mover);
+			}
+			return (side == mover) ? 0.0 : 1.0;
+		}
+		rollout.update(moves[nextRandom(seed) % moves.size()]);
+		side = Piece::opposite(side);
+	}
+	int score = quiesce(rollout, side, -INT_MAX, INT_MAX, QUIESCE_DEPTH);
+	return toResult(side == mover ? score : -score, mover);
+}
+
+double MctsPlayer::toResult(int score, Piece::Color color) const
+{
+	return toValue(score + (color == m_root_turn ? -m_baseline : m_baseline));
+}
+
+int MctsPlayer::quiesce(const Board & board, Piece::Color turn, int alpha, int beta, int depth)
+{
+	int stand = evaluateBoard(board, turn);
+	if(stand >= beta || !depth) {
+		return stand;
+	}
+	alpha = max(alpha, stand);
+
+	unsigned long long legal[64];
+	board.legalMoves(turn, legal);
+	for(int i = 0; i < 64; i++) {
+		for(unsigned long long bits = legal[i]; bits; bits &= bits - 1) {
+			BoardPosition to(__builtin_ctzll(bits));
+			if(!board.isOccupied(to)) {
+				continue;
+			}
+			BoardMove bm(BoardPosition(i), to, board.getPiece(BoardPosition(i)));
+			if(bm.needPromotion()) {
+				bm.setPromotion(Piece::QUEEN);
+			}
+			Board after = board;
+			after.update(bm);
+			int score = -quiesce(after, Piece::opposite(turn), -beta, -alpha, depth - 1);
+			if(score >= beta) {
+				return score;
+			}
+			alpha = max(alpha, score);
+		}
+	}
+	return alpha;
+}
+
+int MctsPlayer::bestChild(int index) const
+{
+	const Node & node = m_tree[index];
+	if(node.state.load(memory_order_acquire) != EXPANDED || !node.child_count) {
+		return -1;
+	}
+	int best = node.first_child;
+	for(int i = 1; i < node.child_count; i++) {
+		if(m_tree[node.first_child + i].visits > m_tree[best].visits) {
+			best = node.first_child + i;
+		}
+	}
+	return best;
+}
+
+void MctsPlayer::report(chrono::steady_clock::time_point start)
+{
+	m_last_report = chrono::steady_clock::now();
+	int best = bestChild(0);
+	if(!m_info_callback || best < 0 || !m_tree[best].visits) {
+		return;
+	}
+
+	SearchInfo info;
+	info.score = toScore(m_tree[best].value / VALUE_SCALE / m_tree[best].visits) + m_baseline;
+	info.seldepth = m_seldepth;
+	info.nodes = min(m_playouts.load(), m_limits.nodes ? m_limits.nodes : LLONG_MAX);
+	info.time = (int)chrono::duration_cast<chrono::milliseconds>(m_last_report - start).count();
+	info.nps = info.time ? info.nodes * 1000 / info.time : 0;
+
+	// The line of the most tried moves
+	Board board = m_root_board;
+	for(int index = best; index >= 0 && m_tree[index].visits; index = bestChild(index)) {
+		BoardMove bm = decodeMove(m_tree[index].move, board);
+		info.pv += (info.pv.empty() ? "" : " ") + moveToCoordinate(bm);
+		board.update(bm);
+		info.depth++;
+	}
+	m_info_callback(info);
+}
+
+// End of file mctsplayer.cpp
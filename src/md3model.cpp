@@ -6,6 +6,7 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey
  **************************************************************************/
 
+#include "logger.h"
 #include "md3model.h"
 
 #include <iostream>
@@ -29,7 +30,7 @@ bool MD3Model::load(const string& filename, const string& skin)
 	m_skin = skin;
 	ifstream infile(m_filename.c_str(), ios::in | ios::binary);
 	if (!infile.is_open()) {
-		cout << "Couldn't open file " << m_filename << endl;
+		LOG_ERROR("md3", "Couldn't open file " << m_filename);
 		return false;
 	}
 		
@@ -135,10 +136,10 @@ bool MD3Model::load(const string& filename, const string& skin)
 					texfile += "/";
 					texfile += bufptr;
 					if(m_textures.find(toks[1]) == m_textures.end()) {
-						cout << "'" << toks[1] << "'" << endl;
+						LOG_DEBUG("md3", "Texture '" << toks[1] << "'");
 						m_textures[toks[1]] = Texture();
 						if(!m_textures[toks[1]].load(texfile))
-							cout << "Failed to load texture: " << texfile << endl;
+							LOG_WARNING("md3", "Failed to load texture: " << texfile);
 					}
 					m_meshes[i].tex = toks[1];
 				}
@@ -151,9 +152,8 @@ bool MD3Model::load(const string& filename, const string& skin)
 
 bool MD3Model::loadGL()
 {
-	cout << "LoadGL called" << endl;
 	for(map<string, Texture>::iterator ti = m_textures.begin(); ti != m_textures.end(); ti++) {
-		cout << "'" << ti->first << "'" << endl;
+		LOG_DEBUG("md3", "Uploading texture '" << ti->first << "'");
 		ti->second.loadGL();
 	}
 	return true;
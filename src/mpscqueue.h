@@ -0,0 +1,131 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : mpscqueue.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+/**
+ * A bounded queue that any number of threads can push to and one thread
+ * pops from, without locks. The capacity is fixed, a push to a full
+ * queue fails instead of growing it, so a flood of messages can't delay
+ * the consumer by more than one queue full.
+ *
+ * Each slot carries a sequence number telling whether it is free for the
+ * producer of a given position or filled for the consumer, so producers
+ * only contend on claiming a position.
+ */
+template<class T>
+class MpscQueue {
+ public:
+	/** Creates a queue, the capacity is rounded up to a power of two. */
+	explicit MpscQueue(int capacity);
+
+	/** Adds value, returns false if the queue is full. */
+	bool tryPush(const T & value);
+
+	/** Adds value, waiting for the consumer while the queue is full. */
+	void push(const T & value);
+
+	/** Takes the oldest value, returns false if the queue is empty. Only
+	 * one thread may pop. */
+	bool tryPop(T & value);
+
+	int capacity() const
+		{ return (int)(m_mask + 1); }
+
+ private:
+	MpscQueue(const MpscQueue &);
+	MpscQueue & operator=(const MpscQueue &);
+
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+
+	// Producers and the consumer write to separate cache lines
+	alignas(64) std::atomic<size_t> m_tail;
+	alignas(64) size_t m_head;
+};
+
+template<class T>
+MpscQueue<T>::MpscQueue(int capacity) :
+	m_tail(0),
+	m_head(0)
+{
+	size_t size = 2;
+	while(size < (size_t)capacity) {
+		size *= 2;
+	}
+	m_cells.reset(new Cell[size]);
+	m_mask = size - 1;
+	for(size_t i = 0; i < size; i++) {
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template<class T>
+bool MpscQueue<T>::tryPush(const T & value)
+{
+	size_t pos = m_tail.load(std::memory_order_relaxed);
+	Cell * cell;
+	while(true) {
+		cell = &m_cells[pos & m_mask];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+		if(diff == 0) {
+			if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if(diff < 0) {
+			// The consumer hasn't freed this slot yet
+			return false;
+		} else {
+			pos = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->value = value;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template<class T>
+void MpscQueue<T>::push(const T & value)
+{
+	while(!tryPush(value)) {
+		std::this_thread::yield();
+	}
+}
+
+template<class T>
+bool MpscQueue<T>::tryPop(T & value)
+{
+	Cell & cell = m_cells[m_head & m_mask];
+	size_t seq = cell.sequence.load(std::memory_order_acquire);
+	if((ptrdiff_t)seq - (ptrdiff_t)(m_head + 1) < 0) {
+		return false;
+	}
+
+	value = cell.value;
+	cell.value = T();
+	cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+	m_head++;
+	return true;
+}
+
+#endif // MPSCQUEUE_H
+
+// End of file mpscqueue.h
@@ -0,0 +1,594 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : notation.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "notation.h"
+
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+
+string moveToCoordinate(const BoardMove & bm)
+{
+	string str;
+	if(!bm.isValid()) {
+		return "0000";
+	}
+
+	str += bm.origin().filec();
+	str += '0' + bm.origin().rank();
+	str += bm.dest().filec();
+	str += '0' + bm.dest().rank();
+
+	switch(bm.getPromotion()) {
+		case Piece::QUEEN:
+			str += 'q';
+			break;
+		case Piece::ROOK:
+			str += 'r';
+			break;
+		case Piece::BISHOP:
+			str += 'b';
+			break;
+		case Piece::KNIGHT:
+			str += 'n';
+			break;
+		default:
+			break;
+	}
+	return str;
+}
+
+BoardMove coordinateToMove(const Board & board, const string & str)
+{
+	BoardMove move;
+	move.invalidate();
+
+	if(str.size() < 4) {
+		return move;
+	}
+
+	BoardPosition origin(str[0], str[1] - '0');
+	BoardPosition dest(str[2], str[3] - '0');
+	if(!origin.isValid() || !dest.isValid() || !board.isOccupied(origin)) {
+		return move;
+	}
+
+	Piece::Type promote = Piece::NOTYPE;
+	if(str.size() > 4) {
+		switch(str[4]) {
+			case 'q': case 'Q': promote = Piece::QUEEN; break;
+			case 'r': case 'R': promote = Piece::ROOK; break;
+			case 'b': case 'B': promote = Piece::BISHOP; break;
+			case 'n': case 'N': promote = Piece::KNIGHT; break;
+			default: break;
+		}
+	}
+
+	return BoardMove(origin, dest, board.getPiece(origin), promote);
+}
+
+static Piece::Type letterPiece(char c)
+{
+	switch(c) {
+		case 'K': return Piece::KING;
+		case 'Q': return Piece::QUEEN;
+		case 'R': return Piece::ROOK;
+		case 'B': return Piece::BISHOP;
+		case 'N': return Piece::KNIGHT;
+		default: return Piece::NOTYPE;
+	}
+}
+
+static char pieceLetter(Piece::Type type)
+{
+	switch(type) {
+		case Piece::KING: return 'K';
+		case Piece::QUEEN: return 'Q';
+		case Piece::ROOK: return 'R';
+		case Piece::BISHOP: return 'B';
+		case Piece::KNIGHT: return 'N';
+		default: return 0;
+	}
+}
+
+// Squares the pieces of the side to move can go to, by origin
+typedef unsigned long long LegalMap[Board::BOARDSIZE*Board::BOARDSIZE];
+
+static char * appendSquare(char * out, const BoardPosition & bp)
+{
+	*out++ = bp.filec();
+	*out++ = '0' + bp.rank();
+	return out;
+}
+
+static int writeSAN(const Board & board, const unsigned long long * legal,
+	const BoardMove & bm, char * out)
+{
+	char * p = out;
+	Piece * piece = bm.isValid() ? board.getPiece(bm.origin()) : NULL;
+	if(!piece) {
+		*p++ = '-';
+		*p++ = '-';
+		*p = '\0';
+		return p - out;
+	}
+
+	Piece::Type type = piece->type();
+	Piece::Color color = piece->color();
+
+	if(type == Piece::KING && bm.fileDiff() == 2) {
+		*p++ = 'O';
+		*p++ = '-';
+		*p++ = 'O';
+		if(bm.signedFileDiff() < 0) {
+			*p++ = '-';
+			*p++ = 'O';
+		}
+	} else {
+		bool capture = board.isOccupied(bm.dest()) ||
+			(type == Piece::PAWN && bm.fileDiff());
+
+		if(type == Piece::PAWN) {
+			if(capture) {
+				*p++ = bm.origin().filec();
+			}
+		} else {
+			*p++ = pieceLetter(type);
+
+			// Name the origin file, rank or both when another piece of
+			// the same kind can go to the same square
+			bool ambiguous = false, samefile = false, samerank = false;
+			unsigned long long dest = getMask(bm.dest());
+			unsigned long long others = board.getPieces(color, type).getBoard() &
+				~getMask(bm.origin());
+			for(int i = 0; others; i++, others >>= 1) {
+				if(!(others & 1) || !(legal[i] & dest)) {
+					continue;
+				}
+				BoardPosition other(i);
+				ambiguous = true;
+				if(other.file() == bm.origin().file()) {
+					samefile = true;
+				}
+				if(other.rank() == bm.origin().rank()) {
+					samerank = true;
+				}
+			}
+			if(ambiguous && (!samefile || samerank)) {
+				*p++ = bm.origin().filec();
+			}
+			if(ambiguous && samefile) {
+				*p++ = '0' + bm.origin().rank();
+			}
+		}
+
+		if(capture) {
+			*p++ = 'x';
+		}
+		p = appendSquare(p, bm.dest());
+
+		if(type == Piece::PAWN && bm.getPromotion() != Piece::NOTYPE) {
+			*p++ = '=';
+			*p++ = pieceLetter(bm.getPromotion());
+		}
+	}
+
+	// Telling mate from check needs the moves of the other side, which
+	// only a checking move pays for
+	Board after = board;
+	after.update(bm);
+	Piece::Color opponent = Piece::opposite(color);
+	if(after.isCheck(opponent)) {
+		LegalMap replies;
+		*p++ = after.legalMoves(opponent, replies) ? '+' : '#';
+	}
+	*p = '\0';
+	return p - out;
+}
+
+string moveToSAN(const Board & board, const BoardMove & bm)
+{
+	Piece * piece = bm.isValid() ? board.getPiece(bm.origin()) : NULL;
+	if(!piece) {
+		return "--";
+	}
+
+	LegalMap legal;
+	board.legalMoves(piece->color(), legal);
+	char san[SAN_BUFFER_SIZE];
+	return string(san, writeSAN(board, legal, bm, san));
+}
+
+string moveToSAN(const ChessGameState & state, const BoardMove & bm)
+{
+	char san[SAN_BUFFER_SIZE];
+	return string(san, writeSAN(state, bm, san));
+}
+
+int writeSAN(const ChessGameState & state, const BoardMove & bm, char * out)
+{
+	return writeSAN(state.getBoard(), state.getLegalMap(), bm, out);
+}
+
+// Check marks and annotations, which don't tell the move apart
+static bool isSANSuffix(char c)
+{
+	return c == '+' || c == '#' || c == '!' || c == '?' || c == ' ';
+}
+
+BoardMove sanToMove(const Board & board, Piece::Color color,
+	const unsigned long long * legal, string_view str)
+{
+	BoardMove none;
+
+	while(!str.empty() && isSANSuffix(str.back())) {
+		str.remove_suffix(1);
+	}
+
+	if(str == "O-O" || str == "0-0" || str == "O-O-O" || str == "0-0-0") {
+		BoardPosition king = board.getKing(color);
+		BoardPosition dest(king.x() + ((str.size() == 3) ? 2 : -2), king.y());
+		if(!board.getPieces(color, Piece::KING).getBoard() || !dest.isValid() ||
+		   !(legal[king.hash()] & getMask(dest))) {
+			return none;
+		}
+		return BoardMove(king, dest, board.getPiece(king));
+	}
+
+	Piece::Type type = Piece::PAWN;
+	if(!str.empty() && letterPiece(str[0]) != Piece::NOTYPE) {
+		type = letterPiece(str[0]);
+		str.remove_prefix(1);
+	}
+
+	// A promotion may leave out the '=', but then follows the rank
+	Piece::Type promote = Piece::NOTYPE;
+	if(type == Piece::PAWN && str.size() >= 3) {
+		char before = str[str.size()-2];
+		Piece::Type letter = letterPiece(toupper(str.back()));
+		if(letter != Piece::NOTYPE && letter != Piece::KING &&
+		   (before == '=' || (before >= '1' && before <= '8'))) {
+			promote = letter;
+			str.remove_suffix(before == '=' ? 2 : 1);
+		}
+	}
+
+	// What's left is the origin, as much of it as given, and the
+	// destination, maybe with a capture in between
+	char squares[4];
+	int length = 0;
+	for(int i = 0; i < (int)str.size(); i++) {
+		char c = str[i];
+		if(c == 'x' || c == ':' || c == '-') {
+			continue;
+		}
+		if(length == 4) {
+			return none;
+		}
+		squares[length++] = c;
+	}
+	if(length < 2) {
+		return none;
+	}
+	BoardPosition dest(squares[length-2], squares[length-1] - '0');
+	if(!dest.isValid()) {
+		return none;
+	}
+	int fromfile = -1, fromrank = -1;
+	for(int i = 0; i < length - 2; i++) {
+		if(squares[i] >= 'a' && squares[i] <= 'h') {
+			fromfile = squares[i] - 'a';
+		} else if(squares[i] >= '1' && squares[i] <= '8') {
+			fromrank = squares[i] - '1';
+		} else {
+			return none;
+		}
+	}
+
+	// Only a pawn reaching the last rank promotes, to a queen if the
+	// piece isn't given
+	if(type == Piece::PAWN && (dest.rank() == 1 || dest.rank() == 8)) {
+		if(promote == Piece::NOTYPE) {
+			promote = Piece::QUEEN;
+		}
+	} else if(promote != Piece::NOTYPE) {
+		return none;
+	}
+
+	unsigned long long mask = getMask(dest);
+	unsigned long long pieces = board.getPieces(color, type).getBoard();
+	int found = -1;
+	for(int i = 0; pieces; i++, pieces >>= 1) {
+		if(!(pieces & 1) || !(legal[i] & mask)) {
+			continue;
+		}
+		BoardPosition origin(i);
+		if((fromfile >= 0 && origin.file0() != fromfile) ||
+		   (fromrank >= 0 && origin.rank0() != fromrank)) {
+			continue;
+		}
+		if(found >= 0) {
+			return none;
+		}
+		found = i;
+	}
+	if(found < 0) {
+		return none;
+	}
+
+	BoardPosition origin(found);
+	return BoardMove(origin, dest, board.getPiece(origin), promote);
+}
+
+BoardMove sanToMove(const Board & board, Piece::Color color, string_view str)
+{
+	LegalMap legal;
+	board.legalMoves(color, legal);
+	return sanToMove(board, color, legal, str);
+}
+
+BoardMove sanToMove(const ChessGameState & state, string_view str)
+{
+	return sanToMove(state.getBoard(), state.getTurn(), state.getLegalMap(), str);
+}
+
+// Splits text at runs of spaces, returns how many of at most max fields
+// were found
+static int splitFields(string_view text, string_view * fields, int max)
+{
+	int count = 0;
+	size_t i = 0;
+	while(count < max) {
+		while(i < text.size() && isspace((unsigned char)text[i])) {
+			i++;
+		}
+		if(i == text.size()) {
+			break;
+		}
+		size_t start = i;
+		while(i < text.size() && !isspace((unsigned char)text[i])) {
+			i++;
+		}
+		fields[count++] = text.substr(start, i - start);
+	}
+	return count;
+}
+
+static bool parseNumber(string_view text, int & value)
+{
+	if(text.empty() || text.size() > 9) {
+		return false;
+	}
+	int result = 0;
+	for(int i = 0; i < (int)text.size(); i++) {
+		if(text[i] < '0' || text[i] > '9') {
+			return false;
+		}
+		result = result * 10 + (text[i] - '0');
+	}
+	value = result;
+	return true;
+}
+
+// Returns true if a piece of this color and type stands on bp
+static bool hasPiece(const Board & board, Piece::Color color, Piece::Type type,
+	const BoardPosition & bp)
+{
+	Piece * piece = board.getPiece(bp);
+	return piece && piece->color() == color && piece->type() == type;
+}
+
+bool parseFEN(string_view fen, Board & board, FenInfo & info)
+{
+	board.reset();
+	info = FenInfo();
+
+	string_view fields[6];
+	int count = splitFields(fen, fields, 6);
+	if(count < 4) {
+		return false;
+	}
+
+	// Piece placement, from a8 to h1
+	string_view placement = fields[0];
+	int rank = 7, file = 0;
+	int kings[Piece::LAST_COLOR + 1] = { 0, 0 };
+	for(int i = 0; i < (int)placement.size(); i++) {
+		char c = placement[i];
+		if(c == '/') {
+			if(file != Board::BOARDSIZE || rank == 0) {
+				return false;
+			}
+			rank--;
+			file = 0;
+			continue;
+		} else if(c >= '1' && c <= '8') {
+			file += c - '0';
+			if(file > Board::BOARDSIZE) {
+				return false;
+			}
+			continue;
+		}
+
+		Piece::Type type = letterPiece(toupper(c));
+		if(type == Piece::NOTYPE) {
+			if(c != 'p' && c != 'P') {
+				return false;
+			}
+			type = Piece::PAWN;
+		}
+		if(file == Board::BOARDSIZE) {
+			return false;
+		}
+		if(type == Piece::PAWN && (rank == 0 || rank == Board::BOARDSIZE - 1)) {
+			return false;
+		}
+		Piece::Color color = isupper(c) ? Piece::WHITE : Piece::BLACK;
+		if(type == Piece::KING) {
+			kings[color]++;
+		}
+		board.addPiece(color, type, BoardPosition(file, rank));
+		file++;
+	}
+	if(rank != 0 || file != Board::BOARDSIZE ||
+	   kings[Piece::WHITE] != 1 || kings[Piece::BLACK] != 1) {
+		return false;
+	}
+
+	if(fields[1] == "w") {
+		info.turn = Piece::WHITE;
+	} else if(fields[1] == "b") {
+		info.turn = Piece::BLACK;
+	} else {
+		return false;
+	}
+
+	// The side that just moved can't have left its king in check
+	if(board.isCheck(info.turn == Piece::WHITE ? Piece::BLACK : Piece::WHITE)) {
+		return false;
+	}
+
+	bool castling[4] = { false, false, false, false };
+	if(fields[2] != "-") {
+		for(int i = 0; i < (int)fields[2].size(); i++) {
+			const char * flags = "KQkq";
+			const char * flag = strchr(flags, fields[2][i]);
+			if(!flag || !*flag) {
+				return false;
+			}
+			castling[flag - flags] = true;
+		}
+	}
+
+	// Rights whose king or rook has left its square are dropped, castling
+	// without them would move pieces that aren't there
+	for(int i = 0; i < 4; i++) {
+		Piece::Color color = (i < 2) ? Piece::WHITE : Piece::BLACK;
+		int home = (color == Piece::WHITE) ? 0 : Board::BOARDSIZE - 1;
+		int rookfile = (i % 2) ? 0 : Board::BOARDSIZE - 1;
+		if(!hasPiece(board, color, Piece::KING, BoardPosition(4, home)) ||
+		   !hasPiece(board, color, Piece::ROOK, BoardPosition(rookfile, home))) {
+			castling[i] = false;
+		}
+	}
+	board.setCastling(castling[0], castling[1], castling[2], castling[3]);
+
+	if(fields[3] != "-") {
+		if(fields[3].size() != 2) {
+			return false;
+		}
+		BoardPosition bp(fields[3][0], fields[3][1] - '0');
+		if(!bp.isValid() || (bp.rank() != 3 && bp.rank() != 6)) {
+			return false;
+		}
+		board.setEnPassant(bp);
+	}
+
+	// The counters are missing in EPD
+	int halfmoves, fullmoves;
+	if(count == 6 && parseNumber(fields[4], halfmoves) &&
+	   parseNumber(fields[5], fullmoves)) {
+		info.halfmoves = halfmoves;
+		info.fullmoves = (fullmoves > 0) ? fullmoves : 1;
+	}
+	return true;
+}
+
+static char * appendNumber(char * out, int value)
+{
+	char digits[12];
+	int length = 0;
+	do {
+		digits[length++] = '0' + value % 10;
+		value /= 10;
+	} while(value > 0);
+	while(length > 0) {
+		*out++ = digits[--length];
+	}
+	return out;
+}
+
+int writeFEN(const Board & board, const FenInfo & info, char * out)
+{
+	char * p = out;
+
+	for(int rank = Board::BOARDSIZE - 1; rank >= 0; rank--) {
+		int empty = 0;
+		for(int file = 0; file < Board::BOARDSIZE; file++) {
+			Piece * piece = board.getPiece(BoardPosition(file, rank));
+			if(!piece) {
+				empty++;
+				continue;
+			}
+			if(empty) {
+				*p++ = '0' + empty;
+				empty = 0;
+			}
+			char letter = (piece->type() == Piece::PAWN) ? 'P' : pieceLetter(piece->type());
+			*p++ = (piece->color() == Piece::WHITE) ? letter : tolower(letter);
+		}
+		if(empty) {
+			*p++ = '0' + empty;
+		}
+		if(rank) {
+			*p++ = '/';
+		}
+	}
+
+	*p++ = ' ';
+	*p++ = (info.turn == Piece::WHITE) ? 'w' : 'b';
+
+	*p++ = ' ';
+	char * castling = p;
+	if(board.canCastle(Piece::WHITE, true)) {
+		*p++ = 'K';
+	}
+	if(board.canCastle(Piece::WHITE, false)) {
+		*p++ = 'Q';
+	}
+	if(board.canCastle(Piece::BLACK, true)) {
+		*p++ = 'k';
+	}
+	if(board.canCastle(Piece::BLACK, false)) {
+		*p++ = 'q';
+	}
+	if(p == castling) {
+		*p++ = '-';
+	}
+
+	// The skipped square counts only if a pawn can take on it
+	*p++ = ' ';
+	char * enpassant = p;
+	bool white = (info.turn == Piece::WHITE);
+	int skipped = white ? 5 : 2;
+	unsigned long long pawns = board.getPieces(info.turn, Piece::PAWN).getBoard();
+	for(int file = 0; file < Board::BOARDSIZE && p == enpassant; file++) {
+		BoardPosition bp(file, skipped);
+		if(!board.isEnPassantSet(bp)) {
+			continue;
+		}
+		int from = white ? skipped - 1 : skipped + 1;
+		if((file > 0 && (pawns & getMask(BoardPosition(file - 1, from)))) ||
+		   (file < Board::BOARDSIZE - 1 && (pawns & getMask(BoardPosition(file + 1, from))))) {
+			p = appendSquare(p, bp);
+		}
+	}
+	if(p == enpassant) {
+		*p++ = '-';
+	}
+
+	*p++ = ' ';
+	p = appendNumber(p, info.halfmoves);
+	*p++ = ' ';
+	p = appendNumber(p, info.fullmoves);
+	*p = '\0';
+	return p - out;
+}
+
+// End of file notation.cpp
@@ -0,0 +1,132 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : notation.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include "board.h"
+#include "boardmove.h"
+#include "chessgamestate.h"
+
+#include <string>
+#include <string_view>
+
+/** Room writeFEN needs, the longest FEN and the terminating null. */
+const int FEN_BUFFER_SIZE = 96;
+
+/** Room writeSAN needs, e.g. "Qa1xh8#" and the terminating null. */
+const int SAN_BUFFER_SIZE = 8;
+
+/** The fields of a FEN that aren't kept by the Board. */
+struct FenInfo {
+	FenInfo() :
+		turn(Piece::WHITE),
+		halfmoves(0),
+		fullmoves(1) {}
+
+	/** The side to move */
+	Piece::Color turn;
+	/** Plies since the last capture or pawn move */
+	int halfmoves;
+	/** Number of the move, starting at 1 and counted after black moves */
+	int fullmoves;
+};
+
+/**
+ * Sets up board from a position in Forsyth-Edwards Notation, without
+ * allocating. The move counters may be left out, as they are in EPD,
+ * anything after them is ignored. Castling rights whose king or rook
+ * isn't on its square are dropped. Returns false if the FEN can't be
+ * read or the position can't come up in a game: pawns on the first or
+ * last rank, or the side not to move in check. The board is then left
+ * in an undefined state.
+ * @param fen - e.g. "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1"
+ * @param board - The board to set up.
+ * @param info - Receives the side to move and the counters.
+ */
+bool parseFEN(std::string_view fen, Board & board, FenInfo & info);
+
+/**
+ * Writes the position in Forsyth-Edwards Notation, without allocating.
+ * The en passant square is only written when a pawn stands ready to
+ * capture there. Returns the length written, not counting the null.
+ * @param out - At least FEN_BUFFER_SIZE chars.
+ */
+int writeFEN(const Board & board, const FenInfo & info, char * out);
+
+/**
+ * Returns the move in the coordinate notation used by the UCI and
+ * xboard protocols, e.g. "e2e4" or "e7e8q".
+ * @param bm - The move to convert.
+ */
+std::string moveToCoordinate(const BoardMove & bm);
+
+/**
+ * Builds a BoardMove from coordinate notation. The returned move is
+ * invalid if the string cannot be parsed or there is no piece on the
+ * origin square. Legality is not checked.
+ * @param board - The board the move is played on.
+ * @param str - The move, e.g. "g1f3" or "a2a1n".
+ */
+BoardMove coordinateToMove(const Board & board, const std::string & str);
+
+/**
+ * Returns the move in standard algebraic notation as used in PGN files,
+ * e.g. "Nbd7", "exd6", "O-O" or "e8=Q#". The move must be legal.
+ * @param board - The board before the move is played.
+ * @param bm - The move to convert.
+ */
+std::string moveToSAN(const Board & board, const BoardMove & bm);
+
+/**
+ * Same as above for the side to move in state, faster as the legal moves
+ * are known already.
+ */
+std::string moveToSAN(const ChessGameState & state, const BoardMove & bm);
+
+/**
+ * Writes the move in standard algebraic notation, the other pieces that
+ * could go to the same square are found in the legal moves of state.
+ * Only a move giving check needs to look further, to tell check from
+ * mate. Returns the length written, not counting the null.
+ * @param state - The state before the move is played, the move must be
+ * legal in it.
+ * @param bm - The move to write.
+ * @param out - At least SAN_BUFFER_SIZE chars.
+ */
+int writeSAN(const ChessGameState & state, const BoardMove & bm, char * out);
+
+/**
+ * Finds the legal move written in standard algebraic notation. Check
+ * marks and annotations are ignored, and so is a missing '=' or an
+ * origin given when it isn't needed. The returned move is invalid if no
+ * legal move, or more than one, matches.
+ * @param board - The board before the move is played.
+ * @param color - The side making the move.
+ * @param str - The move, e.g. "Nbd7", "exd6", "O-O" or "e8=Q+".
+ */
+BoardMove sanToMove(const Board & board, Piece::Color color, std::string_view str);
+
+/**
+ * Same as above for the side to move in state, without allocating.
+ * @param state - The state before the move is played.
+ * @param str - The move.
+ */
+BoardMove sanToMove(const ChessGameState & state, std::string_view str);
+
+/**
+ * Same as above with the legal moves already known, for replaying many
+ * moves on a bare Board.
+ * @param legal - The legal moves of color, as filled in by Board::legalMoves.
+ */
+BoardMove sanToMove(const Board & board, Piece::Color color,
+	const unsigned long long * legal, std::string_view str);
+
+#endif // NOTATION_H
+
+// End of file notation.h
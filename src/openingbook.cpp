@@ -0,0 +1,169 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : openingbook.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "openingbook.h"
+#include "chessgamestate.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <random>
+
+using namespace std;
+
+// Promotion pieces by their number in a move, 0 for none
+static const Piece::Type PROMOTIONS[5] = {
+	Piece::NOTYPE, Piece::KNIGHT, Piece::BISHOP, Piece::ROOK, Piece::QUEEN
+};
+
+// Reads a big endian number of bytes bytes
+static unsigned long long readNumber(const unsigned char * data, int bytes)
+{
+	unsigned long long value = 0;
+	for(int i = 0; i < bytes; i++) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+shared_ptr<const OpeningBook> OpeningBook::load(const string & filename)
+{
+	static mutex s_mutex;
+	static map<string, weak_ptr<const OpeningBook> > s_books;
+
+	lock_guard<mutex> lock(s_mutex);
+	shared_ptr<const OpeningBook> book = s_books[filename].lock();
+	if(!book) {
+		shared_ptr<OpeningBook> opened(new OpeningBook);
+		if(!opened->open(filename)) {
+			return shared_ptr<const OpeningBook>();
+		}
+		book = opened;
+		s_books[filename] = book;
+	}
+	return book;
+}
+
+bool OpeningBook::open(const string & filename)
+{
+	close();
+	if(!m_file.open(filename) || m_file.getSize() % ENTRY_SIZE) {
+		close();
+		return false;
+	}
+	m_entries = (const unsigned char *)m_file.getData();
+	m_count = m_file.getSize() / ENTRY_SIZE;
+	return true;
+}
+
+void OpeningBook::close()
+{
+	m_file.close();
+	m_entries = 0;
+	m_count = 0;
+}
+
+int OpeningBook::findMoves(const ChessGameState & state, vector<BookMove> & moves) const
+{
+	moves.clear();
+	unsigned long long key = state.getKey();
+
+	// The first entry of the key
+	long long low = 0, high = m_count;
+	while(low < high) {
+		long long middle = low + (high - low) / 2;
+		if(readNumber(m_entries + middle * ENTRY_SIZE, 8) < key) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	int total = 0;
+	for(long long i = low; i < m_count; i++) {
+		const unsigned char * entry = m_entries + i * ENTRY_SIZE;
+		if(readNumber(entry, 8) != key) {
+			break;
+		}
+		BookMove move;
+		move.move = decodeMove(state.getBoard(), (unsigned short)readNumber(entry + 8, 2));
+		move.weight = (int)readNumber(entry + 10, 2);
+		if(move.weight > 0 && state.isMoveLegal(move.move) && !move.move.needPromotion()) {
+			moves.push_back(move);
+			total += move.weight;
+		}
+	}
+
+	stable_sort(moves.begin(), moves.end(),
+		[](const BookMove & a, const BookMove & b) { return a.weight > b.weight; });
+	return total;
+}
+
+bool OpeningBook::pickMove(const ChessGameState & state, BoardMove & move) const
+{
+	// Every thread draws from its own generator, games run at once
+	static thread_local mt19937 t_random(random_device{}());
+
+	vector<BookMove> moves;
+	int total = findMoves(state, moves);
+	if(total == 0) {
+		return false;
+	}
+
+	int pick = uniform_int_distribution<int>(0, total - 1)(t_random);
+	for(int i = 0; i < (int)moves.size(); i++) {
+		pick -= moves[i].weight;
+		if(pick < 0) {
+			move = moves[i].move;
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned short OpeningBook::encodeMove(const BoardMove & bm)
+{
+	BoardPosition dest = bm.dest();
+	const Piece * piece = bm.getPiece();
+	if(piece && piece->type() == Piece::KING && bm.signedFileDiff() == 2) {
+		dest = BoardPosition(7, dest.rank0());
+	} else if(piece && piece->type() == Piece::KING && bm.signedFileDiff() == -2) {
+		dest = BoardPosition(0, dest.rank0());
+	}
+
+	int promotion = 0;
+	for(int i = 1; i < 5; i++) {
+		if(bm.getPromotion() == PROMOTIONS[i]) {
+			promotion = i;
+		}
+	}
+	return (unsigned short)(dest.hash() | (bm.origin().hash() << 6) | (promotion << 12));
+}
+
+BoardMove OpeningBook::decodeMove(const Board & board, unsigned short move)
+{
+	BoardPosition dest(move & 63);
+	BoardPosition origin((move >> 6) & 63);
+	int promotion = (move >> 12) & 7;
+	Piece * piece = board.getPiece(origin);
+	if(!piece) {
+		return BoardMove();
+	}
+
+	// The king taking its own rook is castling
+	Piece * target = board.getPiece(dest);
+	if(piece->type() == Piece::KING && target && target->type() == Piece::ROOK &&
+			target->color() == piece->color()) {
+		int file = (dest.file0() > origin.file0()) ? origin.file0() + 2 : origin.file0() - 2;
+		dest = BoardPosition(file, origin.rank0());
+	}
+
+	return BoardMove(origin, dest, piece, promotion < 5 ? PROMOTIONS[promotion] : Piece::NOTYPE);
+}
+
+// End of file openingbook.cpp
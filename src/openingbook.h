@@ -0,0 +1,103 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : openingbook.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef OPENINGBOOK_H
+#define OPENINGBOOK_H
+
+#include "board.h"
+#include "boardmove.h"
+#include "mappedfile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class ChessGameState;
+
+/**
+ * A move of the book and how often it should be played, relative to the
+ * other moves of its position.
+ */
+struct BookMove {
+	BoardMove move;
+	int weight;
+};
+
+/**
+ * An opening book in the Polyglot .bin format, read through a MappedFile.
+ * The file is a list of 16 byte entries sorted by position key, each with
+ * a move, its weight and learning data that is ignored. Numbers are big
+ * endian.
+ *
+ * Positions are found by Board::getKey, which gives Polyglot's keys, so
+ * books made by Polyglot and other programs work as well as those of
+ * BookBuilder.
+ *
+ * Many threads may look up one OpeningBook at once.
+ */
+class OpeningBook {
+ public:
+	OpeningBook() :
+		m_entries(0),
+		m_count(0) {}
+
+	/** Size of an entry in the file. */
+	static const int ENTRY_SIZE = 16;
+
+	/**
+	 * Returns the book in filename, opened once and shared by everyone
+	 * asking for it while it is in use. Null if it can't be read.
+	 */
+	static std::shared_ptr<const OpeningBook> load(const std::string & filename);
+
+	/** Opens a book, returns false if it can't be read. */
+	bool open(const std::string & filename);
+
+	void close();
+
+	bool isOpen() const
+		{ return m_file.isOpen(); }
+
+	/** Returns the number of moves in the book. */
+	long long getEntryCount() const
+		{ return m_count; }
+
+	/**
+	 * Fills moves with the book moves of the position of state, most
+	 * weight first. Entries that aren't legal there are left out.
+	 * Returns the total weight.
+	 */
+	int findMoves(const ChessGameState & state, std::vector<BookMove> & moves) const;
+
+	/**
+	 * Picks a book move for state at random, each move as likely as its
+	 * weight. Returns false if the position isn't in the book.
+	 */
+	bool pickMove(const ChessGameState & state, BoardMove & move) const;
+
+	/**
+	 * Returns a move as a book stores it: to and from squares, then the
+	 * promotion. Castling is written as the king taking its own rook.
+	 */
+	static unsigned short encodeMove(const BoardMove & bm);
+
+	/** Turns an encoded move back into a move on board. */
+	static BoardMove decodeMove(const Board & board, unsigned short move);
+
+ private:
+	OpeningBook(const OpeningBook &);
+	OpeningBook & operator=(const OpeningBook &);
+
+	MappedFile m_file;
+	const unsigned char * m_entries;
+	long long m_count;
+};
+
+#endif // OPENINGBOOK_H
+
+// End of file openingbook.h
@@ -35,6 +35,16 @@ Options::Options()
 	resolution = r800X600;
 	brutalplayer1ply = DEFAULT_PLY_DEPTH;
 	brutalplayer2ply = DEFAULT_PLY_DEPTH;
+	uciengine = "stockfish";
+	ucimovetime = 1000;
+	uciponder = false;
+	enginepool = 1;
+	jobthreads = 0;
+	timecontrol = "";
+	bookfile = "";
+	tablebases = "";
+	matecheck = 0;
+	analysiscache = "";
 
 	// Initialize the enum maps
 	m_boardTypeString[GRANITE] = "Granite";
@@ -47,8 +57,10 @@ Options::Options()
 	m_playerTypeString[BRUTAL] = "Brutal";
 	m_playerTypeString[FAILE] = "Faile";
 	m_playerTypeString[HUMAN] = "Human";
+	m_playerTypeString[MCTS] = "Mcts";
 	m_playerTypeString[RANDOM] = "Random";
 	m_playerTypeString[TEST] = "Test";
+	m_playerTypeString[UCI] = "Uci";
 	m_playerTypeString[XBOARD] = "Xboard";
 
 	m_difficultyString[EASY] = "Easy";
@@ -14,7 +14,7 @@
 
 enum BoardType {GRANITE, WOOD};
 enum PiecesType {BASIC, DEBUG, QUAKE};
-enum PlayerType {BRUTAL, FAILE, HUMAN, RANDOM, TEST, XBOARD};
+enum PlayerType {BRUTAL, FAILE, HUMAN, MCTS, RANDOM, TEST, UCI, XBOARD};
 enum Difficulty {EASY=2, MEDIUM=3, HARD=4};
 
 #define DEFAULT_PLY_DEPTH MEDIUM
@@ -36,6 +36,37 @@ class Options {
 	// Won't need eventually
 	int brutalplayer1ply, brutalplayer2ply;
 
+	// External UCI engine command line, and how long it may think per
+	// move (in milliseconds) when no clock is running
+	std::string uciengine;
+	int ucimovetime;
+	bool uciponder;
+
+	// How many external engines of each kind are started ahead of time
+	// and kept idle for the next game
+	int enginepool;
+
+	// Worker threads for searching and loading, 0 for one per core
+	int jobthreads;
+
+	// Time control of both players, as read by TimeControl::parse, empty
+	// for no clock
+	std::string timecontrol;
+
+	// Opening book the brutal player plays from, empty for none
+	std::string bookfile;
+
+	// Directory of the endgame tablebases the brutal player looks up
+	std::string tablebases;
+
+	// Nodes the brutal player spends looking for a forced mate before
+	// each search, 0 for none
+	int matecheck;
+
+	// File the brutal player keeps the results of its searches in, empty
+	// for none
+	std::string analysiscache;
+
     std::string getBoardString() 
 		{ return m_boardTypeString[board]; }
 	
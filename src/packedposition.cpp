@@ -0,0 +1,371 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : packedposition.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "packedposition.h"
+#include "notation.h"
+
+#include <cstring>
+
+using namespace std;
+
+static const char FILE_MAGIC[8] = { 'C', 'P', 'P', 'A', 'C', 'K', 'E', 'D' };
+static const char CHUNK_MAGIC[4] = { 'P', 'C', 'H', 'K' };
+static const uint32_t VERSION = 1;
+
+// Flags of the file header
+static const uint32_t COMPRESSED = 1;
+
+static const int POSITION_SIZE = sizeof(PackedPosition);
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t chunkpositions;
+	uint32_t reserved;
+};
+
+struct PackedChunk {
+	char magic[4];
+	uint32_t positions;
+	// Bytes of data after this header, a multiple of 8
+	uint32_t size;
+	uint32_t reserved;
+};
+
+// The fixed size is what the format is about
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition isn't 32 bytes");
+
+// Bits of the move field
+static const int MOVE_DEST_SHIFT = 6;
+static const int MOVE_PROMOTION_SHIFT = 12;
+static const int SQUARE_MASK = 63;
+
+// Everything in a file is aligned to 8 bytes
+static size_t align(size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
+bool PackedPosition::pack(const Board & board, Piece::Color turn, int halfmoves,
+	int fullmoves, int score, const BoardMove & bm, int res)
+{
+	memset(this, 0, sizeof(*this));
+	int count = 0;
+	for(int i = 0; i < 64; i++) {
+		BoardPosition bp(i);
+		const Piece * p = board.getPiece(bp);
+		if(!p) {
+			continue;
+		}
+		if(count == 32) {
+			return false;
+		}
+
+		int kind = p->type();
+		if(kind == Piece::ROOK && board.canCastle(p->color(), bp.file0() == 7) &&
+				(bp.file0() == 0 || bp.file0() == 7) &&
+				bp.rank0() == (p->color() == Piece::WHITE ? 0 : 7)) {
+			kind = CASTLING_ROOK;
+		} else if(kind == Piece::PAWN) {
+			// The skipped square is behind a pawn that moved two squares
+			int rank = bp.rank0(), skipped = (p->color() == Piece::WHITE) ? 2 : 5;
+			if(rank == ((p->color() == Piece::WHITE) ? 3 : 4) &&
+					board.isEnPassantSet(BoardPosition(bp.file0(), skipped))) {
+				kind = ENPASSANT_PAWN;
+			}
+		}
+		if(p->color() == Piece::BLACK) {
+			kind += 8;
+		}
+		pieces[count / 2] |= (uint8_t)(kind << (count % 2 * 4));
+		occupied |= 1ULL << i;
+		count++;
+	}
+
+	this->score = (int16_t)max(-32000, min(32000, score));
+	if(bm.isValid()) {
+		int promotion = (bm.getPromotion() == Piece::NOTYPE) ? 0 : bm.getPromotion();
+		move = (uint16_t)(bm.origin().hash() | bm.dest().hash() << MOVE_DEST_SHIFT |
+			promotion << MOVE_PROMOTION_SHIFT);
+	}
+	flags = (uint8_t)(min(halfmoves, 127) | (turn == Piece::BLACK ? 0x80 : 0));
+	result = (uint8_t)res;
+	this->fullmoves = (uint16_t)min(fullmoves, 65535);
+	return true;
+}
+
+void PackedPosition::unpack(Board & board, FenInfo & info) const
+{
+	bool castling[4] = { false, false, false, false };
+	int count = 0;
+	for(uint64_t bits = occupied; bits; bits &= bits - 1, count++) {
+		BoardPosition bp(__builtin_ctzll(bits));
+		int kind = (pieces[count / 2] >> (count % 2 * 4)) & 15;
+		Piece::Color color = (kind & 8) ? Piece::BLACK : Piece::WHITE;
+		kind &= 7;
+		if(kind == CASTLING_ROOK) {
+			castling[(color == Piece::WHITE ? 0 : 2) + (bp.file0() == 0 ? 1 : 0)] = true;
+			kind = Piece::ROOK;
+		} else if(kind == ENPASSANT_PAWN) {
+			board.setEnPassant(BoardPosition(bp.file0(), (color == Piece::WHITE) ? 2 : 5));
+			kind = Piece::PAWN;
+		}
+		board.addPiece(color, (Piece::Type)kind, bp);
+	}
+	board.setCastling(castling[0], castling[1], castling[2], castling[3]);
+
+	info.turn = getTurn();
+	info.halfmoves = flags & 0x7f;
+	info.fullmoves = fullmoves;
+}
+
+BoardMove PackedPosition::getMove(const Board & board) const
+{
+	if(!move) {
+		return BoardMove();
+	}
+	BoardPosition origin(move & SQUARE_MASK);
+	BoardPosition dest((move >> MOVE_DEST_SHIFT) & SQUARE_MASK);
+	int promotion = move >> MOVE_PROMOTION_SHIFT;
+	return BoardMove(origin, dest, board.getPiece(origin),
+		promotion ? (Piece::Type)promotion : Piece::NOTYPE);
+}
+
+// Appends the values of a block, runs of three or more as a count and the
+// value, the rest as a count and the values
+static void compressBlock(const unsigned char * values, int size, vector<unsigned char> & out)
+{
+	int i = 0;
+	while(i < size) {
+		int run = 1;
+		while(i + run < size && run < 130 && values[i + run] == values[i]) {
+			run++;
+		}
+		if(run >= 3) {
+			out.push_back((unsigned char)(128 + run - 3));
+			out.push_back(values[i]);
+			i += run;
+			continue;
+		}
+
+		// Values up to the next run
+		int literal = 0;
+		while(i + literal < size && literal < 128) {
+			if(i + literal + 2 < size && values[i + literal] == values[i + literal + 1] &&
+					values[i + literal] == values[i + literal + 2]) {
+				break;
+			}
+			literal++;
+		}
+		out.push_back((unsigned char)(literal - 1));
+		out.insert(out.end(), values + i, values + i + literal);
+		i += literal;
+	}
+}
+
+// Undoes compressBlock, false if the data doesn't make size values
+static bool expandBlock(const unsigned char * data, const unsigned char * end,
+	unsigned char * values, int size)
+{
+	int i = 0;
+	while(data < end && i < size) {
+		int control = *data++;
+		if(control >= 128) {
+			int run = control - 128 + 3;
+			if(data == end || i + run > size) {
+				return false;
+			}
+			memset(values + i, *data++, run);
+			i += run;
+		} else {
+			int literal = control + 1;
+			if(end - data < literal || i + literal > size) {
+				return false;
+			}
+			memcpy(values + i, data, literal);
+			data += literal;
+			i += literal;
+		}
+	}
+	return i == size;
+}
+
+// Positions of a chunk as differences to the one before, byte 0 of every
+// position first, then byte 1 and so on
+static void deltaEncode(const vector<PackedPosition> & positions, vector<unsigned char> & planes)
+{
+	int count = (int)positions.size();
+	planes.resize((size_t)count * POSITION_SIZE);
+	const unsigned char * prev = 0;
+	for(int i = 0; i < count; i++) {
+		const unsigned char * cur = (const unsigned char *)&positions[i];
+		for(int b = 0; b < POSITION_SIZE; b++) {
+			planes[(size_t)b * count + i] = prev ? cur[b] ^ prev[b] : cur[b];
+		}
+		prev = cur;
+	}
+}
+
+static void deltaDecode(const vector<unsigned char> & planes, vector<PackedPosition> & positions)
+{
+	int count = (int)positions.size();
+	unsigned char * prev = 0;
+	for(int i = 0; i < count; i++) {
+		unsigned char * cur = (unsigned char *)&positions[i];
+		for(int b = 0; b < POSITION_SIZE; b++) {
+			unsigned char value = planes[(size_t)b * count + i];
+			cur[b] = prev ? value ^ prev[b] : value;
+		}
+		prev = cur;
+	}
+}
+
+bool PackedPositionFile::open(const string & filename)
+{
+	close();
+	if(!m_file.open(filename)) {
+		return false;
+	}
+
+	const char * data = m_file.getData();
+	size_t size = m_file.getSize();
+	const FileHeader * header = (const FileHeader *)data;
+	if(size < sizeof(FileHeader) || memcmp(header->magic, FILE_MAGIC, 8) ||
+			header->version != VERSION || header->chunkpositions != CHUNK_POSITIONS) {
+		close();
+		return false;
+	}
+	m_compressed = (header->flags & COMPRESSED) != 0;
+
+	size_t pos = align(sizeof(FileHeader));
+	while(pos < size) {
+		const PackedChunk * chunk = (const PackedChunk *)(data + pos);
+		bool valid = size - pos >= sizeof(PackedChunk) &&
+			!memcmp(chunk->magic, CHUNK_MAGIC, 4) &&
+			chunk->positions > 0 && chunk->positions <= CHUNK_POSITIONS &&
+			chunk->size % 8 == 0 && chunk->size <= size - pos - sizeof(PackedChunk);
+		valid = valid && (m_compressed || chunk->size == chunk->positions * POSITION_SIZE);
+		if(!valid) {
+			close();
+			return false;
+		}
+
+		m_chunks.push_back(chunk);
+		m_positions += chunk->positions;
+		pos += sizeof(PackedChunk) + chunk->size;
+	}
+	return true;
+}
+
+void PackedPositionFile::close()
+{
+	m_file.close();
+	m_chunks.clear();
+	m_positions = 0;
+	m_compressed = false;
+}
+
+bool PackedPositionFile::readChunk(int n, vector<PackedPosition> & positions) const
+{
+	const PackedChunk * chunk = m_chunks[n];
+	const unsigned char * data = (const unsigned char *)(chunk + 1);
+	positions.resize(chunk->positions);
+	if(!m_compressed) {
+		memcpy(positions.data(), data, chunk->size);
+		return true;
+	}
+
+	// The padding isn't part of the runs, decoding stops once all are there
+	vector<unsigned char> planes((size_t)chunk->positions * POSITION_SIZE);
+	if(!expandBlock(data, data + chunk->size, planes.data(), (int)planes.size())) {
+		return false;
+	}
+	deltaDecode(planes, positions);
+	return true;
+}
+
+PackedPositionWriter::~PackedPositionWriter()
+{
+	close();
+}
+
+bool PackedPositionWriter::open(const string & filename, bool compress)
+{
+	close();
+	m_error = false;
+	m_positions = 0;
+	m_compressed = compress;
+
+	m_file = fopen(filename.c_str(), "wb");
+	if(!m_file) {
+		return false;
+	}
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+	header.version = VERSION;
+	header.flags = compress ? COMPRESSED : 0;
+	header.chunkpositions = PackedPositionFile::CHUNK_POSITIONS;
+	fwrite(&header, sizeof(header), 1, m_file);
+	m_bytes = sizeof(header);
+	return !ferror(m_file);
+}
+
+bool PackedPositionWriter::close()
+{
+	if(!m_file) {
+		return !m_error;
+	}
+	if(!m_chunk.empty()) {
+		writeChunk();
+	}
+	if(fclose(m_file)) {
+		m_error = true;
+	}
+	m_file = 0;
+	return !m_error;
+}
+
+void PackedPositionWriter::add(const PackedPosition & position)
+{
+	m_chunk.push_back(position);
+	m_positions++;
+	if((int)m_chunk.size() == PackedPositionFile::CHUNK_POSITIONS) {
+		writeChunk();
+	}
+}
+
+bool PackedPositionWriter::writeChunk()
+{
+	vector<unsigned char> data;
+	if(m_compressed) {
+		vector<unsigned char> planes;
+		deltaEncode(m_chunk, planes);
+		compressBlock(planes.data(), (int)planes.size(), data);
+	} else {
+		const unsigned char * raw = (const unsigned char *)m_chunk.data();
+		data.assign(raw, raw + m_chunk.size() * POSITION_SIZE);
+	}
+	data.resize(align(data.size()));
+
+	PackedChunk header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHUNK_MAGIC, sizeof(header.magic));
+	header.positions = (uint32_t)m_chunk.size();
+	header.size = (uint32_t)data.size();
+	if(fwrite(&header, sizeof(header), 1, m_file) != 1 ||
+			fwrite(data.data(), 1, data.size(), m_file) != data.size()) {
+		m_error = true;
+	}
+	m_bytes += sizeof(header) + data.size();
+	m_chunk.clear();
+	return !m_error;
+}
+
+// End of file packedposition.cpp
@@ -0,0 +1,177 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : packedposition.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef PACKEDPOSITION_H
+#define PACKEDPOSITION_H
+
+#include "board.h"
+#include "boardmove.h"
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct FenInfo;
+
+/**
+ * A position labelled for training in 32 bytes: the board, the search
+ * score, the move played and the result of the game.
+ *
+ * The board is the bitboard of occupied squares, a1 first, and a nibble
+ * for each of those pieces in the same order: the Piece::Type, 8 more
+ * for black. Two more kinds stand for the castling rights and the en
+ * passant square, a rook that may still castle and a pawn that has just
+ * moved two squares.
+ */
+struct PackedPosition {
+	/** Nibble of a rook that may still castle. */
+	static const int CASTLING_ROOK = 6;
+	/** Nibble of a pawn that may be taken en passant. */
+	static const int ENPASSANT_PAWN = 7;
+
+	/**
+	 * Packs a position, false if it has more than 32 pieces.
+	 * @param score - In centipawns from white's point of view.
+	 * @param move - The move played, may be invalid.
+	 * @param result - Half points white scored, 0 to 2.
+	 */
+	bool pack(const Board & board, Piece::Color turn, int halfmoves, int fullmoves,
+		int score, const BoardMove & move, int result);
+
+	/** Sets up the position on an empty board. */
+	void unpack(Board & board, FenInfo & info) const;
+
+	/** Returns the move played, its piece taken from board. */
+	BoardMove getMove(const Board & board) const;
+
+	Piece::Color getTurn() const
+		{ return (flags & 0x80) ? Piece::BLACK : Piece::WHITE; }
+
+	uint64_t occupied;
+	uint8_t pieces[16];
+	/** Centipawns from white's point of view */
+	int16_t score;
+	/** Origin, destination and promotion type, 0 for none */
+	uint16_t move;
+	/** The halfmove clock, the top bit set if black is to move */
+	uint8_t flags;
+	/** Half points white scored, 0 to 2 */
+	uint8_t result;
+	uint16_t fullmoves;
+};
+
+/**
+ * A file of PackedPositions, read through a MappedFile.
+ *
+ * After a short header the positions come in chunks of up to
+ * CHUNK_POSITIONS. Chunks of a compressed file store every position as
+ * the difference to the one before, byte by byte across the chunk, with
+ * run lengths: positions of one game differ in a few bytes, so this
+ * takes about 20 bytes a position. Many threads may read one file at
+ * once.
+ */
+class PackedPositionFile {
+ public:
+	PackedPositionFile() :
+		m_positions(0),
+		m_compressed(false) {}
+
+	/** Positions in a chunk, at most. */
+	static const int CHUNK_POSITIONS = 4096;
+
+	/** Opens a file, returns false if it can't be read. */
+	bool open(const std::string & filename);
+
+	void close();
+
+	bool isOpen() const
+		{ return m_file.isOpen(); }
+
+	long long getPositionCount() const
+		{ return m_positions; }
+
+	int getChunkCount() const
+		{ return (int)m_chunks.size(); }
+
+	bool isCompressed() const
+		{ return m_compressed; }
+
+	/** Returns the size of the file in bytes. */
+	size_t getSize() const
+		{ return m_file.getSize(); }
+
+	/**
+	 * Reads the positions of chunk n. Returns false if they can't be, the
+	 * file is damaged then.
+	 */
+	bool readChunk(int n, std::vector<PackedPosition> & positions) const;
+
+ private:
+	PackedPositionFile(const PackedPositionFile &);
+	PackedPositionFile & operator=(const PackedPositionFile &);
+
+	MappedFile m_file;
+	std::vector<const struct PackedChunk *> m_chunks;
+	long long m_positions;
+	bool m_compressed;
+};
+
+/**
+ * Writes PackedPositions to a new file, a chunk at a time.
+ *
+ * A writer belongs to one thread.
+ */
+class PackedPositionWriter {
+ public:
+	PackedPositionWriter() :
+		m_file(0),
+		m_positions(0),
+		m_bytes(0),
+		m_compressed(false),
+		m_error(false) {}
+
+	/** Writes what is left and closes the file. */
+	~PackedPositionWriter();
+
+	/** Creates a file, returns false if it can't. */
+	bool open(const std::string & filename, bool compress);
+
+	/** Writes the last chunk and closes the file. Returns false on errors. */
+	bool close();
+
+	/** Adds a position, it is written once its chunk is full. */
+	void add(const PackedPosition & position);
+
+	/** Returns the positions added so far. */
+	long long getPositionCount() const
+		{ return m_positions; }
+
+	/** Returns the bytes written so far. */
+	long long getSize() const
+		{ return m_bytes; }
+
+ private:
+	PackedPositionWriter(const PackedPositionWriter &);
+	PackedPositionWriter & operator=(const PackedPositionWriter &);
+
+	// Writes out the positions gathered so far as a chunk
+	bool writeChunk();
+
+	FILE * m_file;
+	long long m_positions;
+	long long m_bytes;
+	bool m_compressed;
+	bool m_error;
+	std::vector<PackedPosition> m_chunk;
+};
+
+#endif // PACKEDPOSITION_H
+
+// End of file packedposition.h
@@ -0,0 +1,561 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : pgn.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "pgn.h"
+#include "chessgame.h"
+#include "jobsystem.h"
+#include "notation.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+// PGN export format keeps lines below 80 characters
+static const int LINE_LENGTH = 79;
+
+void PgnGame::addMoves(const ChessGame & game)
+{
+	ChessGameState state = *game.getStartState();
+	ChessGameState initial;
+	string fen = state.getFEN();
+	if(fen != initial.getFEN()) {
+		setFEN(fen);
+	}
+
+	const vector<BoardMove> & history = game.getMoves();
+	for(int i = 0; i < game.getPly(); i++) {
+		moves.push_back(moveToSAN(state, history[i]));
+		state.update(history[i]);
+	}
+}
+
+void PgnGame::setFEN(const string & fen)
+{
+	addTag("SetUp", "1");
+	addTag("FEN", fen);
+
+	// The side to move is the second field and the move number the sixth
+	stringstream fields(fen);
+	string placement, turn, castling, enpassant, halfmoves, fullmoves;
+	fields >> placement >> turn >> castling >> enpassant >> halfmoves >> fullmoves;
+	int fullmove = atoi(fullmoves.c_str());
+	firstply = (fullmove > 0 ? fullmove - 1 : 0) * 2 + (turn == "b" ? 1 : 0);
+}
+
+void PgnGameView::clear()
+{
+	tags.clear();
+	moves.clear();
+	comments.clear();
+	nags.clear();
+	result = string_view();
+	variations = 0;
+	text = string_view();
+}
+
+string_view PgnGameView::getTag(string_view name) const
+{
+	for(int i = 0; i < (int)tags.size(); i++) {
+		if(tags[i].first == name) {
+			return tags[i].second;
+		}
+	}
+	return string_view();
+}
+
+// What a character is to the tokenizer, looked up rather than compared
+enum {
+	CHAR_SPACE = 1,
+	// Ends a move or move number token
+	CHAR_DELIMITER = 2
+};
+
+struct CharClasses {
+	CharClasses()
+	{
+		for(int i = 0; i < 256; i++) {
+			classes[i] = 0;
+		}
+		const char * spaces = " \t\n\r\f\v";
+		for(const char * c = spaces; *c; c++) {
+			classes[(unsigned char)*c] = CHAR_SPACE | CHAR_DELIMITER;
+		}
+		const char * delimiters = "{}()[];$";
+		for(const char * c = delimiters; *c; c++) {
+			classes[(unsigned char)*c] = CHAR_DELIMITER;
+		}
+	}
+
+	unsigned char classes[256];
+};
+
+static const CharClasses s_chars;
+
+static inline bool isSpace(char c)
+{
+	return s_chars.classes[(unsigned char)c] & CHAR_SPACE;
+}
+
+static inline bool isDelimiter(char c)
+{
+	return s_chars.classes[(unsigned char)c] & CHAR_DELIMITER;
+}
+
+// Returns the glyph of a move suffix, 0 if it isn't one
+static int suffixGlyph(string_view suffix)
+{
+	if(suffix == "!") return 1;
+	if(suffix == "?") return 2;
+	if(suffix == "!!") return 3;
+	if(suffix == "??") return 4;
+	if(suffix == "!?") return 5;
+	if(suffix == "?!") return 6;
+	return 0;
+}
+
+void PgnReader::skipSpace()
+{
+	while(m_pos < m_text.size() && isSpace(m_text[m_pos])) {
+		m_pos++;
+	}
+}
+
+void PgnReader::skipLine()
+{
+	size_t end = m_text.find('\n', m_pos);
+	m_pos = (end == string_view::npos) ? m_text.size() : end + 1;
+}
+
+bool PgnReader::atTagLine() const
+{
+	return m_pos < m_text.size() && m_text[m_pos] == '[' &&
+		(m_pos == 0 || m_text[m_pos-1] == '\n');
+}
+
+bool PgnReader::readTag(PgnGameView & game)
+{
+	size_t pos = m_pos + 1;
+	size_t size = m_text.size();
+
+	while(pos < size && (m_text[pos] == ' ' || m_text[pos] == '\t')) {
+		pos++;
+	}
+	size_t name = pos;
+	while(pos < size && (isalnum((unsigned char)m_text[pos]) || m_text[pos] == '_')) {
+		pos++;
+	}
+	if(pos == name) {
+		return false;
+	}
+	size_t nameend = pos;
+
+	while(pos < size && (m_text[pos] == ' ' || m_text[pos] == '\t')) {
+		pos++;
+	}
+	if(pos >= size || m_text[pos] != '"') {
+		return false;
+	}
+	size_t value = ++pos;
+	while(pos < size && m_text[pos] != '"') {
+		if(m_text[pos] == '\n') {
+			return false;
+		}
+		if(m_text[pos] == '\\') {
+			pos++;
+		}
+		pos++;
+	}
+	if(pos >= size) {
+		return false;
+	}
+	size_t valueend = pos++;
+
+	while(pos < size && (m_text[pos] == ' ' || m_text[pos] == '\t')) {
+		pos++;
+	}
+	if(pos >= size || m_text[pos] != ']') {
+		return false;
+	}
+
+	game.tags.push_back(make_pair(m_text.substr(name, nameend - name),
+		m_text.substr(value, valueend - value)));
+	m_pos = pos + 1;
+	return true;
+}
+
+void PgnReader::skipVariation(PgnGameView & game)
+{
+	int depth = 0;
+	while(m_pos < m_text.size()) {
+		if(atTagLine()) {
+			// Never closed, the next game has started
+			return;
+		}
+
+		char c = m_text[m_pos];
+		if(c == '(') {
+			depth++;
+			game.variations++;
+		} else if(c == ')') {
+			m_pos++;
+			if(--depth == 0) {
+				return;
+			}
+			continue;
+		} else if(c == '{') {
+			size_t end = m_text.find('}', m_pos);
+			m_pos = (end == string_view::npos) ? m_text.size() : end;
+		} else if(c == ';') {
+			skipLine();
+			continue;
+		}
+		m_pos++;
+	}
+}
+
+bool PgnReader::next(PgnGameView & game)
+{
+	size_t size = m_text.size();
+
+	while(true) {
+		game.clear();
+		skipSpace();
+		if(m_pos >= size) {
+			return false;
+		}
+		size_t start = m_pos;
+
+		// Tag pairs, lines that aren't are skipped
+		while(m_pos < size) {
+			char c = m_text[m_pos];
+			if(c == '%' && (m_pos == 0 || m_text[m_pos-1] == '\n')) {
+				skipLine();
+			} else if(c != '[') {
+				break;
+			} else if(!readTag(game)) {
+				skipLine();
+			}
+			skipSpace();
+		}
+
+		// Movetext, up to the result or the tags of the next game
+		while(m_pos < size && game.result.empty()) {
+			if(atTagLine()) {
+				break;
+			}
+
+			char c = m_text[m_pos];
+			if(c == '{') {
+				size_t end = m_text.find('}', m_pos);
+				if(end == string_view::npos) {
+					end = size;
+				}
+				game.comments.push_back(make_pair((int)game.moves.size(),
+					m_text.substr(m_pos + 1, end - m_pos - 1)));
+				m_pos = (end < size) ? end + 1 : size;
+			} else if(c == ';') {
+				size_t end = m_text.find('\n', m_pos);
+				if(end == string_view::npos) {
+					end = size;
+				}
+				size_t last = end;
+				if(last > m_pos + 1 && m_text[last-1] == '\r') {
+					last--;
+				}
+				game.comments.push_back(make_pair((int)game.moves.size(),
+					m_text.substr(m_pos + 1, last - m_pos - 1)));
+				m_pos = end;
+			} else if(c == '(') {
+				skipVariation(game);
+			} else if(c == '$') {
+				int nag = 0;
+				size_t pos = m_pos + 1;
+				while(pos < size && m_text[pos] >= '0' && m_text[pos] <= '9') {
+					nag = nag * 10 + (m_text[pos++] - '0');
+				}
+				if(pos > m_pos + 1) {
+					game.nags.push_back(make_pair((int)game.moves.size(), nag));
+				}
+				m_pos = pos;
+			} else if(c == '%' && m_pos > 0 && m_text[m_pos-1] == '\n') {
+				skipLine();
+			} else if(isDelimiter(c)) {
+				// A stray ')', '}' or ']'
+				m_pos++;
+			} else {
+				size_t end = m_pos;
+				while(end < size && !isDelimiter(m_text[end])) {
+					end++;
+				}
+				string_view token = m_text.substr(m_pos, end - m_pos);
+				m_pos = end;
+
+				if(token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+					game.result = token;
+					break;
+				}
+
+				// Move numbers, which may be run together with the move
+				if(token.substr(0, 3) != "0-0") {
+					size_t digits = 0;
+					while(digits < token.size() && token[digits] >= '0' && token[digits] <= '9') {
+						digits++;
+					}
+					size_t dots = digits;
+					while(dots < token.size() && token[dots] == '.') {
+						dots++;
+					}
+					if(dots > digits || digits == token.size()) {
+						token.remove_prefix(dots);
+					}
+				}
+				if(token.empty()) {
+					continue;
+				}
+
+				size_t suffix = token.size();
+				while(suffix > 0 && (token[suffix-1] == '!' || token[suffix-1] == '?')) {
+					suffix--;
+				}
+				int glyph = suffixGlyph(token.substr(suffix));
+				token.remove_suffix(token.size() - suffix);
+				if(token.empty()) {
+					continue;
+				}
+
+				game.moves.push_back(token);
+				if(glyph) {
+					game.nags.push_back(make_pair((int)game.moves.size(), glyph));
+				}
+			}
+			skipSpace();
+		}
+
+		game.text = m_text.substr(start, m_pos - start);
+		if(!game.tags.empty() || !game.moves.empty() || !game.result.empty()) {
+			return true;
+		}
+	}
+}
+
+// Returns where the first game starting at or after pos starts
+static size_t findGameStart(string_view text, size_t pos)
+{
+	while(true) {
+		size_t found = text.find("\n[", pos);
+		if(found == string_view::npos) {
+			return text.size();
+		}
+
+		// The first tag of a game follows something that isn't a tag
+		size_t end = found;
+		while(end > 0 && isSpace(text[end-1])) {
+			end--;
+		}
+		if(end == 0) {
+			return found + 1;
+		}
+		size_t begin = text.rfind('\n', end - 1);
+		begin = (begin == string_view::npos) ? 0 : begin + 1;
+		if(text[begin] != '[') {
+			return found + 1;
+		}
+		pos = found + 1;
+	}
+}
+
+vector<string_view> PgnReader::split(string_view text, int parts)
+{
+	vector<string_view> result;
+	size_t start = 0;
+	for(int i = 1; i < parts; i++) {
+		size_t pos = findGameStart(text, max(start, text.size() / parts * i));
+		if(pos >= text.size()) {
+			break;
+		}
+		result.push_back(text.substr(start, pos - start));
+		start = pos;
+	}
+	result.push_back(text.substr(start));
+	return result;
+}
+
+long long PgnReader::forEachGame(string_view text,
+	const function<void(const PgnGameView &, int)> & visit)
+{
+	JobSystem * jobs = JobSystem::getInstance();
+
+	// More parts than workers, so that they finish about together
+	vector<string_view> parts = split(text, jobs->getThreadCount() * 4);
+	vector<JobHandle<long long> > handles;
+	for(int i = 0; i < (int)parts.size(); i++) {
+		handles.push_back(jobs->submit(JobSystem::IO, [&parts, &visit, i]() {
+			PgnReader reader(parts[i]);
+			PgnGameView game;
+			long long games = 0;
+			while(reader.next(game)) {
+				visit(game, i);
+				games++;
+			}
+			return games;
+		}));
+	}
+
+	long long games = 0;
+	for(int i = 0; i < (int)handles.size(); i++) {
+		games += handles[i].get();
+	}
+	return games;
+}
+
+string PgnReader::unescape(string_view value)
+{
+	string result;
+	result.reserve(value.size());
+	for(int i = 0; i < (int)value.size(); i++) {
+		if(value[i] == '\\' && i + 1 < (int)value.size()) {
+			i++;
+		}
+		result += value[i];
+	}
+	return result;
+}
+
+bool replayGame(const PgnGameView & game, ChessGameState & state,
+	vector<BoardMove> * moves)
+{
+	string_view fen = game.getTag("FEN");
+	if(fen.empty()) {
+		state.reset();
+	} else if(!state.loadFEN(fen)) {
+		return false;
+	}
+
+	for(int i = 0; i < (int)game.moves.size(); i++) {
+		BoardMove move = sanToMove(state, game.moves[i]);
+		if(!move.isValid()) {
+			return false;
+		}
+		state.update(move);
+		if(moves) {
+			moves->push_back(move);
+		}
+	}
+	return true;
+}
+
+PgnWriter::~PgnWriter()
+{
+	close();
+}
+
+bool PgnWriter::open(const string & filename)
+{
+	close();
+	m_file = fopen(filename.c_str(), "a");
+	return m_file != 0;
+}
+
+void PgnWriter::close()
+{
+	lock_guard<mutex> lock(m_mutex);
+	if(m_file) {
+		writeBuffer();
+		fclose(m_file);
+		m_file = 0;
+	}
+}
+
+void PgnWriter::write(const PgnGame & game)
+{
+	lock_guard<mutex> lock(m_mutex);
+	format(game, m_buffer);
+	if(m_flush_each_game || m_buffer.size() >= BUFFER_SIZE) {
+		writeBuffer();
+	}
+}
+
+void PgnWriter::flush()
+{
+	lock_guard<mutex> lock(m_mutex);
+	writeBuffer();
+}
+
+void PgnWriter::writeBuffer()
+{
+	if(m_file && !m_buffer.empty()) {
+		fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+		fflush(m_file);
+	}
+	m_buffer.clear();
+}
+
+string PgnWriter::format(const PgnGame & game)
+{
+	string out;
+	format(game, out);
+	return out;
+}
+
+void PgnWriter::format(const PgnGame & game, string & out)
+{
+	for(int i = 0; i < (int)game.tags.size(); i++) {
+		out += '[';
+		out += game.tags[i].first;
+		out += " \"";
+		const string & value = game.tags[i].second;
+		for(int j = 0; j < (int)value.size(); j++) {
+			if(value[j] == '"' || value[j] == '\\') {
+				out += '\\';
+			}
+			out += value[j];
+		}
+		out += "\"]\n";
+	}
+	out += '\n';
+
+	// Movetext, wrapped at whole tokens
+	size_t line = out.size();
+	char number[16];
+	for(int i = 0; i <= (int)game.moves.size(); i++) {
+		const char * prefix = "";
+		int prefixlength = 0;
+		string_view move;
+		int ply = game.firstply + i;
+		if(i == (int)game.moves.size()) {
+			move = game.result.empty() ? string_view("*") : string_view(game.result);
+		} else {
+			move = game.moves[i];
+			// A game that starts with black to move starts with "1..."
+			if(ply % 2 == 0) {
+				prefixlength = snprintf(number, sizeof(number), "%d. ", ply / 2 + 1);
+				prefix = number;
+			} else if(i == 0) {
+				prefixlength = snprintf(number, sizeof(number), "%d... ", ply / 2 + 1);
+				prefix = number;
+			}
+		}
+
+		size_t length = prefixlength + move.size();
+		if(out.size() > line) {
+			if(out.size() - line + 1 + length > (size_t)LINE_LENGTH) {
+				out += '\n';
+				line = out.size();
+			} else {
+				out += ' ';
+			}
+		}
+		out.append(prefix, prefixlength);
+		out.append(move.data(), move.size());
+	}
+	out += "\n\n";
+}
+
+// End of file pgn.cpp
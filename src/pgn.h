@@ -0,0 +1,244 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : pgn.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef PGN_H
+#define PGN_H
+
+#include "boardmove.h"
+
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class ChessGame;
+class ChessGameState;
+
+/**
+ * A finished game as it is written to a PGN file. The seven tag roster
+ * comes first, in the order the tags were added.
+ */
+struct PgnGame {
+	PgnGame() :
+		firstply(0) {}
+
+	std::vector<std::pair<std::string, std::string> > tags;
+
+	// Moves in standard algebraic notation
+	std::vector<std::string> moves;
+
+	// "1-0", "0-1", "1/2-1/2" or "*"
+	std::string result;
+
+	// Ply the first move is numbered as, 0 for white's first move. Set
+	// from the FEN for games that don't start from the initial position.
+	int firstply;
+
+	void addTag(const std::string & name, const std::string & value)
+		{ tags.push_back(std::make_pair(name, value)); }
+
+	/**
+	 * Adds the SetUp and FEN tags for a game that starts from fen, and
+	 * numbers the moves from its move number and side to move.
+	 */
+	void setFEN(const std::string & fen);
+
+	/**
+	 * Adds the moves game has played so far, in SAN. If the game didn't
+	 * start from the initial position the SetUp and FEN tags are added.
+	 */
+	void addMoves(const ChessGame & game);
+};
+
+/**
+ * A game read from PGN text. Everything refers into the text, nothing is
+ * copied, so a game is only valid while the text is and until the
+ * reader reads the next one. The vectors keep their memory between
+ * games, after the first few reading a game doesn't allocate.
+ */
+struct PgnGameView {
+	PgnGameView() :
+		variations(0) {}
+
+	/** Empties the game, keeping the memory. */
+	void clear();
+
+	/**
+	 * Returns the value of a tag, empty if there is none. Values are as
+	 * written, with backslash escapes, see PgnReader::unescape.
+	 */
+	std::string_view getTag(std::string_view name) const;
+
+	/** Tag names and values, in the order they were written. */
+	std::vector<std::pair<std::string_view, std::string_view> > tags;
+
+	/** Moves of the main line, in SAN without move suffixes. */
+	std::vector<std::string_view> moves;
+
+	/**
+	 * Comments of the main line, with the number of moves before them.
+	 * The braces or semicolon are left out.
+	 */
+	std::vector<std::pair<int, std::string_view> > comments;
+
+	/**
+	 * Numeric annotation glyphs of the main line, with the number of
+	 * moves up to and including the one they annotate. Move suffixes
+	 * such as "!?" are turned into their glyphs.
+	 */
+	std::vector<std::pair<int, int> > nags;
+
+	/** "1-0", "0-1", "1/2-1/2", "*" or empty if the game has no result. */
+	std::string_view result;
+
+	/** Number of variations skipped, nested ones included. */
+	int variations;
+
+	/** The whole game as it was written. */
+	std::string_view text;
+};
+
+/**
+ * Reads games one after the other out of PGN text, usually a whole
+ * MappedFile. Tags, movetext, comments, variations and NAGs are
+ * tokenized in place. Text that can't be read is skipped up to the next
+ * tag, so one broken game doesn't take the rest of the file with it.
+ *
+ * A reader belongs to one thread. To read a big file on all cores, split
+ * it with split() and give each part a reader of its own, or let
+ * forEachGame() do both.
+ */
+class PgnReader {
+ public:
+	explicit PgnReader(std::string_view text) :
+		m_text(text),
+		m_pos(0) {}
+
+	/**
+	 * Reads the next game into game. Returns false once there are no more
+	 * games.
+	 */
+	bool next(PgnGameView & game);
+
+	/** Returns how far into the text the reader is, in bytes. */
+	size_t getPosition() const
+		{ return m_pos; }
+
+	/**
+	 * Splits text into at most parts pieces of about the same size, each
+	 * starting where a game starts. A game is taken to start at a line
+	 * that opens with '[' after a line that doesn't.
+	 */
+	static std::vector<std::string_view> split(std::string_view text, int parts);
+
+	/**
+	 * Reads every game of text on the JobSystem and calls visit for each,
+	 * on the worker threads. visit gets the game and the number of the
+	 * part it came from, games of the same part come in order. Returns
+	 * the number of games read.
+	 */
+	static long long forEachGame(std::string_view text,
+		const std::function<void(const PgnGameView &, int)> & visit);
+
+	/** Returns a tag value with its backslash escapes undone. */
+	static std::string unescape(std::string_view value);
+
+ private:
+	// Reads a tag pair, returns false if the line isn't one
+	bool readTag(PgnGameView & game);
+
+	// Skips a variation, nested ones and the comments in them included
+	void skipVariation(PgnGameView & game);
+
+	// Returns true at the start of a line that opens with '['
+	bool atTagLine() const;
+
+	void skipSpace();
+	void skipLine();
+
+	std::string_view m_text;
+	size_t m_pos;
+};
+
+/**
+ * Plays the main line of game from its starting position, which is the
+ * FEN tag if there is one. Stops at the first move that isn't legal and
+ * returns false.
+ * @param game - The game to replay.
+ * @param state - Set to the position after the last move played.
+ * @param moves - Receives the moves played, if not null.
+ */
+bool replayGame(const PgnGameView & game, ChessGameState & state,
+	std::vector<BoardMove> * moves = 0);
+
+/**
+ * Appends games to a PGN file. Games can be written from several threads
+ * at once, each one is written whole. Games are gathered in a buffer and
+ * written in big blocks. By default every game is flushed right away, so
+ * that the file can be followed while a match is running, writers of
+ * many games at once turn that off.
+ */
+class PgnWriter {
+ public:
+	PgnWriter() :
+		m_file(0),
+		m_flush_each_game(true) {}
+
+	/** Flushes and closes the file. */
+	~PgnWriter();
+
+	/** Opens the file for appending, returns false if it can't. */
+	bool open(const std::string & filename);
+
+	/** Flushes and closes the file. */
+	void close();
+
+	bool isOpen() const
+		{ return m_file != 0; }
+
+	/**
+	 * Sets whether every game is written out at once, or only when the
+	 * buffer is full.
+	 */
+	void setFlushEachGame(bool flush)
+		{ m_flush_each_game = flush; }
+
+	/** Writes one game. */
+	void write(const PgnGame & game);
+
+	/** Writes out the games still in the buffer. */
+	void flush();
+
+	/** Formats a game the way it is written to the file. */
+	static std::string format(const PgnGame & game);
+
+	/** Same as above, appending to out. */
+	static void format(const PgnGame & game, std::string & out);
+
+	/** Games are written once this many bytes are buffered. */
+	static const size_t BUFFER_SIZE = 1 << 20;
+
+ private:
+	PgnWriter(const PgnWriter &);
+	PgnWriter & operator=(const PgnWriter &);
+
+	// Writes out the buffer, m_mutex held
+	void writeBuffer();
+
+	FILE * m_file;
+	std::string m_buffer;
+	bool m_flush_each_game;
+	std::mutex m_mutex;
+};
+
+#endif // PGN_H
+
+// End of file pgn.h
@@ -0,0 +1,490 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : positionindex.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "positionindex.h"
+#include "chessgamestate.h"
+#include "gamedb.h"
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+static const char INDEX_MAGIC[8] = { 'C', 'P', 'P', 'O', 'S', 'I', 'D', 'X' };
+// 2 has Polyglot's keys
+static const uint32_t VERSION = 2;
+
+// Keys are found through a table of where each top 16 bits start
+static const int BUCKET_BITS = 16;
+static const int BUCKETS = 1 << BUCKET_BITS;
+
+// Bytes of records a shard is sorted in, and the most shards there are
+static const long long SHARD_SIZE = 64 << 20;
+static const int MAX_SHARD_BITS = 12;
+
+// File descriptors left for the rest of the program while the shards are
+// open
+static const int RESERVED_FILES = 32;
+
+// Records a job gathers before it spills them to the shards
+static const size_t SPILL_RECORDS = 1 << 20;
+
+struct IndexHeader {
+	char magic[8];
+	uint32_t version;
+	// Moves of each game indexed, 0 for all
+	uint32_t plies;
+	uint64_t games;
+	uint64_t positions;
+	uint64_t occurrences;
+	// Where the positions and the bucket table start, the occurrences
+	// follow the header
+	uint64_t entries;
+	uint64_t buckets;
+	uint64_t reserved;
+};
+
+struct PositionEntry {
+	uint64_t key;
+	// The first of the games occurrences of the position
+	uint64_t first;
+	uint32_t games;
+	uint32_t whitewins;
+	uint32_t draws;
+	uint32_t blackwins;
+};
+
+struct PositionOccurrence {
+	uint32_t game;
+	uint32_t ply;
+};
+
+// A position of a game while the index is built
+struct PositionRecord {
+	uint64_t key;
+	uint32_t game;
+	uint16_t ply;
+	uint8_t result;
+	uint8_t unused;
+};
+
+static bool operator<(const PositionRecord & a, const PositionRecord & b)
+{
+	if(a.key != b.key) {
+		return a.key < b.key;
+	}
+	if(a.game != b.game) {
+		return a.game < b.game;
+	}
+	return a.ply < b.ply;
+}
+
+// A shard sorted into the positions and occurrences it adds to the index
+struct SortedShard {
+	SortedShard() : valid(false) {}
+
+	bool valid;
+	vector<PositionEntry> entries;
+	vector<PositionOccurrence> occurrences;
+};
+
+// The temporary files of a build, removed when it is done
+struct ShardFiles {
+	ShardFiles(const string & filename, int count) :
+		files(count, (FILE *)0),
+		locks(new mutex[count])
+	{
+		for(int i = 0; i < count; i++) {
+			names.push_back(filename + ".shard" + to_string(i));
+		}
+		names.push_back(filename + ".entries");
+	}
+
+	~ShardFiles()
+	{
+		for(int i = 0; i < (int)files.size(); i++) {
+			if(files[i]) {
+				fclose(files[i]);
+			}
+		}
+		for(int i = 0; i < (int)names.size(); i++) {
+			remove(names[i].c_str());
+		}
+	}
+
+	bool open()
+	{
+		for(int i = 0; i < (int)files.size(); i++) {
+			files[i] = fopen(names[i].c_str(), "w+b");
+			if(!files[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Appends records to shard, from any thread
+	bool write(int shard, const vector<PositionRecord> & records)
+	{
+		lock_guard<mutex> lock(locks[shard]);
+		return fwrite(records.data(), sizeof(PositionRecord), records.size(),
+			files[shard]) == records.size();
+	}
+
+	vector<string> names;
+	vector<FILE *> files;
+	unique_ptr<mutex[]> locks;
+};
+
+// Reads, sorts and counts up a shard
+static SortedShard sortShard(FILE * file)
+{
+	SortedShard shard;
+	vector<PositionRecord> records;
+	if(fseek(file, 0, SEEK_END)) {
+		return shard;
+	}
+	records.resize(ftell(file) / sizeof(PositionRecord));
+	rewind(file);
+	if(fread(records.data(), sizeof(PositionRecord), records.size(), file) != records.size()) {
+		return shard;
+	}
+	sort(records.begin(), records.end());
+
+	for(size_t i = 0; i < records.size(); i++) {
+		const PositionRecord & record = records[i];
+		if(shard.entries.empty() || shard.entries.back().key != record.key) {
+			PositionEntry entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.key = record.key;
+			entry.first = shard.occurrences.size();
+			shard.entries.push_back(entry);
+		} else if(records[i - 1].game == record.game) {
+			// Reached again later in the same game
+			continue;
+		}
+
+		PositionEntry & entry = shard.entries.back();
+		entry.games++;
+		if(record.result == GameHeader::WHITE_WINS) {
+			entry.whitewins++;
+		} else if(record.result == GameHeader::BLACK_WINS) {
+			entry.blackwins++;
+		} else if(record.result == GameHeader::DRAW) {
+			entry.draws++;
+		}
+
+		PositionOccurrence occurrence;
+		occurrence.game = record.game;
+		occurrence.ply = record.ply;
+		shard.occurrences.push_back(occurrence);
+	}
+	shard.valid = true;
+	return shard;
+}
+
+// Returns how many shard files may be open at once, below the limit on
+// open files of the process
+static int maxShards()
+{
+#ifndef WIN32
+	rlimit limit;
+	if(!getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur != RLIM_INFINITY &&
+			limit.rlim_cur < (rlim_t)(1 << MAX_SHARD_BITS) + RESERVED_FILES) {
+		return max((int)limit.rlim_cur - RESERVED_FILES, 1);
+	}
+#endif
+	return 1 << MAX_SHARD_BITS;
+}
+
+bool PositionIndex::build(const GameDatabase & db, const string & filename, int plies)
+{
+	JobSystem * jobs = JobSystem::getInstance();
+	long long games = db.getGameCount();
+
+	// Enough shards for each to be sorted in SHARD_SIZE bytes, unless that
+	// is more files than may be open, then they get bigger
+	long long records = 0;
+	for(long long n = 0; n < games; n++) {
+		int played = db.getPlies(n);
+		records += 1 + ((plies > 0 && played > plies) ? plies : played);
+	}
+	int shardbits = 0;
+	int allowed = maxShards();
+	while(shardbits < MAX_SHARD_BITS && (2 << shardbits) <= allowed &&
+			(records * (long long)sizeof(PositionRecord) >> shardbits) > SHARD_SIZE) {
+		shardbits++;
+	}
+	int shards = 1 << shardbits;
+
+	ShardFiles files(filename, shards);
+	if(!files.open()) {
+		return false;
+	}
+
+	// Every position of every game goes to the shard of its top key bits
+	vector<JobHandle<bool> > handles;
+	for(long long first = 0; first < games; first += GameDatabase::BLOCK_GAMES) {
+		handles.push_back(jobs->submit(JobSystem::IO, [&db, &files, first, games, plies, shardbits]() {
+			long long last = min(first + GameDatabase::BLOCK_GAMES, games);
+			vector<vector<PositionRecord> > buffers(files.files.size());
+			vector<unsigned long long> keys;
+			size_t buffered = 0;
+			bool ok = true;
+			for(long long n = first; n < last && ok; n++) {
+				if(!db.readKeys(n, keys, plies > 0 ? plies : -1)) {
+					return false;
+				}
+				PositionRecord record;
+				record.game = (uint32_t)n;
+				record.result = (uint8_t)db.getResult(n);
+				record.unused = 0;
+				for(int ply = 0; ply < (int)keys.size(); ply++) {
+					record.key = keys[ply];
+					record.ply = (uint16_t)ply;
+					buffers[shardbits ? keys[ply] >> (64 - shardbits) : 0].push_back(record);
+				}
+				buffered += keys.size();
+
+				if(buffered >= SPILL_RECORDS || n + 1 == last) {
+					for(int i = 0; i < (int)buffers.size() && ok; i++) {
+						ok = files.write(i, buffers[i]);
+						buffers[i].clear();
+					}
+					buffered = 0;
+				}
+			}
+			return ok;
+		}));
+	}
+	bool ok = true;
+	for(int i = 0; i < (int)handles.size(); i++) {
+		ok = handles[i].get() && ok;
+	}
+	if(!ok) {
+		return false;
+	}
+
+	FILE * out = fopen(filename.c_str(), "wb");
+	FILE * entries = fopen(files.names.back().c_str(), "w+b");
+	if(!out || !entries) {
+		if(out) {
+			fclose(out);
+		}
+		if(entries) {
+			fclose(entries);
+		}
+		return false;
+	}
+
+	IndexHeader header;
+	memset(&header, 0, sizeof(header));
+	fwrite(&header, sizeof(header), 1, out);
+
+	// Shards are sorted a window at a time and written in key order, the
+	// occurrences straight into the index and the positions after them
+	vector<unsigned long long> buckets(BUCKETS + 1, 0);
+	int window = jobs->getThreadCount();
+	for(int first = 0; first < shards && ok; first += window) {
+		int last = min(first + window, shards);
+		vector<JobHandle<SortedShard> > sorted;
+		for(int i = first; i < last; i++) {
+			FILE * file = files.files[i];
+			sorted.push_back(jobs->submit(JobSystem::IO, [file]() {
+				return sortShard(file);
+			}));
+		}
+
+		for(int i = 0; i < (int)sorted.size(); i++) {
+			SortedShard shard = sorted[i].get();
+			if(!shard.valid) {
+				ok = false;
+				continue;
+			}
+			for(int j = 0; j < (int)shard.entries.size(); j++) {
+				shard.entries[j].first += header.occurrences;
+				buckets[(shard.entries[j].key >> (64 - BUCKET_BITS)) + 1]++;
+			}
+			header.positions += shard.entries.size();
+			header.occurrences += shard.occurrences.size();
+			ok = ok &&
+				fwrite(shard.occurrences.data(), sizeof(PositionOccurrence),
+					shard.occurrences.size(), out) == shard.occurrences.size() &&
+				fwrite(shard.entries.data(), sizeof(PositionEntry),
+					shard.entries.size(), entries) == shard.entries.size();
+		}
+	}
+
+	// Then the positions and the table of where each bucket starts
+	header.entries = sizeof(header) + header.occurrences * sizeof(PositionOccurrence);
+	header.buckets = header.entries + header.positions * sizeof(PositionEntry);
+	rewind(entries);
+	vector<char> buffer(1 << 20);
+	size_t read;
+	while(ok && (read = fread(buffer.data(), 1, buffer.size(), entries)) > 0) {
+		ok = fwrite(buffer.data(), 1, read, out) == read;
+	}
+	fclose(entries);
+	for(int i = 0; i < BUCKETS; i++) {
+		buckets[i + 1] += buckets[i];
+	}
+	ok = ok && fwrite(buckets.data(), sizeof(unsigned long long), buckets.size(), out) == buckets.size();
+
+	memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+	header.version = VERSION;
+	header.plies = plies;
+	header.games = games;
+	ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+	ok = (fclose(out) == 0) && ok;
+	if(!ok) {
+		remove(filename.c_str());
+	}
+	return ok;
+}
+
+bool PositionIndex::open(const string & filename)
+{
+	close();
+	if(!m_file.open(filename)) {
+		return false;
+	}
+
+	const char * data = m_file.getData();
+	size_t size = m_file.getSize();
+	const IndexHeader * header = (const IndexHeader *)data;
+	if(size < sizeof(IndexHeader) || memcmp(header->magic, INDEX_MAGIC, 8) ||
+			header->version != VERSION ||
+			header->entries != sizeof(IndexHeader) + header->occurrences * sizeof(PositionOccurrence) ||
+			header->buckets != header->entries + header->positions * sizeof(PositionEntry) ||
+			header->buckets + (BUCKETS + 1) * sizeof(unsigned long long) != size) {
+		close();
+		return false;
+	}
+
+	m_occurrences = (const PositionOccurrence *)(data + sizeof(IndexHeader));
+	m_entries = (const PositionEntry *)(data + header->entries);
+	m_buckets = (const unsigned long long *)(data + header->buckets);
+	if(m_buckets[BUCKETS] != header->positions) {
+		close();
+		return false;
+	}
+	m_positions = header->positions;
+	m_games = header->games;
+	return true;
+}
+
+void PositionIndex::close()
+{
+	m_file.close();
+	m_buckets = 0;
+	m_entries = 0;
+	m_occurrences = 0;
+	m_positions = 0;
+	m_games = 0;
+}
+
+const PositionEntry * PositionIndex::findEntry(unsigned long long key) const
+{
+	if(!m_buckets) {
+		return 0;
+	}
+	unsigned long long bucket = key >> (64 - BUCKET_BITS);
+	const PositionEntry * first = m_entries + m_buckets[bucket];
+	const PositionEntry * last = m_entries + m_buckets[bucket + 1];
+	const PositionEntry * entry = lower_bound(first, last, key,
+		[](const PositionEntry & e, unsigned long long k) { return e.key < k; });
+	return (entry != last && entry->key == key) ? entry : 0;
+}
+
+bool PositionIndex::find(unsigned long long key, PositionStats & stats) const
+{
+	const PositionEntry * entry = findEntry(key);
+	if(!entry) {
+		stats = PositionStats();
+		return false;
+	}
+	stats.games = entry->games;
+	stats.whitewins = entry->whitewins;
+	stats.draws = entry->draws;
+	stats.blackwins = entry->blackwins;
+	return true;
+}
+
+bool PositionIndex::find(const ChessGameState & state, PositionStats & stats) const
+{
+	return find(state.getKey(), stats);
+}
+
+long long PositionIndex::findGames(unsigned long long key, vector<PositionGame> & games,
+	int max) const
+{
+	games.clear();
+	const PositionEntry * entry = findEntry(key);
+	if(!entry) {
+		return 0;
+	}
+	long long count = entry->games;
+	if(max > 0 && count > max) {
+		count = max;
+	}
+	for(long long i = 0; i < count; i++) {
+		const PositionOccurrence & occurrence = m_occurrences[entry->first + i];
+		PositionGame game;
+		game.game = occurrence.game;
+		game.ply = occurrence.ply;
+		games.push_back(game);
+	}
+	return entry->games;
+}
+
+void PositionIndex::explore(const ChessGameState & state, vector<MoveStats> & moves) const
+{
+	static const Piece::Type PROMOTIONS[4] = {
+		Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT
+	};
+
+	moves.clear();
+	const Board & board = state.getBoard();
+	const unsigned long long * legal = state.getLegalMap();
+	Piece::Color next = Piece::opposite(state.getTurn());
+	for(int i = 0; i < Board::BOARDSIZE*Board::BOARDSIZE; i++) {
+		for(int j = 0; j < Board::BOARDSIZE*Board::BOARDSIZE; j++) {
+			if(!((legal[i] >> j) & 1)) {
+				continue;
+			}
+			BoardMove bm(BoardPosition(i), BoardPosition(j), board.getPiece(BoardPosition(i)));
+			int promotions = bm.needPromotion() ? 4 : 1;
+			for(int k = 0; k < promotions; k++) {
+				if(promotions > 1) {
+					bm.setPromotion(PROMOTIONS[k]);
+				}
+				Board after = board;
+				after.update(bm);
+				MoveStats move;
+				move.move = bm;
+				if(find(after.getKey(next), move.stats)) {
+					moves.push_back(move);
+				}
+			}
+		}
+	}
+
+	stable_sort(moves.begin(), moves.end(),
+		[](const MoveStats & a, const MoveStats & b) { return a.stats.games > b.stats.games; });
+}
+
+// End of file positionindex.cpp
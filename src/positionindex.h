@@ -0,0 +1,143 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : positionindex.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef POSITIONINDEX_H
+#define POSITIONINDEX_H
+
+#include "boardmove.h"
+#include "mappedfile.h"
+
+#include <string>
+#include <vector>
+
+class ChessGameState;
+class GameDatabase;
+
+/**
+ * How the games that reached a position ended.
+ */
+struct PositionStats {
+	PositionStats() :
+		games(0),
+		whitewins(0),
+		draws(0),
+		blackwins(0) {}
+
+	/** Games with the position, unfinished ones included. */
+	long long games;
+	long long whitewins;
+	long long draws;
+	long long blackwins;
+};
+
+/**
+ * A game that reached a position, and the number of moves played before.
+ */
+struct PositionGame {
+	long long game;
+	int ply;
+};
+
+/**
+ * A move of the position being explored and where it leads.
+ */
+struct MoveStats {
+	BoardMove move;
+	PositionStats stats;
+};
+
+/**
+ * An index of every position of a GameDatabase, by Zobrist key, to the
+ * games that reached it and how they ended. Looking a position up is a
+ * binary search through a few entries, the index is read through a
+ * MappedFile and only the pages touched are read in.
+ *
+ * The file holds a table of where the keys with each top 16 bits start,
+ * the positions sorted by key with their results, and for each position
+ * the games and plies it occurred at. A game is counted once for a
+ * position, at the first ply it reached it.
+ *
+ * Many threads may look up one PositionIndex at once.
+ */
+class PositionIndex {
+ public:
+	PositionIndex() :
+		m_buckets(0),
+		m_entries(0),
+		m_occurrences(0),
+		m_positions(0),
+		m_games(0) {}
+
+	/**
+	 * Builds the index of db into filename, on the JobSystem. Positions
+	 * are sorted in shards of the key space, spilled to temporary files
+	 * next to filename, so that databases of any size can be indexed.
+	 * Returns false if a file can't be written or db is damaged.
+	 * @param db - The games to index.
+	 * @param filename - The index to write.
+	 * @param plies - Moves of each game to index, all of them if 0.
+	 */
+	static bool build(const GameDatabase & db, const std::string & filename, int plies = 0);
+
+	/** Opens an index, returns false if it can't be read. */
+	bool open(const std::string & filename);
+
+	void close();
+
+	bool isOpen() const
+		{ return m_file.isOpen(); }
+
+	/** Returns the number of different positions. */
+	long long getPositionCount() const
+		{ return m_positions; }
+
+	/** Returns the number of games indexed. */
+	long long getGameCount() const
+		{ return m_games; }
+
+	/** Looks up a position by key, returns false if no game reached it. */
+	bool find(unsigned long long key, PositionStats & stats) const;
+
+	/** Same as above for the position of state. */
+	bool find(const ChessGameState & state, PositionStats & stats) const;
+
+	/**
+	 * Fills games with the games that reached a position, in the order
+	 * of the database.
+	 * @param key - The key of the position.
+	 * @param games - Filled with the games.
+	 * @param max - Most games to return, all of them if 0.
+	 * @return The number of games that reached the position.
+	 */
+	long long findGames(unsigned long long key, std::vector<PositionGame> & games,
+		int max = 0) const;
+
+	/**
+	 * Looks up every legal move of state, for an opening explorer. Fills
+	 * moves with those played in at least one game, most played first.
+	 */
+	void explore(const ChessGameState & state, std::vector<MoveStats> & moves) const;
+
+ private:
+	PositionIndex(const PositionIndex &);
+	PositionIndex & operator=(const PositionIndex &);
+
+	// Returns the entry of key, null if there is none
+	const struct PositionEntry * findEntry(unsigned long long key) const;
+
+	MappedFile m_file;
+	const unsigned long long * m_buckets;
+	const struct PositionEntry * m_entries;
+	const struct PositionOccurrence * m_occurrences;
+	long long m_positions;
+	long long m_games;
+};
+
+#endif // POSITIONINDEX_H
+
+// End of file positionindex.h
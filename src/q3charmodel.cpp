@@ -6,9 +6,9 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey
  **************************************************************************/
 
+#include "logger.h"
 #include "q3charmodel.h"
 
-#include <iostream>
 #include <fstream>
 #include <string>
 
@@ -29,7 +29,6 @@ bool Q3CharModel::load(const string& modeldir, const string& skin)
 	m_lower.link(&m_upper);
 	m_upper.link(&m_head);
 
-	cout << "Load aimation params" << endl;
 	loadAnimParams();
 	
 	float min[3];
@@ -106,7 +105,7 @@ Q3CharModel::Q3AnimState Q3CharModel::getUpperAnimation(const string& anim_name)
 {
 	Q3AnimState ret;
 	if (m_upper_anim.find(anim_name) == m_upper_anim.end()) {
-		cout << "Failure" << endl;
+		LOG_WARNING("md3", "No upper animation " << anim_name);
 		return ret;
 	}
 	str_to_param_map::const_iterator pi = m_lower_anim.find(anim_name);
@@ -124,7 +123,7 @@ void Q3CharModel::loadAnimParams()
 	string filename = m_modeldir + "animation.cfg";
 	ifstream animcfgfile(filename.c_str());
 	if (!animcfgfile) {
-		cerr << "Failed to load the animation.cfg file: " << filename << endl;
+		LOG_ERROR("md3", "Failed to load the animation.cfg file: " << filename);
 		return;
 	}
 
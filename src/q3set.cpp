@@ -6,12 +6,13 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey
  **************************************************************************/
 
+#include "logger.h"
 #include "pieceset.h"
 #include "SDL_opengl.h"
 
 bool Q3Set::load()
 {
-	cout << "Q3Set::load()" << endl;
+	LOG_DEBUG("md3", "Loading the Quake 3 pieces");
 	m_pieces[Piece::KING].load("../art/md3/cloud/");
 	m_pieces[Piece::QUEEN].load("../art/md3/yum/");
 	m_pieces[Piece::KNIGHT].load("../art/md3/dragon/");
@@ -46,7 +47,7 @@ void Q3Set::draw(const ChessGameState& gs)
 		m_pieces[p].updateAnim(m_upIdle[p]);
 		m_pieces[p].updateAnim(m_lowIdle[p]);
 	}
-	Board b = gs.getBoard();
+	const Board & b = gs.getBoard();
 	
 	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 	
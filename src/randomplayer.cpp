@@ -6,15 +6,17 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey
  **************************************************************************/
 
+#include <chrono>
+#include <thread>
 #include <vector>
 #include <time.h>
 #include "board.h"
 #include "chessplayer.h"
-#include "SDL.h"
 
 using namespace std;
 
-RandomPlayer::RandomPlayer()
+RandomPlayer::RandomPlayer(int delay) :
+	m_delay(delay)
 {
 	m_trustworthy = true;
 	srand(time(NULL));
@@ -23,7 +25,9 @@ RandomPlayer::RandomPlayer()
 void RandomPlayer::think(const ChessGameState & cgs)
 {
 	vector<BoardMove> moves = cgs.getBoard().possibleMoves(getColor());
-    SDL_Delay(150);
+	if(m_delay) {
+		this_thread::sleep_for(chrono::milliseconds(m_delay));
+	}
 	m_move = moves[rand() % moves.size()];
 }
 
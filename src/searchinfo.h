@@ -0,0 +1,75 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : searchinfo.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef SEARCHINFO_H
+#define SEARCHINFO_H
+
+#include <string>
+
+/**
+ * The constraints a ChessPlayer should respect while thinking about its
+ * next move. Every field left at zero means "no limit". Times are in
+ * milliseconds.
+ */
+struct SearchLimits {
+	SearchLimits() :
+		depth(0),
+		nodes(0),
+		movetime(0),
+		wtime(0),
+		btime(0),
+		winc(0),
+		binc(0),
+		movestogo(0) {}
+
+	/** Returns true if the remaining clock time of both sides is known. */
+	bool hasClock() const
+		{ return wtime > 0 || btime > 0; }
+
+	/** Returns true if no limit at all has been set. */
+	bool isEmpty() const
+		{ return !depth && !nodes && !movetime && !hasClock(); }
+
+	int depth;
+	long long nodes;
+	int movetime;
+	int wtime, btime;
+	int winc, binc;
+	int movestogo;
+};
+
+/**
+ * A progress report from a thinking player, for example one 'info' line
+ * of a UCI engine. Fields the player did not report are left at zero.
+ */
+struct SearchInfo {
+	SearchInfo() :
+		depth(0),
+		seldepth(0),
+		score(0),
+		mate(0),
+		nodes(0),
+		nps(0),
+		time(0) {}
+
+	int depth;
+	int seldepth;
+	/** Score in centipawns from the point of view of the thinking player */
+	int score;
+	/** Moves to mate, negative if the thinking player is getting mated */
+	int mate;
+	long long nodes;
+	long long nps;
+	int time;
+	/** Principal variation in coordinate notation, e.g. "e2e4 e7e5" */
+	std::string pv;
+};
+
+#endif // SEARCHINFO_H
+
+// End of file searchinfo.h
@@ -0,0 +1,257 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : selfplay.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "selfplay.h"
+#include "jobsystem.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// Games whose first search finds one side this far ahead are thrown away,
+// the random moves have decided them already
+static const int OPENING_MARGIN = 400;
+
+// A side this far ahead for this many plies in a row wins
+static const int RESIGN_SCORE = 1000;
+static const int RESIGN_PLIES = 8;
+
+// A game this close to even for this many plies in a row, after
+// DRAW_START plies, is drawn
+static const int DRAW_SCORE = 10;
+static const int DRAW_PLIES = 16;
+static const int DRAW_START = 80;
+
+// Keys of the filter are looked for in buckets this long
+static const int FILTER_BUCKET = 4;
+
+// Games between progress reports
+static const int PROGRESS_GAMES = 100;
+
+SelfPlay::SelfPlay() :
+	m_target(1000000),
+	m_nodes(5000),
+	m_random_plies(8),
+	m_threads(0),
+	m_max_plies(400),
+	m_filter_mb(64),
+	m_seen_mask(0),
+	m_written(0),
+	m_games(0),
+	m_duplicates(0)
+{
+}
+
+void SelfPlay::run(PackedPositionWriter & writer)
+{
+	Board::init();
+
+	// The filter is a power of two of buckets, 0 marks an empty slot
+	m_seen.reset();
+	m_seen_mask = 0;
+	if(m_filter_mb > 0) {
+		size_t slots = 1;
+		while(slots * 2 * sizeof(unsigned long long) <= (size_t)m_filter_mb << 20) {
+			slots *= 2;
+		}
+		m_seen.reset(new atomic<unsigned long long>[slots]);
+		for(size_t i = 0; i < slots; i++) {
+			m_seen[i].store(0, memory_order_relaxed);
+		}
+		m_seen_mask = (slots - 1) & ~(size_t)(FILTER_BUCKET - 1);
+	}
+
+	if(m_threads > 0) {
+		JobSystem::setThreadCount(m_threads);
+	}
+	JobSystem * jobs = JobSystem::getInstance();
+	int threads = jobs->getThreadCount();
+
+	m_start = chrono::steady_clock::now();
+	vector<JobHandle<void> > workers;
+	for(int i = 0; i < threads; i++) {
+		workers.push_back(jobs->submit(JobSystem::SEARCH, [this, &writer]() { worker(&writer); }));
+	}
+	for(int i = 0; i < threads; i++) {
+		workers[i].wait();
+	}
+}
+
+void SelfPlay::worker(PackedPositionWriter * writer)
+{
+	BrutalPlayer player;
+	SearchLimits limits;
+	limits.nodes = m_nodes;
+	player.setLimits(limits);
+
+	mt19937 random(random_device{}());
+	vector<Record> records;
+	while(m_written < m_target) {
+		if(playGame(player, random, records)) {
+			finishGame(*writer, records);
+		}
+	}
+}
+
+bool SelfPlay::playGame(BrutalPlayer & player, mt19937 & random, vector<Record> & records)
+{
+	records.clear();
+	ChessGameState state;
+
+	// Any legal move, promotions to a queen
+	for(int ply = 0; ply < m_random_plies; ply++) {
+		const unsigned long long * legal = state.getLegalMap();
+		vector<BoardMove> moves;
+		for(int i = 0; i < 64; i++) {
+			for(unsigned long long bits = legal[i]; bits; bits &= bits - 1) {
+				BoardPosition from(i);
+				BoardMove move(from, BoardPosition(__builtin_ctzll(bits)),
+					state.getBoard().getPiece(from));
+				if(move.needPromotion()) {
+					move.setPromotion(Piece::QUEEN);
+				}
+				moves.push_back(move);
+			}
+		}
+		state.update(moves[random() % moves.size()]);
+		if(state.isGameOver()) {
+			return false;
+		}
+	}
+
+	int score = 0;
+	bool scored = false;
+	player.setInfoCallback([&score, &scored](const SearchInfo & info) {
+		score = info.score;
+		scored = true;
+	});
+
+	int result = 1;
+	int resign = 0, draw = 0;
+	for(int ply = m_random_plies; ; ply++) {
+		if(state.getStatus() == ChessGameState::CHECKMATE) {
+			result = state.isWhiteTurn() ? 0 : 2;
+			break;
+		}
+		if(state.isDraw() || ply >= m_max_plies) {
+			break;
+		}
+
+		Piece::Color turn = state.getTurn();
+		scored = false;
+		player.setIsWhite(turn == Piece::WHITE);
+		player.think(state);
+		BoardMove move = player.getMove();
+		if(move.isValid() && move.needPromotion()) {
+			move.setPromotion(Piece::QUEEN);
+		}
+		if(!state.isMoveLegal(move)) {
+			return false;
+		}
+
+		// A search stopped before its first iteration has no score, the
+		// move is played but the position isn't kept
+		int white = (turn == Piece::WHITE) ? score : -score;
+		if(!scored) {
+			white = 0;
+		} else if(ply == m_random_plies && abs(white) > OPENING_MARGIN) {
+			return false;
+		}
+		if(scored && !state.isCheck()) {
+			Record record;
+			record.position.pack(state.getBoard(), turn, state.getHalfmoveClock(),
+				state.getTurnNumber(), white, move, 1);
+			record.key = state.getKey();
+			records.push_back(record);
+		}
+
+		// The same side has to stay ahead for a resignation
+		if(abs(white) >= RESIGN_SCORE && (resign == 0 || (resign > 0) == (white > 0))) {
+			resign += (white > 0) ? 1 : -1;
+		} else {
+			resign = 0;
+		}
+		if(abs(resign) >= RESIGN_PLIES) {
+			result = (resign > 0) ? 2 : 0;
+			break;
+		}
+		draw = (ply >= DRAW_START && abs(white) <= DRAW_SCORE) ? draw + 1 : 0;
+		if(draw >= DRAW_PLIES) {
+			break;
+		}
+
+		state.update(move);
+	}
+
+	for(int i = 0; i < (int)records.size(); i++) {
+		records[i].position.result = (uint8_t)result;
+	}
+	return true;
+}
+
+void SelfPlay::finishGame(PackedPositionWriter & writer, vector<Record> & records)
+{
+	// Duplicates are dropped before taking the lock
+	int kept = 0, duplicates = 0;
+	for(int i = 0; i < (int)records.size(); i++) {
+		if(isNew(records[i].key)) {
+			records[kept++] = records[i];
+		} else {
+			duplicates++;
+		}
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	for(int i = 0; i < kept && m_written < m_target; i++) {
+		writer.add(records[i].position);
+		m_written++;
+	}
+	m_duplicates += duplicates;
+	m_games++;
+	if(m_games % PROGRESS_GAMES == 0) {
+		printProgress();
+	}
+}
+
+bool SelfPlay::isNew(unsigned long long key)
+{
+	if(!m_seen) {
+		return true;
+	}
+	key = key ? key : 1;
+	size_t bucket = (size_t)key & m_seen_mask;
+	for(int i = 0; i < FILTER_BUCKET; i++) {
+		unsigned long long slot = m_seen[bucket + i].load(memory_order_relaxed);
+		if(slot == key) {
+			return false;
+		}
+		if(!slot && m_seen[bucket + i].compare_exchange_strong(slot, key, memory_order_relaxed)) {
+			return true;
+		}
+		if(slot == key) {
+			return false;
+		}
+	}
+
+	// A full bucket forgets one of its keys, picked by the new one
+	m_seen[bucket + (key >> 60) % FILTER_BUCKET].store(key, memory_order_relaxed);
+	return true;
+}
+
+void SelfPlay::printProgress() const
+{
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - m_start).count();
+	char line[128];
+	snprintf(line, sizeof(line), "Games %lld, positions %lld, duplicates %lld, %.0f positions/s",
+		m_games, (long long)m_written, m_duplicates, m_written / max(seconds, 0.001));
+	cout << line << endl;
+}
+
+// End of file selfplay.cpp
@@ -0,0 +1,123 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : selfplay.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef SELFPLAY_H
+#define SELFPLAY_H
+
+#include "chessgamestate.h"
+#include "chessplayer.h"
+#include "packedposition.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+/**
+ * Plays the BrutalPlayer against itself on all cores to make training
+ * data. Every game starts with a few random moves, and each move after
+ * that is searched to a fixed number of nodes. The positions are written
+ * with the score of their search and the result of the game once it is
+ * over, so a writer only ever sees finished games.
+ *
+ * Games are decided by ChessGameState, or adjudicated once the score has
+ * stayed decisive, or close to even late in the game, for a few moves.
+ * Positions in check are left out, as are those seen before: their keys
+ * are kept in a table shared by all threads, which forgets old keys when
+ * it is full.
+ */
+class SelfPlay {
+ public:
+	SelfPlay();
+
+	/** Sets the number of positions to write, a million by default. */
+	void setPositions(long long positions)
+		{ m_target = positions; }
+
+	/** Sets the nodes searched for every move, 5000 by default. */
+	void setNodes(long long nodes)
+		{ m_nodes = nodes; }
+
+	/** Sets the random moves every game starts with, 8 by default. */
+	void setRandomPlies(int plies)
+		{ m_random_plies = plies; }
+
+	/** Sets how many games are played at once, every core by default. */
+	void setThreads(int threads)
+		{ m_threads = threads; }
+
+	/** Sets the length, in plies, after which a game is called a draw. */
+	void setMaxPlies(int plies)
+		{ m_max_plies = plies; }
+
+	/**
+	 * Sets the megabytes of the table of positions seen, 64 by default, 0
+	 * to keep duplicates.
+	 */
+	void setFilterSize(int megabytes)
+		{ m_filter_mb = megabytes; }
+
+	/** Plays games until enough positions have been written. */
+	void run(PackedPositionWriter & writer);
+
+	long long getGames() const
+		{ return m_games; }
+
+	long long getPositions() const
+		{ return m_written; }
+
+	/** Returns the positions left out because they were seen before. */
+	long long getDuplicates() const
+		{ return m_duplicates; }
+
+ private:
+	SelfPlay(const SelfPlay &);
+	SelfPlay & operator=(const SelfPlay &);
+
+	// A position of a game being played, with its key for the filter
+	struct Record {
+		PackedPosition position;
+		unsigned long long key;
+	};
+
+	void worker(PackedPositionWriter * writer);
+
+	// Plays a game into records, false if it is thrown away for an
+	// opening that is already decided
+	bool playGame(BrutalPlayer & player, std::mt19937 & random, std::vector<Record> & records);
+
+	// Writes the records of a finished game that weren't seen before
+	void finishGame(PackedPositionWriter & writer, std::vector<Record> & records);
+
+	// Returns true if key is new, and remembers it
+	bool isNew(unsigned long long key);
+
+	void printProgress() const;
+
+	long long m_target;
+	long long m_nodes;
+	int m_random_plies;
+	int m_threads;
+	int m_max_plies;
+	int m_filter_mb;
+
+	std::unique_ptr<std::atomic<unsigned long long>[]> m_seen;
+	size_t m_seen_mask;
+
+	std::chrono::steady_clock::time_point m_start;
+	std::mutex m_mutex;
+	std::atomic<long long> m_written;
+	long long m_games;
+	long long m_duplicates;
+};
+
+#endif // SELFPLAY_H
+
+// End of file selfplay.h
@@ -0,0 +1,131 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : selfplayrunner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "jobsystem.h"
+#include "logger.h"
+#include "packedposition.h"
+#include "selfplay.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void printUsage()
+{
+	cerr << "Usage: chesspizza-selfplay [options] FILE\n\n";
+	cerr << "Plays the brutal player against itself from random openings and writes\n";
+	cerr << "the positions, with the score of their search and the result of the\n";
+	cerr << "game, to FILE in 32 bytes each. chesspizza-tune reads the file.\n\n";
+	cerr << "Options:\n";
+	cerr << " -n N  --positions=N\t\t Positions to write, a million by default.\n";
+	cerr << " --nodes=N\t\t\t Nodes searched for each move, 5000 by default.\n";
+	cerr << " --random=PLIES\t\t\t Random moves at the start of each game, 8 by default.\n";
+	cerr << " --maxplies=N\t\t\t Adjudicate a draw after N plies, 400 by default.\n";
+	cerr << " --filter=MB\t\t\t Size of the table of positions seen, 64 by default,\n";
+	cerr << "            \t\t\t 0 keeps duplicates.\n";
+	cerr << " -z  --compress\t\t\t Compress the file, to about 20 bytes a position.\n";
+	cerr << " -j N  --threads=N\t\t Games played at once, one per core by default,\n";
+	cerr << "            \t\t\t at least 2.\n";
+	cerr << LogOptions::usage();
+	cerr << " -h  --help\t\t\t Print this help screen.\n";
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+
+	string output;
+	LogOptions logoptions;
+	long long positions = 1000000, nodes = 5000;
+	int randomplies = 8, maxplies = 400, filter = 64, threads = 0;
+	bool compress = false;
+
+	for(int i = 0; i < (int)args.size(); i++) {
+		if(args[i] == "-h" || args[i] == "--help") {
+			printUsage();
+		} else if(args[i] == "-n" && i + 1 < (int)args.size()) {
+			positions = atoll(args[++i].c_str());
+		} else if(args[i].substr(0, 12) == "--positions=") {
+			positions = atoll(args[i].substr(12).c_str());
+		} else if(args[i].substr(0, 8) == "--nodes=") {
+			nodes = atoll(args[i].substr(8).c_str());
+		} else if(args[i].substr(0, 9) == "--random=") {
+			randomplies = atoi(args[i].substr(9).c_str());
+		} else if(args[i].substr(0, 11) == "--maxplies=") {
+			maxplies = atoi(args[i].substr(11).c_str());
+		} else if(args[i].substr(0, 9) == "--filter=") {
+			filter = atoi(args[i].substr(9).c_str());
+		} else if(args[i] == "-z" || args[i] == "--compress") {
+			compress = true;
+		} else if(args[i] == "-j" && i + 1 < (int)args.size()) {
+			threads = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 10) == "--threads=") {
+			threads = atoi(args[i].substr(10).c_str());
+		} else if(logoptions.parse(args[i])) {
+			// --log or --log-level
+		} else if(args[i][0] == '-' || !output.empty()) {
+			printUsage();
+		} else {
+			output = args[i];
+		}
+	}
+	if(output.empty() || positions <= 0 || nodes <= 0 || randomplies < 0 ||
+	   maxplies <= randomplies || filter < 0) {
+		printUsage();
+	}
+	if(!logoptions.apply()) {
+		return 1;
+	}
+
+	PackedPositionWriter writer;
+	if(!writer.open(output, compress)) {
+		cerr << "Couldn't create " << output << endl;
+		return 1;
+	}
+
+	JobSystem::setThreadCount(threads);
+	threads = JobSystem::getInstance()->getThreadCount();
+	cout << "Playing games of " << nodes << " nodes a move on " << threads << " threads" << endl;
+
+	SelfPlay selfplay;
+	selfplay.setPositions(positions);
+	selfplay.setNodes(nodes);
+	selfplay.setRandomPlies(randomplies);
+	selfplay.setMaxPlies(maxplies);
+	selfplay.setFilterSize(filter);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	selfplay.run(writer);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	int result = 0;
+	if(!writer.close()) {
+		cerr << "Couldn't write " << output << endl;
+		result = 1;
+	}
+
+	char line[160];
+	snprintf(line, sizeof(line), "Wrote %lld positions of %lld games to %s, %lld duplicates left out",
+		selfplay.getPositions(), selfplay.getGames(), output.c_str(), selfplay.getDuplicates());
+	cout << line << endl;
+	snprintf(line, sizeof(line), "%.1f bytes a position, %.0f positions/s, %.0f per thread, in %.1fs",
+		(double)writer.getSize() / max(selfplay.getPositions(), 1LL),
+		selfplay.getPositions() / seconds, selfplay.getPositions() / seconds / threads, seconds);
+	cout << line << endl;
+
+	JobSystem::destroy();
+	Logger::destroy();
+	return result;
+}
+
+// End of file selfplayrunner.cpp
@@ -0,0 +1,583 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : tablebase.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "tablebase.h"
+#include "board.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+static const char TABLE_MAGIC[8] = { 'C', 'P', 'E', 'N', 'D', 'G', 'T', 'B' };
+static const uint32_t VERSION = 1;
+
+// Pieces other than the king, strongest first, with their letters and
+// rough values for telling the stronger side
+static const Piece::Type ORDER[5] = {
+	Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT, Piece::PAWN
+};
+static const char LETTERS[5] = { 'Q', 'R', 'B', 'N', 'P' };
+static const int VALUES[5] = { 9, 5, 3, 3, 1 };
+
+// Squares the white king is mirrored into: a1-d1-d4 without pawns, the
+// files a to d with them
+static const int PAWNLESS_KINGS = 10;
+static const int PAWN_KINGS = 32;
+
+struct TableHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t pieces;
+	char name[16];
+	uint64_t positions;
+	// Each block starts at an offset from the data, one more marks the end
+	uint64_t blocks;
+};
+
+// Which of the squares a1-d1-d4 a king is on, -1 for the others
+static int s_king_slot[64];
+static int s_slot_king[PAWNLESS_KINGS];
+
+static void initKingSlots()
+{
+	static once_flag s_once;
+	call_once(s_once, []() {
+		int slot = 0;
+		for(int sq = 0; sq < 64; sq++) {
+			int file = sq & 7, rank = sq >> 3;
+			if(file < 4 && rank <= file) {
+				s_slot_king[slot] = sq;
+				s_king_slot[sq] = slot++;
+			} else {
+				s_king_slot[sq] = -1;
+			}
+		}
+	});
+}
+
+// Returns the position of type in ORDER, -1 for the king
+static int orderOf(Piece::Type type)
+{
+	for(int i = 0; i < 5; i++) {
+		if(ORDER[i] == type) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Compares the pieces of two sides, counted in the order of ORDER: more
+// pieces is stronger, then more value, then stronger pieces
+static int compareSides(const int * a, const int * b)
+{
+	int counta = 0, countb = 0, valuea = 0, valueb = 0;
+	for(int i = 0; i < 5; i++) {
+		counta += a[i];
+		countb += b[i];
+		valuea += a[i] * VALUES[i];
+		valueb += b[i] * VALUES[i];
+	}
+	if(counta != countb) {
+		return counta - countb;
+	}
+	if(valuea != valueb) {
+		return valuea - valueb;
+	}
+	for(int i = 0; i < 5; i++) {
+		if(a[i] != b[i]) {
+			return a[i] - b[i];
+		}
+	}
+	return 0;
+}
+
+// Returns the table code of the pieces of the stronger and weaker side
+static int materialCode(const int * strong, const int * weak)
+{
+	int code = 0;
+	for(int i = 0; i < 5; i++) {
+		code |= strong[i] << (3 * i);
+		code |= weak[i] << (3 * (i + 5));
+	}
+	return code;
+}
+
+// Sets material to the pieces of two sides, the stronger one as white
+static void setMaterial(TablebaseMaterial & material, const int * white, const int * black)
+{
+	if(compareSides(white, black) < 0) {
+		swap(white, black);
+	}
+	material.count = 0;
+	material.colors[material.count] = Piece::WHITE;
+	material.types[material.count++] = Piece::KING;
+	material.colors[material.count] = Piece::BLACK;
+	material.types[material.count++] = Piece::KING;
+	for(int side = 0; side < 2; side++) {
+		const int * counts = side ? black : white;
+		for(int i = 0; i < 5; i++) {
+			for(int j = 0; j < counts[i]; j++) {
+				material.colors[material.count] = side ? Piece::BLACK : Piece::WHITE;
+				material.types[material.count++] = ORDER[i];
+			}
+		}
+	}
+}
+
+bool TablebaseMaterial::parse(const string & name)
+{
+	size_t split = name.find('v');
+	if(split == string::npos) {
+		return false;
+	}
+
+	int counts[2][5] = { { 0 } };
+	int total = 0;
+	for(int side = 0; side < 2; side++) {
+		string pieces = side ? name.substr(split + 1) : name.substr(0, split);
+		if(pieces.empty() || pieces[0] != 'K') {
+			return false;
+		}
+		for(size_t i = 1; i < pieces.size(); i++) {
+			const char * letter = (const char *)memchr(LETTERS, pieces[i], 5);
+			if(!letter) {
+				return false;
+			}
+			counts[side][letter - LETTERS]++;
+		}
+		total += (int)pieces.size();
+	}
+	if(total > MAX_PIECES) {
+		return false;
+	}
+	setMaterial(*this, counts[0], counts[1]);
+	return true;
+}
+
+string TablebaseMaterial::getName() const
+{
+	string name = "K";
+	for(int i = 2; i < count; i++) {
+		if(colors[i] == Piece::BLACK && colors[i - 1] != Piece::BLACK) {
+			name += "vK";
+		}
+		name += LETTERS[orderOf(types[i])];
+	}
+	if(count < 3 || colors[count - 1] == Piece::WHITE) {
+		name += "vK";
+	}
+	return name;
+}
+
+bool TablebaseMaterial::hasPawns() const
+{
+	for(int i = 0; i < count; i++) {
+		if(types[i] == Piece::PAWN) {
+			return true;
+		}
+	}
+	return false;
+}
+
+long long TablebaseMaterial::getSize() const
+{
+	long long size = 2 * (hasPawns() ? PAWN_KINGS : PAWNLESS_KINGS);
+	for(int i = 1; i < count; i++) {
+		size *= 64;
+	}
+	return size;
+}
+
+long long TablebaseMaterial::getIndex(int * squares, Piece::Color turn) const
+{
+	initKingSlots();
+	bool pawns = hasPawns();
+
+	// Mirrored left to right, and without pawns also top to bottom and
+	// along the diagonal
+	int flip = 0;
+	if((squares[0] & 7) > 3) {
+		flip |= 7;
+	}
+	if(!pawns && (squares[0] >> 3) > 3) {
+		flip |= 56;
+	}
+	for(int i = 0; i < count; i++) {
+		squares[i] ^= flip;
+	}
+	if(!pawns && (squares[0] >> 3) >= (squares[0] & 7)) {
+		// With the king on the diagonal either side of it will do, the
+		// one with the lower squares is taken so that a position has one
+		// index only, which the generator relies on
+		int flipped[MAX_PIECES];
+		for(int i = 0; i < count; i++) {
+			flipped[i] = ((squares[i] & 7) << 3) | (squares[i] >> 3);
+		}
+		int i = 1;
+		while(i < count && flipped[i] == squares[i]) {
+			i++;
+		}
+		if((squares[0] >> 3) > (squares[0] & 7) || (i < count && flipped[i] < squares[i])) {
+			for(i = 0; i < count; i++) {
+				squares[i] = flipped[i];
+			}
+		}
+	}
+
+	long long index = (turn == Piece::WHITE) ? 0 : 1;
+	if(pawns) {
+		index = index * PAWN_KINGS + (squares[0] >> 3) * 4 + (squares[0] & 7);
+	} else {
+		index = index * PAWNLESS_KINGS + s_king_slot[squares[0]];
+	}
+	for(int i = 1; i < count; i++) {
+		index = index * 64 + squares[i];
+	}
+	return index;
+}
+
+void TablebaseMaterial::getSquares(long long index, int * squares, Piece::Color & turn) const
+{
+	initKingSlots();
+	for(int i = count - 1; i > 0; i--) {
+		squares[i] = (int)(index % 64);
+		index /= 64;
+	}
+	if(hasPawns()) {
+		int slot = (int)(index % PAWN_KINGS);
+		squares[0] = (slot / 4) * 8 + slot % 4;
+		index /= PAWN_KINGS;
+	} else {
+		squares[0] = s_slot_king[index % PAWNLESS_KINGS];
+		index /= PAWNLESS_KINGS;
+	}
+	turn = index ? Piece::BLACK : Piece::WHITE;
+}
+
+int TablebaseMaterial::getCode() const
+{
+	int counts[2][5] = { { 0 } };
+	for(int i = 2; i < count; i++) {
+		counts[colors[i] == Piece::WHITE ? 0 : 1][orderOf(types[i])]++;
+	}
+	return materialCode(counts[0], counts[1]);
+}
+
+vector<TablebaseMaterial> TablebaseMaterial::list(int pieces)
+{
+	vector<TablebaseMaterial> materials;
+	for(int total = 1; total <= pieces - 2; total++) {
+		// Every count of the ten kinds of pieces, two bits each, that adds
+		// up, with the stronger side white
+		int counts[2][5];
+		for(int code = 0; code < (1 << 20); code++) {
+			int sum = 0;
+			for(int i = 0; i < 10; i++) {
+				counts[i / 5][i % 5] = (code >> (2 * i)) & 3;
+				sum += counts[i / 5][i % 5];
+			}
+			if(sum == total && compareSides(counts[0], counts[1]) >= 0) {
+				TablebaseMaterial material;
+				setMaterial(material, counts[0], counts[1]);
+				materials.push_back(material);
+			}
+		}
+	}
+	return materials;
+}
+
+string Tablebase::getFilename(const string & dir, const TablebaseMaterial & material)
+{
+	string filename = dir;
+	if(!filename.empty() && filename[filename.size() - 1] != '/') {
+		filename += '/';
+	}
+	return filename + material.getName() + ".cptb";
+}
+
+// Appends the values of a block, runs of three or more as a count and the
+// value, the rest as a count and the values
+static void compressBlock(const unsigned char * values, int size, vector<unsigned char> & out)
+{
+	int i = 0;
+	while(i < size) {
+		int run = 1;
+		while(i + run < size && run < 130 && values[i + run] == values[i]) {
+			run++;
+		}
+		if(run >= 3) {
+			out.push_back((unsigned char)(128 + run - 3));
+			out.push_back(values[i]);
+			i += run;
+			continue;
+		}
+
+		// Values up to the next run
+		int literal = 0;
+		while(i + literal < size && literal < 128) {
+			if(i + literal + 2 < size && values[i + literal] == values[i + literal + 1] &&
+					values[i + literal] == values[i + literal + 2]) {
+				break;
+			}
+			literal++;
+		}
+		out.push_back((unsigned char)(literal - 1));
+		out.insert(out.end(), values + i, values + i + literal);
+		i += literal;
+	}
+}
+
+bool Tablebase::write(const string & filename, const TablebaseMaterial & material,
+	const unsigned char * values)
+{
+	long long size = material.getSize();
+	long long blocks = (size + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES;
+	vector<unsigned long long> offsets;
+	vector<unsigned char> data;
+	for(long long block = 0; block < blocks; block++) {
+		offsets.push_back(data.size());
+		long long first = block * BLOCK_ENTRIES;
+		compressBlock(values + first, (int)min((long long)BLOCK_ENTRIES, size - first), data);
+	}
+	offsets.push_back(data.size());
+
+	TableHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TABLE_MAGIC, sizeof(header.magic));
+	header.version = VERSION;
+	header.pieces = material.count;
+	string name = material.getName();
+	memcpy(header.name, name.c_str(), min(name.size(), sizeof(header.name) - 1));
+	header.positions = size;
+	header.blocks = blocks;
+
+	FILE * file = fopen(filename.c_str(), "wb");
+	if(!file) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(offsets.data(), sizeof(unsigned long long), offsets.size(), file) == offsets.size();
+	ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+	ok = (fclose(file) == 0) && ok;
+	if(!ok) {
+		remove(filename.c_str());
+	}
+	return ok;
+}
+
+bool Tablebase::open(const string & filename)
+{
+	close();
+	if(!m_file.open(filename) || m_file.getSize() < sizeof(TableHeader)) {
+		close();
+		return false;
+	}
+
+	const TableHeader * header = (const TableHeader *)m_file.getData();
+	string name(header->name, strnlen(header->name, sizeof(header->name)));
+	if(memcmp(header->magic, TABLE_MAGIC, 8) || header->version != VERSION ||
+			!m_material.parse(name) || m_material.getName() != name ||
+			(unsigned long long)m_material.getSize() != header->positions ||
+			header->blocks != (header->positions + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES) {
+		close();
+		return false;
+	}
+
+	size_t data = sizeof(TableHeader) + (header->blocks + 1) * sizeof(unsigned long long);
+	m_offsets = (const unsigned long long *)(m_file.getData() + sizeof(TableHeader));
+	if(data > m_file.getSize() || m_offsets[header->blocks] != m_file.getSize() - data) {
+		close();
+		return false;
+	}
+	m_data = (const unsigned char *)m_file.getData() + data;
+	m_blocks = header->blocks;
+	return true;
+}
+
+void Tablebase::close()
+{
+	m_file.close();
+	m_material = TablebaseMaterial();
+	m_offsets = 0;
+	m_data = 0;
+	m_blocks = 0;
+}
+
+int Tablebase::getValue(long long index) const
+{
+	long long block = index / BLOCK_ENTRIES;
+	int skip = (int)(index % BLOCK_ENTRIES);
+	const unsigned char * data = m_data + m_offsets[block];
+	const unsigned char * end = m_data + m_offsets[block + 1];
+	while(data < end) {
+		int control = *data++;
+		if(control >= 128) {
+			int run = control - 128 + 3;
+			if(skip < run) {
+				return *data;
+			}
+			skip -= run;
+			data++;
+		} else {
+			int literal = control + 1;
+			if(skip < literal) {
+				return data[skip];
+			}
+			skip -= literal;
+			data += literal;
+		}
+	}
+	return 0;
+}
+
+shared_ptr<const Tablebases> Tablebases::load(const string & dir)
+{
+	static mutex s_mutex;
+	static map<string, weak_ptr<const Tablebases> > s_tablebases;
+
+	lock_guard<mutex> lock(s_mutex);
+	shared_ptr<const Tablebases> tablebases = s_tablebases[dir].lock();
+	if(!tablebases) {
+		shared_ptr<Tablebases> opened(new Tablebases);
+		if(!opened->open(dir)) {
+			return shared_ptr<const Tablebases>();
+		}
+		tablebases = opened;
+		s_tablebases[dir] = tablebases;
+	}
+	return tablebases;
+}
+
+int Tablebases::open(const string & dir)
+{
+	close();
+	vector<TablebaseMaterial> materials = TablebaseMaterial::list(TablebaseMaterial::MAX_PIECES);
+	for(int i = 0; i < (int)materials.size(); i++) {
+		unique_ptr<Tablebase> table(new Tablebase);
+		if(table->open(Tablebase::getFilename(dir, materials[i]))) {
+			addTable(move(table));
+		}
+	}
+	return getTableCount();
+}
+
+void Tablebases::close()
+{
+	m_tables.clear();
+	m_max_pieces = 0;
+}
+
+void Tablebases::addTable(unique_ptr<Tablebase> table)
+{
+	const TablebaseMaterial & material = table->getMaterial();
+	m_max_pieces = max(m_max_pieces, material.count);
+	m_tables[material.getCode()] = move(table);
+}
+
+bool Tablebases::probe(const Board & board, Piece::Color turn, TablebaseResult & result) const
+{
+	if(board.canCastle(Piece::WHITE, true) || board.canCastle(Piece::WHITE, false) ||
+			board.canCastle(Piece::BLACK, true) || board.canCastle(Piece::BLACK, false)) {
+		return false;
+	}
+
+	Piece::Color colors[TablebaseMaterial::MAX_PIECES];
+	Piece::Type types[TablebaseMaterial::MAX_PIECES];
+	int squares[TablebaseMaterial::MAX_PIECES];
+	int count = 0;
+	for(int c = 0; c <= Piece::LAST_COLOR; c++) {
+		for(int t = 0; t <= Piece::LAST_TYPE; t++) {
+			unsigned long long bits = board.getPieces((Piece::Color)c, (Piece::Type)t).getBoard();
+			for(int sq = 0; bits; sq++, bits >>= 1) {
+				if(!(bits & 1)) {
+					continue;
+				}
+				if(count == m_max_pieces) {
+					return false;
+				}
+				colors[count] = (Piece::Color)c;
+				types[count] = (Piece::Type)t;
+				squares[count++] = sq;
+			}
+		}
+	}
+
+	// Tables know nothing of en passant, a position where a pawn can
+	// take that way isn't in them
+	unsigned long long pawns = board.getPieces(turn, Piece::PAWN).getBoard();
+	for(int sq = 0; pawns; sq++, pawns >>= 1) {
+		unsigned long long targets = (pawns & 1) ? Board::pawnAttacks[turn][sq] : 0;
+		for(int target = 0; targets; target++, targets >>= 1) {
+			if((targets & 1) && board.isEnPassantSet(BoardPosition(target))) {
+				return false;
+			}
+		}
+	}
+	return probe(count, colors, types, squares, turn, result);
+}
+
+bool Tablebases::probe(int count, const Piece::Color * colors, const Piece::Type * types,
+	const int * squares, Piece::Color turn, TablebaseResult & result) const
+{
+	int counts[2][5] = { { 0 } };
+	int kings[2] = { 0, 0 };
+	for(int i = 0; i < count; i++) {
+		int side = (colors[i] == Piece::WHITE) ? 0 : 1;
+		if(types[i] == Piece::KING) {
+			kings[side]++;
+		} else {
+			counts[side][orderOf(types[i])]++;
+		}
+	}
+	if(kings[0] != 1 || kings[1] != 1) {
+		return false;
+	}
+	if(count == 2) {
+		result = TablebaseResult();
+		return true;
+	}
+
+	// Looked up with the colors swapped when black is stronger
+	bool swapped = compareSides(counts[0], counts[1]) < 0;
+	int code = swapped ? materialCode(counts[1], counts[0]) : materialCode(counts[0], counts[1]);
+	map<int, unique_ptr<Tablebase> >::const_iterator it = m_tables.find(code);
+	if(it == m_tables.end()) {
+		return false;
+	}
+	const Tablebase & table = *it->second;
+	const TablebaseMaterial & material = table.getMaterial();
+
+	// The squares in the order of the table
+	int ordered[TablebaseMaterial::MAX_PIECES];
+	bool used[TablebaseMaterial::MAX_PIECES] = { false };
+	for(int i = 0; i < material.count; i++) {
+		for(int j = 0; j < count; j++) {
+			Piece::Color color = swapped ? Piece::opposite(colors[j]) : colors[j];
+			if(!used[j] && color == material.colors[i] && types[j] == material.types[i]) {
+				ordered[i] = swapped ? (squares[j] ^ 56) : squares[j];
+				used[j] = true;
+				break;
+			}
+		}
+	}
+
+	int value = table.getValue(material.getIndex(ordered, swapped ? Piece::opposite(turn) : turn));
+	if(value == 0) {
+		result = TablebaseResult();
+	} else {
+		result.dtm = value - 1;
+		result.wdl = (result.dtm % 2) ? TablebaseResult::WIN : TablebaseResult::LOSS;
+	}
+	return true;
+}
+
+// End of file tablebase.cpp
@@ -0,0 +1,204 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : tablebase.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "mappedfile.h"
+#include "piece.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Board;
+
+/**
+ * What a tablebase knows of a position, for the side to move.
+ */
+struct TablebaseResult {
+	enum Wdl { LOSS = -1, DRAW = 0, WIN = 1 };
+
+	TablebaseResult() :
+		wdl(DRAW),
+		dtm(0) {}
+
+	Wdl wdl;
+	/** Plies to mate with best play, 0 for draws and for mate itself. */
+	int dtm;
+};
+
+/**
+ * The pieces of a tablebase, named like KQvKR. The stronger side is
+ * always white, a position with the stronger side black is looked up
+ * with the colors swapped and the board turned around.
+ *
+ * Pieces are listed white king, black king, the other white pieces and
+ * the other black pieces, queens first and pawns last.
+ */
+struct TablebaseMaterial {
+	/** Most pieces a tablebase may have, the kings included. */
+	static const int MAX_PIECES = 5;
+
+	TablebaseMaterial() :
+		count(0) {}
+
+	/**
+	 * Reads a material name. The sides may be in either order, the
+	 * stronger one becomes white. Returns false if it isn't one.
+	 */
+	bool parse(const std::string & name);
+
+	/** Returns the name, the stronger side first. */
+	std::string getName() const;
+
+	bool hasPawns() const;
+
+	/** Number of positions, invalid ones included, both sides to move. */
+	long long getSize() const;
+
+	/**
+	 * Returns the position of pieces on squares with turn to move. The
+	 * board is mirrored so that the white king lies in the part of the
+	 * board the table covers, squares is changed to match.
+	 * @param squares - A square for every piece, by BoardPosition::hash().
+	 */
+	long long getIndex(int * squares, Piece::Color turn) const;
+
+	/** Reverses getIndex, returns the squares and side to move of index. */
+	void getSquares(long long index, int * squares, Piece::Color & turn) const;
+
+	/**
+	 * Returns a number that is the same for every table with the same
+	 * pieces, whichever side has them.
+	 */
+	int getCode() const;
+
+	/**
+	 * Returns every material of three to pieces pieces that has a
+	 * table, fewest pieces first.
+	 */
+	static std::vector<TablebaseMaterial> list(int pieces);
+
+	int count;
+	Piece::Color colors[MAX_PIECES];
+	Piece::Type types[MAX_PIECES];
+};
+
+/**
+ * One tablebase file, read through a MappedFile. The distance to mate of
+ * every position is kept in a byte, the positions in blocks compressed
+ * with run lengths. Looking a position up decodes a part of one block.
+ *
+ * Many threads may read one Tablebase at once.
+ */
+class Tablebase {
+ public:
+	Tablebase() :
+		m_offsets(0),
+		m_data(0),
+		m_blocks(0) {}
+
+	/** Positions of a compressed block. */
+	static const int BLOCK_ENTRIES = 4096;
+
+	/** Returns the file name of the table of material in dir. */
+	static std::string getFilename(const std::string & dir, const TablebaseMaterial & material);
+
+	/**
+	 * Writes a table. Values are 0 for draws and invalid positions, else
+	 * the plies to mate plus one: odd for the side to move losing, even
+	 * for it winning. Returns false if the file can't be written.
+	 */
+	static bool write(const std::string & filename, const TablebaseMaterial & material,
+		const unsigned char * values);
+
+	/** Opens a table, returns false if it can't be read. */
+	bool open(const std::string & filename);
+
+	void close();
+
+	bool isOpen() const
+		{ return m_file.isOpen(); }
+
+	const TablebaseMaterial & getMaterial() const
+		{ return m_material; }
+
+	/** Returns the value written for the position index. */
+	int getValue(long long index) const;
+
+ private:
+	Tablebase(const Tablebase &);
+	Tablebase & operator=(const Tablebase &);
+
+	MappedFile m_file;
+	TablebaseMaterial m_material;
+	const unsigned long long * m_offsets;
+	const unsigned char * m_data;
+	long long m_blocks;
+};
+
+/**
+ * The tablebases of a directory, for finding the perfect move in simple
+ * endings. Positions with castling rights or an en passant capture are
+ * never found, and the fifty move rule is not taken into account.
+ *
+ * Needs Board::init() to have been called. Many threads may probe one
+ * Tablebases at once.
+ */
+class Tablebases {
+ public:
+	Tablebases() :
+		m_max_pieces(0) {}
+
+	/**
+	 * Returns the tablebases of dir, opened once and shared by everyone
+	 * asking for them while they are in use. Null if dir has none.
+	 */
+	static std::shared_ptr<const Tablebases> load(const std::string & dir);
+
+	/** Opens the tables in dir, returns the number found. */
+	int open(const std::string & dir);
+
+	void close();
+
+	int getTableCount() const
+		{ return (int)m_tables.size(); }
+
+	/** Returns the most pieces of a table, the kings included. */
+	int getMaxPieces() const
+		{ return m_max_pieces; }
+
+	/**
+	 * Looks up the position of board with turn to move. Returns false if
+	 * there is no table for it.
+	 */
+	bool probe(const Board & board, Piece::Color turn, TablebaseResult & result) const;
+
+	/**
+	 * Same as above for count pieces on squares, listed in any order.
+	 * Only kings is a draw even without a table.
+	 */
+	bool probe(int count, const Piece::Color * colors, const Piece::Type * types,
+		const int * squares, Piece::Color turn, TablebaseResult & result) const;
+
+	/** Adds an opened table, for the generator. */
+	void addTable(std::unique_ptr<Tablebase> table);
+
+ private:
+	Tablebases(const Tablebases &);
+	Tablebases & operator=(const Tablebases &);
+
+	std::map<int, std::unique_ptr<Tablebase> > m_tables;
+	int m_max_pieces;
+};
+
+#endif // TABLEBASE_H
+
+// End of file tablebase.h
@@ -0,0 +1,648 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : tablebasegenerator.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "tablebasegenerator.h"
+#include "board.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "tablebase.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+static const int MAX_PIECES = TablebaseMaterial::MAX_PIECES;
+
+// Values are the plies to mate plus one, up to MAX_VALUE. INVALID marks
+// the positions that can't occur among the pending values.
+static const int MAX_VALUE = 254;
+static const int INVALID = 255;
+
+// Fewest positions a job goes through at once
+static const long long MIN_CHUNK = 1 << 16;
+
+// Steps of the sliding pieces, file then rank
+static const int ROOK_STEPS[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+static const int BISHOP_STEPS[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+static const Piece::Type PROMOTIONS[4] = {
+	Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT
+};
+
+static unsigned long long bit(int sq)
+{
+	return 1ULL << sq;
+}
+
+// Returns the squares a slider on sq reaches, each line up to the first
+// occupied square
+static unsigned long long slide(int sq, unsigned long long occupied, const int steps[4][2])
+{
+	unsigned long long reached = 0;
+	for(int i = 0; i < 4; i++) {
+		int file = (sq & 7) + steps[i][0], rank = (sq >> 3) + steps[i][1];
+		for(; file >= 0 && file < 8 && rank >= 0 && rank < 8; file += steps[i][0], rank += steps[i][1]) {
+			reached |= bit(rank * 8 + file);
+			if(occupied & bit(rank * 8 + file)) {
+				break;
+			}
+		}
+	}
+	return reached;
+}
+
+// Returns the squares a piece attacks
+static unsigned long long attacks(Piece::Type type, Piece::Color color, int sq,
+	unsigned long long occupied)
+{
+	switch(type) {
+		case Piece::PAWN:
+			return Board::pawnAttacks[color][sq];
+		case Piece::KNIGHT:
+			return Board::knightAttacks[sq];
+		case Piece::BISHOP:
+			return slide(sq, occupied, BISHOP_STEPS);
+		case Piece::ROOK:
+			return slide(sq, occupied, ROOK_STEPS);
+		case Piece::QUEEN:
+			return slide(sq, occupied, BISHOP_STEPS) | slide(sq, occupied, ROOK_STEPS);
+		case Piece::KING:
+			return Board::kingAttacks[sq];
+		default:
+			return 0;
+	}
+}
+
+// The value of a move for the side making it, out of the value of the
+// position it leads to for the other side
+static int backValue(int value)
+{
+	return value ? value + 1 : 0;
+}
+
+// Returns true if a value is a loss for the side to move
+static bool isLoss(int value)
+{
+	return value && (value - 1) % 2 == 0;
+}
+
+/**
+ * A table while it is generated. Each position has a value, set once it
+ * is known, and a pending value found ahead of the ply it belongs to.
+ */
+class Generation {
+ public:
+	Generation(const TablebaseMaterial & material, const Tablebases & tables) :
+		m_material(material),
+		m_tables(tables),
+		m_size(material.getSize()),
+		m_values(m_size),
+		m_pending(m_size),
+		m_resolved(0),
+		m_max_pending(0),
+		m_failed(false) {}
+
+	/**
+	 * Works out every value. Returns false if a table it needs is
+	 * missing or a mate is too far away.
+	 */
+	bool run();
+
+	/** Returns the values, the invalid positions set like their neighbors. */
+	vector<unsigned char> getValues() const;
+
+	/** Counts the won and lost positions and finds the longest mate. */
+	void getStats(long long & wins, long long & losses, int & longest) const;
+
+	long long getSize() const
+		{ return m_size; }
+
+ private:
+	// Runs func on the JobSystem for every position, a chunk per job
+	void forEachChunk(const function<void(long long, long long)> & func);
+
+	bool isAttacked(int sq, Piece::Color by, const int * squares, int skip,
+		unsigned long long occupied) const;
+	bool isValid(const int * squares, Piece::Color turn) const;
+	// Returns false for the second index of a position on the diagonal
+	bool isCanonical(long long index, const int * squares, Piece::Color turn) const;
+
+	// The value of a position out of those of its moves, 0 if unknown
+	int evaluate(const int * squares, Piece::Color turn) const;
+	// The value of the position after a capture or promotion, in the
+	// table of what is left
+	int probeExit(const int * squares, int skip, int moved, Piece::Type promotion,
+		Piece::Color turn) const;
+	// Adds up the value of a move with those of the other moves
+	void addMove(int value, int & win, int & loss, bool & lost) const;
+
+	// Finds the positions one move before a position of the last ply
+	void retract(long long index, int ply);
+	// Sets a value found for ply, or saves it for later
+	void resolve(long long index, int value, int ply);
+
+	const TablebaseMaterial & m_material;
+	const Tablebases & m_tables;
+	long long m_size;
+	vector<atomic<unsigned char> > m_values;
+	vector<atomic<unsigned char> > m_pending;
+	atomic<long long> m_resolved;
+	atomic<int> m_max_pending;
+	mutable atomic<bool> m_failed;
+};
+
+void Generation::forEachChunk(const function<void(long long, long long)> & func)
+{
+	JobSystem * jobs = JobSystem::getInstance();
+	long long chunk = max(MIN_CHUNK, m_size / (jobs->getThreadCount() * 64));
+	vector<JobHandle<void> > handles;
+	for(long long first = 0; first < m_size; first += chunk) {
+		long long last = min(first + chunk, m_size);
+		handles.push_back(jobs->submit(JobSystem::ANALYSIS, [&func, first, last]() {
+			func(first, last);
+		}));
+	}
+	for(int i = 0; i < (int)handles.size(); i++) {
+		handles[i].wait();
+	}
+}
+
+bool Generation::isAttacked(int sq, Piece::Color by, const int * squares, int skip,
+	unsigned long long occupied) const
+{
+	for(int i = 0; i < m_material.count; i++) {
+		if(i != skip && m_material.colors[i] == by &&
+				(attacks(m_material.types[i], by, squares[i], occupied) & bit(sq))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Generation::isValid(const int * squares, Piece::Color turn) const
+{
+	unsigned long long occupied = 0;
+	for(int i = 0; i < m_material.count; i++) {
+		if(occupied & bit(squares[i])) {
+			return false;
+		}
+		if(m_material.types[i] == Piece::PAWN && (squares[i] < 8 || squares[i] >= 56)) {
+			return false;
+		}
+		occupied |= bit(squares[i]);
+	}
+
+	// The side that just moved can't be in check
+	int king = (turn == Piece::WHITE) ? 1 : 0;
+	return !isAttacked(squares[king], turn, squares, -1, occupied);
+}
+
+bool Generation::isCanonical(long long index, const int * squares, Piece::Color turn) const
+{
+	int position[MAX_PIECES];
+	for(int i = 0; i < m_material.count; i++) {
+		position[i] = squares[i];
+	}
+	return m_material.getIndex(position, turn) == index;
+}
+
+void Generation::addMove(int value, int & win, int & loss, bool & lost) const
+{
+	if(!value) {
+		lost = false;
+	} else if(isLoss(value)) {
+		win = win ? min(win, backValue(value)) : backValue(value);
+	} else {
+		loss = max(loss, backValue(value));
+	}
+}
+
+int Generation::probeExit(const int * squares, int skip, int moved, Piece::Type promotion,
+	Piece::Color turn) const
+{
+	Piece::Color colors[MAX_PIECES];
+	Piece::Type types[MAX_PIECES];
+	int left[MAX_PIECES];
+	int count = 0;
+	for(int i = 0; i < m_material.count; i++) {
+		if(i != skip) {
+			colors[count] = m_material.colors[i];
+			types[count] = (i == moved && promotion != Piece::NOTYPE) ? promotion : m_material.types[i];
+			left[count++] = squares[i];
+		}
+	}
+
+	TablebaseResult result;
+	if(!m_tables.probe(count, colors, types, left, turn, result)) {
+		LOG_ERROR("tablebase", "No table for a capture or promotion of " << m_material.getName());
+		m_failed = true;
+		return 0;
+	}
+	return (result.wdl == TablebaseResult::DRAW) ? 0 : result.dtm + 1;
+}
+
+int Generation::evaluate(const int * squares, Piece::Color turn) const
+{
+	Piece::Color other = Piece::opposite(turn);
+	int king = (turn == Piece::WHITE) ? 0 : 1;
+	int ahead = (turn == Piece::WHITE) ? 8 : -8;
+	unsigned long long occupied = 0, own = 0;
+	for(int i = 0; i < m_material.count; i++) {
+		occupied |= bit(squares[i]);
+		if(m_material.colors[i] == turn) {
+			own |= bit(squares[i]);
+		}
+	}
+
+	int win = 0, loss = 0;
+	bool moved = false, lost = true;
+	int child[MAX_PIECES];
+	for(int i = 0; i < m_material.count; i++) {
+		if(m_material.colors[i] != turn) {
+			continue;
+		}
+		int from = squares[i];
+		Piece::Type type = m_material.types[i];
+
+		unsigned long long targets;
+		if(type == Piece::PAWN) {
+			targets = Board::pawnAttacks[turn][from] & occupied & ~own;
+			if(!(occupied & bit(from + ahead))) {
+				targets |= bit(from + ahead);
+				int start = (turn == Piece::WHITE) ? 1 : 6;
+				if((from >> 3) == start && !(occupied & bit(from + 2 * ahead))) {
+					targets |= bit(from + 2 * ahead);
+				}
+			}
+		} else {
+			targets = attacks(type, turn, from, occupied) & ~own;
+		}
+
+		for(int to = 0; targets; to++, targets >>= 1) {
+			if(!(targets & 1)) {
+				continue;
+			}
+			int captured = -1;
+			for(int j = 0; j < m_material.count; j++) {
+				if(j != i && squares[j] == to) {
+					captured = j;
+				}
+			}
+			for(int j = 0; j < m_material.count; j++) {
+				child[j] = squares[j];
+			}
+			child[i] = to;
+			unsigned long long after = (occupied & ~bit(from)) | bit(to);
+			if(isAttacked(child[king], other, child, captured, after)) {
+				continue;
+			}
+			moved = true;
+
+			bool promotes = (type == Piece::PAWN) && (to < 8 || to >= 56);
+			if(promotes) {
+				for(int p = 0; p < 4; p++) {
+					addMove(probeExit(child, captured, i, PROMOTIONS[p], other), win, loss, lost);
+				}
+				continue;
+			}
+			if(captured >= 0) {
+				addMove(probeExit(child, captured, i, Piece::NOTYPE, other), win, loss, lost);
+				continue;
+			}
+
+			int next[MAX_PIECES];
+			for(int j = 0; j < m_material.count; j++) {
+				next[j] = child[j];
+			}
+			int value = m_values[m_material.getIndex(next, other)].load(memory_order_relaxed);
+
+			// After a double step the pawns next to it may take en
+			// passant, which the table of the position leaves out
+			if(type == Piece::PAWN && (to - from == 2 * ahead)) {
+				int epwin = 0, eploss = 0;
+				bool eplost = true, ep = false;
+				int otherking = 1 - king;
+				for(int j = 0; j < m_material.count; j++) {
+					if(m_material.colors[j] != other || m_material.types[j] != Piece::PAWN ||
+							(child[j] >> 3) != (to >> 3) || abs((child[j] & 7) - (to & 7)) != 1) {
+						continue;
+					}
+					int taken[MAX_PIECES];
+					for(int k = 0; k < m_material.count; k++) {
+						taken[k] = child[k];
+					}
+					taken[j] = from + ahead;
+					unsigned long long occupiedep = (after & ~bit(to) & ~bit(child[j])) | bit(from + ahead);
+					if(isAttacked(taken[otherking], turn, taken, i, occupiedep)) {
+						continue;
+					}
+					ep = true;
+					addMove(probeExit(taken, i, j, Piece::NOTYPE, turn), epwin, eploss, eplost);
+				}
+				if(ep) {
+					if(value && !isLoss(value)) {
+						epwin = epwin ? min(epwin, value) : value;
+					}
+					if(epwin) {
+						value = epwin;
+					} else if(!eplost || !isLoss(value)) {
+						value = 0;
+					} else {
+						value = max(value, eploss);
+					}
+				}
+			}
+			addMove(value, win, loss, lost);
+		}
+	}
+
+	int value;
+	if(win) {
+		value = win;
+	} else if(!moved) {
+		value = isAttacked(squares[king], other, squares, -1, occupied) ? 1 : 0;
+	} else {
+		value = lost ? loss : 0;
+	}
+	if(value > MAX_VALUE) {
+		LOG_ERROR("tablebase", "A mate of " << m_material.getName() << " is too long to keep");
+		m_failed = true;
+		return 0;
+	}
+	return value;
+}
+
+void Generation::resolve(long long index, int value, int ply)
+{
+	if(!value) {
+		return;
+	}
+	if(value == ply + 1) {
+		unsigned char unknown = 0;
+		if(m_values[index].compare_exchange_strong(unknown, (unsigned char)value,
+				memory_order_relaxed)) {
+			m_resolved++;
+		}
+		return;
+	}
+
+	unsigned char pending = m_pending[index].load(memory_order_relaxed);
+	while((pending == 0 || value < pending) &&
+			!m_pending[index].compare_exchange_weak(pending, (unsigned char)value,
+				memory_order_relaxed)) {
+	}
+	int most = m_max_pending.load(memory_order_relaxed);
+	while(value > most && !m_max_pending.compare_exchange_weak(most, value,
+			memory_order_relaxed)) {
+	}
+}
+
+void Generation::retract(long long index, int ply)
+{
+	int squares[MAX_PIECES];
+	Piece::Color turn;
+	m_material.getSquares(index, squares, turn);
+	Piece::Color mover = Piece::opposite(turn);
+	bool lost = isLoss(m_values[index].load(memory_order_relaxed));
+	int king = (turn == Piece::WHITE) ? 0 : 1;
+	int back = (mover == Piece::WHITE) ? -8 : 8;
+
+	unsigned long long occupied = 0;
+	for(int i = 0; i < m_material.count; i++) {
+		occupied |= bit(squares[i]);
+	}
+
+	int before[MAX_PIECES];
+	for(int i = 0; i < m_material.count; i++) {
+		if(m_material.colors[i] != mover) {
+			continue;
+		}
+		int sq = squares[i];
+
+		// Pawns step back, the others go back the way they came
+		unsigned long long origins;
+		bool doublestep = false;
+		if(m_material.types[i] == Piece::PAWN) {
+			origins = 0;
+			int rank = (sq + back) >> 3;
+			if(rank >= 1 && rank <= 6 && !(occupied & bit(sq + back))) {
+				origins |= bit(sq + back);
+				int fourth = (mover == Piece::WHITE) ? 3 : 4;
+				if((sq >> 3) == fourth && !(occupied & bit(sq + 2 * back))) {
+					origins |= bit(sq + 2 * back);
+				}
+			}
+		} else {
+			origins = attacks(m_material.types[i], mover, sq, occupied) & ~occupied;
+		}
+
+		for(int from = 0; origins; from++, origins >>= 1) {
+			if(!(origins & 1)) {
+				continue;
+			}
+			for(int j = 0; j < m_material.count; j++) {
+				before[j] = squares[j];
+			}
+			before[i] = from;
+			unsigned long long occupiedbefore = (occupied & ~bit(sq)) | bit(from);
+			if(isAttacked(before[king], mover, before, -1, occupiedbefore)) {
+				continue;
+			}
+			doublestep = (m_material.types[i] == Piece::PAWN) && (sq - from == -2 * back);
+
+			int position[MAX_PIECES];
+			for(int j = 0; j < m_material.count; j++) {
+				position[j] = before[j];
+			}
+			long long previous = m_material.getIndex(position, mover);
+			if(m_values[previous].load(memory_order_relaxed)) {
+				continue;
+			}
+
+			// Moving into a loss wins, unless en passant may change it, and
+			// a position is lost once all its moves are
+			if(lost && !doublestep) {
+				resolve(previous, ply + 1, ply);
+			} else {
+				resolve(previous, evaluate(before, mover), ply);
+			}
+		}
+	}
+}
+
+bool Generation::run()
+{
+	// The mates, and the values of moves that leave the table
+	forEachChunk([this](long long first, long long last) {
+		int squares[MAX_PIECES];
+		Piece::Color turn;
+		for(long long index = first; index < last; index++) {
+			m_material.getSquares(index, squares, turn);
+			if(!isValid(squares, turn) || !isCanonical(index, squares, turn)) {
+				m_pending[index] = INVALID;
+				continue;
+			}
+			int value = evaluate(squares, turn);
+			if(value == 1) {
+				m_values[index] = 1;
+			} else {
+				resolve(index, value, 0);
+			}
+		}
+	});
+
+	// Then a ply at a time, from the positions of the ply before
+	for(int ply = 1; ply < MAX_VALUE && !m_failed; ply++) {
+		m_resolved = 0;
+		forEachChunk([this, ply](long long first, long long last) {
+			for(long long index = first; index < last; index++) {
+				int value = m_values[index].load(memory_order_relaxed);
+				if(value == ply) {
+					retract(index, ply);
+				} else if(!value && m_pending[index].load(memory_order_relaxed) == ply + 1) {
+					resolve(index, ply + 1, ply);
+				}
+			}
+		});
+		if(m_resolved == 0 && m_max_pending <= ply + 1) {
+			break;
+		}
+	}
+	return !m_failed;
+}
+
+vector<unsigned char> Generation::getValues() const
+{
+	vector<unsigned char> values(m_size);
+	unsigned char last = 0;
+	for(long long index = 0; index < m_size; index++) {
+		if(m_pending[index].load(memory_order_relaxed) != INVALID) {
+			last = m_values[index].load(memory_order_relaxed);
+		}
+		values[index] = last;
+	}
+	return values;
+}
+
+void Generation::getStats(long long & wins, long long & losses, int & longest) const
+{
+	wins = losses = 0;
+	longest = 0;
+	for(long long index = 0; index < m_size; index++) {
+		int value = m_values[index].load(memory_order_relaxed);
+		if(value && m_pending[index].load(memory_order_relaxed) != INVALID) {
+			(isLoss(value) ? losses : wins)++;
+			longest = max(longest, value - 1);
+		}
+	}
+}
+
+// Returns the name of a material out of the pieces of each side
+static string materialName(const string & white, const string & black)
+{
+	return "K" + white + "vK" + black;
+}
+
+// Generates material and everything it leads to that isn't in tables yet
+static bool generateTable(const TablebaseMaterial & material, const string & dir,
+	Tablebases & tables, set<string> & done)
+{
+	string name = material.getName();
+	if(material.count < 3 || !done.insert(name).second) {
+		return true;
+	}
+
+	// A capture takes away a piece, a promotion turns a pawn into another
+	string sides[2];
+	sides[0] = name.substr(1, name.find('v') - 1);
+	sides[1] = name.substr(name.find('v') + 2);
+	for(int side = 0; side < 2; side++) {
+		for(size_t i = 0; i < sides[side].size(); i++) {
+			string left = sides[side];
+			left.erase(i, 1);
+			TablebaseMaterial captured;
+			captured.parse(side ? materialName(sides[0], left) : materialName(left, sides[1]));
+			if(!generateTable(captured, dir, tables, done)) {
+				return false;
+			}
+
+			if(sides[side][i] == 'P') {
+				for(int p = 0; p < 4; p++) {
+					string promoted = sides[side];
+					promoted[i] = "QRBN"[p];
+					TablebaseMaterial next;
+					next.parse(side ? materialName(sides[0], promoted) : materialName(promoted, sides[1]));
+					if(!generateTable(next, dir, tables, done)) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+
+	string filename = Tablebase::getFilename(dir, material);
+	unique_ptr<Tablebase> table(new Tablebase);
+	if(table->open(filename)) {
+		tables.addTable(move(table));
+		return true;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<unsigned char> values;
+	long long wins, losses;
+	int longest;
+	{
+		Generation generation(material, tables);
+		if(!generation.run()) {
+			return false;
+		}
+		values = generation.getValues();
+		generation.getStats(wins, losses, longest);
+	}
+	if(!Tablebase::write(filename, material, values.data()) || !table->open(filename)) {
+		LOG_ERROR("tablebase", "Couldn't write " << filename);
+		return false;
+	}
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	LOG_INFO("tablebase", name << ": " << values.size() << " positions, " << wins <<
+		" wins, " << losses << " losses, longest mate " << longest << " plies, " <<
+		seconds << "s");
+	tables.addTable(move(table));
+	return true;
+}
+
+bool TablebaseGenerator::generate(const string & name, const string & dir)
+{
+	TablebaseMaterial material;
+	if(!material.parse(name)) {
+		return false;
+	}
+	Tablebases tables;
+	set<string> done;
+	return generateTable(material, dir, tables, done);
+}
+
+bool TablebaseGenerator::generateAll(int pieces, const string & dir)
+{
+	vector<TablebaseMaterial> materials = TablebaseMaterial::list(min(pieces, MAX_PIECES));
+	Tablebases tables;
+	set<string> done;
+	for(int i = 0; i < (int)materials.size(); i++) {
+		if(!generateTable(materials[i], dir, tables, done)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// End of file tablebasegenerator.cpp
@@ -0,0 +1,42 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : tablebasegenerator.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#ifndef TABLEBASEGENERATOR_H
+#define TABLEBASEGENERATOR_H
+
+#include <string>
+
+/**
+ * Works out the tablebases read by Tablebases by retrograde analysis:
+ * the mates are found first, then a ply at a time every position that
+ * leads into one already known, going backwards through the moves that
+ * could have led to it. Captures and promotions are looked up in the
+ * tables of the material they lead to, which are generated first.
+ *
+ * Each ply is spread over the JobSystem. A table takes two bytes per
+ * position while it is generated, about 10 MB for four pieces without
+ * pawns, 33 MB with them and 2 GB for five pieces with pawns.
+ *
+ * Needs Board::init() to have been called.
+ */
+class TablebaseGenerator {
+ public:
+	/**
+	 * Generates the table of a material, like KRvKP, into dir with every
+	 * table it depends on. Tables already in dir are kept.
+	 * @return false if material isn't one or a table can't be written.
+	 */
+	static bool generate(const std::string & material, const std::string & dir);
+
+	/** Generates every table of up to pieces pieces, the kings included. */
+	static bool generateAll(int pieces, const std::string & dir);
+};
+
+#endif // TABLEBASEGENERATOR_H
+
+// End of file tablebasegenerator.h
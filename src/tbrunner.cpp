@@ -0,0 +1,191 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : tbrunner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "chessgamestate.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "notation.h"
+#include "tablebase.h"
+#include "tablebasegenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void printUsage()
+{
+	cerr << "Usage: chesspizza-tb [options] COMMAND [ARGS]\n\n";
+	cerr << "Generates and reads endgame tablebases, the distance to mate of every\n";
+	cerr << "position with a few pieces, worked out backwards from the mates.\n\n";
+	cerr << "Commands:\n";
+	cerr << " generate MATERIAL...\t\t Generate tables, like KRvK or KQvKR, and\n";
+	cerr << "                     \t\t those they lead to.\n";
+	cerr << " generate --pieces=N\t\t Generate every table of up to N pieces.\n";
+	cerr << " probe [FEN]\t\t\t Look up a position, the moves of it too.\n\n";
+	cerr << "Options:\n";
+	cerr << " -d DIR  --dir=DIR\t\t Directory of the tables, the current one by default.\n";
+	cerr << " -j N  --threads=N\t\t Threads used, one per core by default.\n";
+	cerr << LogOptions::usage();
+	cerr << " -h  --help\t\t\t Print this help screen.\n";
+	exit(1);
+}
+
+static string resultName(const TablebaseResult & result)
+{
+	if(result.wdl == TablebaseResult::DRAW) {
+		return "draw";
+	}
+	if(result.dtm == 0) {
+		return "mated";
+	}
+	string name = (result.wdl == TablebaseResult::WIN) ? "win" : "loss";
+	return name + " in " + to_string(result.dtm) + " plies";
+}
+
+static int probePosition(const string & dir, const string & fen)
+{
+	Tablebases tables;
+	if(!tables.open(dir)) {
+		cerr << "No tables in " << dir << endl;
+		return 1;
+	}
+	ChessGameState state;
+	if(!fen.empty() && !state.loadFEN(fen)) {
+		cerr << "Couldn't read the position " << fen << endl;
+		return 1;
+	}
+
+	const Board & board = state.getBoard();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	TablebaseResult result;
+	bool found = tables.probe(board, state.getTurn(), result);
+	double lookup = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << state.getFEN() << "\n";
+	if(!found) {
+		cout << "Not in the tables" << endl;
+		return 0;
+	}
+	cout << resultName(result) << " for the side to move\n\n";
+
+	// Every move with the result it leaves the other side, best first
+	static const Piece::Type PROMOTIONS[4] = {
+		Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT
+	};
+	const unsigned long long * legal = state.getLegalMap();
+	Piece::Color next = Piece::opposite(state.getTurn());
+	vector<pair<int, string> > moves;
+	for(int i = 0; i < Board::BOARDSIZE*Board::BOARDSIZE; i++) {
+		for(int j = 0; j < Board::BOARDSIZE*Board::BOARDSIZE; j++) {
+			if(!((legal[i] >> j) & 1)) {
+				continue;
+			}
+			BoardMove bm(BoardPosition(i), BoardPosition(j), board.getPiece(BoardPosition(i)));
+			int promotions = bm.needPromotion() ? 4 : 1;
+			for(int k = 0; k < promotions; k++) {
+				if(promotions > 1) {
+					bm.setPromotion(PROMOTIONS[k]);
+				}
+				Board after = board;
+				after.update(bm);
+				TablebaseResult reply;
+				if(!tables.probe(after, next, reply)) {
+					continue;
+				}
+
+				// Quick wins first, then draws, then slow losses
+				int order = (reply.wdl == TablebaseResult::LOSS) ? reply.dtm :
+					(reply.wdl == TablebaseResult::DRAW) ? 1000 : 2000 - reply.dtm;
+				string line = moveToSAN(state, bm) + "\t" +
+					(reply.wdl == TablebaseResult::LOSS ? "win" :
+					reply.wdl == TablebaseResult::WIN ? "loss" : "draw");
+				if(reply.wdl != TablebaseResult::DRAW) {
+					line += " in " + to_string(reply.dtm + 1) + " plies";
+				}
+				moves.push_back(make_pair(order, line));
+			}
+		}
+	}
+	stable_sort(moves.begin(), moves.end(),
+		[](const pair<int, string> & a, const pair<int, string> & b) { return a.first < b.first; });
+	for(int i = 0; i < (int)moves.size(); i++) {
+		cout << moves[i].second << "\n";
+	}
+	cout << "\nLooked up in " << lookup * 1e6 << "us" << endl;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+
+	vector<string> commands;
+	string dir = ".";
+	LogOptions logoptions;
+	int threads = 0, pieces = 0;
+
+	for(int i = 0; i < (int)args.size(); i++) {
+		if(args[i] == "-h" || args[i] == "--help") {
+			printUsage();
+		} else if(args[i] == "-d" && i + 1 < (int)args.size()) {
+			dir = args[++i];
+		} else if(args[i].substr(0, 6) == "--dir=") {
+			dir = args[i].substr(6);
+		} else if(args[i] == "-j" && i + 1 < (int)args.size()) {
+			threads = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 10) == "--threads=") {
+			threads = atoi(args[i].substr(10).c_str());
+		} else if(args[i].substr(0, 9) == "--pieces=") {
+			pieces = atoi(args[i].substr(9).c_str());
+		} else if(logoptions.parse(args[i])) {
+			// --log or --log-level
+		} else if(args[i][0] == '-') {
+			printUsage();
+		} else {
+			commands.push_back(args[i]);
+		}
+	}
+	if(!logoptions.apply()) {
+		return 1;
+	}
+	JobSystem::setThreadCount(threads);
+	Board::init();
+
+	int result = 0;
+	if(!commands.empty() && commands[0] == "generate" && (commands.size() > 1 || pieces)) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		if(pieces && !TablebaseGenerator::generateAll(pieces, dir)) {
+			result = 1;
+		}
+		for(int i = 1; i < (int)commands.size() && !result; i++) {
+			if(!TablebaseGenerator::generate(commands[i], dir)) {
+				cerr << "Couldn't generate " << commands[i] << endl;
+				result = 1;
+			}
+		}
+		if(!result) {
+			cout << "Generated in " << chrono::duration<double>(
+				chrono::steady_clock::now() - start).count() << "s" << endl;
+		}
+	} else if((commands.size() == 1 || commands.size() == 2) && commands[0] == "probe") {
+		result = probePosition(dir, commands.size() == 2 ? commands[1] : "");
+	} else {
+		printUsage();
+	}
+
+	JobSystem::destroy();
+	Logger::destroy();
+	return result;
+}
+
+// End of file tbrunner.cpp
@@ -0,0 +1,164 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : tunerunner.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+
+#include "evaltuner.h"
+#include "gamedb.h"
+#include "jobsystem.h"
+#include "logger.h"
+#include "mappedfile.h"
+#include "packedposition.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Iterations between progress reports
+static const int REPORT_INTERVAL = 50;
+
+static void printUsage()
+{
+	cerr << "Usage: chesspizza-tune [options] FILE...\n\n";
+	cerr << "Tunes the piece values and square tables of the brutal player to the\n";
+	cerr << "results of the games positions come from, and writes them in the form\n";
+	cerr << "of src/evalparams.h, to be built in.\n\n";
+	cerr << "FILE is a game database, positions of chesspizza-selfplay, or text with\n";
+	cerr << "a FEN or EPD position and the result, like 1-0 or [0.5], on each line.\n\n";
+	cerr << "Options:\n";
+	cerr << " -o FILE  --output=FILE\t Where to write the parameters, evalparams.h\n";
+	cerr << "                       \t by default.\n";
+	cerr << " -i N  --iterations=N\t\t Steps of the optimizer, 1000 by default.\n";
+	cerr << " --rate=R\t\t\t Step size in centipawns, 1 by default.\n";
+	cerr << " --skip=PLIES\t\t\t Leave out the first PLIES of each game, 8 by default.\n";
+	cerr << " --sample=N\t\t\t Read every N-th position of the games or files only.\n";
+	cerr << " -j N  --threads=N\t\t Threads used, one per core by default.\n";
+	cerr << LogOptions::usage();
+	cerr << " -h  --help\t\t\t Print this help screen.\n";
+	exit(1);
+}
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static chrono::steady_clock::time_point lastReport;
+
+static void printProgress(int iteration, double error)
+{
+	if(iteration % REPORT_INTERVAL == 0) {
+		cout << "Iteration " << iteration << ": error " << error << ", " <<
+			secondsSince(lastReport) / REPORT_INTERVAL << "s a pass" << endl;
+		lastReport = chrono::steady_clock::now();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+
+	vector<string> files;
+	string output = "evalparams.h";
+	LogOptions logoptions;
+	int threads = 0, iterations = 1000;
+	double rate = 1.0;
+	TuningFilter filter;
+
+	for(int i = 0; i < (int)args.size(); i++) {
+		if(args[i] == "-h" || args[i] == "--help") {
+			printUsage();
+		} else if(args[i] == "-o" && i + 1 < (int)args.size()) {
+			output = args[++i];
+		} else if(args[i].substr(0, 9) == "--output=") {
+			output = args[i].substr(9);
+		} else if(args[i] == "-i" && i + 1 < (int)args.size()) {
+			iterations = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 13) == "--iterations=") {
+			iterations = atoi(args[i].substr(13).c_str());
+		} else if(args[i].substr(0, 7) == "--rate=") {
+			rate = atof(args[i].substr(7).c_str());
+		} else if(args[i].substr(0, 7) == "--skip=") {
+			filter.skip = atoi(args[i].substr(7).c_str());
+		} else if(args[i].substr(0, 9) == "--sample=") {
+			filter.sample = atoi(args[i].substr(9).c_str());
+		} else if(args[i] == "-j" && i + 1 < (int)args.size()) {
+			threads = atoi(args[++i].c_str());
+		} else if(args[i].substr(0, 10) == "--threads=") {
+			threads = atoi(args[i].substr(10).c_str());
+		} else if(logoptions.parse(args[i])) {
+			// --log or --log-level
+		} else if(args[i][0] == '-') {
+			printUsage();
+		} else {
+			files.push_back(args[i]);
+		}
+	}
+	if(files.empty() || iterations < 0 || rate <= 0) {
+		printUsage();
+	}
+	if(!logoptions.apply()) {
+		return 1;
+	}
+	JobSystem::setThreadCount(threads);
+	Board::init();
+
+	// Binary files are told apart from text by opening them
+	EvalTuner tuner;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(int i = 0; i < (int)files.size(); i++) {
+		GameDatabase db;
+		PackedPositionFile packed;
+		MappedFile text;
+		long long added;
+		if(db.open(files[i])) {
+			added = tuner.addGames(db, filter);
+		} else if(packed.open(files[i])) {
+			added = tuner.addPacked(packed, filter);
+		} else if(text.open(files[i])) {
+			added = tuner.addText(text.getText());
+		} else {
+			cerr << "Couldn't read " << files[i] << endl;
+			return 1;
+		}
+		cout << "Read " << added << " positions from " << files[i] << endl;
+	}
+	if(!tuner.getPositionCount()) {
+		cerr << "No positions to tune on" << endl;
+		return 1;
+	}
+	cout << "Loaded " << tuner.getPositionCount() << " positions, " <<
+		tuner.getMemoryUsage() / tuner.getPositionCount() << " bytes each, in " <<
+		secondsSince(start) << "s" << endl;
+
+	start = chrono::steady_clock::now();
+	double scale = tuner.fitScale();
+	double error = tuner.computeError();
+	cout << "Scale " << scale << ", error " << error << endl;
+
+	lastReport = chrono::steady_clock::now();
+	tuner.setProgress(printProgress);
+	error = tuner.tune(iterations, rate);
+	cout << "Tuned in " << secondsSince(start) << "s, error " << error << endl;
+
+	int result = 0;
+	if(tuner.write(output)) {
+		cout << "Wrote " << output << endl;
+	} else {
+		cerr << "Couldn't write " << output << endl;
+		result = 1;
+	}
+
+	JobSystem::destroy();
+	Logger::destroy();
+	return result;
+}
+
+// End of file tunerunner.cpp
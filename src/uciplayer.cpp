@@ -0,0 +1,589 @@
+/***************************************************************************
+ * Brutal Chess
+ * http://brutalchess.sf.net
+ *
+ * File : uciplayer.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey
+ **************************************************************************/
+#ifndef WIN32
+
+#include "board.h"
+#include "chessgamestate.h"
+#include "chessplayer.h"
+#include "enginepool.h"
+#include "engineprocess.h"
+#include "logger.h"
+#include "notation.h"
+#include "options.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+// How long the engine gets to answer 'isready'
+static const int HANDSHAKE_TIMEOUT = 10000;
+
+// Returns the number of plies played to reach cgs
+static int plyOf(const ChessGameState & cgs)
+{
+	return (cgs.getTurnNumber() - 1) * 2 + (cgs.isWhiteTurn() ? 0 : 1);
+}
+
+UciPlayer::UciPlayer(const string & command) :
+	m_command(command),
+	m_engine(0),
+	m_reader_stop(false),
+	m_got_uciok(false),
+	m_got_readyok(false),
+	m_got_bestmove(false),
+	m_engine_dead(false),
+	m_answered(false),
+	m_start_ply(0),
+	m_pondering(false),
+	m_ponderhit(false)
+{
+	Options * opts = Options::getInstance();
+	if(m_command.empty()) {
+		m_command = opts->uciengine;
+	}
+	m_ponder = opts->uciponder;
+	m_default_movetime = opts->ucimovetime;
+	m_trustworthy = true;
+}
+
+UciPlayer::~UciPlayer()
+{
+	shutdownEngine();
+}
+
+void UciPlayer::newGame()
+{
+	if(!m_engine && !runChessEngine()) {
+		return;
+	}
+
+	forgetAnswer();
+	if(m_pondering) {
+		stopPondering();
+	}
+	m_start.clear();
+	m_start_ply = 0;
+	m_moves.clear();
+
+	// The process is reused, only its game state is reset
+	m_engine->writeLine("ucinewgame");
+	waitForReady();
+}
+
+void UciPlayer::loadGame(const ChessGameState& cgs)
+{
+	forgetAnswer();
+	if(m_pondering) {
+		stopPondering();
+	}
+	m_start = cgs.getFEN();
+	m_start_ply = plyOf(cgs);
+	m_moves.clear();
+}
+
+bool UciPlayer::runChessEngine()
+{
+	// The pool hands out engines that have already answered 'uci'
+	EnginePool * pool = EnginePool::getInstance();
+	m_engine = pool->lease(m_command, EnginePool::UCI);
+	if(!m_engine) {
+		LOG_ERROR("uci", m_command << " does not speak UCI");
+		return false;
+	}
+
+	m_got_uciok = m_got_readyok = m_got_bestmove = m_engine_dead = false;
+	m_name = pool->getName(m_engine);
+	m_reader_stop = false;
+	m_reader = thread(&UciPlayer::readerLoop, this);
+
+	if(m_ponder) {
+		m_engine->writeLine("setoption name Ponder value true");
+	}
+	for(int i = 0; i < (int)m_options.size(); i++) {
+		m_engine->writeLine("setoption name " + m_options[i].first +
+			" value " + m_options[i].second);
+	}
+	if(!waitForReady()) {
+		shutdownEngine();
+		return false;
+	}
+	return true;
+}
+
+void UciPlayer::shutdownEngine()
+{
+	if(!m_engine) {
+		return;
+	}
+
+	// Leave the engine idle, the pool resets it for the next player
+	m_engine->writeLine("stop");
+	m_reader_stop = true;
+	if(m_reader.joinable()) {
+		m_reader.join();
+	}
+	if(m_request) {
+		m_request->abandon();
+		m_request.reset();
+		m_request_state.reset();
+	}
+	EnginePool::getInstance()->release(m_engine);
+	m_engine = 0;
+	m_pondering = false;
+}
+
+void UciPlayer::readerLoop()
+{
+	string line;
+	while(!m_reader_stop) {
+		if(!m_engine->readLine(line, 100)) {
+			if(m_engine->atEof()) {
+				break;
+			}
+			continue;
+		}
+
+		string token;
+		stringstream ss(line);
+		ss >> token;
+
+		if(token == "info") {
+			parseInfo(line);
+			continue;
+		}
+
+		if(token == "bestmove") {
+			string best, ponder;
+			ss >> best;
+			if(ss >> token && token == "ponder") {
+				ss >> ponder;
+			}
+
+			// A pending request is answered here, else think() or
+			// stopPondering() is waiting for the move
+			MoveRequestPtr request;
+			ChessGameStatePtr state;
+			{
+				lock_guard<mutex> lock(m_mutex);
+				request.swap(m_request);
+				state.swap(m_request_state);
+				if(!request) {
+					m_bestmove = best;
+					m_bestponder = ponder;
+					m_got_bestmove = true;
+				}
+			}
+			m_cond.notify_all();
+			if(request) {
+				answerRequest(request, *state, best, ponder);
+			}
+			continue;
+		}
+
+		lock_guard<mutex> lock(m_mutex);
+		if(token == "uciok") {
+			m_got_uciok = true;
+		} else if(token == "readyok") {
+			m_got_readyok = true;
+		} else if(token == "id") {
+			if(ss >> token && token == "name") {
+				getline(ss >> ws, m_name);
+			}
+			continue;
+		} else {
+			continue;
+		}
+		m_cond.notify_all();
+	}
+
+	MoveRequestPtr request;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_engine_dead = true;
+		request.swap(m_request);
+		m_request_state.reset();
+	}
+	m_cond.notify_all();
+	if(request) {
+		m_is_thinking = false;
+		request->complete(BoardMove());
+	}
+}
+
+void UciPlayer::parseInfo(const string & line)
+{
+	SearchInfo info;
+	bool useful = false;
+	string token;
+	stringstream ss(line);
+	ss >> token;
+
+	while(ss >> token) {
+		if(token == "depth") {
+			ss >> info.depth;
+		} else if(token == "seldepth") {
+			ss >> info.seldepth;
+		} else if(token == "nodes") {
+			ss >> info.nodes;
+		} else if(token == "nps") {
+			ss >> info.nps;
+		} else if(token == "time") {
+			ss >> info.time;
+		} else if(token == "score") {
+			ss >> token;
+			if(token == "cp") {
+				ss >> info.score;
+			} else if(token == "mate") {
+				ss >> info.mate;
+			}
+			useful = true;
+		} else if(token == "pv") {
+			getline(ss >> ws, info.pv);
+			useful = true;
+		} else if(token == "string") {
+			// Free text until the end of the line
+			return;
+		}
+	}
+
+	if(!useful) {
+		return;
+	}
+
+	function<void(const SearchInfo &)> cb;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_info = info;
+		cb = m_info_callback;
+	}
+	if(cb) {
+		cb(info);
+	}
+}
+
+bool UciPlayer::waitForReady()
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_got_readyok = false;
+	lock.unlock();
+
+	m_engine->writeLine("isready");
+
+	lock.lock();
+	return m_cond.wait_for(lock, chrono::milliseconds(HANDSHAKE_TIMEOUT),
+		[this] { return m_got_readyok || m_engine_dead; }) && !m_engine_dead;
+}
+
+bool UciPlayer::waitForBestMove(string & best, string & ponder)
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_cond.wait(lock, [this] { return m_got_bestmove || m_engine_dead; });
+	if(!m_got_bestmove) {
+		return false;
+	}
+	m_got_bestmove = false;
+	best = m_bestmove;
+	ponder = m_bestponder;
+	return true;
+}
+
+bool UciPlayer::reachesPosition(const ChessGameState & cgs) const
+{
+	return m_start_ply + (int)m_moves.size() == plyOf(cgs);
+}
+
+void UciPlayer::sendPosition(const string & extra)
+{
+	string cmd = m_start.empty() ? "position startpos" : "position fen " + m_start;
+	if(!m_moves.empty() || !extra.empty()) {
+		cmd += " moves";
+		for(int i = 0; i < (int)m_moves.size(); i++) {
+			cmd += ' ';
+			cmd += m_moves[i];
+		}
+		if(!extra.empty()) {
+			cmd += ' ';
+			cmd += extra;
+		}
+	}
+	m_engine->writeLine(cmd);
+}
+
+string UciPlayer::goCommand(bool ponder) const
+{
+	stringstream ss;
+	ss << "go";
+	if(ponder) {
+		ss << " ponder";
+	}
+
+	if(m_limits.hasClock()) {
+		ss << " wtime " << m_limits.wtime << " btime " << m_limits.btime;
+		if(m_limits.winc) {
+			ss << " winc " << m_limits.winc;
+		}
+		if(m_limits.binc) {
+			ss << " binc " << m_limits.binc;
+		}
+		if(m_limits.movestogo) {
+			ss << " movestogo " << m_limits.movestogo;
+		}
+	}
+	if(m_limits.movetime) {
+		ss << " movetime " << m_limits.movetime;
+	}
+	if(m_limits.depth) {
+		ss << " depth " << m_limits.depth;
+	}
+	if(m_limits.nodes) {
+		ss << " nodes " << m_limits.nodes;
+	}
+
+	// Never let the engine think unbounded unless asked to
+	if(m_limits.isEmpty()) {
+		ss << " movetime " << m_default_movetime;
+	}
+	return ss.str();
+}
+
+void UciPlayer::think(const ChessGameState & cgs)
+{
+	m_is_thinking = true;
+	m_move.invalidate();
+
+	if(!m_engine && !runChessEngine()) {
+		m_is_thinking = false;
+		return;
+	}
+
+	startThinking(cgs);
+	string best, ponder;
+	if(waitForBestMove(best, ponder)) {
+		playBestMove(cgs, best, ponder);
+	}
+	m_is_thinking = false;
+}
+
+MoveRequestPtr UciPlayer::requestMove(const ChessGameStatePtr & state,
+	const SearchLimits & limits, const MoveCallback & callback)
+{
+	// Starting the engine takes a while, which is left to a job
+	if(!m_engine) {
+		return ChessPlayer::requestMove(state, limits, callback);
+	}
+
+	MoveRequestPtr request(new MoveRequest(this, callback, true));
+	setLimits(limits);
+	m_is_thinking = true;
+	m_move.invalidate();
+	startThinking(*state);
+
+	// A ponder that hit may have finished already
+	string best, ponder;
+	bool answered = false;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if(m_got_bestmove || m_engine_dead) {
+			answered = m_got_bestmove;
+			m_got_bestmove = false;
+			best = m_bestmove;
+			ponder = m_bestponder;
+		} else {
+			m_request = request;
+			m_request_state = state;
+			return request;
+		}
+	}
+	if(answered) {
+		answerRequest(request, *state, best, ponder);
+	} else {
+		m_is_thinking = false;
+		request->complete(BoardMove());
+	}
+	return request;
+}
+
+void UciPlayer::answerRequest(const MoveRequestPtr & request,
+	const ChessGameState & cgs, const string & best, const string & ponder)
+{
+	// This runs on the reader thread, so only the request's own state is
+	// read. The game thread records the move in moveMade().
+	BoardMove move = coordinateToMove(cgs.getBoard(), best);
+	if(move.isValid()) {
+		lock_guard<mutex> lock(m_mutex);
+		m_answered = true;
+		m_answer_ponder = ponder;
+	}
+	m_is_thinking = false;
+	request->complete(move);
+}
+
+void UciPlayer::forgetAnswer()
+{
+	// An answer that wasn't played by now was cancelled
+	lock_guard<mutex> lock(m_mutex);
+	m_answered = false;
+}
+
+void UciPlayer::startThinking(const ChessGameState & cgs)
+{
+	forgetAnswer();
+
+	// A game that was set up or joined without its moves, the engine gets
+	// the position itself
+	if(!reachesPosition(cgs)) {
+		if(m_pondering) {
+			stopPondering();
+		}
+		m_start = cgs.getFEN();
+		m_start_ply = plyOf(cgs);
+		m_moves.clear();
+	}
+
+	// A ponder that missed has already been stopped in opponentMove, one
+	// that hit keeps running and only its 'bestmove' has to be collected.
+	if(m_pondering && !m_ponderhit) {
+		stopPondering();
+	}
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_info = SearchInfo();
+	}
+	if(!m_pondering) {
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_got_bestmove = false;
+		}
+		sendPosition("");
+		m_engine->writeLine(goCommand(false));
+	}
+	m_pondering = false;
+	m_ponderhit = false;
+}
+
+void UciPlayer::playBestMove(const ChessGameState & cgs, const string & best,
+	const string & ponder)
+{
+	m_move = coordinateToMove(cgs.getBoard(), best);
+	if(m_move.isValid()) {
+		m_moves.push_back(moveToCoordinate(m_move));
+		if(m_ponder && !ponder.empty()) {
+			startPondering(ponder);
+		}
+	}
+}
+
+void UciPlayer::opponentMove(const BoardMove & move, const ChessGameState &)
+{
+	forgetAnswer();
+	string movestr = moveToCoordinate(move);
+
+	if(m_pondering) {
+		if(movestr == m_pondermove) {
+			// The engine guessed right, its search simply continues
+			m_engine->writeLine("ponderhit");
+			m_ponderhit = true;
+		} else {
+			stopPondering();
+		}
+	}
+	m_moves.push_back(movestr);
+}
+
+void UciPlayer::moveMade(const BoardMove & move, const ChessGameState &)
+{
+	string ponder;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if(!m_answered) {
+			return;
+		}
+		m_answered = false;
+		ponder = m_answer_ponder;
+	}
+
+	m_moves.push_back(moveToCoordinate(move));
+	if(m_ponder && !ponder.empty()) {
+		startPondering(ponder);
+	}
+}
+
+void UciPlayer::interruptThinking()
+{
+	if(m_engine && m_is_thinking) {
+		m_engine->writeLine("stop");
+	}
+	m_is_thinking = false;
+}
+
+void UciPlayer::undoMove()
+{
+	forgetAnswer();
+	if(m_pondering) {
+		stopPondering();
+	}
+	if(!m_moves.empty()) {
+		m_moves.pop_back();
+	}
+}
+
+void UciPlayer::setOption(const string & name, const string & value)
+{
+	m_options.push_back(make_pair(name, value));
+	if(m_engine) {
+		m_engine->writeLine("setoption name " + name + " value " + value);
+	}
+}
+
+string UciPlayer::getEngineName() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_name;
+}
+
+SearchInfo UciPlayer::getLastInfo() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_info;
+}
+
+void UciPlayer::setInfoCallback(const function<void(const SearchInfo &)> & cb)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_info_callback = cb;
+}
+
+void UciPlayer::startPondering(const string & ponder)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_got_bestmove = false;
+	}
+	m_pondermove = ponder;
+	sendPosition(ponder);
+	m_engine->writeLine(goCommand(true));
+	m_pondering = true;
+	m_ponderhit = false;
+}
+
+void UciPlayer::stopPondering()
+{
+	// The engine must answer a 'stop' with a 'bestmove', which is
+	// thrown away since it was computed for the wrong position.
+	m_engine->writeLine("stop");
+	string best, ponder;
+	waitForBestMove(best, ponder);
+	m_pondering = false;
+	m_ponderhit = false;
+}
+
+#endif
+
+// end of file uciplayer.cpp
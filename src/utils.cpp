@@ -6,10 +6,15 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey
  **************************************************************************/
 
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "bench.h"
+#include "chessclock.h"
+#include "enginepool.h"
+#include "logger.h"
 #include "options.h"
 #include "utils.h"
 
@@ -18,6 +23,10 @@ using namespace std;
 void Quit(int returnCode)
 {
 	// Delete our singleton class here
+#ifndef WIN32
+	EnginePool::destroy();
+#endif
+	Logger::destroy();
 	SDL_Quit();
 	exit(returnCode);
 }
@@ -29,14 +38,26 @@ void printUsage()
 	cerr << endl << endl << endl;
 	cerr << " -a  --animations=on|off\t\t\t Turn off animations, on by default.";
 	cerr << endl << endl;
+	cerr << " --analysis-cache=FILE\t\t\t\t Let the brutal player keep its searches in FILE and reuse them.";
+	cerr << endl << endl;
+	cerr << " --bench[=DEPTH]\t\t\t\t Search the benchmark positions, print nodes and speed, and exit.";
+	cerr << endl << endl;
 	cerr << " -b BOARD_THEME  --board=BOARD_THEME\t\t Set the in-game board. Choices are granite.";
 	cerr << endl << endl;
+	cerr << " --book=FILE\t\t\t\t\t Play the openings of the brutal player from a book.";
+	cerr << endl << endl;
+	cerr << " --engine-pool=COUNT\t\t\t\t Engines kept running between games, 1 by default.";
+	cerr << endl << endl;
 	cerr << " -f  --fullscreen=on|off\t\t\t Play in fullscreen mode, windowed by default.";
         cerr << endl << endl;
 	cerr << " -h  --help\t\t\t\t\t Print this help screen.";
 	cerr << endl << endl;
 	cerr << " -l PLAYER1 PLAYER2  --player1=PLAYER1\t\t Set your player and opponent. Choices are brutal,\n";
-	cerr << "                     --player2=PLAYER2\t\t faile, human, random, test, xboard.";
+	cerr << "                     --player2=PLAYER2\t\t faile, human, mcts, random, test, uci, xboard.";
+	cerr << endl << endl;
+	cerr << " --mate-check=NODES\t\t\t\t Let the brutal player look for a forced mate first, in NODES positions.";
+	cerr << endl << endl;
+	cerr << " --ponder=on|off\t\t\t\t Let the uci engine think on your time, off by default.";
 	cerr << endl << endl;
 	cerr << " -p PIECE_SET  --pieces=PIECE_SET\t\t Select the piece set. Choices are basic, quake.";
 	cerr << endl << endl;
@@ -44,6 +65,17 @@ void printUsage()
 	cerr << endl << endl;
 	cerr << " -s  --shadows=on|off\t\t\t\t Turn off shadows, on by default.";
 	cerr << endl << endl;
+	cerr << " --tablebases=DIR\t\t\t\t Let the brutal player look up endings in the tablebases of DIR.";
+	cerr << endl << endl;
+	cerr << " --tc=[MOVES/]SECONDS[+INC]\t\t\t Give both players a clock, e.g. 300+2 or 40/5400. A dDELAY\n";
+	cerr << "                           \t\t\t or bDELAY suffix adds a simple or Bronstein delay.";
+	cerr << endl << endl;
+	cerr << " --threads=COUNT\t\t\t\t Worker threads for thinking and loading, one per core by default.";
+	cerr << endl << endl;
+	cerr << " --uci-engine=COMMAND\t\t\t\t Engine run by the uci player, stockfish by default.";
+	cerr << endl << endl;
+	cerr << " --uci-movetime=MILLISECONDS\t\t\t Time the uci engine gets per move, 1000 by default.";
+	cerr << endl << endl;
 	cerr << " -z WIDTHxHEIGHT  --resolution=WIDTHxHEIGHT\t Set screen resolution. Currently support 640x480,\n";
 	cerr << "                                           \t 800x600, 1024x768, 1280x1024, 1400x1050, 1600x1200.";
 	cerr << endl << endl;
@@ -60,7 +92,17 @@ void parseCommandLine(int argc, char* argv[])
 
 	// -z WIDTHxHEIGHT  --resolution=WIDTHxHEIGHT
 	for(int i=0; i < args.size(); i++) {
-		if(args[i].substr(0,13) == "--animations=") {
+		if(args[i] == "--bench" || args[i].substr(0,8) == "--bench=") {
+			int depth = BENCH_DEPTH;
+			if(args[i].size() > 8) {
+				depth = atoi(args[i].substr(8).c_str());
+				if(depth <= 0) {
+					printUsage();
+				}
+			}
+			runBench(depth);
+			Quit(0);
+		} else if(args[i].substr(0,13) == "--animations=") {
 			if(args[i].substr(13,3) == "on") {
 				opts->animations = true;
 			} else if(args[i].substr(13,4) == "off") {
@@ -100,10 +142,14 @@ void parseCommandLine(int argc, char* argv[])
 				opts->player1 = BRUTAL;
 			} else if(args[i+1] == "human") {
 				opts->player1 = HUMAN;
+			} else if(args[i+1] == "mcts") {
+				opts->player1 = MCTS;
 			} else if(args[i+1] == "random") {
 				opts->player1 = RANDOM;
 			} else if(args[i+1] == "test") {
 				opts->player1 = TEST;
+			} else if(args[i+1] == "uci") {
+				opts->player1 = UCI;
 			} else if(args[i+1] == "xboard") {
 				opts->player1 = XBOARD;
 			} else {
@@ -113,10 +159,14 @@ void parseCommandLine(int argc, char* argv[])
 				opts->player1 = BRUTAL;
 			} else if(args[i+2] == "human") {
 				opts->player1 = HUMAN;
+			} else if(args[i+2] == "mcts") {
+				opts->player1 = MCTS;
 			} else if(args[i+2] == "random") {
 				opts->player1 = RANDOM;
 			} else if(args[i+2] == "test") {
 				opts->player1 = TEST;
+			} else if(args[i+2] == "uci") {
+				opts->player1 = UCI;
 			} else if(args[i+2] == "xboard") {
 				opts->player1 = XBOARD;
 			} else {
@@ -128,10 +178,14 @@ void parseCommandLine(int argc, char* argv[])
 				opts->player1 = BRUTAL;
 			} else if(args[i].substr(10, 10) == "human") {
 				opts->player1 = HUMAN;
+			} else if(args[i].substr(10, 10) == "mcts") {
+				opts->player1 = MCTS;
 			} else if(args[i].substr(10, 10) == "random") {
 				opts->player1 = RANDOM;
 			} else if(args[i].substr(10, 10) == "test") {
 				opts->player1 = TEST;
+			} else if(args[i].substr(10, 10) == "uci") {
+				opts->player1 = UCI;
 			} else if(args[i].substr(10, 10) == "xboard") {
 				opts->player1 = XBOARD;
 			} else {
@@ -142,10 +196,14 @@ void parseCommandLine(int argc, char* argv[])
 				opts->player2 = BRUTAL;
 			} else if(args[i].substr(10, 10) == "human") {
 				opts->player2 = HUMAN;
+			} else if(args[i].substr(10, 10) == "mcts") {
+				opts->player2 = MCTS;
 			} else if(args[i].substr(10, 10) == "random") {
 				opts->player2 = RANDOM;
 			} else if(args[i].substr(10, 10) == "test") {
 				opts->player2 = TEST;
+			} else if(args[i].substr(10, 10) == "uci") {
+				opts->player2 = UCI;
 			} else if(args[i].substr(10, 10) == "xboard") {
 				opts->player2 = XBOARD;
 			} else {
@@ -172,6 +230,50 @@ void parseCommandLine(int argc, char* argv[])
 			} else {
 				printUsage();
 			}
+		} else if(args[i].substr(0,13) == "--tablebases=") {
+			opts->tablebases = args[i].substr(13);
+			if(opts->tablebases.empty()) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,13) == "--mate-check=") {
+			opts->matecheck = atoi(args[i].substr(13).c_str());
+			if(opts->matecheck <= 0) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,17) == "--analysis-cache=") {
+			opts->analysiscache = args[i].substr(17);
+			if(opts->analysiscache.empty()) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,7) == "--book=") {
+			opts->bookfile = args[i].substr(7);
+			if(opts->bookfile.empty()) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,14) == "--engine-pool=") {
+			opts->enginepool = atoi(args[i].substr(14).c_str());
+			if(opts->enginepool < 0) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,5) == "--tc=") {
+			TimeControl tc;
+			opts->timecontrol = args[i].substr(5);
+			if(!TimeControl::parse(opts->timecontrol, tc)) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,10) == "--threads=") {
+			opts->jobthreads = atoi(args[i].substr(10).c_str());
+			if(opts->jobthreads < 0) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,9) == "--ponder=") {
+			if(args[i].substr(9,3) == "on") {
+				opts->uciponder = true;
+			} else if(args[i].substr(9,4) == "off") {
+				opts->uciponder = false;
+			} else {
+				printUsage();
+			}
 		} else if(args[i].substr(0,14) == "--reflections=") {
 			if(args[i].substr(14,3) == "on") {
 				opts->reflections = true;
@@ -188,6 +290,16 @@ void parseCommandLine(int argc, char* argv[])
 			} else {
 				printUsage();
 			}
+		} else if(args[i].substr(0,13) == "--uci-engine=") {
+			opts->uciengine = args[i].substr(13);
+			if(opts->uciengine.empty()) {
+				printUsage();
+			}
+		} else if(args[i].substr(0,15) == "--uci-movetime=") {
+			opts->ucimovetime = atoi(args[i].substr(15).c_str());
+			if(opts->ucimovetime <= 0) {
+				printUsage();
+			}
 		} else if(args[i] == "-z" && numParams(args,i) == 1) {
 			if(args[i+1] == "640x480") {
 				opts->resolution = r640X480;
@@ -257,6 +369,8 @@ ChessPlayer* toPlayer(PlayerType player)
 		return new BrutalPlayer();
 	} else if(player == HUMAN) {
 		return new HumanPlayer();
+	} else if(player == MCTS) {
+		return new MctsPlayer();
 	} else if(player == RANDOM) {
 		return new RandomPlayer();
 //	} else if(player == TEST) {
@@ -265,6 +379,8 @@ ChessPlayer* toPlayer(PlayerType player)
 #ifndef WIN32
 	else if(player == FAILE) {
 		return new FailePlayer();
+	} else if(player == UCI) {
+		return new UciPlayer(Options::getInstance()->uciengine);
 	} else if(player == XBOARD) {
 		return new XboardPlayer();
 	} 
@@ -272,6 +388,36 @@ ChessPlayer* toPlayer(PlayerType player)
 	printUsage();
 }
 
+void startEngines()
+{
+#ifndef WIN32
+	Options * opts = Options::getInstance();
+	EnginePool * pool = EnginePool::getInstance();
+	PlayerType players[2] = { opts->player1, opts->player2 };
+
+	// Both sides may be the same engine, which then needs two of them
+	int count[3] = { 0, 0, 0 };
+	for(int i = 0; i < 2; i++) {
+		if(players[i] == UCI) {
+			count[0] += opts->enginepool;
+		} else if(players[i] == XBOARD) {
+			count[1] += opts->enginepool;
+		} else if(players[i] == FAILE) {
+			count[2] += opts->enginepool;
+		}
+	}
+	if(count[0]) {
+		pool->prespawn(opts->uciengine, EnginePool::UCI, count[0]);
+	}
+	if(count[1]) {
+		pool->prespawn("gnuchess", EnginePool::XBOARD, count[1], 20);
+	}
+	if(count[2]) {
+		pool->prespawn("./faile", EnginePool::XBOARD, count[2], 20);
+	}
+#endif
+}
+
 PieceSet* toPieces(PiecesType pieces)
 {
 	if(pieces == BASIC) {
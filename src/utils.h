@@ -22,6 +22,12 @@ BoardTheme* toBoard(BoardType board);
 ChessPlayer* toPlayer(PlayerType player);
 PieceSet* toPieces(PiecesType pieces);
 
+/**
+ * Starts the external engines picked on the command line ahead of time,
+ * so the first game doesn't wait on them.
+ */
+void startEngines();
+
 void parseCommandLine(int argc, char* argv[]);
 
 void printUsage();
@@ -10,83 +10,142 @@
 #include "board.h"
 #include "chessgamestate.h"
 #include "chessplayer.h"
+#include "enginepool.h"
+#include "engineprocess.h"
+#include "logger.h"
 
-#include <cassert>
+#include <chrono>
 #include <sstream>
 #include <string>
 
 using namespace std;
 
+// How often think() looks whether it was interrupted
+static const int INTERRUPT_CHECK = 100;
 
-XboardPlayer::XboardPlayer()
+XboardPlayer::XboardPlayer() :
+	XboardPlayer("gnuchess", "My move is:", "xboard", true)
+{
+}
+
+XboardPlayer::XboardPlayer(const string & command, const string & moveprefix,
+	const char * category, bool sendpromotion) :
+	m_command(command),
+	m_moveprefix(moveprefix),
+	m_category(category),
+	m_sendpromotion(sendpromotion),
+	m_engine(0),
+	m_initialized(false),
+	m_reader_stop(false),
+	m_got_move(false),
+	m_engine_dead(false)
 {
 	m_trustworthy = true;
 }
 
 XboardPlayer::~XboardPlayer()
 {
-	write(m_to[1], "quit\n", 5);
+	m_reader_stop = true;
+	if(m_reader.joinable()) {
+		m_reader.join();
+	}
+	if(m_request) {
+		m_request->abandon();
+	}
+
+	// The engine goes back to the pool instead of being quit, the next
+	// player gets it without waiting for it to start up again
+	EnginePool::getInstance()->release(m_engine);
 }
 
 void XboardPlayer::newGame()
 {
-	runChessEngine();
+	if(!m_initialized) {
+		runChessEngine();
+	} else {
+		// A move left over from the last game is of no use
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_got_move = false;
+		}
+		m_engine->writeLine("new");
+	}
 }
 
-void XboardPlayer::loadGame(const ChessGameState& cgs)
+void XboardPlayer::loadGame(const ChessGameState&)
 {
 }
 
 void XboardPlayer::startGame()
 {
-	if(m_is_white)
-		write(m_to[1], "go\n", 3);
+	if(m_is_white && m_initialized)
+		m_engine->writeLine("go");
 }
 
-// Set up gnuchess
 void XboardPlayer::runChessEngine()
 {
-	pipe( m_to );
-	pipe( m_from );
-
-	if (fork() == 0) {
-		// Child Process
-		nice( 20 );
-		dup2( m_to[0], 0 );
-		dup2( m_from[1], 1 );
-		close( m_to[0] );
-		close( m_to[1] );
-		close( m_from[0] );
-		execvp( "gnuchess", NULL );
-		cerr << "Couldn't run gnuchess" << endl;
+	m_engine = EnginePool::getInstance()->lease(m_command, EnginePool::XBOARD, 20);
+	m_initialized = (m_engine != 0);
+	if(m_initialized) {
+		m_reader_stop = false;
+		m_engine_dead = false;
+		m_reader = thread(&XboardPlayer::readerLoop, this);
 	}
-	write( m_to[1], "xboard\n", 7);
-	m_initialized = true;
 }
 
-// Get a move from GnuChess
-void XboardPlayer::think(const ChessGameState & cgs)
+void XboardPlayer::readerLoop()
 {
-	if (!m_initialized)
-		runChessEngine();
-	
 	string output;
-	char c;
-	while ( output.substr(0, 11) != "My move is:") {
-		output = "";
-		while ( read( m_from[0], &c, 1 ) ) {
-			if ( c == '\n' )
+	while(!m_reader_stop) {
+		if(!m_engine->readLine(output, 100)) {
+			if(m_engine->atEof()) {
 				break;
-			output += c;
+			}
+			continue;
+		}
+		LOG_DEBUG(m_category, "< " << output);
+		if(output.compare(0, m_moveprefix.size(), m_moveprefix) != 0) {
+			continue;
+		}
+		string reply = output.substr(m_moveprefix.size());
+
+		MoveRequestPtr request;
+		ChessGameStatePtr state;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			request.swap(m_request);
+			state.swap(m_request_state);
+			if(!request) {
+				m_reply = reply;
+				m_got_move = true;
+			}
+		}
+		m_cond.notify_all();
+		if(request) {
+			m_is_thinking = false;
+			request->complete(parseMove(reply, *state));
 		}
-		cout << output << endl;
 	}
-	output = output.substr(12, 5);
 
-	cout << output << endl;
-	
-	// Construct a BoardMove from the move string.
-	stringstream oss(output);
+	// The engine died, there is no move to make
+	MoveRequestPtr request;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_engine_dead = true;
+		request.swap(m_request);
+		m_request_state.reset();
+	}
+	m_cond.notify_all();
+	if(request) {
+		m_is_thinking = false;
+		request->complete(BoardMove());
+	}
+}
+
+BoardMove XboardPlayer::parseMove(const string & reply, const ChessGameState & cgs) const
+{
+	stringstream oss(reply);
+	char c;
 	int rank;
 		
 	oss >> c;
@@ -96,43 +155,105 @@ void XboardPlayer::think(const ChessGameState & cgs)
 	oss >> c;
 	oss >> rank;
 	BoardPosition dest(c, rank);
+
+	char promote;
+	if(oss.get(promote) && promote != ' ') {
+		LOG_DEBUG(m_category, "Pawn promotion: " << promote);
+	}
 	
 	Board b = cgs.getBoard();
-	BoardMove move(origin, dest, b.getPiece(origin));
-	m_move = move;
+	return BoardMove(origin, dest, b.getPiece(origin));
 }
 
-// Send your move to GnuChess
-void XboardPlayer::opponentMove(const BoardMove & move, const ChessGameState & cgs)
+// Get a move from the engine
+void XboardPlayer::think(const ChessGameState & cgs)
 {
+	m_is_thinking = true;
+	m_move.invalidate();
 	if (!m_initialized)
 		runChessEngine();
-
-	Board board = cgs.getBoard();
+	if (!m_initialized) {
+		m_is_thinking = false;
+		return;
+	}
 	
-	Piece * piece = board.getPiece(move.dest());
+	// The reader thread keeps a move that came before it was asked for
+	unique_lock<mutex> lock(m_mutex);
+	while(!m_got_move && !m_engine_dead && m_is_thinking) {
+		m_cond.wait_for(lock, chrono::milliseconds(INTERRUPT_CHECK));
+	}
+	m_is_thinking = false;
+	if(!m_got_move) {
+		// Interrupted, or the engine died, there is no move to make
+		return;
+	}
+	m_got_move = false;
+	m_move = parseMove(m_reply, cgs);
+}
+
+void XboardPlayer::interruptThinking()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_is_thinking = false;
+	}
+	m_cond.notify_all();
+}
+
+MoveRequestPtr XboardPlayer::requestMove(const ChessGameStatePtr & state,
+	const SearchLimits & limits, const MoveCallback & callback)
+{
+	// Starting the engine takes a while, which is left to a job
+	if(!m_initialized) {
+		return ChessPlayer::requestMove(state, limits, callback);
+	}
+
+	// The engine thinks on its own once it has the opponent's move, it
+	// may have answered already
+	MoveRequestPtr request(new MoveRequest(this, callback, false));
+	BoardMove move;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if(!m_got_move && !m_engine_dead) {
+			m_request = request;
+			m_request_state = state;
+			m_is_thinking = true;
+			return request;
+		}
+		if(m_got_move) {
+			move = parseMove(m_reply, *state);
+			m_got_move = false;
+		}
+	}
+	request->complete(move);
+	return request;
+}
+
+// Send your move to the engine
+void XboardPlayer::opponentMove(const BoardMove & move, const ChessGameState &)
+{
+	if (!m_initialized)
+		runChessEngine();
+	if (!m_initialized)
+		return;
 
-	int characters = 5;
 	string movestr = "";
 	movestr += move.origin().filec();
 	movestr += '0' + move.origin().rank();
 	movestr += move.dest().filec();
 	movestr += '0' + move.dest().rank();
-	if(move.getPromotion() != Piece::NOTYPE) {
+	if(m_sendpromotion && move.getPromotion() != Piece::NOTYPE) {
 		movestr += 'q';
-		characters++;
 	}
-	movestr += '\n';
-
-	cout << movestr << endl;
 
-	write( m_to[1], movestr.c_str(), characters);
+	LOG_DEBUG(m_category, "> " << movestr);
+	m_engine->writeLine(movestr);
 }
 
 void XboardPlayer::undoMove()
 {
-	string undo = "undo\n";
-	write(m_to[1], undo.c_str(), 5);
+	if (m_initialized)
+		m_engine->writeLine("undo");
 }
 
 #endif